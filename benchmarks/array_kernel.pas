@@ -0,0 +1,26 @@
+program array_kernel;
+const
+    n = 4096;
+var
+    i, k: integer;
+    sum, half: real;
+    x, y, z: array[1..n] of real;
+    p, q: array[0..n] of integer;
+begin
+    for i := 1 to n do
+    begin
+        x[i] := i;
+        y[i] := n - i;
+    end;
+    half := 0.5;
+    for k := 1 to 2000 do
+    begin
+        for i := 1 to n do z[i] := x[i] * half;
+        for i := 1 to n do x[i] := z[i] + y[i];
+        for i := 0 to n do p[i] := q[i] + k;
+    end;
+    sum := 0;
+    for i := 1 to n do
+        sum := sum + (x[i] - y[i] * 2) + p[i mod 100];
+    Writeln(sum:16:2);
+end.
@@ -0,0 +1,32 @@
+program branches;
+var
+    n, x, steps, longest, best, small, large: integer;
+begin
+    longest := 0;
+    best := 0;
+    small := 0;
+    large := 0;
+    for n := 1 to 30000 do
+    begin
+        x := n;
+        steps := 0;
+        while x <> 1 do
+        begin
+            if x mod 2 = 0 then
+                x := x div 2
+            else
+                x := 3 * x + 1;
+            steps := steps + 1;
+        end;
+        if steps > longest then
+        begin
+            longest := steps;
+            best := n;
+        end
+        else if steps < 50 then
+            small := small + 1
+        else if (steps > 200) and (n mod 2 = 1) then
+            large := large + 1;
+    end;
+    Writeln(best, ' ', longest, ' ', small, ' ', large);
+end.
@@ -0,0 +1,27 @@
+program float_kernel;
+var
+    i, k: integer;
+    pi, sign, x, guess, area, step: real;
+begin
+    pi := 0.0;
+    sign := 1.0;
+    for i := 0 to 1000000 do
+    begin
+        pi := pi + sign * 4.0 / (2 * i + 1);
+        sign := -sign;
+    end;
+    area := 0.0;
+    step := 1.0 / 200000;
+    for i := 0 to 199999 do
+    begin
+        x := (i + 0.5) * step;
+        area := area + 4.0 / (1.0 + x * x) * step;
+    end;
+    for i := 1 to 20000 do
+    begin
+        guess := i;
+        for k := 1 to 10 do
+            guess := (guess + i / guess) / 2.0;
+    end;
+    Writeln(pi:12:8, area:12:8, guess:12:4);
+end.
@@ -0,0 +1,14 @@
+program int_loop;
+var
+    i, j, sum, checksum: integer;
+begin
+    checksum := 0;
+    for i := 1 to 2000 do
+    begin
+        sum := 0;
+        for j := 1 to 1000 do
+            sum := sum + (i * j) mod 7 + j div 3;
+        checksum := (checksum + sum) mod 1000003;
+    end;
+    Writeln(checksum);
+end.
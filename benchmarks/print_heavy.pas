@@ -0,0 +1,17 @@
+program print_heavy;
+var
+    i: integer;
+    x: real;
+    flag: boolean;
+begin
+    x := 0.0;
+    for i := 1 to 100000 do
+    begin
+        x := x + 0.25;
+        flag := i mod 3 = 0;
+        Writeln('line ', i, ' value ', x:10:2, ' ', flag);
+        Write(i:8);
+        Write(' ');
+        Writeln(x);
+    end;
+end.
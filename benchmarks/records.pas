@@ -0,0 +1,33 @@
+program records;
+const
+    n = 1000;
+type
+    particle = record
+        x, v: real;
+        id: integer;
+        alive: boolean
+    end;
+var
+    i, k: integer;
+    sum: real;
+    ps: array[1..n] of particle;
+    p: particle;
+begin
+    for i := 1 to n do
+    begin
+        ps[i].x := i;
+        ps[i].v := 0.5;
+        ps[i].id := i;
+        ps[i].alive := true;
+    end;
+    for k := 1 to 2000 do
+        for i := 1 to n do
+            ps[i].x := ps[i].x + ps[i].v;
+    sum := 0;
+    for i := 1 to n do
+    begin
+        p := ps[i];
+        sum := sum + p.x + p.id;
+    end;
+    Writeln(sum:16:2);
+end.
@@ -0,0 +1,33 @@
+program recursion;
+var
+    i, total: integer;
+
+function fib(n: integer): integer;
+begin
+    if n < 2 then
+        fib := n
+    else
+        fib := fib(n - 1) + fib(n - 2)
+end;
+
+function depth(n: integer): integer;
+begin
+    if n = 0 then
+        depth := 0
+    else
+        depth := depth(n - 1) + 1
+end;
+
+procedure add(var acc: integer; n: integer);
+begin
+    acc := acc + n
+end;
+
+begin
+    total := fib(25);
+    for i := 1 to 10 do
+        total := total + depth(100000);
+    for i := 1 to 1000000 do
+        add(total, i mod 7);
+    Writeln(total);
+end.
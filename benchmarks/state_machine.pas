@@ -0,0 +1,27 @@
+program state_machine;
+var
+    i, state, accepted, rejected, seed, hits: integer;
+begin
+    state := 0;
+    accepted := 0;
+    rejected := 0;
+    hits := 0;
+    seed := 12345;
+    for i := 1 to 3000000 do
+    begin
+        seed := (seed * 1103 + 12345) mod 65536;
+        case state of
+            0: if seed mod 3 = 0 then state := 1 else state := 4;
+            1: if (seed div 16) mod 2 = 0 then state := 2 else state := 0;
+            2: state := 3;
+            3: begin accepted := accepted + 1; state := 0 end;
+            4..7: state := state + 1;
+            8: begin rejected := rejected + 1; state := 0 end;
+        end;
+        case seed of
+            7, 1000, 5000, 20000, 40000, 65000: hits := hits + 1;
+            30000..30100: hits := hits + 2;
+        end
+    end;
+    Writeln(accepted, ' ', rejected, ' ', hits);
+end.
@@ -0,0 +1,22 @@
+program string_concat;
+var
+    i, j, equal: integer;
+    line, text, last: string;
+begin
+    equal := 0;
+    last := '';
+    for i := 1 to 20000 do
+    begin
+        line := '';
+        for j := 1 to 40 do
+            line := line + 'ab';
+        text := 'row ' + line + ' end';
+        if text = last then
+            equal := equal + 1;
+        last := text;
+    end;
+    text := '';
+    for i := 1 to 50000 do
+        text := text + 'x';
+    Writeln(equal, ' ', last);
+end.
@@ -0,0 +1,16 @@
+program arrays;
+const
+    n = 5;
+var
+    i, j: integer;
+    squares: array[1..n] of integer;
+    grid: array[1..3, 1..3] of real;
+begin
+    for i := 1 to n do
+        squares[i] := i * i;
+    for i := 1 to 3 do
+        for j := 1 to 3 do
+            grid[i, j] := i / j;
+    Writeln('squares[n] = ', squares[n]);
+    Writeln('grid[3][2] = ', grid[3][2]:6:2);
+end.
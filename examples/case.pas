@@ -0,0 +1,28 @@
+program cases;
+const
+    Space = ' ';
+var
+    i, small, tens, other, vowels, digits: integer;
+    c: char;
+begin
+    small := 0;
+    tens := 0;
+    other := 0;
+    for i := 1 to 100 do
+        case i of
+            1..9: small := small + 1;
+            10, 20, 30, 40, 50: tens := tens + 1;
+        else
+            other := other + 1
+        end;
+
+    vowels := 0;
+    digits := 0;
+    c := 'e';
+    case c of
+        'a', 'e', 'i', 'o', 'u': vowels := vowels + 1;
+        '0'..'9': digits := digits + 1;
+        Space: ;
+    end;
+    Writeln(small, ' ', tens, ' ', other, ' ', vowels, ' ', digits);
+end.
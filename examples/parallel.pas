@@ -0,0 +1,41 @@
+program parallel;
+const
+    n = 400;
+    steps = 200;
+var
+    i, j, inside, widest: integer;
+    x, y, zx, zy, t, area: real;
+    counts: array[1..n] of integer;
+begin
+    {$PARALLEL}
+    for i := 1 to n do
+    begin
+        counts[i] := 0;
+        y := 2 * i / n - 1;
+        for j := 1 to n do
+        begin
+            x := 3 * j / n - 2;
+            zx := 0;
+            zy := 0;
+            t := 0;
+            inside := 0;
+            while (inside < steps) and (zx * zx + zy * zy < 4) do
+            begin
+                t := zx * zx + x - zy * zy;
+                zy := 2 * zx * zy + y;
+                zx := t;
+                inside := inside + 1;
+            end;
+            if inside = steps then counts[i] := counts[i] + 1;
+        end;
+    end;
+    area := 0;
+    widest := 0;
+    {$PARALLEL}
+    for i := 1 to n do
+    begin
+        area := area + counts[i] * 6 / (n * n);
+        if counts[i] > widest then widest := counts[i];
+    end;
+    Writeln('area = ', area:0:4, ', most points in a row = ', widest);
+end.
@@ -0,0 +1,27 @@
+program records;
+type
+    point = record
+        x, y: real
+    end;
+    segment = record
+        a, b: point;
+        name: string
+    end;
+var
+    i: integer;
+    s: segment;
+    path: array[1..3] of point;
+begin
+    s.a.x := 1;
+    s.a.y := 2;
+    s.b := s.a;
+    s.b.x := 4;
+    s.name := 'ab';
+    for i := 1 to 3 do
+    begin
+        path[i].x := i;
+        path[i].y := i * i;
+    end;
+    Writeln('s.b = ', s.b.x:6:2, s.b.y:6:2, ' ', s.name);
+    Writeln('path[3].y = ', path[3].y:6:2);
+end.
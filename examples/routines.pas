@@ -0,0 +1,60 @@
+program routines;
+type
+    vector = array[1..4] of integer;
+var
+    i, j, steps: integer;
+    v: vector;
+
+function fib(n: integer): integer;
+begin
+    if n < 2 then
+        fib := n
+    else
+        fib := fib(n - 1) + fib(n - 2)
+end;
+
+function gcd(a, b: integer): integer;
+begin
+    if b = 0 then
+        gcd := a
+    else
+        gcd := gcd(b, a mod b)
+end;
+
+procedure swap(var a, b: integer);
+var
+    t: integer;
+begin
+    t := a;
+    a := b;
+    b := t
+end;
+
+procedure reverse(var a: vector);
+var
+    k: integer;
+begin
+    for k := 1 to 2 do
+        swap(a[k], a[5 - k])
+end;
+
+procedure countdown(n: integer);
+begin
+    steps := steps + 1;
+    if n > 0 then
+        countdown(n - 1)
+end;
+
+begin
+    i := 3;
+    j := 7;
+    swap(i, j);
+    for i := 1 to 4 do
+        v[i] := i * i;
+    reverse(v);
+    steps := 0;
+    countdown(100000);
+    Writeln('fib(15) = ', fib(15));
+    Writeln('gcd(84, 36) = ', gcd(84, 36));
+    Writeln('j = ', j, ' v[1] = ', v[1], ' steps = ', steps);
+end.
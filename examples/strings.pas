@@ -0,0 +1,25 @@
+program strings;
+var
+    text, word, reversed: string;
+    i, at, words: integer;
+begin
+    text := 'the quick brown fox jumps over the lazy dog';
+    words := 0;
+    reversed := '';
+    while Length(text) > 0 do
+    begin
+        at := Pos(' ', text);
+        if at = 0 then
+            at := Length(text) + 1;
+        word := Copy(text, 1, at - 1);
+        text := Copy(text, at + 1, Length(text));
+        reversed := word + ' ' + reversed;
+        words := words + 1;
+    end;
+
+    text := '';
+    for i := 1 to 1000 do
+        text := text + 'ab';
+    Writeln(words, ' ', reversed);
+    Writeln(Length(text), ' ', Pos('ba', text), ' ', Copy(text, 1999, 10));
+end.
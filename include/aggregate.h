@@ -0,0 +1,103 @@
+#ifndef __AGGREGATE_H__
+#define __AGGREGATE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "value.h"
+
+namespace interpreter {
+
+	struct Bounds {
+		int32_t low, high;
+		[[nodiscard]] int32_t count() const noexcept { return high - low + 1; }
+		bool operator==(const Bounds&) const = default;
+	};
+
+	// Type of a variable, element or field: a scalar or, for Reference, an entry of the aggregate table
+	struct TypeRef {
+		DataType type = DataType::Null;
+		int32_t aggregate = -1;
+		bool operator==(const TypeRef&) const = default;
+	};
+
+	struct Field {
+		std::string name;
+		TypeRef type;
+		uint32_t offset = 0; // bytes from the start of the record, set by layout
+		bool operator==(const Field&) const = default;
+	};
+
+	// array[low..high, ...] of element, array of array is the same type with the bounds joined,
+	// or a record when there are no bounds. Aggregates are flat: the fields and elements of
+	// nested aggregates are stored inline, so every access is one offset into one buffer.
+	struct AggregateType {
+		TypeRef element;            // arrays
+		std::vector<Bounds> bounds; // arrays
+		std::vector<Field> fields;  // records, in declaration order
+		uint32_t size = 0;          // bytes, a multiple of align, set by layout
+		uint32_t align = 1;
+		bool strings = false;       // holds string payloads somewhere inside
+
+		static constexpr size_t max_size = size_t{1} << 30;
+
+		// bytes of an unboxed scalar of canonical type
+		[[nodiscard]] static size_t width(DataType type) noexcept;
+		[[nodiscard]] bool is_record() const noexcept { return bounds.empty(); }
+		// number of elements, throws when the bounds are empty or too large
+		[[nodiscard]] size_t count() const;
+		[[nodiscard]] const Field* field(const std::string& name) const;
+		bool operator==(const AggregateType&) const = default;
+	};
+
+	using AggregateTable = std::vector<AggregateType>;
+
+	// Sizes, alignments and field offsets of the table, nested aggregates come before the
+	// ones containing them. Fields are placed by decreasing alignment, so records have no
+	// padding but at the end. Throws for empty or oversized types and duplicate fields.
+	void layout(AggregateTable& types);
+
+	// the same elements and fields of the same types, whatever their table entries
+	[[nodiscard]] bool equivalent(const AggregateTable& types, TypeRef lhs, TypeRef rhs);
+
+	// Storage of one array or record variable, the frame slot of the variable points to it.
+	// Scalars are unboxed in a single zeroed, cache line aligned buffer: int32_t, double,
+	// bool and char values as such, strings as counted StringData pointers.
+	struct AggregateData {
+		void* data;                  // first, native code loads it through the frame slot
+		const AggregateTable* types;
+		const AggregateType* type;
+		size_t count = 1;            // elements of an array, 1 for a record
+		bool strings = false;        // holds string payloads, nothing else of the types is read without them
+		bool owned = true;           // false for a view of storage owned elsewhere
+
+		AggregateData(const AggregateTable& types, int32_t type);
+		// view of the aggregate of the type at data, for var parameters
+		AggregateData(const AggregateTable& types, int32_t type, void* data) noexcept;
+		~AggregateData() noexcept;
+		AggregateData(const AggregateData&) = delete;
+		AggregateData& operator=(const AggregateData&) = delete;
+
+		template<typename T> [[nodiscard]] T* elements() const noexcept { return static_cast<T*>(data); }
+		// boxed copies of single scalars for the generic instructions, at is in units of the scalar
+		[[nodiscard]] Value get(size_t at, DataType type) const;
+		void set(size_t at, DataType type, Value val);
+		// releases the strings and zeroes the storage, as if it was just made
+		void clear() noexcept;
+
+		// an unboxed scalar of canonical type, the payload of a boxed one has the same layout
+		[[nodiscard]] static Value load(const char* at, DataType type);
+		// the scalar takes over the reference of a string value
+		static void store(char* at, DataType type, Value val);
+
+		// block copy of an aggregate between two places of the same type, strings stay shared
+		static void copy(const AggregateTable& types, int32_t type, void* to, const void* from);
+		// (1, 2, 3) for arrays with nested parentheses for every further dimension, (x: 1; y: 2) for records
+		void print(std::ostream& os) const;
+	};
+}
+
+#endif
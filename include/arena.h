@@ -0,0 +1,59 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+struct ArenaStats {
+	uint64_t blocks = 0; // taken from the heap
+	uint64_t reused = 0; // blocks a finished arena left to the thread
+	uint64_t bytes = 0;  // handed out to objects, including alignment
+};
+
+// Monotonic allocator: objects are carved out of large blocks and the memory is
+// only released when the arena goes away, all at once. Blocks of the standard
+// size are kept by the thread for its next arena, a program compiled after
+// another one allocates nothing from the heap for its nodes.
+class Arena {
+	struct Block {
+		Block* next;
+		size_t size;
+	};
+
+	Block* head = nullptr;  // standard blocks, objects go to the first
+	Block* large = nullptr; // one block for every oversized object
+	char* cursor = nullptr;
+	char* limit = nullptr;
+
+	void* grow(size_t size, size_t align);
+	void retire() noexcept;
+public:
+	static constexpr size_t block_size = 16 << 10;
+
+	Arena() = default;
+	~Arena();
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	// counters of the calling thread
+	static ArenaStats stats() noexcept;
+
+	void* allocate(size_t size, size_t align) {
+		const auto at = (reinterpret_cast<uintptr_t>(cursor) + align - 1) & ~(uintptr_t{align} - 1);
+		if (at + size > reinterpret_cast<uintptr_t>(limit)) return grow(size, align);
+		cursor = reinterpret_cast<char*>(at + size);
+		return reinterpret_cast<void*>(at);
+	}
+
+	// destructors of the objects are not run by the arena
+	template<typename T, typename... Args> T* make(Args&&... args) {
+		return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	// frees everything at once, the arena can be filled again
+	void reset() noexcept { retire(); }
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef __ARITH_H__
+#define __ARITH_H__
+
+#include <cstdint>
+
+// Integer arithmetic of the language, shared by the interpreter, the optimizer and the kernels.
+// Results wrap around on overflow, they are computed on unsigned values so they do so
+// without undefined behaviour. Division and modulo by zero are checked by the callers.
+namespace arith {
+	inline int32_t add(int32_t lhs, int32_t rhs) {
+		return static_cast<int32_t>(static_cast<uint32_t>(lhs) + static_cast<uint32_t>(rhs));
+	}
+
+	inline int32_t sub(int32_t lhs, int32_t rhs) {
+		return static_cast<int32_t>(static_cast<uint32_t>(lhs) - static_cast<uint32_t>(rhs));
+	}
+
+	inline int32_t mul(int32_t lhs, int32_t rhs) {
+		return static_cast<int32_t>(static_cast<uint32_t>(lhs) * static_cast<uint32_t>(rhs));
+	}
+
+	inline int32_t neg(int32_t val) {
+		return static_cast<int32_t>(0u - static_cast<uint32_t>(val));
+	}
+
+	// the quotient of the lowest integer by -1 does not fit and wraps to itself
+	inline int32_t div(int32_t lhs, int32_t rhs) {
+		return rhs == -1 ? neg(lhs) : lhs / rhs;
+	}
+
+	inline int32_t mod(int32_t lhs, int32_t rhs) {
+		return rhs == -1 ? 0 : lhs % rhs;
+	}
+}
+
+#endif
@@ -0,0 +1,257 @@
+#ifndef __AST_H__
+#define __AST_H__
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "arena.h"
+#include "aggregate.h"
+#include "value.h"
+
+namespace ast {
+
+	// Nodes live in the arena of their Program, releasing one only runs its destructor
+	struct Destroy {
+		template<typename T> void operator()(T* node) const noexcept { node->~T(); }
+	};
+
+	template<typename T> using NodePtr = std::unique_ptr<T, Destroy>;
+
+	enum class Operator : byte_t {
+		Add,
+		Sub,
+		Mul,
+		Div,
+		IntDiv,
+		Mod,
+		And,
+		Or,
+		Eq,
+		Ne,
+		Lt,
+		Le,
+		Ge,
+		Gt,
+		Neg,
+		Not,
+		ToReal, //integer to real widening, inserted by the type checker
+	};
+
+	//-------------------------expressions------------------------------------
+
+	struct Expr {
+		enum class Kind : byte_t { Literal, Variable, Unary, Binary, Element, Call };
+
+		const Kind kind;
+		DataType type = DataType::Null; //static type, set by the type checker
+
+		explicit Expr(Kind kind) : kind(kind) {}
+		virtual ~Expr() = default;
+
+		template<typename T> [[nodiscard]] const T& as() const { return static_cast<const T&>(*this); }
+		template<typename T> [[nodiscard]] T& as() { return static_cast<T&>(*this); }
+	};
+
+	using ExprPtr = NodePtr<Expr>;
+
+	struct Literal : Expr {
+		Value value;
+		explicit Literal(Value value) : Expr(Kind::Literal), value(std::move(value)) {}
+	};
+
+	struct Variable : Expr {
+		std::string name;
+		explicit Variable(std::string name) : Expr(Kind::Variable), name(std::move(name)) {}
+	};
+
+	struct Unary : Expr {
+		Operator op;
+		ExprPtr operand;
+		Unary(Operator op, ExprPtr operand) : Expr(Kind::Unary), op(op), operand(std::move(operand)) {}
+	};
+
+	struct Binary : Expr {
+		Operator op;
+		ExprPtr lhs, rhs;
+		Binary(Operator op, ExprPtr lhs, ExprPtr rhs)
+			: Expr(Kind::Binary), op(op), lhs(std::move(lhs)), rhs(std::move(rhs)) {}
+	};
+
+	// [i, j] with one index per dimension of an array, or .name of a record field
+	struct Selector {
+		std::vector<ExprPtr> indices; //empty for a field
+		std::string field;
+	};
+
+	// a[i, j].x, part of an array or record variable
+	struct Element : Expr {
+		std::string name;
+		std::vector<Selector> selectors;
+		Element(std::string name, std::vector<Selector> selectors)
+			: Expr(Kind::Element), name(std::move(name)), selectors(std::move(selectors)) {}
+	};
+
+	// string functions of the language, the program's routines hide them
+	enum class Builtin : byte_t { None, Length, Copy, Pos };
+
+	// f(a, b) of a function declared by the program or a builtin, the type checker turns a bare f into one
+	struct FunctionCall : Expr {
+		std::string name;
+		std::vector<ExprPtr> args;
+		Builtin builtin = Builtin::None; //set by the type checker
+		explicit FunctionCall(std::string name, std::vector<ExprPtr> args = {})
+			: Expr(Kind::Call), name(std::move(name)), args(std::move(args)) {}
+	};
+
+	//-------------------------statements------------------------------------
+
+	struct Stmt {
+		enum class Kind : byte_t { Compound, Assign, Call, Read, If, While, For, Case };
+
+		const Kind kind;
+		uint32_t source_line = 0; //line of the first token, 0 if the statement is made up
+
+		explicit Stmt(Kind kind) : kind(kind) {}
+		virtual ~Stmt() = default;
+
+		template<typename T> [[nodiscard]] const T& as() const { return static_cast<const T&>(*this); }
+		template<typename T> [[nodiscard]] T& as() { return static_cast<T&>(*this); }
+	};
+
+	using StmtPtr = NodePtr<Stmt>;
+
+	struct Compound : Stmt {
+		std::vector<StmtPtr> body;
+		Compound() : Stmt(Kind::Compound) {}
+	};
+
+	// variable, array element or record field written by an assignment or Read
+	struct Target {
+		std::string name;
+		std::vector<Selector> selectors; //empty for the whole variable
+		Target(std::string name, std::vector<Selector> selectors = {}) : name(std::move(name)), selectors(std::move(selectors)) {}
+	};
+
+	struct Assign : Stmt {
+		Target target;
+		ExprPtr value;
+		Assign(Target target, ExprPtr value) : Stmt(Kind::Assign), target(std::move(target)), value(std::move(value)) {}
+	};
+
+	// value:width:decimals of a Write argument, either part may be missing
+	struct Format {
+		ExprPtr width, decimals;
+	};
+
+	// Write, Writeln or a procedure of the program
+	struct Call : Stmt {
+		std::string name;
+		std::vector<ExprPtr> args;
+		std::vector<Format> formats; //one per argument of Write and Writeln
+		explicit Call(std::string name) : Stmt(Kind::Call), name(std::move(name)) {}
+	};
+
+	struct Read : Stmt {
+		std::vector<Target> targets;
+		bool line = false; //Readln, skips the rest of the line afterwards
+		Read() : Stmt(Kind::Read) {}
+	};
+
+	struct If : Stmt {
+		ExprPtr cond;
+		StmtPtr then_branch, else_branch;
+		If(ExprPtr cond, StmtPtr then_branch, StmtPtr else_branch)
+			: Stmt(Kind::If), cond(std::move(cond)), then_branch(std::move(then_branch)), else_branch(std::move(else_branch)) {}
+	};
+
+	struct While : Stmt {
+		ExprPtr cond;
+		StmtPtr body;
+		While(ExprPtr cond, StmtPtr body) : Stmt(Kind::While), cond(std::move(cond)), body(std::move(body)) {}
+	};
+
+	// {$PARALLEL} for runs parts of the range on several threads, which the type checker
+	// allows when no iteration depends on another: scalars the body writes are reductions
+	// or assigned by every iteration before it reads them, and each array it writes is
+	// accessed only at the loop variable's index.
+	struct For : Stmt {
+		// sum := sum + x, or if x < min then min := x and the same for max
+		struct Reduction {
+			enum class Kind : byte_t { Sum, Min, Max };
+			std::string var;
+			Kind kind;
+		};
+
+		std::string var;
+		ExprPtr from, to;
+		bool down;
+		StmtPtr body;
+		bool parallel = false;
+		std::vector<Reduction> reductions; //of a parallel loop, set by the type checker
+		std::vector<std::pair<std::string, std::string>> disjoint; //written array and an array or var parameter that may share its storage
+		For(std::string var, ExprPtr from, ExprPtr to, bool down, StmtPtr body)
+			: Stmt(Kind::For), var(std::move(var)), from(std::move(from)), to(std::move(to)), down(down), body(std::move(body)) {}
+	};
+
+	// case selector of labels: statement; ... else statements end. The labels are integer or
+	// char constants, a range stands for all values from low to high.
+	struct Case : Stmt {
+		struct Label {
+			Value low, high;
+		};
+		struct Arm {
+			std::vector<Label> labels;
+			StmtPtr body;
+		};
+
+		ExprPtr selector;
+		std::vector<Arm> arms;
+		StmtPtr else_branch; //may be null
+		explicit Case(ExprPtr selector) : Stmt(Kind::Case), selector(std::move(selector)) {}
+
+		// the integer or the code of the char, labels and selector values compare by it
+		[[nodiscard]] static int32_t ordinal(const Value& v) noexcept {
+			return v.type() == DataType::Char ? static_cast<unsigned char>(v.value.char_ptr) : v.value.int_ptr;
+		}
+	};
+
+	//-------------------------program------------------------------------
+
+	struct Decl {
+		std::string name;
+		DataType type;
+		bool is_const;
+		Value value;
+		bool hidden = false; //compiler generated temporary
+		int32_t aggregate = -1; //index into Program::types, the type is Reference
+		bool by_ref = false; //var parameter
+	};
+
+	// Procedure or function of the program. Its scope is the parameters, its own declarations
+	// and the globals, a function returns what was last assigned to its name.
+	struct Routine {
+		std::string name;
+		std::vector<Decl> params;
+		DataType result = DataType::Null; //Null for procedures
+		std::vector<Decl> decls; //constants and variables
+		NodePtr<Compound> body;
+		uint32_t source_line = 0;
+	};
+
+	struct Program {
+		Arena arena; //first, the nodes are destroyed before their memory goes
+		std::string name;
+		std::vector<Decl> decls;
+		AggregateTable types; //arrays and records, laid out by the type checker
+		std::vector<Routine> routines;
+		NodePtr<Compound> body;
+
+		template<typename T, typename... Args> NodePtr<T> make(Args&&... args) {
+			return NodePtr<T>(arena.make<T>(std::forward<Args>(args)...));
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,237 @@
+#ifndef __BYTECODE_H__
+#define __BYTECODE_H__
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "aggregate.h"
+#include "value.h"
+
+namespace interpreter {
+
+// a, b - operands of the instruction, see comments
+#define PASCAL_OPCODES(X) \
+	X(Push)        /* a: constant */                    \
+	X(Load)        /* a: slot */                        \
+	X(Store)       /* a: slot */                        \
+	X(AddI)        /* I - integer operands */           \
+	X(SubI)                                             \
+	X(MulI)                                             \
+	X(IntDivI)                                          \
+	X(ModI)                                             \
+	X(NegI)                                             \
+	X(AddR)        /* R - real operands */              \
+	X(SubR)                                             \
+	X(MulR)                                             \
+	X(DivR)                                             \
+	X(NegR)                                             \
+	X(ToReal)                                           \
+	X(Concat)                                           \
+	X(Append)      /* a: slot, s := s + x in place */   \
+	X(AppendGlobal) /* a: slot of the program's frame */\
+	X(StrLength)                                        \
+	X(StrCopy)     /* string, index, count */           \
+	X(StrPos)      /* part, string */                   \
+	X(Not)                                              \
+	X(And)                                              \
+	X(Or)                                               \
+	X(EqI)                                              \
+	X(NeI)                                              \
+	X(LtI)                                              \
+	X(LeI)                                              \
+	X(GeI)                                              \
+	X(GtI)                                              \
+	X(EqR)                                              \
+	X(NeR)                                              \
+	X(LtR)                                              \
+	X(LeR)                                              \
+	X(GeR)                                              \
+	X(GtR)                                              \
+	X(Eq)          /* strings, booleans, chars */       \
+	X(Ne)                                               \
+	X(Lt)                                               \
+	X(Le)                                               \
+	X(Ge)                                               \
+	X(Gt)                                               \
+	X(Jump)        /* a: target */                      \
+	X(JumpIfFalse) /* a: target */                      \
+	X(JumpTable)   /* a: table, pops the selector */    \
+	X(JumpSearch)  /* a: table, pops the selector */    \
+	X(ForTest)     /* a: slot, b: exit target */        \
+	X(ForTestDown) /* a: slot, b: exit target */        \
+	X(ForNext)     /* a: slot, b: head, pops at limit */\
+	X(ForPrev)     /* a: slot, b: head, pops at limit */\
+	X(Write)       /* a: args, b: formatted */          \
+	X(Writeln)     /* a, b: as Write */                 \
+	X(Read)        /* a: slot */                        \
+	X(ReadLine)    /* rest of the line is skipped */    \
+	X(Index)       /* a: dimension */                   \
+	X(LoadElemI)   /* a: slot, b: dimension */          \
+	X(LoadElemR)                                        \
+	X(LoadElem)    /* strings, booleans, chars */       \
+	X(StoreElemI)  /* a: slot, b: dimension */          \
+	X(StoreElemR)                                       \
+	X(StoreElem)                                        \
+	X(LoadFieldI)  /* a: slot, b: dimension */          \
+	X(LoadFieldR)  /* without index, see Dimension */   \
+	X(LoadField)                                        \
+	X(StoreFieldI) /* a: slot, b: dimension */          \
+	X(StoreFieldR)                                      \
+	X(StoreField)                                       \
+	X(ReadElem)    /* a: slot, b: dimension */          \
+	X(Address)     /* a: slot, b: dimension */          \
+	X(Copy)        /* a: aggregate type */              \
+	X(Kernel)      /* a: kernel, b: exit target */      \
+	X(Parallel)    /* a: parallel loop, b: exit target */\
+	X(ParallelEnd) /* a: parallel loop */               \
+	X(LoadGlobal)  /* a: slot of the program's frame */ \
+	X(StoreGlobal) /* a: slot of the program's frame */ \
+	X(Ref)         /* a: slot, see Routine */           \
+	X(RefGlobal)   /* a: slot of the program's frame */ \
+	X(LoadRefI)    /* a: slot of a reference, b: type */\
+	X(LoadRefR)                                         \
+	X(LoadRef)                                          \
+	X(StoreRefI)   /* a: slot of a reference, b: type */\
+	X(StoreRefR)                                        \
+	X(StoreRef)                                         \
+	X(ReadRef)     /* a: type, pops the reference */    \
+	X(Call)        /* a: routine */                     \
+	X(TailCall)    /* a: routine, the one running */    \
+	X(Return)      /* a: routine */                     \
+	X(Halt)
+
+	enum class OpCode : byte_t {
+#define PASCAL_OPCODE_ENUM(name) name,
+		PASCAL_OPCODES(PASCAL_OPCODE_ENUM)
+#undef PASCAL_OPCODE_ENUM
+	};
+
+	struct Instruction {
+		OpCode op;
+		int32_t a = 0;
+		int32_t b = 0;
+	};
+
+	struct Symbol {
+		int32_t slot;
+		DataType type;
+		bool is_const;
+		bool hidden = false;
+		int32_t aggregate = -1; // index into Chunk::types
+		bool local = false;     // slot of a routine's frame, compiler only
+		bool reference = false; // var parameter, the slot holds its reference
+	};
+
+	// Access to a scalar inside an aggregate: the index becomes (index - low) * stride + base,
+	// in units of the scalar's width, or of bytes for the address of an inner aggregate.
+	// Field accesses have no index, their offset is base alone.
+	struct Dimension {
+		int32_t low, high;
+		int32_t stride;
+		int32_t base = 0;
+		DataType type = DataType::Null; // of the scalar, for the generic instructions
+	};
+
+	// Loop body x[i] := a op b over whole 1-D arrays, run by the Kernel instruction
+	struct Kernel {
+		struct Operand {
+			enum class Kind : byte_t { Array, Variable, Constant };
+			Kind kind;
+			int32_t index; // slot or constant
+		};
+
+		OpCode op;        // AddI, SubI, MulI, AddR, SubR, MulR or Store for a copy of a
+		int32_t target;   // array slot
+		Operand a, b;     // b is unused by Store
+		int32_t var;      // slot of the loop variable
+		bool down;        // downto loop
+	};
+
+	// For loop whose iterations the Parallel instruction splits into parts run on several
+	// threads. Each part runs the loop's code on a copy of the frame until ParallelEnd.
+	struct ParallelLoop {
+		// slot of a scalar
+		struct Place {
+			int32_t slot;
+			bool global; // of the program's frame, in a routine
+		};
+		struct Reduction {
+			enum class Kind : byte_t { Sum, Min, Max };
+			Kind kind;
+			Place var;
+			bool real;
+		};
+		// storage that must not overlap for the parts to run at once
+		struct Disjoint {
+			int32_t aggregate; // slot of an aggregate the loop writes
+			int32_t other;     // slot of another aggregate or of a scalar var parameter
+			bool scalar;
+		};
+
+		int32_t var;                       // slot of the loop variable
+		bool down;                         // downto loop
+		int32_t routine = -1;              // whose frame the loop runs in, -1 for the program
+		std::vector<Reduction> reductions; // combined in the order of the parts
+		std::vector<Place> privates;       // scalars the body writes, the last part's values are kept
+		std::vector<Disjoint> disjoint;
+	};
+
+	// Dispatch of a case statement on the selector: JumpTable indexes targets by selector - low,
+	// JumpSearch binary searches the ranges. Chars select by their code.
+	struct JumpTable {
+		struct Range {
+			int32_t low, high;
+			int32_t target;
+		};
+
+		int32_t low = 0;
+		std::vector<int32_t> targets; // JumpTable, the gaps go to otherwise
+		std::vector<Range> ranges;    // JumpSearch, sorted and disjoint
+		int32_t otherwise = 0;        // target when no label matches
+		bool chars = false;
+	};
+
+	// Procedure or function. Its frame lies on the operand stack of the caller: the arguments
+	// the caller pushed become the parameters, followed by the result of a function and the
+	// locals. Scalar var parameters hold a Reference whose address_ptr points to the payload
+	// of the variable, boxed or unboxed alike, see AggregateData::load.
+	struct Routine {
+		// Arrays and records of the frame, set up by Call. Local ones and value parameters take
+		// storage of their own, var parameters view the caller's and the program's are aliased.
+		struct Aggregate {
+			enum class Kind : byte_t { Local, Value, Var, Global };
+			Kind kind;
+			int32_t slot;
+			int32_t index; // aggregate type, or slot of the program's frame for Global
+		};
+
+		std::string name;
+		int32_t entry = 0, end = 0; // code[entry, end)
+		int32_t params = 0;
+		int32_t result = -1;        // slot of a function's result
+		int32_t max_stack = 0;      // operand stack depth the body needs above the frame
+		std::vector<Value> frame;   // initial frame, the parameters are overwritten by the arguments
+		std::vector<Aggregate> aggregates;
+	};
+
+	struct Chunk {
+		std::string program_name;
+		std::vector<Instruction> code;
+		std::vector<Value> constants;
+		std::vector<Value> globals; // initial frame, indexed by slot
+		std::map<std::string, Symbol> symbols;
+		int32_t max_stack = 0; // operand stack depth the code needs
+		std::vector<uint32_t> lines;     // source line of every instruction, 0 for code no statement owns
+		std::vector<int32_t> statements; // first instruction of every statement, in code order
+		AggregateTable types;            // arrays and records, laid out
+		std::vector<Dimension> dimensions;
+		std::vector<Kernel> kernels;
+		std::vector<ParallelLoop> parallels;
+		std::vector<JumpTable> tables;
+		std::vector<Routine> routines;   // code of routines follows the Halt of the program
+	};
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "bytecode.h"
+
+struct CacheStats {
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t stores = 0;
+	uint64_t rejected = 0; // corrupt entries or entries written by another bytecode format
+};
+
+// On-disk cache of compiled programs. Entries are keyed by a hash of the
+// source text and the bytecode format, so editing a program or upgrading the
+// interpreter simply misses; every entry is also validated when it is mapped
+// and a bad one only costs a recompile. Files are replaced atomically.
+class ChunkCache {
+	std::string directory;
+
+	[[nodiscard]] std::string path(uint64_t key) const;
+public:
+	explicit ChunkCache(std::string directory);
+
+	static uint64_t key(std::string_view source) noexcept;
+	static CacheStats stats() noexcept;
+
+	std::optional<Chunk> load(std::string_view source);
+	bool store(std::string_view source, const Chunk& chunk);
+	size_t clear();
+};
+
+#endif
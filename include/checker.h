@@ -0,0 +1,46 @@
+#ifndef __CHECKER_H__
+#define __CHECKER_H__
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ast.h"
+
+// Infers the static type of every expression, inserts integer to real
+// widening and rejects ill-typed programs before they are compiled
+class TypeChecker {
+
+	ast::Program* program = nullptr;
+	std::map<std::string, const ast::Decl*> symbols;
+	std::map<std::string, const ast::Routine*> routines;
+	const ast::Routine* routine = nullptr; //being checked
+	std::map<std::string, const ast::Decl*> locals; //of the routine
+	ast::Decl result; //of the function, assigned to its name
+
+	const ast::Decl& variable(const std::string& identifier);
+	const ast::Decl& assignable(const std::string& identifier);
+	void widen(ast::ExprPtr& expr);
+	void coerce(ast::ExprPtr& expr, DataType target);
+	TypeRef select(TypeRef type, const ast::Selector& selector, const std::string& name);
+	TypeRef access(const ast::Decl& var, std::vector<ast::Selector>& selectors);
+	TypeRef reference(const ast::Expr& expr);
+	TypeRef target(ast::Target& target);
+	[[nodiscard]] bool callable(const std::string& name) const;
+	const ast::Routine& callee(const std::string& name);
+	void arguments(const ast::Routine& callee, std::vector<ast::ExprPtr>& args);
+	DataType builtin(ast::FunctionCall& call);
+	void check(const ast::Routine& routine);
+	void parallel(ast::For& loop);
+
+	void statement(ast::Stmt& stmt);
+	DataType expression(ast::ExprPtr& expr);
+	DataType binary(ast::Binary& expr);
+	DataType unary(ast::Unary& expr);
+public:
+	static DataType canonical(DataType type) noexcept;
+
+	void check(ast::Program& program);
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef __COMPILER_H__
+#define __COMPILER_H__
+
+#include "ast.h"
+#include "bytecode.h"
+
+// Resolves identifiers to frame slots and emits bytecode for a type checked AST
+class Compiler {
+	// place inside an aggregate variable, see access
+	struct Access {
+		TypeRef type;
+		int32_t dimension;
+		bool indexed; // the offset is on the stack
+	};
+
+	static constexpr int64_t max_table = 4096; // entries of the jump table of a case statement
+
+	Chunk chunk;
+	const ast::Program* program = nullptr;
+	int32_t depth = 0;
+	uint32_t line = 0; // of the statement being compiled
+	std::map<std::string, int32_t> routines; // index into Chunk::routines by name
+	Routine* routine = nullptr;              // being compiled
+	const ast::Routine* source = nullptr;    // of the routine
+	std::map<std::string, Symbol> locals;    // of the routine, they hide the globals
+	bool tail = false;                       // the statement is the last the routine runs
+
+	size_t emit(OpCode op, int32_t a = 0, int32_t b = 0);
+	[[nodiscard]] int32_t here() const;
+	int32_t constant(const Value& val);
+	void declare(const ast::Decl& decl);
+	void local(const ast::Decl& decl, bool param);
+	const Symbol& variable(const std::string& identifier);
+	const Symbol& assignable(const std::string& identifier);
+	[[nodiscard]] bool global(const Symbol& var) const;
+	void load(const Symbol& var);
+	void store(const Symbol& var);
+	bool append(const std::string& name, const Symbol& var, const ast::Expr& value);
+	int32_t dimension(Dimension dim);
+	Access access(const Symbol& var, const std::vector<ast::Selector>& selectors, bool bytes = false);
+	TypeRef address(const Symbol& var, const std::vector<ast::Selector>& selectors);
+	void reference(const ast::Expr& arg);
+	[[nodiscard]] bool frame_bound(const ast::Expr& arg) const;
+	void call(const std::string& name, const std::vector<ast::ExprPtr>& args, bool last);
+	void compile(const ast::Routine& routine, int32_t index);
+	int32_t kernel(const ast::For& loop, const Symbol& var);
+	int32_t parallel(const ast::For& loop, const Symbol& var);
+
+	[[nodiscard]] int32_t stack_effect(OpCode op, int32_t a, int32_t b) const;
+	static OpCode operation(ast::Operator op, DataType operand);
+	static OpCode element(OpCode op, DataType type);
+
+	void statement(const ast::Stmt& stmt);
+	void expression(const ast::Expr& expr);
+public:
+	Chunk compile(const ast::Program& program);
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef __DESCENT_PARSER_H__
+#define __DESCENT_PARSER_H__
+
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "ast.h"
+#include "exceptions.h"
+#include "tokenizer.h"
+
+// Hand written recursive descent parser for the subset of PascalParser.g4 the
+// AstBuilder supports, it builds the same AST straight from the tokens without
+// a parse tree. Anything outside the subset throws a parse_error so the caller
+// can fall back to the ANTLR front end.
+class DescentParser {
+	Tokenizer tokenizer;
+	Lexeme current{};
+	ast::Program* program = nullptr; //owns the nodes being built
+	std::map<std::string, TypeRef> named; //of the type definitions
+	const std::vector<ast::Decl>* locals = nullptr; //of the routine being parsed
+
+	void advance() { current = tokenizer.next(); }
+	[[nodiscard]] bool at(TokenKind kind) const { return current.kind == kind; }
+	bool accept(TokenKind kind);
+	Lexeme expect(TokenKind kind, const char* what);
+	[[noreturn]] void fail(const std::string& msg) const;
+	template<typename T> T number(const Lexeme& token) const;
+
+	ast::NodePtr<ast::Compound> block(std::vector<ast::Decl>& decls, bool outer);
+	void constants(std::vector<ast::Decl>& decls);
+	void typeDefinitions();
+	void variables(std::vector<ast::Decl>& decls);
+	void routine();
+	TypeRef type();
+	TypeRef typeIdentifier();
+	TypeRef arrayType();
+	TypeRef recordType();
+	[[nodiscard]] const ast::Decl* constant() const;
+	int32_t bound();
+	Value label();
+
+	ast::NodePtr<ast::Compound> compoundStatement();
+	ast::StmtPtr statement();
+	ast::StmtPtr unlabelledStatement();
+	ast::StmtPtr procedureStatement(std::string name);
+	ast::StmtPtr ifStatement();
+	ast::StmtPtr whileStatement();
+	ast::StmtPtr forStatement();
+	ast::StmtPtr caseStatement();
+
+	ast::ExprPtr expression();
+	ast::ExprPtr simpleExpression();
+	ast::ExprPtr term();
+	ast::ExprPtr signedFactor();
+	ast::ExprPtr factor();
+	std::vector<ast::Selector> selectors();
+public:
+	explicit DescentParser(std::string_view source) : tokenizer(source) {}
+
+	std::unique_ptr<ast::Program> parse();
+};
+
+#endif
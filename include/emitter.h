@@ -0,0 +1,39 @@
+#ifndef __EMITTER_H__
+#define __EMITTER_H__
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ast.h"
+
+// Translates a type checked AST into a standalone C program with the same
+// output as running it in the VM
+class CEmitter {
+
+	std::ostringstream body;
+	std::map<std::string, const ast::Decl*> symbols;
+	std::vector<std::string> literals;
+	int temporaries = 0;
+	int depth = 1;
+
+	std::ostream& line();
+	std::string temporary();
+	const ast::Decl& variable(const std::string& identifier);
+	std::string literal(const Value& val);
+
+	static std::string identifier(const ast::Decl& decl);
+	static std::string c_type(DataType type);
+	static std::string quote(std::string_view str);
+	static bool fallible(const ast::Expr& expr);
+
+	std::string evaluate(const ast::Expr& expr);
+	void statement(const ast::Stmt& stmt);
+	void nested(const ast::Stmt& stmt);
+	std::string expression(const ast::Expr& expr);
+public:
+	std::string emit(const ast::Program& program, bool dump = true);
+};
+
+#endif
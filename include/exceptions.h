@@ -16,7 +16,7 @@ public:
 			, int numLine = -1
 			, const string& erInfo = "Undeclared error");
 
-    [[nodiscard]] char const* what() const override;
+    [[nodiscard]] char const* what() const noexcept override;
 
     ~base_exception() override = default;
 };
@@ -51,4 +51,10 @@ public:
 				const string& erInfo = "Parse error");
 };
 
+class type_error :  public base_exception{
+public:
+	type_error(const string& fileName, const string& className, int numLine,
+			   const string& erInfo = "Type error");
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef __INPUT_H__
+#define __INPUT_H__
+
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+#include "value.h"
+
+// Buffered program input. The stream is pulled in blocks and values are
+// parsed with from_chars straight from the buffer, Pascal style: numbers are
+// separated by any whitespace, a string takes the rest of the current line
+// and Readln skips past the end of the line.
+class Input {
+	std::istream& is;
+	std::vector<char> buffer; // allocated by the first read, most programs never read
+	size_t capacity;
+	size_t pos = 0;
+	size_t end = 0;
+	bool fed = false;    // the host feeds the input, the stream is not read
+	bool closed = false; // nothing more will be fed
+
+	bool fill();
+	bool delimited(bool line) const noexcept;
+	bool skip_spaces();
+	std::string_view token(bool line);
+public:
+	static constexpr size_t default_capacity = 1 << 16;
+
+	explicit Input(std::istream& is = std::cin, size_t capacity = default_capacity);
+	Input(const Input&) = delete;
+	Input& operator=(const Input&) = delete;
+
+	// reads the next value of the variable's type, the variable keeps its type tag
+	void read(Value& var);
+	// consumes the rest of the current line including the line break
+	void skip_line();
+	// discards what was buffered but not read, e.g. before the stream is refilled for another run,
+	// and goes back to reading the stream
+	void reset() noexcept {
+		pos = end = 0;
+		fed = closed = false;
+	}
+
+	// Appends input from the host. From the first call on the stream is no longer read and
+	// reads past what was fed fail as at the end of a stream once the input is closed.
+	void feed(std::string_view text);
+	void close() noexcept { closed = true; }
+	// whether the next value, or the rest of the line, can be read without waiting for more
+	// input; a stream always counts as ready, reading it blocks instead
+	[[nodiscard]] bool ready(bool line) const noexcept { return !fed || closed || delimited(line); }
+};
+
+#endif
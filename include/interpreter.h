@@ -0,0 +1,151 @@
+#ifndef __INTERPRETER_H__
+#define __INTERPRETER_H__
+
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "bytecode.h"
+#include "options.h"
+#include "vm.h"
+
+// Outcome of compiling or running a program, failures carry the message instead of throwing
+struct Status {
+	std::string error;
+
+	[[nodiscard]] bool ok() const noexcept { return error.empty(); }
+	explicit operator bool() const noexcept { return ok(); }
+};
+
+// Bytecode of a program that is never modified after construction, any number
+// of threads may run it at the same time. Its string constants and initial
+// values are pinned, copying them into a frame does not touch shared counters.
+class CompiledProgram {
+	Chunk code;
+public:
+	explicit CompiledProgram(Chunk chunk);
+	~CompiledProgram();
+	CompiledProgram(const CompiledProgram&) = delete;
+	CompiledProgram& operator=(const CompiledProgram&) = delete;
+
+	[[nodiscard]] const Chunk& chunk() const noexcept { return code; }
+	[[nodiscard]] const std::string& name() const noexcept { return code.program_name; }
+};
+
+struct CompileResult : Status {
+	std::shared_ptr<const CompiledProgram> program;
+};
+
+// Outcome of a slice of a run, Finished also when the program failed
+struct SliceResult : Status {
+	Progress progress = Progress::Finished;
+};
+
+// State of one run: the variable frame, operand stack, loops compiled by the JIT
+// and the program's streams. A context belongs to one thread at a time and is
+// meant to be reused, a run only resets the frame.
+//
+// Lifetime: the frame keeps the values of the last run, its strings are owned by the
+// program. The context holds on to the program of its last run until the next run
+// replaces the frame or the context is destroyed, so the caller may drop its own
+// reference to a program at any time.
+class ExecutionContext {
+	std::shared_ptr<const CompiledProgram> loaded; // declared first, the VM lets go of its values before
+	VM vm;
+public:
+	explicit ExecutionContext(std::istream& in = std::cin, std::ostream& out = std::cout, const Options& options = {});
+
+	Status run(std::shared_ptr<const CompiledProgram> program);
+	// Runs in slices of at most steps loop back edges and routine calls, 0 for no limit, so one
+	// thread can take turns between contexts
+	Status start(std::shared_ptr<const CompiledProgram> program);
+	SliceResult resume(uint64_t steps);
+	[[nodiscard]] bool running() const noexcept { return vm.started(); }
+	[[nodiscard]] uint64_t steps() const noexcept { return vm.steps(); }
+	// input from the host instead of the stream, Read waits for it until the input is closed
+	void feed(std::string_view text) { vm.input.feed(text); }
+	void close_input() noexcept { vm.input.close(); }
+	// value of a variable or constant after the last run, nullptr if there is none or the last
+	// run was of another program
+	[[nodiscard]] const Value* variable(const CompiledProgram& program, std::string_view name) const;
+	// prints the visible variables like the interpreter does at the end of a program
+	void dump(const CompiledProgram& program, std::ostream& os) const;
+	// statements counted and timed by the last run, empty unless the options ask for profiling
+	[[nodiscard]] const Profile& profile() const noexcept { return vm.profile; }
+};
+
+// Runs any number of programs on the calling thread, a slice of steps each in turn, so a loop
+// that never ends only delays the others. A program reading input that was not fed yet waits
+// without holding the thread. Options bound the steps, time and memory of every program.
+// Finished tasks keep their output and variables until they are removed.
+class Scheduler {
+public:
+	using Task = uint64_t;
+	static constexpr uint64_t default_slice = 10000;
+private:
+	struct Entry {
+		std::shared_ptr<const CompiledProgram> program;
+		std::ostringstream out;
+		ExecutionContext context;
+		Status status;
+		bool waiting = false;
+		bool done = false;
+
+		Entry(std::shared_ptr<const CompiledProgram> program, std::istream& in, const Options& options);
+	};
+
+	Options options;
+	uint64_t slice;
+	std::istringstream none; // stream of the contexts, their input is fed
+	std::unordered_map<Task, std::unique_ptr<Entry>> tasks;
+	std::deque<Task> ready;  // runnable tasks in turn, removed ones are skipped
+	Task next = 0;
+
+	void wake(Task task, Entry& entry);
+public:
+	explicit Scheduler(const Options& options = {}, uint64_t slice = default_slice);
+
+	// starts the program, the task holds on to it; unknown tasks throw std::out_of_range below
+	Task spawn(std::shared_ptr<const CompiledProgram> program);
+	void feed(Task task, std::string_view text);
+	// no more input, reads past the end fail
+	void close_input(Task task);
+	// runs a slice of the next task in turn, false when every task finished or waits for input
+	bool step();
+	// steps until no task can go on
+	void run();
+
+	[[nodiscard]] bool finished(Task task) const { return tasks.at(task)->done; }
+	[[nodiscard]] bool waiting(Task task) const { return tasks.at(task)->waiting; }
+	// of a finished task, the error when it failed or went over a limit
+	[[nodiscard]] const Status& status(Task task) const { return tasks.at(task)->status; }
+	[[nodiscard]] uint64_t steps(Task task) const { return tasks.at(task)->context.steps(); }
+	// what the task wrote since the last call
+	std::string output(Task task);
+	void dump(Task task, std::ostream& os) const;
+	void remove(Task task) { tasks.erase(task); }
+	[[nodiscard]] size_t size() const noexcept { return tasks.size(); }
+};
+
+// Entry point of the embedding API: turns sources into shareable compiled
+// programs. Nothing here touches global state, compile may be called from
+// several threads and every run gets its own context.
+class Interpreter {
+	Options options;
+public:
+	explicit Interpreter(const Options& options = {}) : options(options) {}
+
+	[[nodiscard]] const Options& settings() const noexcept { return options; }
+
+	[[nodiscard]] CompileResult compile(const std::string& source) const;
+	[[nodiscard]] ExecutionContext context(std::istream& in, std::ostream& out) const;
+	// compiles and runs once, for callers that do not keep the program
+	Status run(const std::string& source, std::istream& in, std::ostream& out) const;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef __JIT_H__
+#define __JIT_H__
+
+#include <cstdint>
+#include <exception>
+#include <utility>
+#include <vector>
+
+#include "bytecode.h"
+#include "input.h"
+#include "output.h"
+
+// Execution state shared between the interpreter and native code
+struct JitState {
+	Value* frame;
+	Value* sp;
+	const Chunk* chunk;
+	std::exception_ptr error;
+	Input* input;
+	Output* output;
+	Value* globals; // frame of the program, the same as frame outside routines
+};
+
+// Runs a loop natively, returns the bytecode position to resume the
+// interpreter at or -1 if an exception was stored in the state
+using JitFunction = int32_t (*)(JitState*);
+// Executes the single instruction at pc in the interpreter, returns non zero on error
+using JitSlowPath = int32_t (*)(JitState*, int32_t);
+
+// Template JIT for x86-64 Linux: translates the bytecode of a loop into
+// machine code working on the same frame and operand stack as the VM
+class Jit {
+	std::vector<std::pair<void*, size_t>> blocks;
+	bool enabled;
+public:
+	Jit();
+	~Jit();
+	Jit(const Jit&) = delete;
+	Jit& operator=(const Jit&) = delete;
+
+	[[nodiscard]] bool available() const noexcept;
+	void clear() noexcept;
+	JitFunction compile(const Chunk& chunk, int32_t head, int32_t end, JitSlowPath slow);
+};
+
+#endif
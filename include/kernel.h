@@ -0,0 +1,13 @@
+#ifndef __KERNEL_H__
+#define __KERNEL_H__
+
+#include <cstdint>
+
+#include "bytecode.h"
+
+// Runs the loop of a Kernel instruction over all iterations at once when
+// every array covers the whole index range, the loop variable is left as the
+// checked loop leaves it. Returns false without touching anything otherwise.
+bool run_kernel(const Chunk& chunk, const Kernel& kernel, Value* frame, int32_t to);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef __OPTIMIZER_H__
+#define __OPTIMIZER_H__
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "ast.h"
+
+// Constant folding and propagation, dead branch elimination and loop
+// invariant code motion over a type checked AST
+class Optimizer {
+
+	ast::Program* program = nullptr;
+	std::map<std::string, Value> constants; //of the scope being optimized
+	std::vector<ast::Decl>* decls = nullptr; //of the scope, temporaries are added here
+	const ast::Routine* routine = nullptr; //being optimized, null for the program body
+	int temporaries = 0;
+
+	void fold(ast::ExprPtr& expr);
+	void statement(ast::StmtPtr& stmt);
+	void nested(ast::StmtPtr& stmt);
+	void compound(ast::Compound& stmt);
+	void hoist(ast::StmtPtr& loop);
+	void aliases(std::set<std::string>& assigned) const;
+	void hoist(ast::ExprPtr& expr, const std::set<std::string>& assigned, std::vector<ast::StmtPtr>& hoisted);
+	void hoist(ast::Stmt& stmt, const std::set<std::string>& assigned, std::vector<ast::StmtPtr>& hoisted);
+public:
+	void optimize(ast::Program& program);
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef __OPTIONS_H__
+#define __OPTIONS_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum class Frontend : uint8_t {
+	Fast,     // hand written parser, ANTLR only for programs it does not accept
+	Antlr,    // always parse with ANTLR
+	Validate, // parse with both and fail unless the trees are identical
+};
+
+struct Options {
+	bool dump = true;                // print the variables when the program ends
+	bool jit = false;                // compile hot loops to native code
+	uint32_t jit_threshold = 1000;   // back edges taken before a loop is compiled
+	std::string cache_dir;           // compiled program cache, disabled when empty
+	Frontend frontend = Frontend::Fast;
+	bool profile = false;            // count and time every statement, the jit is off meanwhile
+	std::string flamegraph;          // folded stacks of the profile are written here when not empty
+	size_t stack_size = 256u << 20;  // bytes for the frames of procedure and function calls
+	unsigned threads = 0;            // running {$PARALLEL} loops, 0 for one per hardware thread
+	// limits of a run, 0 for none; a limited run is only interpreted, without jit, kernels or parallel loops
+	uint64_t max_steps = 0;          // loop back edges and routine calls
+	uint32_t time_limit = 0;         // milliseconds of wall time from the start of the run
+	size_t memory_limit = 0;         // bytes of frames, arrays, records and strings
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef __OUTPUT_H__
+#define __OUTPUT_H__
+
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+#include "value.h"
+
+// Buffered program output. Values are formatted with to_chars straight into a
+// reusable buffer that reaches the stream only when it fills up or on flush(),
+// so printing a line costs no allocation and no system call.
+class Output {
+	std::ostream& os;
+	std::vector<char> buffer;
+	size_t used = 0;
+
+	void drain();
+	void pad(int count, char c = ' ');
+public:
+	static constexpr size_t default_capacity = 1 << 16;
+	static constexpr int max_field = 1 << 16; // widest field and most decimals of a value
+
+	explicit Output(std::ostream& os = std::cout, size_t capacity = default_capacity);
+	Output(const Output&) = delete;
+	Output& operator=(const Output&) = delete;
+	~Output();
+
+	void put(char c) {
+		if (used == buffer.size()) drain();
+		buffer[used++] = c;
+	}
+	void write(std::string_view str);
+	// Pascal value:width:decimals, a negative width left aligns and decimals < 0 means not given
+	void write(const Value& val, int width = 0, int decimals = -1);
+	// hands everything written so far to the stream and flushes it
+	void flush();
+};
+
+#endif
@@ -1,10 +1,22 @@
 #ifndef PASCAL_PARSER_H
 #define PASCAL_PARSER_H
+#include<memory>
 #include<string>
+#include "options.h"
+
+namespace ast { struct Program; }
 
 class Runtime {
 public:
-	static void run(const std::string& infix);
+	// syntax only, builds the AST with the front end selected in options
+	static std::unique_ptr<ast::Program> parse(const std::string& infix, const Options& options = {});
+	// parses, type checks and optimizes, the front end shared by all backends
+	static std::unique_ptr<ast::Program> analyze(const std::string& infix, const Options& options = {});
+	// compiles and runs on the standard streams, errors are reported on stderr.
+	// False when the program does not compile or fails while it runs.
+	[[nodiscard]] static bool run(const std::string& infix, const Options& options = {});
+	// translates the program to a standalone C source, throws on compile errors
+	static std::string emit_c(const std::string& infix, const Options& options = {});
 };
 
 #endif //PASCAL_PARSER_H
@@ -0,0 +1,69 @@
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bytecode.h"
+
+struct LineStats {
+	uint64_t executions = 0;  // statements starting on the line that ran
+	uint64_t iterations = 0;  // back edges taken by the loops of the line
+	uint64_t nanoseconds = 0; // spent in the instructions of the line
+};
+
+// Statement level profile of a run
+struct Profile {
+	std::string program_name;
+	uint64_t nanoseconds = 0;
+	std::map<uint32_t, LineStats> lines;      // by source line, 0 is code outside any statement
+	std::map<std::string, uint64_t> builtins; // calls of Write and Writeln, values read by Read, lines skipped by Readln
+	std::map<std::string, uint64_t> stacks;   // nanoseconds by program;routine;enclosing loops;line, no routine outside them
+
+	// the lines that took the most time, with their text when the source is given
+	void report(std::ostream& os, std::string_view source = {}, size_t limit = 20) const;
+	// one "frame;frame;frame nanoseconds" line per stack, the input format of flamegraph.pl
+	void folded(std::ostream& os) const;
+};
+
+// Collects a Profile while the VM interprets a chunk. The code is split into
+// segments of consecutive instructions on the same line in the same loops and
+// the clock is only read when execution moves to another segment.
+class Profiler {
+	using clock = std::chrono::steady_clock;
+	static constexpr uint32_t none = UINT32_MAX;
+
+	const Chunk& chunk;
+	Profile& profile;
+	std::vector<uint32_t> segments;  // by instruction
+	std::vector<uint8_t> counted;    // by instruction, its executions are reported
+	std::vector<uint64_t> hits;      // by instruction
+	std::vector<uint64_t> spent;     // nanoseconds by segment
+	std::vector<uint32_t> lines;     // by segment
+	std::vector<std::string> stacks; // by segment
+	uint32_t current = none;
+	clock::time_point start, mark;
+
+	void enter(uint32_t segment);
+public:
+	Profiler(const Chunk& chunk, Profile& profile);
+
+	// called before the instruction at pc runs
+	void step(int32_t pc) {
+		if (segments[pc] != current) enter(segments[pc]);
+		if (counted[pc]) ++hits[pc];
+	}
+	// takes back the step of an instruction that runs again when a suspended run resumes
+	void unstep(int32_t pc) {
+		if (counted[pc]) --hits[pc];
+	}
+	// stops the clock and fills the profile
+	void finish();
+};
+
+#endif
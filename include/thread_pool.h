@@ -0,0 +1,52 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each with its own task deque. A worker runs its
+// newest task first and, once its deque is empty, steals the oldest task of
+// another worker, so uneven tasks even out without a shared queue.
+class ThreadPool {
+	using Task = std::function<void()>;
+
+	struct Queue {
+		std::mutex lock;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	size_t queued = 0;             // tasks waiting in the deques, guarded by lock
+	std::atomic<size_t> unfinished{0};
+	std::atomic<size_t> next{0};   // deque of the next task submitted from outside the pool
+	std::exception_ptr error;
+	bool stopping = false;
+
+	bool take(size_t self, Task& task);
+	void work(size_t self);
+public:
+	explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	[[nodiscard]] size_t size() const noexcept { return workers.size(); }
+
+	// tasks submitted by a worker go to its own deque, others are spread round robin
+	void submit(Task task);
+	// blocks until every submitted task has finished, rethrows the first exception a task threw
+	void wait();
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef __TOKENIZER_H__
+#define __TOKENIZER_H__
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "value.h"
+
+enum class TokenKind : byte_t {
+	Eof,
+	Identifier,
+	IntegerConst,
+	RealConst,
+	StringConst,
+
+	//keywords of the supported subset
+	And,
+	Array,
+	Begin,
+	Boolean,
+	Case,
+	Char,
+	Const,
+	Div,
+	Do,
+	Downto,
+	Else,
+	End,
+	False,
+	For,
+	Function,
+	If,
+	Integer,
+	Mod,
+	Not,
+	Of,
+	Or,
+	Procedure,
+	Program,
+	Real,
+	Record,
+	String,
+	Then,
+	To,
+	True,
+	Type,
+	Var,
+	While,
+	Reserved, //keyword of the grammar outside the subset, e.g. repeat or with
+	Parallel, //{$PARALLEL} directive, other directives are comments
+
+	Plus,
+	Minus,
+	Star,
+	Slash,
+	Assign,
+	Comma,
+	Semi,
+	Colon,
+	Equal,
+	NotEqual,
+	Lt,
+	Le,
+	Ge,
+	Gt,
+	LParen,
+	RParen,
+	Dot,
+	DotDot,
+	LBrack, //[ or (.
+	RBrack, //] or .)
+	Other, //any other symbol of the grammar or a lexical error
+};
+
+struct Lexeme {
+	TokenKind kind;
+	std::string_view text; //points into the source, string constants keep their quotes
+	uint32_t line;
+};
+
+// Text of a string constant: drops the enclosing quotes and undoubles the embedded ones
+std::string unquote(std::string_view literal);
+
+// Single pass lexer over the source text with the token rules of PascalLexer.g4,
+// keywords are case insensitive and lexemes never allocate
+class Tokenizer {
+	std::string_view source;
+	size_t pos = 0;
+	uint32_t line = 1;
+
+	bool skip();
+public:
+	explicit Tokenizer(std::string_view source) : source(source) {}
+
+	Lexeme next();
+};
+
+#endif
@@ -1,7 +1,9 @@
 #ifndef __VALUE_H__
 #define __VALUE_H__
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <map>
 #include <iostream>
 #include <functional>
@@ -14,7 +16,7 @@ namespace interpreter {
 		Reference,
 		Double,
 		Real,
-		Extended, //long double
+		Extended, //stored as double
 		Byte, //uchar
 		Word, //short
 		Integer,
@@ -33,6 +35,58 @@ namespace interpreter {
 	};
 
 	bool in_group(DataType type, TypeGroup group);
+
+	struct StringStats {
+		uint64_t made = 0;      // payloads created
+		uint64_t allocated = 0; // of them taken from the heap, the rest reused a released payload
+	};
+
+	// Bytes a run holds against its limit. The payloads StringData makes on a thread the meter
+	// is installed on are charged to it and given back when they are released.
+	struct MemoryMeter {
+		size_t used = 0;
+		size_t limit = 0; // 0 for none
+
+		// throws "Memory limit exceeded" and leaves used as it was when the bytes don't fit
+		void charge(size_t bytes);
+		void credit(size_t bytes) noexcept { used -= bytes < used ? bytes : used; }
+	};
+
+	// Reference counted string payload, characters follow the header. A shared payload
+	// is immutable, append writes in place only to one its caller holds the only
+	// reference to and copies it otherwise. A pinned payload is owned by a compiled
+	// program and is never counted, so threads sharing the program copy its strings
+	// without writing to them.
+	struct StringData {
+		static constexpr uint32_t pinned = UINT32_MAX;
+
+		uint32_t refs;
+		uint32_t size;
+		uint32_t capacity; // characters that fit without a new payload
+
+		[[nodiscard]] const char* data() const noexcept { return reinterpret_cast<const char*>(this + 1); }
+		[[nodiscard]] char* data() noexcept { return reinterpret_cast<char*>(this + 1); }
+
+		// room for at least capacity characters
+		static StringData* make(std::string_view lhs, std::string_view rhs = {}, size_t capacity = 0);
+		// str followed by tail, the reference to str becomes the reference to the result.
+		// A payload that grows in place at least doubles, so appending in a loop is linear.
+		static StringData* append(StringData* str, std::string_view tail);
+		static void release(StringData* str) noexcept;
+		// meter of the payloads the calling thread makes and releases from now on, returns the
+		// one it replaces
+		static MemoryMeter* install(MemoryMeter* meter) noexcept;
+		// counters of the calling thread
+		static StringStats stats() noexcept;
+	};
+
+	// Copy(str, index, count) and Pos(part, str) of the language, positions count from 1.
+	// Copy clamps the range to the string, Pos is 0 when part is empty or not found.
+	[[nodiscard]] std::string_view substring(std::string_view str, int32_t index, int32_t count) noexcept;
+	[[nodiscard]] int32_t position(std::string_view part, std::string_view str) noexcept;
+
+	struct AggregateData;
+	void print(std::ostream& os, const AggregateData* aggregate);
 }
 
 using namespace interpreter;
@@ -42,32 +96,35 @@ using namespace interpreter;
 class Value {
 
 private:
-	[[maybe_unused]] std::string _name;
-	 const bool _const = false;
-	 DataType _type;
+	DataType _type = DataType::Null;
 public:
 	union {
 		int int_ptr;
-		long double double_ptr;
+		double double_ptr;
 		bool bool_ptr;
-		std::string* string_ptr;
+		StringData* string_ptr; //nullptr is an empty string
 		char char_ptr;
+		AggregateData* aggregate_ptr; //Reference: storage of an array or record variable, owned by the VM
+		char* address_ptr; //Reference on the operand stack: an aggregate inside a storage, see Address
 	} value = {} ;
 
 public:
 
-	Value();
-	Value(const Value& v);
-	explicit Value(DataType type, const void* p = nullptr, bool is_const = false);
-	explicit Value(const std::string& name, DataType type, const void* p = nullptr, bool is_const = false);
+	Value() noexcept = default;
+	explicit Value(DataType type) noexcept;
+	explicit Value(int v) noexcept;
+	explicit Value(double v) noexcept;
+	explicit Value(bool v) noexcept;
+	explicit Value(char v) noexcept;
+	explicit Value(std::string_view v);
+	explicit Value(const char* v) : Value(std::string_view(v)) {}
+	Value(const Value& v) noexcept;
 	Value(Value&& moved) noexcept;
 	~Value();
 	operator bool() const noexcept;
-	[[nodiscard]] bool is_const() const noexcept;
 	[[nodiscard]] DataType type() const noexcept;
-	void init_type(const void* ptr);
+	[[nodiscard]] std::string_view str() const noexcept;
 	[[nodiscard]] int cmp(const Value& other) const noexcept;
-	[[nodiscard]] std::string name() const;
 
 	Value operator+(const Value& other) const;
 	Value operator-(const Value& other) const;
@@ -77,7 +134,7 @@ public:
 
 	Value operator-() const;
 
-	Value& operator=(const Value& other);
+	Value& operator=(const Value& other) noexcept;
 	Value& operator=(Value&& other) noexcept;
 
 	bool operator==(const Value& other) const noexcept;
@@ -91,14 +148,28 @@ public:
 	friend std::ostream& operator<<(std::ostream& os, const Value& v) {
 		switch(v._type) {
 			case DataType::Integer:
+			case DataType::Word:
+			case DataType::Byte:
 				os << v.value.int_ptr;
 				break;
 			case DataType::Double:
 			case DataType::Real:
+			case DataType::Extended:
 				os << v.value.double_ptr;
 				break;
 			case DataType::String:
-				os << *v.value.string_ptr;
+				os << v.str();
+				break;
+			case DataType::Boolean:
+				os << (v.value.bool_ptr ? "TRUE" : "FALSE");
+				break;
+			case DataType::Char:
+				os << v.value.char_ptr;
+				break;
+			case DataType::Reference:
+				print(os, v.value.aggregate_ptr);
+				break;
+			default:
 				break;
 		}
 		return os;
@@ -106,6 +177,8 @@ public:
 
 };
 
+static_assert(sizeof(Value) == 16);
+
 namespace  interpreter {
 
 const std::map<std::string, std::function<bool(const Value &, const Value &)>> compares = {
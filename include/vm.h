@@ -0,0 +1,100 @@
+#ifndef __VM_H__
+#define __VM_H__
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "bytecode.h"
+#include "jit.h"
+#include "input.h"
+#include "options.h"
+#include "output.h"
+#include "profiler.h"
+#include "thread_pool.h"
+
+struct Program {
+	std::string program_name;
+	std::vector<Value> stack; // entries above the stack pointer are free, frames of routines grow it within its capacity
+	std::vector<Value> frame;
+	std::vector<std::unique_ptr<AggregateData>> aggregates; // of the last run, the frames point to them
+};
+
+// Why VM::resume returned
+enum class Progress : uint8_t {
+	Finished, // the program ended
+	Yielded,  // the slice was used up, resume goes on
+	Waiting,  // a Read needs input that was not fed yet
+};
+
+class VM {
+	// where Return resumes
+	struct CallFrame {
+		const Instruction* ret;
+		Value* frame;
+	};
+
+	// where the interpreter stopped
+	enum class Stop : uint8_t { Halt, Budget, Input };
+
+	// The run start made and resume continues. The interpreter returns when its budget of steps
+	// runs out before a back edge or call, or before a Read of input not fed yet, and picks up
+	// at the same instruction with the frames and calls as they were.
+	struct Run {
+		const Chunk* chunk = nullptr; // none when no run is going on
+		JitState state{};
+		int32_t pc = 0;
+		uint64_t steps = 0;           // taken so far
+		MemoryMeter memory;           // bytes of the stack, arrays, records and strings
+		std::chrono::steady_clock::time_point deadline;
+	};
+
+	Options options;
+	Run current;
+	bool bounded = false;           // limited or sliced, the run stays in the interpreter
+	std::unique_ptr<Profiler> profiler;
+	Jit jit;
+	std::vector<uint32_t> counters; // back edges taken, by loop head
+	std::vector<JitFunction> compiled;
+	std::vector<CallFrame> calls;
+	std::vector<std::vector<AggregateData*>> spare; // storage of returned routines by aggregate type, cleared
+	std::vector<AggregateData*> views;              // of returned var parameters
+	std::unique_ptr<ThreadPool> pool;               // runs the parts of parallel loops, made by the first one
+	std::vector<std::unique_ptr<VM>> workers;       // interpret the parts, for the chunk of the run
+	std::vector<VM*> idle;                          // workers not running a part, guarded by lock
+	std::mutex lock;
+	int32_t running = -1;                           // parallel loop a worker runs a part of
+
+	static Value* execute(const Chunk& chunk, const Instruction& ins, Value* frame, Value* globals, Value* sp, Input& input, Output& output);
+	static int32_t slow_path(JitState* state, int32_t pc) noexcept;
+	JitFunction hot_loop(const Chunk& chunk, int32_t head, int32_t end);
+	void grow(size_t size);
+	void charge(size_t bytes);
+	void finish() noexcept;
+	void enter(const Chunk& chunk, const Routine& routine, Value* frame, Value* globals);
+	void leave(const Routine& routine, Value* frame) noexcept;
+	bool parallel(const Chunk& chunk, int32_t index, int32_t head, Value* frame, Value* globals, int32_t last);
+	void prepare(const Chunk& chunk);
+	template<bool Profiling> Stop interpret(const Chunk& chunk, JitState& state, Profiler* profiler, int32_t pc, uint64_t& budget);
+public:
+	Program program;
+	Input input;
+	Output output;
+	Profile profile; // of the last run when options.profile is set
+
+	explicit VM(const Options& options = {}, std::istream& is = std::cin, std::ostream& os = std::cout);
+
+	void run(const Chunk& chunk);
+	// Runs in slices: start sets the chunk up to run, each resume runs it for at most steps back
+	// edges and calls, 0 for no limit. Fed input (see Input::feed) makes Read wait for the host
+	// instead of the stream. The chunk must outlive the run, errors and limits throw from resume.
+	void start(const Chunk& chunk);
+	Progress resume(uint64_t steps = 0);
+	[[nodiscard]] bool started() const noexcept { return current.chunk != nullptr; }
+	[[nodiscard]] uint64_t steps() const noexcept { return current.steps; }
+};
+
+#endif
@@ -0,0 +1,68 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "interpreter.h"
+
+namespace {
+
+const char* source = R"(program greet;
+const greeting = 'Hello, ';
+var name: string; n, i, sum: integer;
+begin
+  Readln(name);
+  Read(n);
+  sum := 0;
+  for i := 1 to n do sum := sum + i * i;
+  Writeln(greeting + name, sum)
+end.
+)";
+
+}
+
+// Usage: embedding [threads] [runs per thread]
+// Compiles one program and runs it concurrently, each thread with its own context and streams
+int main(int argc, char** argv) {
+	const int threads = argc > 1 ? std::atoi(argv[1]) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	const int runs = argc > 2 ? std::atoi(argv[2]) : 10000;
+
+	Options options;
+	options.dump = false;
+	const Interpreter interpreter(options);
+	const auto compiled = interpreter.compile(source);
+	if (!compiled) {
+		std::cerr << compiled.error << std::endl;
+		return 1;
+	}
+
+	std::atomic<int> failures{0};
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> pool;
+	for (int t = 0; t < threads; ++t) {
+		pool.emplace_back([&, t] {
+			std::istringstream in;
+			std::ostringstream out;
+			auto context = interpreter.context(in, out);
+			for (int i = 0; i < runs; ++i) {
+				const int n = t + i % 100;
+				in.clear();
+				in.str("thread " + std::to_string(t) + "\n" + std::to_string(n) + "\n");
+				out.str({});
+				const auto expected = "Hello, thread " + std::to_string(t) + " " + std::to_string(n * (n + 1) * (2 * n + 1) / 6) + " \n";
+				if (!context.run(compiled.program) || out.str() != expected) ++failures;
+			}
+		});
+	}
+	for (auto& thread : pool) thread.join();
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	const auto total = static_cast<double>(threads) * runs;
+	std::cout << threads << " threads, " << total << " runs in " << elapsed.count() << " s, "
+			  << total / elapsed.count() << " runs/s, " << failures << " failures" << std::endl;
+	return failures ? 1 : 0;
+}
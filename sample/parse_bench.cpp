@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "ast.h"
+#include "pascal_parser.h"
+
+namespace {
+
+// Straight line program of the given size mixing every construct of the supported subset
+std::string generate(int lines) {
+	std::ostringstream out;
+	out << "program bench;\nconst limit = 100; scale = 2.5;\nvar i, j, k: integer; x: real; s: string; b: boolean;\nbegin\n";
+	for (int n = 0; n < lines; ++n) {
+		switch (n % 5) {
+			case 0: out << "  i := (i + " << n << ") * 3 - j div 7 mod 11;\n"; break;
+			case 1: out << "  if (i > j) and not b then x := x / scale + 1.0e-3 else s := s + 'abc';\n"; break;
+			case 2: out << "  for k := 1 to 10 do begin j := j + k * 2; b := j <> i end;\n"; break;
+			case 3: out << "  while i > limit do i := i - limit;\n"; break;
+			default: out << "  Writeln('line ', i, ' ', x:8:2);\n"; break;
+		}
+	}
+	out << "  Writeln(s)\nend.\n";
+	return out.str();
+}
+
+// Best wall time of the runs in milliseconds, the tree is freed outside the timed region
+double measure(const std::string& source, Frontend frontend, int runs) {
+	Options options;
+	options.frontend = frontend;
+	double best = 1e300;
+	for (int i = 0; i < runs; ++i) {
+		const auto start = std::chrono::steady_clock::now();
+		auto program = Runtime::parse(source, options);
+		const auto end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	return best;
+}
+
+}
+
+// Usage: parse_bench [lines] [runs] [speedup]
+// Fails when the descent parser is less than the given times faster than the generated one
+int main(int argc, char** argv) {
+	const int lines = argc > 1 ? std::atoi(argv[1]) : 100000;
+	const int runs = argc > 2 ? std::atoi(argv[2]) : 5;
+	const double required = argc > 3 ? std::atof(argv[3]) : 10.0;
+	const auto source = generate(lines);
+
+	Options validate;
+	validate.frontend = Frontend::Validate;
+	try {
+		Runtime::parse(source, validate);
+	} catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	const auto antlr = measure(source, Frontend::Antlr, runs);
+	const auto fast = measure(source, Frontend::Fast, runs);
+	std::cout << lines << " lines, " << source.size() / 1024 << " KiB, best of " << runs << std::endl
+			  << "antlr:   " << antlr << " ms" << std::endl
+			  << "descent: " << fast << " ms" << std::endl
+			  << "speedup: " << antlr / fast << "x" << std::endl;
+	if (antlr / fast < required) {
+		std::cerr << "speedup below " << required << "x" << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,158 @@
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "arena.h"
+#include "cache.h"
+#include "pascal_parser.h"
+
+namespace {
+
+// a decimal number of up to 18 digits
+bool number(const std::string& text, uint64_t& res) {
+	if (text.empty() || text.size() > 18 || text.find_first_not_of("0123456789") != std::string::npos) return false;
+	res = std::stoull(text);
+	return true;
+}
+
+void usage() {
+	std::cerr << "Usage: pascal [--jit] [--no-dump] [--parser fast|antlr|validate] [--cache dir [--cache-stats]] [--alloc-stats]" << std::endl
+			  << "              [--profile] [--flamegraph file] [--threads n] [--max-steps n] [--time-limit ms] [--memory-limit mb]" << std::endl
+			  << "              [--emit-c | --aot] [-o output] file.pas" << std::endl
+			  << "       pascal --cache dir --clear-cache" << std::endl
+			  << "  --parser  front end, validate parses with both and checks the trees match" << std::endl
+			  << "  --cache   reuse compiled programs stored in dir" << std::endl
+			  << "  --alloc-stats  count the string payloads and syntax tree memory of the run" << std::endl
+			  << "  --profile  report the statements that took the most time on stderr, disables --jit" << std::endl
+			  << "  --flamegraph  profile and write the folded stacks for flamegraph.pl to file" << std::endl
+			  << "  --threads  run {$PARALLEL} loops on n threads, one per hardware thread by default" << std::endl
+			  << "  --max-steps, --time-limit, --memory-limit  stop the program after n loop iterations and calls," << std::endl
+			  << "             ms milliseconds or when it holds more than mb megabytes, disables --jit" << std::endl
+			  << "  --emit-c  write the program translated to C to output (stdout by default)" << std::endl
+			  << "  --aot     translate to C and build a native executable with cc" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+	// program input and output are buffered by the interpreter, stdio does not need to see them
+	std::ios::sync_with_stdio(false);
+	Options options;
+	bool emit_c = false, aot = false, cache_stats = false, clear_cache = false, alloc_stats = false;
+	std::string path, output;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--jit") options.jit = true;
+		else if (arg == "--no-dump") options.dump = false;
+		else if (arg == "--emit-c") emit_c = true;
+		else if (arg == "--aot") aot = true;
+		else if (arg == "-o" && i + 1 < argc) output = argv[++i];
+		else if (arg == "--parser" && i + 1 < argc) {
+			const std::string frontend = argv[++i];
+			if (frontend == "fast") options.frontend = Frontend::Fast;
+			else if (frontend == "antlr") options.frontend = Frontend::Antlr;
+			else if (frontend == "validate") options.frontend = Frontend::Validate;
+			else {
+				usage();
+				return 2;
+			}
+		}
+		else if (arg == "--cache" && i + 1 < argc) options.cache_dir = argv[++i];
+		else if (arg == "--cache-stats") cache_stats = true;
+		else if (arg == "--clear-cache") clear_cache = true;
+		else if (arg == "--alloc-stats") alloc_stats = true;
+		else if (arg == "--profile") options.profile = true;
+		else if (arg == "--flamegraph" && i + 1 < argc) {
+			options.profile = true;
+			options.flamegraph = argv[++i];
+		}
+		else if (arg == "--threads" && i + 1 < argc) {
+			const std::string threads = argv[++i];
+			if (threads.empty() || threads.size() > 4 || threads.find_first_not_of("0123456789") != std::string::npos) {
+				usage();
+				return 2;
+			}
+			options.threads = static_cast<unsigned>(std::stoul(threads));
+		}
+		else if ((arg == "--max-steps" || arg == "--time-limit" || arg == "--memory-limit") && i + 1 < argc) {
+			uint64_t limit;
+			if (!number(argv[++i], limit) || (arg == "--time-limit" && limit > UINT32_MAX) || (arg == "--memory-limit" && limit > (1u << 30))) {
+				usage();
+				return 2;
+			}
+			if (arg == "--max-steps") options.max_steps = limit;
+			else if (arg == "--time-limit") options.time_limit = static_cast<uint32_t>(limit);
+			else options.memory_limit = static_cast<size_t>(limit) << 20;
+		}
+		else if (!arg.empty() && arg[0] != '-' && path.empty()) path = arg;
+		else {
+			usage();
+			return 2;
+		}
+	}
+	if (clear_cache && !options.cache_dir.empty()) {
+		std::cerr << "Removed " << ChunkCache(options.cache_dir).clear() << " cached programs" << std::endl;
+		if (path.empty()) return 0;
+	}
+	if (path.empty()) {
+		usage();
+		return 2;
+	}
+
+	std::ifstream fin(path);
+	if (!fin.is_open()) {
+		std::cerr << "No such file: " << path << std::endl;
+		return 1;
+	}
+	std::stringstream ss;
+	ss << fin.rdbuf();
+
+	if (!emit_c && !aot) {
+		const auto ok = Runtime::run(ss.str(), options);
+		if (cache_stats) {
+			const auto stats = ChunkCache::stats();
+			std::cerr << "cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+					  << stats.stores << " stores, " << stats.rejected << " rejected" << std::endl;
+		}
+		if (alloc_stats) {
+			const auto strings = StringData::stats();
+			const auto nodes = Arena::stats();
+			std::cerr << "strings: " << strings.made << " made, " << strings.allocated << " from the heap" << std::endl
+					  << "syntax tree: " << nodes.bytes << " bytes, " << nodes.blocks << " blocks from the heap, "
+					  << nodes.reused << " reused" << std::endl;
+		}
+		return ok ? 0 : 1;
+	}
+
+	std::string source;
+	try {
+		source = Runtime::emit_c(ss.str(), options);
+	} catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	if (!aot) {
+		if (output.empty()) {
+			std::cout << source;
+			return 0;
+		}
+		std::ofstream(output) << source;
+		return 0;
+	}
+
+	if (output.empty()) {
+		output = path;
+		if (const auto dot = output.rfind('.'); dot != std::string::npos && output.find('/', dot) == std::string::npos)
+			output.erase(dot);
+		if (output == path) output += ".out";
+	}
+	const auto c_path = output + ".c";
+	std::ofstream(c_path) << source;
+	const char* cc = std::getenv("CC");
+	const auto command = std::string(cc ? cc : "cc") + " -O2 -o '" + output + "' '" + c_path + "' -lm";
+	return std::system(command.c_str()) == 0 ? 0 : 1;
+}
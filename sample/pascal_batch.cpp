@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "interpreter.h"
+#include "thread_pool.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+enum class Outcome {
+	Ok,
+	Mismatch,     // ran, but the output differs from NAME.out
+	RuntimeError,
+	CompileError,
+	IoError,
+};
+
+const char* name(Outcome outcome) {
+	switch (outcome) {
+		case Outcome::Ok: return "ok";
+		case Outcome::Mismatch: return "mismatch";
+		case Outcome::RuntimeError: return "runtime error";
+		case Outcome::CompileError: return "compile error";
+		default: return "io error";
+	}
+}
+
+struct Job {
+	fs::path path;
+	fs::path output; // under --out-dir, see collect
+	Outcome outcome = Outcome::Ok;
+	std::string message;
+	double millis = 0;
+};
+
+struct Settings {
+	Options options;
+	bool quiet = false;
+	fs::path out_dir;
+};
+
+void usage() {
+	std::cerr << "Usage: pascal_batch [-j threads] [--jit] [--dump] [--parser fast|antlr|validate] [--cache dir]" << std::endl
+			  << "                    [--out-dir dir] [--quiet] [--manifest file]... [path]..." << std::endl
+			  << "  path        a .pas file or a directory searched recursively for them" << std::endl
+			  << "  --manifest  file with one path per line, # starts a comment" << std::endl
+			  << "  --out-dir   keep the output of every program under dir, at its path from the parent of the" << std::endl
+			  << "              path or manifest entry it was found by" << std::endl
+			  << "  --quiet     report only the programs that did not pass" << std::endl
+			  << "NAME.in next to NAME.pas is the program's input, NAME.out the expected output." << std::endl;
+}
+
+std::string slurp(const fs::path& path) {
+	std::ifstream fin(path, std::ios::binary);
+	if (!fin.is_open()) throw std::runtime_error("Can't read " + path.string());
+	std::stringstream ss;
+	ss << fin.rdbuf();
+	return ss.str();
+}
+
+// One line of an error message for the report, exceptions of the interpreter put the cause on the Error: line
+std::string headline(const std::string& message) {
+	const auto at = message.find("Error: ");
+	const auto from = at == std::string::npos ? 0 : at;
+	return message.substr(from, message.find('\n', from) - from);
+}
+
+// The output of a program goes to its path from the parent of the path given for it, which
+// never leaves --out-dir also when the given path has .. parts
+void collect(const fs::path& path, std::vector<Job>& jobs) {
+	auto root = fs::absolute(path).lexically_normal();
+	if (!root.has_filename()) root = root.parent_path();
+	const auto base = root.parent_path();
+	const auto add = [&](const fs::path& file) {
+		auto& job = jobs.emplace_back();
+		job.path = file;
+		job.output = fs::absolute(file).lexically_normal().lexically_relative(base);
+		if (job.output.empty() || *job.output.begin() == "..") job.output = file.filename();
+		job.output.replace_extension(".out");
+	};
+	if (!fs::is_directory(path)) {
+		add(path);
+		return;
+	}
+	std::vector<fs::path> found;
+	for (const auto& entry : fs::recursive_directory_iterator(path))
+		if (entry.is_regular_file() && entry.path().extension() == ".pas") found.push_back(entry.path());
+	std::sort(found.begin(), found.end());
+	for (const auto& file : found) add(file);
+}
+
+void read_manifest(const fs::path& manifest, std::vector<Job>& jobs) {
+	std::istringstream lines(slurp(manifest));
+	for (std::string line; std::getline(lines, line);) {
+		line.erase(std::find(line.begin(), line.end(), '#'), line.end());
+		const auto first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos) continue;
+		line = line.substr(first, line.find_last_not_of(" \t\r") + 1 - first);
+		// relative entries are relative to the manifest
+		const fs::path entry(line);
+		collect(entry.is_absolute() ? entry : manifest.parent_path() / entry, jobs);
+	}
+}
+
+// Compiles and runs one program with its own streams, never throws
+void run(Job& job, const Interpreter& interpreter, const Settings& settings) {
+	const auto start = std::chrono::steady_clock::now();
+	std::ostringstream out;
+	try {
+		const auto compiled = interpreter.compile(slurp(job.path));
+		if (!compiled) {
+			job.outcome = Outcome::CompileError;
+			job.message = compiled.error;
+		} else {
+			auto input_path = job.path;
+			std::ifstream fin(input_path.replace_extension(".in"), std::ios::binary);
+			std::istringstream none;
+			auto context = interpreter.context(fin.is_open() ? static_cast<std::istream&>(fin) : none, out);
+			if (const auto status = context.run(compiled.program); !status) {
+				job.outcome = Outcome::RuntimeError;
+				job.message = status.error;
+			}
+			if (settings.options.dump) {
+				out << "================Dumping variables================" << std::endl;
+				context.dump(*compiled.program, out);
+			}
+			auto expected_path = job.path;
+			if (job.outcome == Outcome::Ok && fs::exists(expected_path.replace_extension(".out"))
+				&& slurp(expected_path) != out.str()) {
+				job.outcome = Outcome::Mismatch;
+				job.message = "output differs from " + expected_path.string();
+			}
+		}
+		if (!settings.out_dir.empty()) {
+			const auto target = settings.out_dir / job.output;
+			fs::create_directories(target.parent_path());
+			std::ofstream(target, std::ios::binary) << out.str();
+		}
+	} catch (std::exception& e) {
+		job.outcome = Outcome::IoError;
+		job.message = e.what();
+	}
+	job.millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+int main(int argc, char** argv) {
+	std::ios::sync_with_stdio(false);
+	Settings settings;
+	settings.options.dump = false;
+	unsigned threads = std::thread::hardware_concurrency();
+	std::vector<Job> jobs;
+	try {
+		for (int i = 1; i < argc; ++i) {
+			const std::string arg = argv[i];
+			if (arg == "-j" && i + 1 < argc) threads = static_cast<unsigned>(std::stoul(argv[++i]));
+			else if (arg == "--jit") settings.options.jit = true;
+			else if (arg == "--dump") settings.options.dump = true;
+			else if (arg == "--quiet") settings.quiet = true;
+			else if (arg == "--cache" && i + 1 < argc) settings.options.cache_dir = argv[++i];
+			else if (arg == "--out-dir" && i + 1 < argc) settings.out_dir = argv[++i];
+			else if (arg == "--manifest" && i + 1 < argc) read_manifest(argv[++i], jobs);
+			else if (arg == "--parser" && i + 1 < argc) {
+				const std::string frontend = argv[++i];
+				if (frontend == "fast") settings.options.frontend = Frontend::Fast;
+				else if (frontend == "antlr") settings.options.frontend = Frontend::Antlr;
+				else if (frontend == "validate") settings.options.frontend = Frontend::Validate;
+				else {
+					usage();
+					return 2;
+				}
+			}
+			else if (!arg.empty() && arg[0] != '-') collect(arg, jobs);
+			else {
+				usage();
+				return 2;
+			}
+		}
+	} catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 2;
+	}
+	if (jobs.empty()) {
+		usage();
+		return 2;
+	}
+
+	const Interpreter interpreter(settings.options);
+	const auto start = std::chrono::steady_clock::now();
+	{
+		ThreadPool pool(threads);
+		for (auto& job : jobs)
+			pool.submit([&job, &interpreter, &settings] { run(job, interpreter, settings); });
+		pool.wait();
+		threads = static_cast<unsigned>(pool.size());
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	size_t counts[5] = {};
+	double busy = 0;
+	std::cout << std::fixed << std::setprecision(3);
+	for (const auto& job : jobs) {
+		++counts[static_cast<size_t>(job.outcome)];
+		busy += job.millis;
+		if (settings.quiet && job.outcome == Outcome::Ok) continue;
+		std::cout << std::left << std::setw(14) << name(job.outcome) << std::right << std::setw(10) << job.millis << " ms  " << job.path.string();
+		if (!job.message.empty()) std::cout << ": " << headline(job.message);
+		std::cout << '\n';
+	}
+	std::cout << jobs.size() << " programs: " << counts[0] << " ok, " << counts[1] << " mismatched, " << counts[2]
+			  << " runtime errors, " << counts[3] << " compile errors, " << counts[4] << " io errors" << '\n'
+			  << elapsed.count() << " s on " << threads << " threads, " << jobs.size() / elapsed.count() << " programs/s, "
+			  << busy / 1000 / elapsed.count() << " threads busy on average" << std::endl;
+	return counts[0] == jobs.size() ? 0 : 1;
+}
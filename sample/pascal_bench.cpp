@@ -0,0 +1,345 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ast.h"
+#include "checker.h"
+#include "compiler.h"
+#include "interpreter.h"
+#include "optimizer.h"
+#include "pascal_parser.h"
+#include "tokenizer.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// order of the phases in the report, total is their sum
+const char* const phases[] = {"lex", "parse", "analyze", "compile", "execute", "total"};
+const char* const statistics[] = {"min", "median", "mean", "stddev"};
+
+struct Settings {
+	Options options;
+	int runs = 10;
+	int warmup = 1;
+	std::string filter;
+	std::string json;         // results are written here, - is stdout
+	std::string baseline;     // results to compare against
+	double threshold = 10;    // percent a median may grow before it is a regression
+	double min_ms = 0.5;      // medians of the baseline below this are too noisy to compare
+};
+
+// Milliseconds of one phase over the runs
+struct Series {
+	std::vector<double> samples;
+
+	[[nodiscard]] double get(std::string_view statistic) const {
+		auto sorted = samples;
+		std::sort(sorted.begin(), sorted.end());
+		const auto n = static_cast<double>(sorted.size());
+		double mean = 0;
+		for (const auto s : sorted) mean += s / n;
+		if (statistic == "min") return sorted.front();
+		if (statistic == "median") {
+			const auto mid = sorted.size() / 2;
+			return sorted.size() % 2 ? sorted[mid] : (sorted[mid - 1] + sorted[mid]) / 2;
+		}
+		if (statistic == "mean") return mean;
+		double var = 0;
+		for (const auto s : sorted) var += (s - mean) * (s - mean);
+		return sorted.size() > 1 ? std::sqrt(var / (n - 1)) : 0;
+	}
+};
+
+struct Benchmark {
+	std::string name;
+	fs::path path;
+	std::map<std::string, Series> phases;
+};
+
+// Output of the programs is formatted as usual and thrown away
+class Discard : public std::streambuf {
+protected:
+	int overflow(int c) override { return c; }
+	std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+void usage() {
+	std::cerr << "Usage: pascal_bench [--runs n] [--warmup n] [--jit] [--filter text] [--json file]" << std::endl
+			  << "                    [--baseline file [--threshold percent] [--min-ms ms]] [path]..." << std::endl
+			  << "  path         a .pas file or a directory of them, benchmarks by default" << std::endl
+			  << "  --json       write the statistics of every phase to file, - for stdout" << std::endl
+			  << "  --baseline   compare the medians with a file written by --json, fails on regressions" << std::endl
+			  << "  --threshold  growth of a median reported as a regression, 10 by default" << std::endl
+			  << "  --min-ms     skip the phases the baseline measured below this, 0.5 by default" << std::endl
+			  << "NAME.in next to NAME.pas is the program's input." << std::endl;
+}
+
+std::string slurp(const fs::path& path) {
+	std::ifstream fin(path, std::ios::binary);
+	if (!fin.is_open()) throw std::runtime_error("Can't read " + path.string());
+	std::stringstream ss;
+	ss << fin.rdbuf();
+	return ss.str();
+}
+
+template<typename F> double timed(F&& f) {
+	const auto start = clock_type::now();
+	f();
+	return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+// One pass through every phase, the same steps Interpreter::compile and ExecutionContext::run take
+void run_once(Benchmark& bench, const std::string& source, const std::string& input, const Settings& settings, bool record) {
+	double ms[6] = {};
+	ms[0] = timed([&] {
+		Tokenizer tokenizer(source);
+		while (tokenizer.next().kind != TokenKind::Eof) {}
+	});
+	std::unique_ptr<ast::Program> tree;
+	ms[1] = timed([&] { tree = Runtime::parse(source, settings.options); });
+	ms[2] = timed([&] {
+		TypeChecker checker;
+		Optimizer optimizer;
+		checker.check(*tree);
+		optimizer.optimize(*tree);
+	});
+	std::shared_ptr<const CompiledProgram> program;
+	ms[3] = timed([&] {
+		Compiler compiler;
+		program = std::make_shared<const CompiledProgram>(compiler.compile(*tree));
+	});
+	std::istringstream in(input);
+	Discard discard;
+	std::ostream out(&discard);
+	ExecutionContext context(in, out, settings.options);
+	Status status;
+	ms[4] = timed([&] { status = context.run(program); });
+	if (!status) throw std::runtime_error(status.error);
+	if (!record) return;
+	for (size_t i = 0; i < 5; ++i) {
+		bench.phases[phases[i]].samples.push_back(ms[i]);
+		ms[5] += ms[i];
+	}
+	bench.phases["total"].samples.push_back(ms[5]);
+}
+
+void collect(const fs::path& path, std::vector<Benchmark>& benchmarks) {
+	std::vector<fs::path> found;
+	if (fs::is_directory(path)) {
+		for (const auto& entry : fs::directory_iterator(path))
+			if (entry.is_regular_file() && entry.path().extension() == ".pas") found.push_back(entry.path());
+		std::sort(found.begin(), found.end());
+	} else found.push_back(path);
+	for (auto& file : found)
+		benchmarks.push_back({file.stem().string(), std::move(file), {}});
+}
+
+void write_json(std::ostream& os, const std::vector<Benchmark>& benchmarks, const Settings& settings) {
+	os << std::setprecision(6) << "{\n  \"format\": 1,\n  \"runs\": " << settings.runs
+	   << ",\n  \"jit\": " << (settings.options.jit ? "true" : "false") << ",\n  \"benchmarks\": {";
+	for (size_t b = 0; b < benchmarks.size(); ++b) {
+		os << (b ? ",\n" : "\n") << "    \"" << benchmarks[b].name << "\": {";
+		for (size_t p = 0; p < std::size(phases); ++p) {
+			const auto& series = benchmarks[b].phases.at(phases[p]);
+			os << (p ? ",\n" : "\n") << "      \"" << phases[p] << "\": {";
+			for (size_t s = 0; s < std::size(statistics); ++s)
+				os << (s ? ", " : "") << '"' << statistics[s] << "\": " << series.get(statistics[s]);
+			os << '}';
+		}
+		os << "\n    }";
+	}
+	os << "\n  }\n}\n";
+}
+
+// Numbers of a JSON document by the path of keys leading to them, joined with '/'. Just
+// enough JSON to read back what write_json produces, array elements are keyed by index.
+class JsonNumbers {
+	std::string_view text;
+	size_t pos = 0;
+
+	[[noreturn]] void fail() const {
+		throw std::runtime_error("Malformed JSON at offset " + std::to_string(pos));
+	}
+
+	char peek() {
+		while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) ++pos;
+		if (pos == text.size()) fail();
+		return text[pos];
+	}
+
+	void expect(char c) {
+		if (peek() != c) fail();
+		++pos;
+	}
+
+	std::string string() {
+		expect('"');
+		std::string res;
+		while (pos < text.size() && text[pos] != '"') {
+			if (text[pos] == '\\' && ++pos == text.size()) fail();
+			res += text[pos++];
+		}
+		expect('"');
+		return res;
+	}
+
+	void value(const std::string& path) {
+		const auto prefix = path.empty() ? path : path + "/";
+		switch (peek()) {
+			case '{':
+				++pos;
+				if (peek() == '}') break;
+				do {
+					const auto key = string();
+					expect(':');
+					value(prefix + key);
+				} while (peek() == ',' && ++pos);
+				expect('}');
+				return;
+			case '[': {
+				++pos;
+				if (peek() == ']') break;
+				size_t index = 0;
+				do value(prefix + std::to_string(index++));
+				while (peek() == ',' && ++pos);
+				expect(']');
+				return;
+			}
+			case '"':
+				string();
+				return;
+			default: {
+				const auto end = text.find_first_of(",}] \t\r\n", pos);
+				const auto token = std::string(text.substr(pos, end - pos));
+				pos = end == std::string_view::npos ? text.size() : end;
+				if (token == "true" || token == "false" || token == "null") return;
+				size_t used = 0;
+				try {
+					numbers[path] = std::stod(token, &used);
+				} catch (std::exception&) {
+					fail();
+				}
+				if (used != token.size()) fail();
+				return;
+			}
+		}
+		++pos; // closing bracket of an empty object or array
+	}
+public:
+	std::map<std::string, double> numbers;
+
+	explicit JsonNumbers(std::string_view text) : text(text) {
+		value("");
+	}
+};
+
+// Prints the medians that moved beyond the threshold, returns the number of regressions
+size_t compare(const std::vector<Benchmark>& benchmarks, const Settings& settings) {
+	const auto baseline = JsonNumbers(slurp(settings.baseline)).numbers;
+	size_t regressions = 0, compared = 0;
+	std::cout << std::fixed << std::setprecision(3);
+	for (const auto& bench : benchmarks) {
+		for (const auto* phase : phases) {
+			const auto it = baseline.find("benchmarks/" + bench.name + "/" + phase + "/median");
+			if (it == baseline.end() || it->second < settings.min_ms) continue;
+			++compared;
+			const auto now = bench.phases.at(phase).get("median");
+			const auto change = (now / it->second - 1) * 100;
+			if (std::abs(change) <= settings.threshold) continue;
+			regressions += change > 0;
+			std::cout << (change > 0 ? "REGRESSION " : "improved   ") << std::left << std::setw(24)
+					  << bench.name + "/" + phase << std::right << std::setw(12) << it->second << " ms ->"
+					  << std::setw(12) << now << " ms  " << std::showpos << std::setprecision(1) << change
+					  << "%" << std::noshowpos << std::setprecision(3) << '\n';
+		}
+	}
+	std::cout << compared << " medians compared with " << settings.baseline << ", " << regressions
+			  << " regressions beyond " << std::defaultfloat << settings.threshold << "%" << std::endl;
+	return regressions;
+}
+
+}
+
+int main(int argc, char** argv) {
+	std::ios::sync_with_stdio(false);
+	Settings settings;
+	settings.options.dump = false;
+	std::vector<Benchmark> benchmarks;
+	try {
+		for (int i = 1; i < argc; ++i) {
+			const std::string arg = argv[i];
+			if (arg == "--runs" && i + 1 < argc) settings.runs = std::max(std::stoi(argv[++i]), 1);
+			else if (arg == "--warmup" && i + 1 < argc) settings.warmup = std::max(std::stoi(argv[++i]), 0);
+			else if (arg == "--jit") settings.options.jit = true;
+			else if (arg == "--filter" && i + 1 < argc) settings.filter = argv[++i];
+			else if (arg == "--json" && i + 1 < argc) settings.json = argv[++i];
+			else if (arg == "--baseline" && i + 1 < argc) settings.baseline = argv[++i];
+			else if (arg == "--threshold" && i + 1 < argc) settings.threshold = std::stod(argv[++i]);
+			else if (arg == "--min-ms" && i + 1 < argc) settings.min_ms = std::stod(argv[++i]);
+			else if (!arg.empty() && arg[0] != '-') collect(arg, benchmarks);
+			else {
+				usage();
+				return 2;
+			}
+		}
+		if (benchmarks.empty()) collect("benchmarks", benchmarks);
+	} catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 2;
+	}
+	std::erase_if(benchmarks, [&](const Benchmark& b) { return b.name.find(settings.filter) == std::string::npos; });
+	if (benchmarks.empty()) {
+		usage();
+		return 2;
+	}
+
+	// the table goes to stderr when stdout carries the JSON
+	auto& table = settings.json == "-" ? std::cerr : std::cout;
+	table << std::fixed << std::setprecision(3) << std::left << std::setw(16) << "median ms" << std::right;
+	for (const auto* phase : phases) table << std::setw(10) << phase;
+	table << std::setw(10) << "sd total" << '\n';
+	for (auto& bench : benchmarks) {
+		try {
+			const auto source = slurp(bench.path);
+			auto input_path = bench.path;
+			input_path.replace_extension(".in");
+			const auto input = fs::exists(input_path) ? slurp(input_path) : std::string();
+			for (int i = 0; i < settings.warmup + settings.runs; ++i)
+				run_once(bench, source, input, settings, i >= settings.warmup);
+		} catch (std::exception& e) {
+			std::cerr << bench.path.string() << ": " << e.what() << std::endl;
+			return 1;
+		}
+		table << std::left << std::setw(16) << bench.name << std::right;
+		for (const auto* phase : phases) table << std::setw(10) << bench.phases[phase].get("median");
+		table << std::setw(10) << bench.phases["total"].get("stddev") << std::endl;
+	}
+
+	if (settings.json == "-") write_json(std::cout, benchmarks, settings);
+	else if (!settings.json.empty()) {
+		std::ofstream fout(settings.json);
+		if (!fout.is_open()) {
+			std::cerr << "Can't write " << settings.json << std::endl;
+			return 1;
+		}
+		write_json(fout, benchmarks, settings);
+	}
+	try {
+		if (!settings.baseline.empty() && compare(benchmarks, settings) > 0) return 1;
+	} catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 2;
+	}
+	return 0;
+}
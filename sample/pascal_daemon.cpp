@@ -0,0 +1,457 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define PASCAL_DAEMON
+#endif
+
+#include "cache.h"
+#include "interpreter.h"
+#include "thread_pool.h"
+
+// A long running interpreter serving runs over a Unix domain socket, so short programs skip
+// process startup and find the parser, the compiled programs and the execution contexts warm.
+//
+// A request is one header line followed by the payloads it announces:
+//   SOURCE dump source-bytes input-bytes\n source input
+//   PROGRAM dump id input-bytes\n input
+// dump is 0 or 1, id names a program an earlier SOURCE request compiled. The reply is
+//   status id output-bytes dump-bytes error-bytes compile-us run-us\n output dump error
+// with status one of ok, compile-error, runtime-error, unknown-program or bad-request. A
+// connection takes any number of requests, a bad request closes it after the reply.
+
+namespace {
+
+constexpr const char* default_socket = "/tmp/pascal.sock";
+constexpr size_t max_header = 256;
+constexpr size_t max_payload = size_t{64} << 20;
+
+void usage() {
+	std::cerr << "Usage: pascal_daemon serve [--socket path] [-j threads] [--jit] [--parser fast|antlr|validate]" << std::endl
+			  << "                           [--cache dir] [--programs n] [--max-steps n] [--time-limit ms] [--memory-limit mb]" << std::endl
+			  << "       pascal_daemon run [--socket path] [--no-dump] [--time] file.pas | --id id" << std::endl
+			  << "  serve       accept runs until interrupted, " << default_socket << " by default" << std::endl
+			  << "  --programs  compiled programs kept in memory, 256 by default" << std::endl
+			  << "  --max-steps, --time-limit, --memory-limit  bound every run: loop iterations and calls," << std::endl
+			  << "              milliseconds and megabytes, disables --jit" << std::endl
+			  << "  run         run the program on the server with stdin as its input" << std::endl
+			  << "  --id        run a program the server compiled before, --time prints its id" << std::endl;
+}
+
+#ifdef PASCAL_DAEMON
+
+// Whole messages over a stream socket, the descriptor is closed with the connection
+class Connection {
+	int fd;
+	std::string pending; // received past what was taken
+
+	bool receive() {
+		char buffer[1 << 16];
+		for (;;) {
+			const auto got = ::recv(fd, buffer, sizeof(buffer), 0);
+			if (got > 0) {
+				pending.append(buffer, static_cast<size_t>(got));
+				return true;
+			}
+			if (got == 0 || errno != EINTR) return false;
+		}
+	}
+public:
+	explicit Connection(int fd) noexcept : fd(fd) {}
+	~Connection() { ::close(fd); }
+	Connection(const Connection&) = delete;
+	Connection& operator=(const Connection&) = delete;
+
+	// the next line without its line break, false at the end of the stream or for an overlong line
+	bool line(std::string& res) {
+		size_t end;
+		while ((end = pending.find('\n')) == std::string::npos) {
+			if (pending.size() > max_header || !receive()) return false;
+		}
+		if (end > max_header) return false;
+		res.assign(pending, 0, end);
+		pending.erase(0, end + 1);
+		return true;
+	}
+
+	bool bytes(size_t count, std::string& res) {
+		while (pending.size() < count)
+			if (!receive()) return false;
+		res.assign(pending, 0, count);
+		pending.erase(0, count);
+		return true;
+	}
+
+	bool send(std::string_view data) {
+		while (!data.empty()) {
+			const auto sent = ::send(fd, data.data(), data.size(), 0);
+			if (sent < 0 && errno == EINTR) continue;
+			if (sent <= 0) return false;
+			data.remove_prefix(static_cast<size_t>(sent));
+		}
+		return true;
+	}
+};
+
+// The socket at the path, -1 with errno set on failure
+int connect_to(const std::string& path) {
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+	const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) return -1;
+	if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+		const auto error = errno;
+		::close(fd);
+		errno = error;
+		return -1;
+	}
+	return fd;
+}
+
+std::string hex(uint64_t key) {
+	std::ostringstream os;
+	os << std::hex << std::setw(16) << std::setfill('0') << key;
+	return os.str();
+}
+
+uint64_t microseconds(std::chrono::steady_clock::time_point start) {
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+//-------------------------server------------------------------------
+
+// Compiled programs by id, the least recently used one is dropped when there are too many
+class Programs {
+	struct Entry {
+		std::string source;
+		std::shared_ptr<const CompiledProgram> program;
+		uint64_t used;
+	};
+
+	std::mutex lock;
+	std::unordered_map<std::string, Entry> entries;
+	size_t limit;
+	uint64_t clock = 0;
+public:
+	explicit Programs(size_t limit) : limit(std::max<size_t>(limit, 1)) {}
+
+	// the program of the id, also compiled from the source when it is given
+	std::shared_ptr<const CompiledProgram> find(const std::string& id, const std::string* source = nullptr) {
+		std::lock_guard guard(lock);
+		const auto it = entries.find(id);
+		if (it == entries.end() || (source && it->second.source != *source)) return nullptr;
+		it->second.used = ++clock;
+		return it->second.program;
+	}
+
+	void add(const std::string& id, std::string source, std::shared_ptr<const CompiledProgram> program) {
+		std::lock_guard guard(lock);
+		if (entries.size() >= limit && !entries.contains(id)) {
+			const auto oldest = std::min_element(entries.begin(), entries.end(),
+												 [](const auto& l, const auto& r) { return l.second.used < r.second.used; });
+			entries.erase(oldest);
+		}
+		entries[id] = {std::move(source), std::move(program), ++clock};
+	}
+};
+
+// Streams and execution context of a worker thread, reused by every run it serves. The context
+// holds on to the program it ran last, a program evicted from Programs stays alive until then.
+struct Session {
+	std::istringstream in;
+	std::ostringstream out;
+	ExecutionContext context;
+
+	explicit Session(const Interpreter& interpreter) : context(interpreter.context(in, out)) {}
+};
+
+struct Reply {
+	std::string status = "ok";
+	std::string id, output, dump, error;
+	uint64_t compile = 0, run = 0; // microseconds
+
+	[[nodiscard]] std::string encode() const {
+		std::ostringstream os;
+		os << status << ' ' << (id.empty() ? "-" : id) << ' ' << output.size() << ' ' << dump.size() << ' ' << error.size() << ' '
+		   << compile << ' ' << run << '\n'
+		   << output << dump << error;
+		return os.str();
+	}
+};
+
+class Server {
+	const Interpreter& interpreter;
+	Programs programs;
+
+	// compiles the source unless a program of the same source is kept
+	std::shared_ptr<const CompiledProgram> compile(const std::string& source, Reply& reply) {
+		reply.id = hex(ChunkCache::key(source));
+		if (auto program = programs.find(reply.id, &source)) return program;
+		const auto start = std::chrono::steady_clock::now();
+		auto compiled = interpreter.compile(source);
+		reply.compile = microseconds(start);
+		if (!compiled) {
+			reply.status = "compile-error";
+			reply.error = compiled.error;
+			return nullptr;
+		}
+		programs.add(reply.id, source, compiled.program);
+		return compiled.program;
+	}
+
+	void run(const std::shared_ptr<const CompiledProgram>& program, std::string input, bool dump, Reply& reply) {
+		thread_local Session session(interpreter);
+		session.in.clear();
+		session.in.str(std::move(input));
+		session.out.str({});
+		const auto start = std::chrono::steady_clock::now();
+		const auto status = session.context.run(program);
+		reply.run = microseconds(start);
+		reply.output = session.out.str();
+		if (!status) {
+			reply.status = "runtime-error";
+			reply.error = status.error;
+		}
+		if (!dump) return;
+		std::ostringstream os;
+		session.context.dump(*program, os);
+		reply.dump = os.str();
+	}
+
+	// false when the framing is lost and the connection has to close
+	bool request(Connection& connection, const std::string& header, Reply& reply) {
+		std::istringstream words(header);
+		std::string verb, id;
+		int dump = -1;
+		size_t source_size = 0, input_size = 0;
+		words >> verb >> dump;
+		if (verb == "SOURCE") words >> source_size >> input_size;
+		else if (verb == "PROGRAM") words >> id >> input_size;
+		if (!words || (dump != 0 && dump != 1) || source_size > max_payload || input_size > max_payload
+			|| (verb != "SOURCE" && verb != "PROGRAM")) {
+			reply.status = "bad-request";
+			reply.error = "Malformed request header";
+			return false;
+		}
+		std::string source, input;
+		if (!connection.bytes(source_size, source) || !connection.bytes(input_size, input)) return false;
+
+		std::shared_ptr<const CompiledProgram> program;
+		if (verb == "SOURCE") {
+			program = compile(source, reply);
+		} else if (!(program = programs.find(id))) {
+			reply.id = id;
+			reply.status = "unknown-program";
+			reply.error = "No compiled program " + id;
+		} else {
+			reply.id = id;
+		}
+		if (program) run(program, std::move(input), dump == 1, reply);
+		return true;
+	}
+public:
+	Server(const Interpreter& interpreter, size_t limit) : interpreter(interpreter), programs(limit) {}
+
+	void serve(int fd) {
+		Connection connection(fd);
+		for (std::string header; connection.line(header);) {
+			Reply reply;
+			const bool more = request(connection, header, reply);
+			if (!connection.send(reply.encode()) || !more) return;
+		}
+	}
+};
+
+std::atomic<int> listener{-1};
+
+extern "C" void stop(int) {
+	// accept fails once the socket is shut down, which ends the serve loop
+	if (const int fd = listener.load(); fd >= 0) ::shutdown(fd, SHUT_RDWR);
+}
+
+int serve(const std::string& path, const Options& options, unsigned threads, size_t limit) {
+	// a socket someone still accepts on belongs to a running server, a stale one is replaced
+	if (const int fd = connect_to(path); fd >= 0) {
+		::close(fd);
+		std::cerr << "A server is already listening on " << path << std::endl;
+		return 1;
+	}
+	::unlink(path.c_str());
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path)) {
+		std::cerr << "Socket path is too long: " << path << std::endl;
+		return 1;
+	}
+	std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+	const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || ::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd, 128) != 0) {
+		std::cerr << "Can't listen on " << path << ": " << std::strerror(errno) << std::endl;
+		if (fd >= 0) ::close(fd);
+		return 1;
+	}
+
+	const Interpreter interpreter(options);
+	// the first program pays for the parser's tables, not the first client
+	(void)interpreter.compile("program warm; var i: integer; begin for i := 1 to 2 do i := i end.");
+	Server server(interpreter, limit);
+
+	listener = fd;
+	std::signal(SIGPIPE, SIG_IGN);
+	std::signal(SIGINT, stop);
+	std::signal(SIGTERM, stop);
+	std::cerr << "Serving on " << path << std::endl;
+	{
+		ThreadPool pool(threads);
+		for (;;) {
+			const int client = ::accept(fd, nullptr, nullptr);
+			if (client >= 0) {
+				// an idle client gives its worker back after a while
+				timeval idle{30, 0};
+				::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle));
+				pool.submit([&server, client] { server.serve(client); });
+				continue;
+			}
+			if (errno != EINTR && errno != ECONNABORTED) break;
+		}
+		pool.wait();
+	}
+	listener = -1;
+	::close(fd);
+	::unlink(path.c_str());
+	return 0;
+}
+
+//-------------------------client------------------------------------
+
+int run(const std::string& path, const std::string& file, const std::string& id, bool dump, bool timing) {
+	std::string source;
+	if (!file.empty()) {
+		std::ifstream fin(file, std::ios::binary);
+		if (!fin.is_open()) {
+			std::cerr << "No such file: " << file << std::endl;
+			return 1;
+		}
+		std::stringstream ss;
+		ss << fin.rdbuf();
+		source = ss.str();
+	}
+	std::stringstream input;
+	input << std::cin.rdbuf();
+
+	const int fd = connect_to(path);
+	if (fd < 0) {
+		std::cerr << "Can't connect to " << path << ": " << std::strerror(errno) << std::endl;
+		return 1;
+	}
+	Connection connection(fd);
+	const auto body = input.str();
+	const auto header = file.empty() ? "PROGRAM " + std::to_string(dump) + " " + id + " " + std::to_string(body.size()) + "\n"
+									 : "SOURCE " + std::to_string(dump) + " " + std::to_string(source.size()) + " "
+										   + std::to_string(body.size()) + "\n";
+	std::string line;
+	if (!connection.send(header) || !connection.send(source) || !connection.send(body) || !connection.line(line)) {
+		std::cerr << "The server closed the connection" << std::endl;
+		return 1;
+	}
+	Reply reply;
+	size_t sizes[3] = {};
+	std::istringstream words(line);
+	words >> reply.status >> reply.id >> sizes[0] >> sizes[1] >> sizes[2] >> reply.compile >> reply.run;
+	if (!words || !connection.bytes(sizes[0], reply.output) || !connection.bytes(sizes[1], reply.dump)
+		|| !connection.bytes(sizes[2], reply.error)) {
+		std::cerr << "Malformed reply from the server" << std::endl;
+		return 1;
+	}
+
+	std::cout << reply.output;
+	if (!reply.error.empty()) std::cerr << reply.error << std::endl;
+	if (dump && (reply.status == "ok" || reply.status == "runtime-error"))
+		std::cout << "================Dumping variables================" << std::endl << reply.dump;
+	std::cout.flush();
+	if (timing)
+		std::cerr << "program " << reply.id << ": compile " << reply.compile << " us, run " << reply.run << " us" << std::endl;
+	return reply.status == "ok" ? 0 : 1;
+}
+
+#endif
+
+}
+
+int main(int argc, char** argv) {
+	std::ios::sync_with_stdio(false);
+	if (argc < 2) {
+		usage();
+		return 2;
+	}
+	const std::string mode = argv[1];
+	Options options;
+	std::string path = default_socket, file, id;
+	unsigned threads = std::thread::hardware_concurrency();
+	size_t limit = 256;
+	bool timing = false;
+	for (int i = 2; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool serving = mode == "serve";
+		if (arg == "--socket" && i + 1 < argc) path = argv[++i];
+		else if (serving && arg == "-j" && i + 1 < argc) threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+		else if (serving && arg == "--jit") options.jit = true;
+		else if (serving && arg == "--cache" && i + 1 < argc) options.cache_dir = argv[++i];
+		else if (serving && arg == "--programs" && i + 1 < argc) limit = std::strtoul(argv[++i], nullptr, 10);
+		else if (serving && arg == "--max-steps" && i + 1 < argc) options.max_steps = std::strtoull(argv[++i], nullptr, 10);
+		else if (serving && arg == "--time-limit" && i + 1 < argc) options.time_limit = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		else if (serving && arg == "--memory-limit" && i + 1 < argc) options.memory_limit = std::strtoull(argv[++i], nullptr, 10) << 20;
+		else if (serving && arg == "--parser" && i + 1 < argc) {
+			const std::string frontend = argv[++i];
+			if (frontend == "fast") options.frontend = Frontend::Fast;
+			else if (frontend == "antlr") options.frontend = Frontend::Antlr;
+			else if (frontend == "validate") options.frontend = Frontend::Validate;
+			else {
+				usage();
+				return 2;
+			}
+		}
+		else if (!serving && arg == "--no-dump") options.dump = false;
+		else if (!serving && arg == "--time") timing = true;
+		else if (!serving && arg == "--id" && i + 1 < argc && file.empty() && std::strpbrk(argv[i + 1], " \t\r\n") == nullptr)
+			id = argv[++i];
+		else if (!serving && !arg.empty() && arg[0] != '-' && file.empty() && id.empty()) file = arg;
+		else {
+			usage();
+			return 2;
+		}
+	}
+#ifdef PASCAL_DAEMON
+	if (mode == "serve") return serve(path, options, threads, limit);
+	if (mode == "run" && (!file.empty() || !id.empty())) return run(path, file, id, options.dump, timing);
+	usage();
+	return 2;
+#else
+	(void)threads, (void)limit, (void)timing;
+	std::cerr << "pascal_daemon needs Unix domain sockets" << std::endl;
+	return 1;
+#endif
+}
@@ -0,0 +1,93 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "interpreter.h"
+
+namespace {
+
+const char* greet = R"(program greet;
+var name: string; n, i, sum: integer;
+begin
+  Readln(name);
+  Read(n);
+  sum := 0;
+  for i := 1 to n do sum := sum + i * i;
+  Writeln('Hello, ' + name, sum)
+end.
+)";
+
+const char* spin = R"(program spin;
+var i: integer;
+begin
+  i := 0;
+  while true do i := i + 1
+end.
+)";
+
+const char* hoard = R"(program hoard;
+var s: string;
+begin
+  s := 'x';
+  while true do s := s + s
+end.
+)";
+
+}
+
+// Usage: scheduler [programs]
+// Runs many programs that read their input on one thread next to two that never end and are
+// stopped by the limits, the input is fed in pieces while they run
+int main(int argc, char** argv) {
+	const int count = argc > 1 ? std::atoi(argv[1]) : 1000;
+
+	Options options;
+	options.dump = false;
+	options.max_steps = 10'000'000;
+	options.time_limit = 10'000;
+	options.memory_limit = 16u << 20;
+	const Interpreter interpreter(options);
+	std::vector<CompileResult> compiled;
+	for (const auto* source : {greet, spin, hoard}) {
+		compiled.push_back(interpreter.compile(source));
+		if (!compiled.back()) {
+			std::cerr << compiled.back().error << std::endl;
+			return 1;
+		}
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	Scheduler scheduler(options);
+	const auto spinner = scheduler.spawn(compiled[1].program);
+	const auto hoarder = scheduler.spawn(compiled[2].program);
+	std::vector<Scheduler::Task> tasks;
+	for (int i = 0; i < count; ++i)
+		tasks.push_back(scheduler.spawn(compiled[0].program));
+	// every program waits for its name, then for a number split across two pieces
+	for (int i = 0; i < count; ++i) {
+		scheduler.step();
+		scheduler.feed(tasks[i], "task " + std::to_string(i) + "\n");
+	}
+	for (int i = 0; i < count; ++i)
+		scheduler.feed(tasks[i], std::to_string(1 + i % 10));
+	for (int i = 0; i < 4 * count; ++i)
+		scheduler.step();
+	for (int i = 0; i < count; ++i)
+		scheduler.feed(tasks[i], std::to_string(i % 100) + "\n");
+	scheduler.run();
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	int failures = 0;
+	for (int i = 0; i < count; ++i) {
+		const int64_t n = std::stoi(std::to_string(1 + i % 10) + std::to_string(i % 100));
+		const auto expected = "Hello, task " + std::to_string(i) + " " + std::to_string(n * (n + 1) * (2 * n + 1) / 6) + " \n";
+		if (!scheduler.finished(tasks[i]) || !scheduler.status(tasks[i]) || scheduler.output(tasks[i]) != expected) ++failures;
+	}
+	std::cout << count << " programs in " << elapsed.count() << " s, " << failures << " failures" << std::endl
+			  << "spin: " << scheduler.status(spinner).error << " after " << scheduler.steps(spinner) << " steps" << std::endl
+			  << "hoard: " << scheduler.status(hoarder).error << " after " << scheduler.steps(hoarder) << " steps" << std::endl;
+	return failures || scheduler.status(spinner) || scheduler.status(hoarder) ? 1 : 0;
+}
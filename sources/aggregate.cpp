@@ -0,0 +1,247 @@
+#include "aggregate.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+constexpr std::align_val_t alignment{64};
+
+// bytes of a part of an aggregate that is laid out
+size_t bytes(const AggregateTable& types, TypeRef ref) noexcept {
+	return ref.type == DataType::Reference ? types[ref.aggregate].size : AggregateType::width(ref.type);
+}
+
+// elements of a laid out array, 1 for a record, unlike AggregateType::count it can't throw
+size_t length(const AggregateTable& types, const AggregateType& type) noexcept {
+	return type.is_record() ? 1 : type.size / bytes(types, type.element);
+}
+
+// calls f with the address of every string pointer inside the aggregate at the address, of count
+// elements when it is an array. Never throws, the types were checked by layout.
+template<typename F> void each_string(const AggregateTable& types, const AggregateType& type, size_t count, char* at, F&& f) noexcept {
+	if (!type.strings) return;
+	const auto visit = [&](TypeRef ref, char* place) {
+		if (ref.type == DataType::String) f(reinterpret_cast<StringData**>(place));
+		else if (ref.type == DataType::Reference) each_string(types, types[ref.aggregate], length(types, types[ref.aggregate]), place, f);
+	};
+	if (type.is_record()) {
+		for (const auto& field : type.fields)
+			visit(field.type, at + field.offset);
+		return;
+	}
+	const auto stride = bytes(types, type.element);
+	for (size_t i = 0; i < count; ++i)
+		visit(type.element, at + i * stride);
+}
+
+void print(std::ostream& os, const AggregateTable& types, TypeRef ref, const char* at);
+
+void print_array(std::ostream& os, const AggregateTable& types, const AggregateType& type, size_t dim, size_t stride, const char* at) {
+	stride /= static_cast<size_t>(type.bounds[dim].count());
+	os << '(';
+	for (int32_t i = 0; i < type.bounds[dim].count(); ++i) {
+		if (i) os << ", ";
+		if (dim + 1 < type.bounds.size()) print_array(os, types, type, dim + 1, stride, at + i * stride);
+		else print(os, types, type.element, at + i * stride);
+	}
+	os << ')';
+}
+
+void print(std::ostream& os, const AggregateTable& types, TypeRef ref, const char* at) {
+	if (ref.type != DataType::Reference) {
+		os << AggregateData::load(at, ref.type);
+		return;
+	}
+	const auto& type = types[ref.aggregate];
+	if (!type.is_record()) {
+		print_array(os, types, type, 0, type.size, at);
+		return;
+	}
+	os << '(';
+	for (size_t i = 0; i < type.fields.size(); ++i) {
+		if (i) os << "; ";
+		os << type.fields[i].name << ": ";
+		print(os, types, type.fields[i].type, at + type.fields[i].offset);
+	}
+	os << ')';
+}
+
+}
+
+size_t AggregateType::width(DataType type) noexcept {
+	switch (type) {
+		case DataType::Integer: return sizeof(int32_t);
+		case DataType::Double: return sizeof(double);
+		case DataType::String: return sizeof(StringData*);
+		default: return 1;
+	}
+}
+
+size_t AggregateType::count() const {
+	size_t res = 1;
+	for (const auto& dim : bounds) {
+		if (dim.high < dim.low) throw std::runtime_error("Array bounds are empty");
+		res *= static_cast<size_t>(static_cast<int64_t>(dim.high) - dim.low + 1);
+		if (res > max_size) throw std::runtime_error("Array is too large");
+	}
+	return res;
+}
+
+const Field* AggregateType::field(const std::string& name) const {
+	const auto it = std::find_if(fields.begin(), fields.end(), [&](const Field& f) { return f.name == name; });
+	return it == fields.end() ? nullptr : &*it;
+}
+
+void interpreter::layout(AggregateTable& types) {
+	for (size_t i = 0; i < types.size(); ++i) {
+		auto& type = types[i];
+		// size and alignment of a part, nested aggregates are already laid out
+		const auto measure = [&](TypeRef ref) -> std::pair<size_t, uint32_t> {
+			if (ref.type != DataType::Reference) {
+				const auto bytes = AggregateType::width(ref.type);
+				return {bytes, static_cast<uint32_t>(bytes)};
+			}
+			if (ref.aggregate < 0 || static_cast<size_t>(ref.aggregate) >= i) throw std::runtime_error("Invalid type");
+			return {types[ref.aggregate].size, types[ref.aggregate].align};
+		};
+		const auto has_strings = [&](TypeRef ref) {
+			return ref.type == DataType::String || (ref.type == DataType::Reference && types[ref.aggregate].strings);
+		};
+
+		size_t size = 0;
+		if (!type.is_record()) {
+			const auto [element, align] = measure(type.element);
+			size = type.count() * element;
+			type.align = align;
+			type.strings = has_strings(type.element);
+		} else {
+			std::vector<size_t> order(type.fields.size());
+			for (size_t f = 0; f < order.size(); ++f) {
+				order[f] = f;
+				for (size_t g = 0; g < f; ++g)
+					if (type.fields[g].name == type.fields[f].name)
+						throw std::runtime_error("Duplicate field: " + type.fields[f].name);
+			}
+			std::stable_sort(order.begin(), order.end(), [&](size_t l, size_t r) {
+				return measure(type.fields[l].type).second > measure(type.fields[r].type).second;
+			});
+			type.align = 1;
+			type.strings = false;
+			for (const auto f : order) {
+				auto& field = type.fields[f];
+				const auto [bytes, align] = measure(field.type);
+				field.offset = static_cast<uint32_t>(size);
+				size += bytes;
+				type.align = std::max(type.align, align);
+				type.strings = type.strings || has_strings(field.type);
+				if (size > AggregateType::max_size) throw std::runtime_error("Record is too large");
+			}
+			size = (size + type.align - 1) / type.align * type.align;
+		}
+		if (size > AggregateType::max_size) throw std::runtime_error(type.is_record() ? "Record is too large" : "Array is too large");
+		type.size = static_cast<uint32_t>(size);
+	}
+}
+
+bool interpreter::equivalent(const AggregateTable& types, TypeRef lhs, TypeRef rhs) {
+	if (lhs.type != rhs.type) return false;
+	if (lhs.type != DataType::Reference || lhs.aggregate == rhs.aggregate) return true;
+	const auto& a = types[lhs.aggregate];
+	const auto& b = types[rhs.aggregate];
+	if (a.bounds != b.bounds || a.fields.size() != b.fields.size()) return false;
+	for (size_t i = 0; i < a.fields.size(); ++i)
+		if (a.fields[i].name != b.fields[i].name || !equivalent(types, a.fields[i].type, b.fields[i].type)) return false;
+	return a.is_record() || equivalent(types, a.element, b.element);
+}
+
+AggregateData::AggregateData(const AggregateTable& types, int32_t type)
+	: types(&types), type(&types[type]), count(this->type->is_record() ? 1 : this->type->count()), strings(this->type->strings) {
+	const auto bytes = std::max<size_t>(this->type->size, 1);
+	data = ::operator new(bytes, alignment);
+	std::memset(data, 0, bytes);
+}
+
+AggregateData::AggregateData(const AggregateTable& types, int32_t type, void* data) noexcept
+	: data(data), types(&types), type(&types[type]), owned(false) {}
+
+AggregateData::~AggregateData() noexcept {
+	if (!owned) return;
+	if (strings) each_string(*types, *type, count, elements<char>(), [](StringData** str) { StringData::release(*str); });
+	::operator delete(data, alignment);
+}
+
+Value AggregateData::get(size_t at, DataType type) const {
+	return load(elements<char>() + at * AggregateType::width(type), type);
+}
+
+void AggregateData::set(size_t at, DataType type, Value val) {
+	store(elements<char>() + at * AggregateType::width(type), type, std::move(val));
+}
+
+void AggregateData::clear() noexcept {
+	if (strings) each_string(*types, *type, count, elements<char>(), [](StringData** str) { StringData::release(*str); });
+	std::memset(data, 0, std::max<size_t>(type->size, 1));
+}
+
+Value AggregateData::load(const char* at, DataType type) {
+	switch (type) {
+		case DataType::Integer: {
+			int32_t v;
+			std::memcpy(&v, at, sizeof(v));
+			return Value{v};
+		}
+		case DataType::Double: {
+			double v;
+			std::memcpy(&v, at, sizeof(v));
+			return Value{v};
+		}
+		case DataType::Boolean: return Value{*at != 0};
+		case DataType::Char: return Value{*at};
+		default: {
+			Value res{DataType::String};
+			StringData* str;
+			std::memcpy(&str, at, sizeof(str));
+			if (str && str->refs != StringData::pinned) ++str->refs;
+			res.value.string_ptr = str;
+			return res;
+		}
+	}
+}
+
+void AggregateData::store(char* at, DataType type, Value val) {
+	switch (type) {
+		case DataType::Integer: std::memcpy(at, &val.value.int_ptr, sizeof(int32_t)); break;
+		case DataType::Double: std::memcpy(at, &val.value.double_ptr, sizeof(double)); break;
+		case DataType::Boolean: *at = val.value.bool_ptr; break;
+		case DataType::Char: *at = val.value.char_ptr; break;
+		default: {
+			auto& slot = *reinterpret_cast<StringData**>(at);
+			StringData::release(slot);
+			slot = std::exchange(val.value.string_ptr, nullptr);
+			break;
+		}
+	}
+}
+
+void AggregateData::copy(const AggregateTable& types, int32_t type, void* to, const void* from) {
+	if (to == from) return;
+	const auto& aggregate = types[type];
+	// the source's strings gain the references the target's lose
+	const auto count = length(types, aggregate);
+	each_string(types, aggregate, count, static_cast<char*>(const_cast<void*>(from)), [](StringData** str) {
+		if (*str && (*str)->refs != StringData::pinned) ++(*str)->refs;
+	});
+	each_string(types, aggregate, count, static_cast<char*>(to), [](StringData** str) { StringData::release(*str); });
+	std::memcpy(to, from, aggregate.size);
+}
+
+void AggregateData::print(std::ostream& os) const {
+	::print(os, *types, {DataType::Reference, static_cast<int32_t>(type - types->data())}, elements<char>());
+}
+
+void interpreter::print(std::ostream& os, const AggregateData* aggregate) {
+	if (aggregate) aggregate->print(os);
+}
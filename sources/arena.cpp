@@ -0,0 +1,81 @@
+#include "arena.h"
+
+namespace {
+
+// Standard blocks of finished arenas, the thread's next arena starts with them
+struct Spares {
+	static constexpr size_t capacity = 8;
+
+	void* blocks[capacity];
+	size_t count;
+	bool closed; // the thread is exiting, blocks go straight back to the heap
+	ArenaStats stats;
+};
+
+thread_local Spares spares{};
+
+// Returns the spare blocks to the heap when the thread exits
+thread_local struct SparesGuard {
+	~SparesGuard() {
+		spares.closed = true;
+		while (spares.count) ::operator delete(spares.blocks[--spares.count]);
+	}
+} spares_guard;
+
+}
+
+Arena::~Arena() {
+	retire();
+}
+
+ArenaStats Arena::stats() noexcept {
+	return spares.stats;
+}
+
+void* Arena::grow(size_t size, size_t align) {
+	static_assert(alignof(Block) <= alignof(std::max_align_t));
+	const auto needed = sizeof(Block) + size + align;
+	if (needed > block_size) {
+		auto* block = static_cast<Block*>(::operator new(needed));
+		++spares.stats.blocks;
+		spares.stats.bytes += size;
+		*block = {large, needed};
+		large = block;
+		return reinterpret_cast<void*>((reinterpret_cast<uintptr_t>(block + 1) + align - 1) & ~(uintptr_t{align} - 1));
+	}
+	// the bytes of a block are counted when it is left
+	if (head) spares.stats.bytes += static_cast<size_t>(cursor - reinterpret_cast<char*>(head + 1));
+	Block* block;
+	if (spares.count) {
+		block = static_cast<Block*>(spares.blocks[--spares.count]);
+		++spares.stats.reused;
+	} else {
+		block = static_cast<Block*>(::operator new(block_size));
+		++spares.stats.blocks;
+	}
+	*block = {head, block_size};
+	head = block;
+	cursor = reinterpret_cast<char*>(block + 1);
+	limit = reinterpret_cast<char*>(block) + block_size;
+	return allocate(size, align);
+}
+
+void Arena::retire() noexcept {
+	(void)spares_guard;
+	if (head) spares.stats.bytes += static_cast<size_t>(cursor - reinterpret_cast<char*>(head + 1));
+	for (auto* block = head; block;) {
+		auto* next = block->next;
+		if (!spares.closed && spares.count < Spares::capacity)
+			spares.blocks[spares.count++] = block;
+		else
+			::operator delete(block);
+		block = next;
+	}
+	for (auto* block = large; block;) {
+		auto* next = block->next;
+		::operator delete(block);
+		block = next;
+	}
+	head = large = nullptr;
+	cursor = limit = nullptr;
+}
@@ -0,0 +1,497 @@
+#include "cache.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PASCAL_MMAP
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// bump whenever the serialized layout of Chunk changes
+constexpr uint32_t format_version = 8;
+constexpr uint32_t opcodes = static_cast<uint32_t>(OpCode::Halt) + 1;
+constexpr char magic[4] = {'P', 'B', 'C', '\0'};
+constexpr const char* extension = ".pbc";
+constexpr uint64_t check_seed = 0x9E3779B97F4A7C15ull;
+
+struct Header {
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint64_t source_size;
+	uint64_t check;       // second hash of the source, guards against key collisions
+	uint32_t opcodes;
+	uint32_t value_size;
+	uint64_t checksum;    // of everything after the header
+};
+
+struct Counters {
+	std::atomic<uint64_t> hits{0}, misses{0}, stores{0}, rejected{0};
+} counters;
+
+uint64_t fnv1a(std::string_view data, uint64_t hash = 14695981039346656037ull) noexcept {
+	for (const unsigned char c : data) {
+		hash ^= c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+class Writer {
+public:
+	std::string out;
+
+	template<typename T> void raw(const T& val) { out.append(reinterpret_cast<const char*>(&val), sizeof(T)); }
+	void u32(uint32_t val) { raw(val); }
+	void str(std::string_view val) {
+		u32(static_cast<uint32_t>(val.size()));
+		out.append(val);
+	}
+	void value(const Value& val) {
+		raw(static_cast<uint8_t>(val.type()));
+		if (val.type() == DataType::String) str(val.str());
+		else raw(val.value);
+	}
+};
+
+// Bounds checked reads from the mapped file, throws on truncated or corrupt data
+class Reader {
+	const char* pos;
+	const char* end;
+public:
+	Reader(const char* data, size_t size) : pos(data), end(data + size) {}
+
+	const char* take(size_t size) {
+		if (static_cast<size_t>(end - pos) < size) throw std::runtime_error("Truncated cache entry");
+		const auto* res = pos;
+		pos += size;
+		return res;
+	}
+	template<typename T> T raw() {
+		T val;
+		std::memcpy(&val, take(sizeof(T)), sizeof(T));
+		return val;
+	}
+	uint32_t u32() { return raw<uint32_t>(); }
+	std::string_view str() {
+		const auto size = u32();
+		return {take(size), size};
+	}
+	Value value() {
+		const auto type = static_cast<DataType>(raw<uint8_t>());
+		if (type > DataType::Char) throw std::runtime_error("Corrupt cache entry");
+		if (type == DataType::String) return Value{str()};
+		Value res{type};
+		res.value = raw<decltype(res.value)>();
+		return res;
+	}
+	[[nodiscard]] bool done() const { return pos == end; }
+};
+
+std::string serialize(uint64_t key, std::string_view source, const Chunk& chunk) {
+	Writer w;
+	Header header{};
+	std::memcpy(header.magic, magic, sizeof(magic));
+	header.version = format_version;
+	header.key = key;
+	header.source_size = source.size();
+	header.check = fnv1a(source, check_seed);
+	header.opcodes = opcodes;
+	header.value_size = sizeof(Value);
+	w.raw(header);
+	const auto body = w.out.size();
+
+	w.str(chunk.program_name);
+	w.u32(static_cast<uint32_t>(chunk.max_stack));
+	w.u32(static_cast<uint32_t>(chunk.code.size()));
+	for (const auto& ins : chunk.code) {
+		w.raw(static_cast<uint8_t>(ins.op));
+		w.raw(ins.a);
+		w.raw(ins.b);
+	}
+	for (const auto line : chunk.lines)
+		w.u32(line);
+	w.u32(static_cast<uint32_t>(chunk.statements.size()));
+	for (const auto start : chunk.statements)
+		w.raw(start);
+	w.u32(static_cast<uint32_t>(chunk.constants.size()));
+	for (const auto& val : chunk.constants)
+		w.value(val);
+	w.u32(static_cast<uint32_t>(chunk.globals.size()));
+	for (const auto& val : chunk.globals)
+		w.value(val);
+	w.u32(static_cast<uint32_t>(chunk.symbols.size()));
+	for (const auto& [name, symbol] : chunk.symbols) {
+		w.str(name);
+		w.raw(symbol.slot);
+		w.raw(static_cast<uint8_t>(symbol.type));
+		w.raw(static_cast<uint8_t>(symbol.is_const));
+		w.raw(static_cast<uint8_t>(symbol.hidden));
+		w.raw(symbol.aggregate);
+	}
+	// the layout is computed again when the chunk is loaded
+	w.u32(static_cast<uint32_t>(chunk.types.size()));
+	for (const auto& type : chunk.types) {
+		w.raw(static_cast<uint8_t>(type.element.type));
+		w.raw(type.element.aggregate);
+		w.u32(static_cast<uint32_t>(type.bounds.size()));
+		for (const auto& dim : type.bounds) {
+			w.raw(dim.low);
+			w.raw(dim.high);
+		}
+		w.u32(static_cast<uint32_t>(type.fields.size()));
+		for (const auto& field : type.fields) {
+			w.str(field.name);
+			w.raw(static_cast<uint8_t>(field.type.type));
+			w.raw(field.type.aggregate);
+		}
+	}
+	w.u32(static_cast<uint32_t>(chunk.dimensions.size()));
+	for (const auto& dim : chunk.dimensions) {
+		w.raw(dim.low);
+		w.raw(dim.high);
+		w.raw(dim.stride);
+		w.raw(dim.base);
+		w.raw(static_cast<uint8_t>(dim.type));
+	}
+	w.u32(static_cast<uint32_t>(chunk.kernels.size()));
+	for (const auto& kernel : chunk.kernels) {
+		w.raw(static_cast<uint8_t>(kernel.op));
+		w.raw(kernel.target);
+		for (const auto& operand : {kernel.a, kernel.b}) {
+			w.raw(static_cast<uint8_t>(operand.kind));
+			w.raw(operand.index);
+		}
+		w.raw(kernel.var);
+		w.raw(static_cast<uint8_t>(kernel.down));
+	}
+	w.u32(static_cast<uint32_t>(chunk.tables.size()));
+	for (const auto& table : chunk.tables) {
+		w.raw(table.low);
+		w.u32(static_cast<uint32_t>(table.targets.size()));
+		for (const auto target : table.targets)
+			w.raw(target);
+		w.u32(static_cast<uint32_t>(table.ranges.size()));
+		for (const auto& range : table.ranges) {
+			w.raw(range.low);
+			w.raw(range.high);
+			w.raw(range.target);
+		}
+		w.raw(table.otherwise);
+		w.raw(static_cast<uint8_t>(table.chars));
+	}
+	w.u32(static_cast<uint32_t>(chunk.routines.size()));
+	for (const auto& routine : chunk.routines) {
+		w.str(routine.name);
+		for (const auto field : {routine.entry, routine.end, routine.params, routine.result, routine.max_stack})
+			w.raw(field);
+		w.u32(static_cast<uint32_t>(routine.frame.size()));
+		for (const auto& val : routine.frame)
+			w.value(val);
+		w.u32(static_cast<uint32_t>(routine.aggregates.size()));
+		for (const auto& aggregate : routine.aggregates) {
+			w.raw(static_cast<uint8_t>(aggregate.kind));
+			w.raw(aggregate.slot);
+			w.raw(aggregate.index);
+		}
+	}
+	w.u32(static_cast<uint32_t>(chunk.parallels.size()));
+	for (const auto& loop : chunk.parallels) {
+		w.raw(loop.routine);
+		w.raw(loop.var);
+		w.raw(static_cast<uint8_t>(loop.down));
+		w.u32(static_cast<uint32_t>(loop.reductions.size()));
+		for (const auto& reduction : loop.reductions) {
+			w.raw(static_cast<uint8_t>(reduction.kind));
+			w.raw(static_cast<uint8_t>(reduction.var.global));
+			w.raw(reduction.var.slot);
+			w.raw(static_cast<uint8_t>(reduction.real));
+		}
+		w.u32(static_cast<uint32_t>(loop.privates.size()));
+		for (const auto& place : loop.privates) {
+			w.raw(static_cast<uint8_t>(place.global));
+			w.raw(place.slot);
+		}
+		w.u32(static_cast<uint32_t>(loop.disjoint.size()));
+		for (const auto& disjoint : loop.disjoint) {
+			w.raw(disjoint.aggregate);
+			w.raw(disjoint.other);
+			w.raw(static_cast<uint8_t>(disjoint.scalar));
+		}
+	}
+	header.checksum = fnv1a(std::string_view(w.out).substr(body));
+	std::memcpy(w.out.data(), &header, sizeof(header));
+	return std::move(w.out);
+}
+
+Chunk deserialize(uint64_t key, std::string_view source, const char* data, size_t size) {
+	Reader r(data, size);
+	const auto header = r.raw<Header>();
+	if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != format_version
+		|| header.key != key || header.source_size != source.size() || header.check != fnv1a(source, check_seed)
+		|| header.opcodes != opcodes || header.value_size != sizeof(Value))
+		throw std::runtime_error("Stale cache entry");
+	if (header.checksum != fnv1a({data + sizeof(header), size - sizeof(header)}))
+		throw std::runtime_error("Corrupt cache entry");
+
+	Chunk chunk;
+	chunk.program_name = r.str();
+	chunk.max_stack = static_cast<int32_t>(r.u32());
+	chunk.code.resize(r.u32());
+	for (auto& ins : chunk.code) {
+		const auto op = r.raw<uint8_t>();
+		if (op >= opcodes) throw std::runtime_error("Corrupt cache entry");
+		ins.op = static_cast<OpCode>(op);
+		ins.a = r.raw<int32_t>();
+		ins.b = r.raw<int32_t>();
+	}
+	chunk.lines.resize(chunk.code.size());
+	for (auto& line : chunk.lines)
+		line = r.u32();
+	chunk.statements.resize(r.u32());
+	for (auto& start : chunk.statements) {
+		start = r.raw<int32_t>();
+		if (start < 0 || static_cast<size_t>(start) >= chunk.code.size()) throw std::runtime_error("Corrupt cache entry");
+	}
+	chunk.constants.resize(r.u32());
+	for (auto& val : chunk.constants)
+		val = r.value();
+	chunk.globals.resize(r.u32());
+	for (auto& val : chunk.globals)
+		val = r.value();
+	for (auto count = r.u32(); count; --count) {
+		std::string name{r.str()};
+		Symbol symbol{};
+		symbol.slot = r.raw<int32_t>();
+		symbol.type = static_cast<DataType>(r.raw<uint8_t>());
+		symbol.is_const = r.raw<uint8_t>() != 0;
+		symbol.hidden = r.raw<uint8_t>() != 0;
+		symbol.aggregate = r.raw<int32_t>();
+		if (symbol.slot < 0 || static_cast<size_t>(symbol.slot) >= chunk.globals.size())
+			throw std::runtime_error("Corrupt cache entry");
+		chunk.symbols.emplace(std::move(name), symbol);
+	}
+	chunk.types.resize(r.u32());
+	for (auto& type : chunk.types) {
+		type.element.type = static_cast<DataType>(r.raw<uint8_t>());
+		type.element.aggregate = r.raw<int32_t>();
+		type.bounds.resize(r.u32());
+		for (auto& dim : type.bounds) {
+			dim.low = r.raw<int32_t>();
+			dim.high = r.raw<int32_t>();
+		}
+		type.fields.resize(r.u32());
+		for (auto& field : type.fields) {
+			field.name = r.str();
+			field.type.type = static_cast<DataType>(r.raw<uint8_t>());
+			field.type.aggregate = r.raw<int32_t>();
+		}
+	}
+	layout(chunk.types); // throws on types no compiled program has
+	chunk.dimensions.resize(r.u32());
+	for (auto& dim : chunk.dimensions) {
+		dim.low = r.raw<int32_t>();
+		dim.high = r.raw<int32_t>();
+		dim.stride = r.raw<int32_t>();
+		dim.base = r.raw<int32_t>();
+		dim.type = static_cast<DataType>(r.raw<uint8_t>());
+	}
+	chunk.kernels.resize(r.u32());
+	for (auto& kernel : chunk.kernels) {
+		kernel.op = static_cast<OpCode>(r.raw<uint8_t>());
+		kernel.target = r.raw<int32_t>();
+		for (auto* operand : {&kernel.a, &kernel.b}) {
+			operand->kind = static_cast<Kernel::Operand::Kind>(r.raw<uint8_t>());
+			operand->index = r.raw<int32_t>();
+		}
+		kernel.var = r.raw<int32_t>();
+		kernel.down = r.raw<uint8_t>() != 0;
+	}
+	// the VM jumps to the targets unchecked
+	const auto target = [&] {
+		const auto res = r.raw<int32_t>();
+		if (res < 0 || static_cast<size_t>(res) >= chunk.code.size()) throw std::runtime_error("Corrupt cache entry");
+		return res;
+	};
+	chunk.tables.resize(r.u32());
+	for (auto& table : chunk.tables) {
+		table.low = r.raw<int32_t>();
+		table.targets.resize(r.u32());
+		for (auto& at : table.targets)
+			at = target();
+		table.ranges.resize(r.u32());
+		for (auto& range : table.ranges) {
+			range.low = r.raw<int32_t>();
+			range.high = r.raw<int32_t>();
+			range.target = target();
+		}
+		table.otherwise = target();
+		table.chars = r.raw<uint8_t>() != 0;
+	}
+	chunk.routines.resize(r.u32());
+	for (auto& routine : chunk.routines) {
+		routine.name = r.str();
+		for (auto* field : {&routine.entry, &routine.end, &routine.params, &routine.result, &routine.max_stack})
+			*field = r.raw<int32_t>();
+		routine.frame.resize(r.u32());
+		for (auto& val : routine.frame)
+			val = r.value();
+		routine.aggregates.resize(r.u32());
+		for (auto& aggregate : routine.aggregates) {
+			const auto kind = r.raw<uint8_t>();
+			if (kind > static_cast<uint8_t>(Routine::Aggregate::Kind::Global)) throw std::runtime_error("Corrupt cache entry");
+			aggregate.kind = static_cast<Routine::Aggregate::Kind>(kind);
+			aggregate.slot = r.raw<int32_t>();
+			aggregate.index = r.raw<int32_t>();
+			const auto limit = aggregate.kind == Routine::Aggregate::Kind::Global ? chunk.globals.size() : chunk.types.size();
+			if (aggregate.slot < 0 || static_cast<size_t>(aggregate.slot) >= routine.frame.size() || aggregate.index < 0
+				|| static_cast<size_t>(aggregate.index) >= limit)
+				throw std::runtime_error("Corrupt cache entry");
+		}
+		if (routine.entry < 0 || routine.entry > routine.end || static_cast<size_t>(routine.end) > chunk.code.size()
+			|| routine.params < 0 || static_cast<size_t>(routine.params) > routine.frame.size() || routine.max_stack < 0)
+			throw std::runtime_error("Corrupt cache entry");
+	}
+	// the parts copy frames and combine the slots unchecked
+	chunk.parallels.resize(r.u32());
+	for (auto& loop : chunk.parallels) {
+		loop.routine = r.raw<int32_t>();
+		if (loop.routine < -1 || loop.routine >= static_cast<int32_t>(chunk.routines.size())) throw std::runtime_error("Corrupt cache entry");
+		const auto size = loop.routine < 0 ? chunk.globals.size() : chunk.routines[loop.routine].frame.size();
+		const auto slot = [&](bool global) {
+			const auto res = r.raw<int32_t>();
+			if (res < 0 || static_cast<size_t>(res) >= (global ? chunk.globals.size() : size)) throw std::runtime_error("Corrupt cache entry");
+			return res;
+		};
+		const auto place = [&] {
+			const bool global = r.raw<uint8_t>() != 0;
+			return ParallelLoop::Place{slot(global), global};
+		};
+		loop.var = slot(false);
+		loop.down = r.raw<uint8_t>() != 0;
+		loop.reductions.resize(r.u32());
+		for (auto& reduction : loop.reductions) {
+			const auto kind = r.raw<uint8_t>();
+			if (kind > static_cast<uint8_t>(ParallelLoop::Reduction::Kind::Max)) throw std::runtime_error("Corrupt cache entry");
+			reduction.kind = static_cast<ParallelLoop::Reduction::Kind>(kind);
+			reduction.var = place();
+			reduction.real = r.raw<uint8_t>() != 0;
+		}
+		loop.privates.resize(r.u32());
+		for (auto& at : loop.privates)
+			at = place();
+		loop.disjoint.resize(r.u32());
+		for (auto& disjoint : loop.disjoint) {
+			disjoint.aggregate = slot(false);
+			disjoint.other = slot(false);
+			disjoint.scalar = r.raw<uint8_t>() != 0;
+		}
+	}
+	for (const auto& [name, symbol] : chunk.symbols)
+		if (symbol.aggregate >= static_cast<int32_t>(chunk.types.size())) throw std::runtime_error("Corrupt cache entry");
+	if (!r.done() || chunk.code.empty()) throw std::runtime_error("Corrupt cache entry");
+	return chunk;
+}
+
+}
+
+ChunkCache::ChunkCache(std::string directory) : directory(std::move(directory)) {}
+
+uint64_t ChunkCache::key(std::string_view source) noexcept {
+	const uint32_t salt[] = {format_version, opcodes, static_cast<uint32_t>(sizeof(Value))};
+	return fnv1a(source, fnv1a({reinterpret_cast<const char*>(salt), sizeof(salt)}));
+}
+
+CacheStats ChunkCache::stats() noexcept {
+	return {counters.hits.load(), counters.misses.load(), counters.stores.load(), counters.rejected.load()};
+}
+
+std::string ChunkCache::path(uint64_t key) const {
+	char name[17];
+	std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+	return (fs::path(directory) / (name + std::string(extension))).string();
+}
+
+std::optional<Chunk> ChunkCache::load(std::string_view source) {
+	const auto key = ChunkCache::key(source);
+	const auto file = path(key);
+	try {
+#ifdef PASCAL_MMAP
+		const int fd = ::open(file.c_str(), O_RDONLY);
+		if (fd < 0) {
+			++counters.misses;
+			return std::nullopt;
+		}
+		struct stat st{};
+		void* data = MAP_FAILED;
+		if (::fstat(fd, &st) == 0 && st.st_size > 0)
+			data = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (data == MAP_FAILED) throw std::runtime_error("Unreadable cache entry");
+		struct Unmap {
+			void* data;
+			size_t size;
+			~Unmap() { ::munmap(data, size); }
+		} unmap{data, static_cast<size_t>(st.st_size)};
+		auto chunk = deserialize(key, source, static_cast<const char*>(data), unmap.size);
+#else
+		std::ifstream in(file, std::ios::binary);
+		if (!in) {
+			++counters.misses;
+			return std::nullopt;
+		}
+		const std::string data{std::istreambuf_iterator<char>(in), {}};
+		auto chunk = deserialize(key, source, data.data(), data.size());
+#endif
+		++counters.hits;
+		return chunk;
+	} catch (const std::exception&) {
+		++counters.rejected;
+		++counters.misses;
+		std::error_code ec;
+		fs::remove(file, ec);
+		return std::nullopt;
+	}
+}
+
+bool ChunkCache::store(std::string_view source, const Chunk& chunk) {
+	const auto key = ChunkCache::key(source);
+	const auto file = path(key);
+	const auto tmp = file + "." + std::to_string(std::random_device{}()) + ".tmp";
+	std::error_code ec;
+	fs::create_directories(directory, ec);
+	{
+		std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+		const auto data = serialize(key, source, chunk);
+		if (!out.write(data.data(), static_cast<std::streamsize>(data.size())))
+			return false;
+	}
+	fs::rename(tmp, file, ec);
+	if (ec) {
+		fs::remove(tmp, ec);
+		return false;
+	}
+	++counters.stores;
+	return true;
+}
+
+size_t ChunkCache::clear() {
+	size_t removed = 0;
+	std::error_code ec;
+	for (const auto& entry : fs::directory_iterator(directory, ec))
+		if (entry.path().extension() == extension && fs::remove(entry.path(), ec))
+			++removed;
+	return removed;
+}
@@ -0,0 +1,879 @@
+#include "checker.h"
+#include "exceptions.h"
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <set>
+#include <stdexcept>
+
+using namespace ast;
+
+namespace {
+
+std::string type_name(DataType type) {
+	if (type == DataType::Reference) return "array or record";
+	for (const auto& [name, t] : types)
+		if (t == type) return name;
+	return "untyped";
+}
+
+bool is_number(DataType type) {
+	return type == DataType::Integer || type == DataType::Double;
+}
+
+struct Signature {
+	const char* name;
+	Builtin builtin;
+	std::vector<DataType> params;
+	DataType result;
+};
+
+const Signature builtins[] = {
+	{"Length", Builtin::Length, {DataType::String}, DataType::Integer},
+	{"Copy", Builtin::Copy, {DataType::String, DataType::Integer, DataType::Integer}, DataType::String},
+	{"Pos", Builtin::Pos, {DataType::String, DataType::String}, DataType::Integer},
+};
+
+}
+
+DataType TypeChecker::canonical(DataType type) noexcept {
+	if (type == DataType::Char) return type;
+	if (in_group(type, TypeGroup::Numeric)) return DataType::Integer;
+	if (in_group(type, TypeGroup::Real)) return DataType::Double;
+	return type;
+}
+
+// The locals of a routine hide the globals
+const Decl& TypeChecker::variable(const std::string& identifier) {
+	if (const auto it = locals.find(identifier); it != locals.end()) return *it->second;
+	const auto it = symbols.find(identifier);
+	if (it == symbols.end())
+		throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Undeclared identifier: " + identifier);
+	return *it->second;
+}
+
+const Decl& TypeChecker::assignable(const std::string& identifier) {
+	if (routine && routine->result != DataType::Null && identifier == routine->name) return result;
+	const auto& var = variable(identifier);
+	if (var.is_const)
+		throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Can't modify constant");
+	return var;
+}
+
+void TypeChecker::widen(ExprPtr& expr) {
+	if (expr->type != DataType::Integer) return;
+	expr = program->make<Unary>(Operator::ToReal, std::move(expr));
+	expr->type = DataType::Double;
+}
+
+void TypeChecker::coerce(ExprPtr& expr, DataType target) {
+	target = canonical(target);
+	if (target == DataType::Double) widen(expr);
+	// a string constant of one character is a char where one is expected
+	if (target == DataType::Char && expr->type == DataType::String) {
+		const Value* val = nullptr;
+		if (expr->kind == Expr::Kind::Literal) val = &expr->as<Literal>().value;
+		else if (expr->kind == Expr::Kind::Variable && variable(expr->as<Variable>().name).is_const)
+			val = &variable(expr->as<Variable>().name).value;
+		if (val && val->str().size() == 1) {
+			expr = program->make<Literal>(Value{val->str()[0]});
+			expr->type = DataType::Char;
+		}
+	}
+	if (expr->type != target)
+		throw type_error(__FILE__, typeid(*this).name(), __LINE__,
+						 "Incompatible types: got " + type_name(expr->type) + " expected " + type_name(target));
+}
+
+// Type of the part of an aggregate of the type the selector picks. The index list
+// of a[i, j] spans nested array types, each takes as many indices as it has dimensions.
+TypeRef TypeChecker::select(TypeRef type, const Selector& selector, const std::string& name) {
+	const auto* aggregate = type.type == DataType::Reference ? &program->types[type.aggregate] : nullptr;
+	if (!selector.field.empty()) {
+		if (!aggregate || !aggregate->is_record())
+			throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Not a record: " + name);
+		const auto* field = aggregate->field(selector.field);
+		if (!field) throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Unknown field: " + selector.field);
+		return field->type;
+	}
+	for (size_t used = 0; used < selector.indices.size(); used += aggregate->bounds.size()) {
+		aggregate = type.type == DataType::Reference ? &program->types[type.aggregate] : nullptr;
+		if (!aggregate || aggregate->is_record())
+			throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Not an array: " + name);
+		if (selector.indices.size() - used < aggregate->bounds.size())
+			throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Wrong number of indices for " + name);
+		type = aggregate->element;
+	}
+	return type;
+}
+
+// Type of the part of the variable the selectors pick, the indices are checked on the way
+TypeRef TypeChecker::access(const Decl& var, std::vector<Selector>& selectors) {
+	TypeRef type{canonical(var.type), var.aggregate};
+	for (auto& selector : selectors) {
+		for (auto& index : selector.indices) {
+			expression(index);
+			coerce(index, DataType::Integer);
+		}
+		type = select(type, selector, var.name);
+	}
+	return type;
+}
+
+// Aggregate type of a checked variable or element
+TypeRef TypeChecker::reference(const Expr& expr) {
+	if (expr.kind == Expr::Kind::Variable) {
+		const auto& var = variable(expr.as<Variable>().name);
+		return {var.type, var.aggregate};
+	}
+	const auto& elem = expr.as<Element>();
+	const auto& var = variable(elem.name);
+	TypeRef type{var.type, var.aggregate};
+	for (const auto& selector : elem.selectors)
+		type = select(type, selector, var.name);
+	return type;
+}
+
+// Type of the variable or part of it written to
+TypeRef TypeChecker::target(Target& target) {
+	return access(assignable(target.name), target.selectors);
+}
+
+// The name is a routine's, locals hide them as well
+bool TypeChecker::callable(const std::string& name) const {
+	return routines.contains(name) && !locals.contains(name);
+}
+
+const Routine& TypeChecker::callee(const std::string& name) {
+	if (!callable(name)) throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Unknown function: " + name);
+	return *routines.at(name);
+}
+
+// The arguments of a builtin are values converted as by an assignment
+DataType TypeChecker::builtin(FunctionCall& call) {
+	const auto* it = std::find_if(std::begin(builtins), std::end(builtins), [&](const Signature& s) { return call.name == s.name; });
+	if (it == std::end(builtins)) throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Unknown function: " + call.name);
+	if (call.args.size() != it->params.size())
+		throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Wrong number of arguments for " + call.name);
+	for (size_t i = 0; i < call.args.size(); ++i) {
+		expression(call.args[i]);
+		coerce(call.args[i], it->params[i]);
+	}
+	call.builtin = it->builtin;
+	return it->result;
+}
+
+// Value arguments are converted as by an assignment, var parameters take variables
+// or parts of them of the same type
+void TypeChecker::arguments(const Routine& callee, std::vector<ExprPtr>& args) {
+	if (args.size() != callee.params.size())
+		throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Wrong number of arguments for " + callee.name);
+	for (size_t i = 0; i < args.size(); ++i) {
+		const auto& param = callee.params[i];
+		const TypeRef type{canonical(param.type), param.aggregate};
+		auto& arg = args[i];
+		if (param.by_ref) {
+			TypeRef actual;
+			if (arg->kind == Expr::Kind::Variable && !callable(arg->as<Variable>().name)) {
+				const auto& var = assignable(arg->as<Variable>().name);
+				actual = {canonical(var.type), var.aggregate};
+			} else if (arg->kind == Expr::Kind::Element) {
+				auto& elem = arg->as<Element>();
+				actual = access(assignable(elem.name), elem.selectors);
+			} else {
+				throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Variable expected for var parameter " + param.name);
+			}
+			if (!equivalent(program->types, type, actual))
+				throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Incompatible types for var parameter " + param.name);
+			arg->type = actual.type;
+			continue;
+		}
+		expression(arg);
+		if (type.type != DataType::Reference) {
+			coerce(arg, type.type);
+			continue;
+		}
+		if (arg->type != DataType::Reference || !equivalent(program->types, type, reference(*arg)))
+			throw type_error(__FILE__, typeid(*this).name(), __LINE__,
+							 program->types[type.aggregate].is_record() ? "Incompatible types: records differ"
+																	  : "Incompatible types: arrays differ");
+	}
+}
+
+void TypeChecker::check(const Routine& routine) {
+	this->routine = &routine;
+	locals.clear();
+	result = {routine.name, routine.result, false, Value{routine.result}};
+	for (const auto* decls : {&routine.params, &routine.decls})
+		for (const auto& decl : *decls)
+			if (decl.name == routine.name || !locals.emplace(decl.name, &decl).second)
+				throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Duplicate identifier: " + decl.name);
+	statement(*routine.body);
+	locals.clear();
+	this->routine = nullptr;
+}
+
+void TypeChecker::check(ast::Program& program) {
+	this->program = &program;
+	symbols.clear();
+	routines.clear();
+	locals.clear();
+	routine = nullptr;
+	for (auto& type : program.types) {
+		type.element.type = canonical(type.element.type);
+		for (auto& field : type.fields)
+			field.type.type = canonical(field.type.type);
+	}
+	try {
+		layout(program.types);
+	} catch (std::runtime_error& e) {
+		throw type_error(__FILE__, typeid(*this).name(), __LINE__, e.what());
+	}
+	for (const auto& decl : program.decls)
+		symbols.emplace(decl.name, &decl);
+	for (const auto& r : program.routines)
+		if (symbols.contains(r.name) || !routines.emplace(r.name, &r).second)
+			throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Duplicate identifier: " + r.name);
+	for (const auto& r : program.routines)
+		check(r);
+	statement(*program.body);
+}
+
+//-------------------------statements------------------------------------
+
+void TypeChecker::statement(Stmt& stmt) {
+	switch (stmt.kind) {
+		case Stmt::Kind::Compound:
+			for (auto& s : stmt.as<Compound>().body)
+				statement(*s);
+			break;
+		case Stmt::Kind::Assign: {
+			auto& assign = stmt.as<Assign>();
+			const auto type = target(assign.target);
+			expression(assign.value);
+			if (type.type != DataType::Reference) {
+				coerce(assign.value, type.type);
+				break;
+			}
+			// whole arrays and records are copied between places of equivalent types
+			if (assign.value->type != DataType::Reference || !equivalent(program->types, type, reference(*assign.value)))
+				throw type_error(__FILE__, typeid(*this).name(), __LINE__,
+								 program->types[type.aggregate].is_record() ? "Incompatible types: records differ"
+																			: "Incompatible types: arrays differ");
+			break;
+		}
+		case Stmt::Kind::Call: {
+			auto& call = stmt.as<Call>();
+			if (call.name != "Write" && call.name != "Writeln") {
+				const auto& procedure = callee(call.name);
+				if (procedure.result != DataType::Null)
+					throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Result of function is not used: " + call.name);
+				if (std::any_of(call.formats.begin(), call.formats.end(), [](const Format& f) { return f.width || f.decimals; }))
+					throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Format specifiers are only allowed for Write and Writeln");
+				arguments(procedure, call.args);
+				break;
+			}
+			call.formats.resize(call.args.size());
+			for (size_t i = 0; i < call.args.size(); ++i) {
+				if (expression(call.args[i]) == DataType::Reference)
+					throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Can't write values of type " + type_name(DataType::Reference));
+				auto& format = call.formats[i];
+				if (format.width) {
+					expression(format.width);
+					coerce(format.width, DataType::Integer);
+				}
+				if (format.decimals) {
+					if (call.args[i]->type != DataType::Double)
+						throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Decimals are only allowed for real values");
+					expression(format.decimals);
+					coerce(format.decimals, DataType::Integer);
+				}
+			}
+			break;
+		}
+		case Stmt::Kind::Read:
+			for (auto& t : stmt.as<Read>().targets) {
+				const auto type = target(t).type;
+				if (!is_number(type) && type != DataType::String)
+					throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Can't read values of type " + type_name(type));
+			}
+			break;
+		case Stmt::Kind::If: {
+			auto& branch = stmt.as<If>();
+			expression(branch.cond);
+			coerce(branch.cond, DataType::Boolean);
+			statement(*branch.then_branch);
+			if (branch.else_branch) statement(*branch.else_branch);
+			break;
+		}
+		case Stmt::Kind::While: {
+			auto& loop = stmt.as<While>();
+			expression(loop.cond);
+			coerce(loop.cond, DataType::Boolean);
+			statement(*loop.body);
+			break;
+		}
+		case Stmt::Kind::For: {
+			auto& loop = stmt.as<For>();
+			const auto& var = assignable(loop.var);
+			if (canonical(var.type) != DataType::Integer)
+				throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Only integers applicable as variables in for loop");
+			if (routine && (!locals.contains(loop.var) || var.by_ref))
+				throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Only local variables applicable as variables in for loop");
+			expression(loop.from);
+			coerce(loop.from, DataType::Integer);
+			expression(loop.to);
+			coerce(loop.to, DataType::Integer);
+			statement(*loop.body);
+			if (loop.parallel) parallel(loop);
+			break;
+		}
+		case Stmt::Kind::Case: {
+			auto& branch = stmt.as<Case>();
+			const auto type = expression(branch.selector);
+			if (type != DataType::Integer && type != DataType::Char)
+				throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Only integers and chars applicable as case selectors");
+			std::vector<std::pair<int32_t, int32_t>> ranges;
+			for (auto& arm : branch.arms) {
+				for (const auto& label : arm.labels) {
+					for (const auto& bound : {label.low.type(), label.high.type()})
+						if (bound != type)
+							throw type_error(__FILE__, typeid(*this).name(), __LINE__,
+											 "Incompatible types: got " + type_name(bound) + " expected " + type_name(type) + " in case label");
+					if (Case::ordinal(label.low) > Case::ordinal(label.high))
+						throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Case label range is empty");
+					ranges.emplace_back(Case::ordinal(label.low), Case::ordinal(label.high));
+				}
+				statement(*arm.body);
+			}
+			std::sort(ranges.begin(), ranges.end());
+			for (size_t i = 1; i < ranges.size(); ++i)
+				if (ranges[i].first <= ranges[i - 1].second)
+					throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Duplicate case label");
+			if (branch.else_branch) statement(*branch.else_branch);
+			break;
+		}
+	}
+}
+
+//-------------------------expressions------------------------------------
+
+DataType TypeChecker::expression(ExprPtr& expr) {
+	switch (expr->kind) {
+		case Expr::Kind::Literal:
+			expr->type = canonical(expr->as<Literal>().value.type());
+			break;
+		case Expr::Kind::Variable:
+			if (callable(expr->as<Variable>().name)) {
+				expr = program->make<FunctionCall>(std::move(expr->as<Variable>().name));
+				return expression(expr);
+			}
+			expr->type = canonical(variable(expr->as<Variable>().name).type);
+			break;
+		case Expr::Kind::Unary:
+			expr->type = unary(expr->as<Unary>());
+			break;
+		case Expr::Kind::Binary:
+			expr->type = binary(expr->as<Binary>());
+			break;
+		case Expr::Kind::Element: {
+			auto& elem = expr->as<Element>();
+			expr->type = access(variable(elem.name), elem.selectors).type;
+			break;
+		}
+		case Expr::Kind::Call: {
+			auto& call = expr->as<FunctionCall>();
+			if (!callable(call.name)) {
+				expr->type = builtin(call);
+				break;
+			}
+			const auto& function = callee(call.name);
+			if (function.result == DataType::Null)
+				throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Procedure has no result: " + call.name);
+			arguments(function, call.args);
+			expr->type = canonical(function.result);
+			break;
+		}
+	}
+	return expr->type;
+}
+
+DataType TypeChecker::unary(Unary& expr) {
+	const auto type = expression(expr.operand);
+	switch (expr.op) {
+		case Operator::Neg:
+			if (is_number(type)) return type;
+			break;
+		case Operator::Not:
+			if (type == DataType::Boolean) return type;
+			break;
+		case Operator::ToReal:
+			if (type == DataType::Integer) return DataType::Double;
+			break;
+		default:
+			break;
+	}
+	throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Operator is not applicable to " + type_name(type));
+}
+
+DataType TypeChecker::binary(Binary& expr) {
+	const auto lhs = expression(expr.lhs);
+	const auto rhs = expression(expr.rhs);
+	const auto numeric = [&] {
+		if (lhs == rhs) return lhs;
+		widen(expr.lhs);
+		widen(expr.rhs);
+		return DataType::Double;
+	};
+
+	switch (expr.op) {
+		case Operator::Add:
+			if (lhs == DataType::String && rhs == DataType::String) return DataType::String;
+			[[fallthrough]];
+		case Operator::Sub:
+		case Operator::Mul:
+			if (is_number(lhs) && is_number(rhs)) return numeric();
+			break;
+		case Operator::Div:
+			if (is_number(lhs) && is_number(rhs)) {
+				widen(expr.lhs);
+				widen(expr.rhs);
+				return DataType::Double;
+			}
+			break;
+		case Operator::IntDiv:
+		case Operator::Mod:
+			if (lhs == DataType::Integer && rhs == DataType::Integer) return DataType::Integer;
+			break;
+		case Operator::And:
+		case Operator::Or:
+			if (lhs == DataType::Boolean && rhs == DataType::Boolean) return DataType::Boolean;
+			break;
+		case Operator::Eq:
+		case Operator::Ne:
+		case Operator::Lt:
+		case Operator::Le:
+		case Operator::Ge:
+		case Operator::Gt:
+			if (is_number(lhs) && is_number(rhs)) {
+				numeric();
+				return DataType::Boolean;
+			}
+			if (lhs == rhs && lhs != DataType::Reference) return DataType::Boolean;
+			break;
+		default:
+			break;
+	}
+	throw type_error(__FILE__, typeid(*this).name(), __LINE__,
+					 "Operator is not applicable to " + type_name(lhs) + " and " + type_name(rhs));
+}
+
+//-------------------------parallel loops------------------------------------
+
+namespace {
+
+bool same(const Expr& lhs, const Expr& rhs);
+
+bool same(const std::vector<Selector>& lhs, const std::vector<Selector>& rhs) {
+	return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const Selector& l, const Selector& r) {
+		return l.field == r.field && std::equal(l.indices.begin(), l.indices.end(), r.indices.begin(), r.indices.end(),
+												[](const ExprPtr& a, const ExprPtr& b) { return same(*a, *b); });
+	});
+}
+
+// the same computation on the same variables, calls are never the same
+bool same(const Expr& lhs, const Expr& rhs) {
+	if (lhs.kind != rhs.kind || lhs.type != rhs.type) return false;
+	switch (lhs.kind) {
+		case Expr::Kind::Literal: return lhs.as<Literal>().value == rhs.as<Literal>().value;
+		case Expr::Kind::Variable: return lhs.as<Variable>().name == rhs.as<Variable>().name;
+		case Expr::Kind::Unary:
+			return lhs.as<Unary>().op == rhs.as<Unary>().op && same(*lhs.as<Unary>().operand, *rhs.as<Unary>().operand);
+		case Expr::Kind::Binary: {
+			const auto& l = lhs.as<Binary>();
+			const auto& r = rhs.as<Binary>();
+			return l.op == r.op && same(*l.lhs, *r.lhs) && same(*l.rhs, *r.rhs);
+		}
+		case Expr::Kind::Element:
+			return lhs.as<Element>().name == rhs.as<Element>().name && same(lhs.as<Element>().selectors, rhs.as<Element>().selectors);
+		default: return false;
+	}
+}
+
+bool is_variable(const Expr& expr, const std::string& name) {
+	return expr.kind == Expr::Kind::Variable && expr.as<Variable>().name == name;
+}
+
+bool mentions(const Expr& expr, const std::string& name) {
+	switch (expr.kind) {
+		case Expr::Kind::Variable: return expr.as<Variable>().name == name;
+		case Expr::Kind::Unary: return mentions(*expr.as<Unary>().operand, name);
+		case Expr::Kind::Binary: return mentions(*expr.as<Binary>().lhs, name) || mentions(*expr.as<Binary>().rhs, name);
+		case Expr::Kind::Element:
+			for (const auto& selector : expr.as<Element>().selectors)
+				for (const auto& index : selector.indices)
+					if (mentions(*index, name)) return true;
+			return false;
+		case Expr::Kind::Call:
+			return std::any_of(expr.as<FunctionCall>().args.begin(), expr.as<FunctionCall>().args.end(),
+							   [&](const ExprPtr& arg) { return mentions(*arg, name); });
+		default: return false;
+	}
+}
+
+// Proves that no iteration of a parallel loop depends on another, see For. Finds the first
+// reason the iterations may depend on each other in three passes: collect records what the
+// body writes and accesses, flow follows the order of the scalar writes and reads and the
+// arrays written are then checked to be indexed by the loop variable.
+class Dependences {
+	using Lookup = std::function<const Decl&(const std::string&)>;
+	using Predicate = std::function<bool(const std::string&)>;
+	// sum := sum + x, or if x < min then min := x, x is the operand
+	struct Candidate {
+		For::Reduction reduction;
+		const Expr* operand;
+	};
+
+	const For& loop;
+	const AggregateTable& types;
+	Lookup decl;
+	Predicate global; // a variable of the program used in a routine
+	std::map<std::string, int> writes; // assignments of scalars
+	std::map<std::string, std::vector<const std::vector<Selector>*>> accesses; // of aggregates, nullptr for the whole
+	std::set<std::string> stored;      // aggregates written
+	std::set<std::string> references;  // scalar var parameters read
+	std::map<const Stmt*, Candidate> candidates;
+	std::map<std::string, For::Reduction::Kind> reductions;
+	std::string problem;
+
+	void fail(std::string why) {
+		if (problem.empty()) problem = std::move(why);
+	}
+	void access(const std::string& name, const std::vector<Selector>* selectors, DataType type) {
+		if (type == DataType::String || (type == DataType::Reference && types[decl(name).aggregate].strings))
+			fail("strings are shared between the threads");
+		accesses[name].push_back(selectors);
+	}
+	std::optional<Candidate> candidate(const Stmt& stmt) const;
+	void collect(const Expr& expr);
+	void collect(const Stmt& stmt);
+	void read(const Expr& expr, const std::set<std::string>& defined);
+	void flow(const Stmt& stmt, std::set<std::string>& defined);
+	void indexed(const std::string& name);
+	[[nodiscard]] bool runs(const For& inner) const;
+public:
+	Dependences(const For& loop, const AggregateTable& types, Lookup decl, Predicate global)
+		: loop(loop), types(types), decl(std::move(decl)), global(std::move(global)) {}
+
+	// empty when the iterations are independent, the reductions and the storage to check are added to the loop
+	std::string check(For& result);
+};
+
+std::optional<Dependences::Candidate> Dependences::candidate(const Stmt& stmt) const {
+	using Kind = For::Reduction::Kind;
+	if (stmt.kind == Stmt::Kind::Assign) {
+		const auto& assign = stmt.as<Assign>();
+		const auto& name = assign.target.name;
+		if (!assign.target.selectors.empty() || assign.value->kind != Expr::Kind::Binary) return std::nullopt;
+		const auto& sum = assign.value->as<Binary>();
+		const Expr* operand = nullptr;
+		if ((sum.op == Operator::Add || sum.op == Operator::Sub) && is_variable(*sum.lhs, name)) operand = sum.rhs.get();
+		else if (sum.op == Operator::Add && is_variable(*sum.rhs, name)) operand = sum.lhs.get();
+		if (!operand || mentions(*operand, name)) return std::nullopt;
+		return Candidate{{name, Kind::Sum}, operand};
+	}
+	if (stmt.kind != Stmt::Kind::If || stmt.as<If>().else_branch) return std::nullopt;
+	const auto& branch = stmt.as<If>();
+	const Stmt* then = branch.then_branch.get();
+	if (then->kind == Stmt::Kind::Compound && then->as<Compound>().body.size() == 1) then = then->as<Compound>().body.front().get();
+	if (then->kind != Stmt::Kind::Assign || branch.cond->kind != Expr::Kind::Binary) return std::nullopt;
+	const auto& assign = then->as<Assign>();
+	const auto& name = assign.target.name;
+	const auto& cond = branch.cond->as<Binary>();
+	if (!assign.target.selectors.empty() || mentions(*assign.value, name)) return std::nullopt;
+	// x < v and v > x keep the smaller value
+	const bool less = cond.op == Operator::Lt || cond.op == Operator::Le;
+	if (!less && cond.op != Operator::Gt && cond.op != Operator::Ge) return std::nullopt;
+	if (same(*cond.lhs, *assign.value) && is_variable(*cond.rhs, name))
+		return Candidate{{name, less ? Kind::Min : Kind::Max}, assign.value.get()};
+	if (is_variable(*cond.lhs, name) && same(*cond.rhs, *assign.value))
+		return Candidate{{name, less ? Kind::Max : Kind::Min}, assign.value.get()};
+	return std::nullopt;
+}
+
+void Dependences::collect(const Expr& expr) {
+	switch (expr.kind) {
+		case Expr::Kind::Literal:
+			break;
+		case Expr::Kind::Variable: {
+			const auto& name = expr.as<Variable>().name;
+			if (expr.type == DataType::Reference) access(name, nullptr, expr.type);
+			else if (expr.type == DataType::String) fail("strings are shared between the threads");
+			else if (decl(name).by_ref) references.insert(name);
+			break;
+		}
+		case Expr::Kind::Unary:
+			collect(*expr.as<Unary>().operand);
+			break;
+		case Expr::Kind::Binary:
+			collect(*expr.as<Binary>().lhs);
+			collect(*expr.as<Binary>().rhs);
+			break;
+		case Expr::Kind::Element: {
+			const auto& elem = expr.as<Element>();
+			for (const auto& selector : elem.selectors)
+				for (const auto& index : selector.indices) collect(*index);
+			access(elem.name, &elem.selectors, expr.type);
+			break;
+		}
+		case Expr::Kind::Call:
+			fail("function " + expr.as<FunctionCall>().name + " is called");
+			break;
+	}
+}
+
+void Dependences::collect(const Stmt& stmt) {
+	switch (stmt.kind) {
+		case Stmt::Kind::Compound:
+			for (const auto& s : stmt.as<Compound>().body) collect(*s);
+			break;
+		case Stmt::Kind::Assign: {
+			const auto& assign = stmt.as<Assign>();
+			const auto& name = assign.target.name;
+			for (const auto& selector : assign.target.selectors)
+				for (const auto& index : selector.indices) collect(*index);
+			collect(*assign.value);
+			if (decl(name).aggregate >= 0) {
+				access(name, &assign.target.selectors, assign.value->type);
+				stored.insert(name);
+				break;
+			}
+			if (assign.value->type == DataType::String) fail("strings are shared between the threads");
+			++writes[name];
+			if (auto found = candidate(stmt)) candidates.emplace(&stmt, *found);
+			break;
+		}
+		case Stmt::Kind::Call:
+			fail(stmt.as<Call>().name == "Write" || stmt.as<Call>().name == "Writeln" ? "output is written in order"
+																						: "procedure " + stmt.as<Call>().name + " is called");
+			break;
+		case Stmt::Kind::Read:
+			fail("input is read in order");
+			break;
+		case Stmt::Kind::If: {
+			const auto& branch = stmt.as<If>();
+			if (auto found = candidate(stmt)) candidates.emplace(&stmt, *found);
+			collect(*branch.cond);
+			collect(*branch.then_branch);
+			if (branch.else_branch) collect(*branch.else_branch);
+			break;
+		}
+		case Stmt::Kind::While:
+			collect(*stmt.as<While>().cond);
+			collect(*stmt.as<While>().body);
+			break;
+		case Stmt::Kind::For: {
+			const auto& inner = stmt.as<For>();
+			++writes[inner.var];
+			collect(*inner.from);
+			collect(*inner.to);
+			collect(*inner.body);
+			break;
+		}
+		case Stmt::Kind::Case: {
+			const auto& branch = stmt.as<Case>();
+			collect(*branch.selector);
+			for (const auto& arm : branch.arms) collect(*arm.body);
+			if (branch.else_branch) collect(*branch.else_branch);
+			break;
+		}
+	}
+}
+
+// A scalar the body writes is read after the iteration assigned it, reductions only by themselves
+void Dependences::read(const Expr& expr, const std::set<std::string>& defined) {
+	switch (expr.kind) {
+		case Expr::Kind::Variable: {
+			const auto& name = expr.as<Variable>().name;
+			if (reductions.contains(name)) fail(name + " is read outside its reduction");
+			else if (writes.contains(name) && !defined.contains(name)) fail(name + " is carried over from the previous iteration");
+			break;
+		}
+		case Expr::Kind::Unary:
+			read(*expr.as<Unary>().operand, defined);
+			break;
+		case Expr::Kind::Binary:
+			read(*expr.as<Binary>().lhs, defined);
+			read(*expr.as<Binary>().rhs, defined);
+			break;
+		case Expr::Kind::Element:
+			for (const auto& selector : expr.as<Element>().selectors)
+				for (const auto& index : selector.indices) read(*index, defined);
+			break;
+		default:
+			break;
+	}
+}
+
+// defined holds the scalars every path so far assigned
+void Dependences::flow(const Stmt& stmt, std::set<std::string>& defined) {
+	if (const auto it = candidates.find(&stmt); it != candidates.end() && reductions.contains(it->second.reduction.var)) {
+		read(*it->second.operand, defined);
+		return;
+	}
+	const auto both = [](const std::set<std::string>& lhs, const std::set<std::string>& rhs) {
+		std::set<std::string> res;
+		std::set_intersection(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), std::inserter(res, res.end()));
+		return res;
+	};
+	switch (stmt.kind) {
+		case Stmt::Kind::Compound:
+			for (const auto& s : stmt.as<Compound>().body) flow(*s, defined);
+			break;
+		case Stmt::Kind::Assign: {
+			const auto& assign = stmt.as<Assign>();
+			for (const auto& selector : assign.target.selectors)
+				for (const auto& index : selector.indices) read(*index, defined);
+			read(*assign.value, defined);
+			if (writes.contains(assign.target.name)) defined.insert(assign.target.name);
+			break;
+		}
+		case Stmt::Kind::If: {
+			const auto& branch = stmt.as<If>();
+			read(*branch.cond, defined);
+			auto then = defined;
+			flow(*branch.then_branch, then);
+			if (!branch.else_branch) break;
+			flow(*branch.else_branch, defined);
+			defined = both(then, defined);
+			break;
+		}
+		case Stmt::Kind::While: {
+			read(*stmt.as<While>().cond, defined);
+			auto body = defined;
+			flow(*stmt.as<While>().body, body);
+			break;
+		}
+		case Stmt::Kind::For: {
+			const auto& inner = stmt.as<For>();
+			read(*inner.from, defined);
+			read(*inner.to, defined);
+			defined.insert(inner.var);
+			auto body = defined;
+			flow(*inner.body, body);
+			if (runs(inner)) defined = std::move(body);
+			break;
+		}
+		case Stmt::Kind::Case: {
+			const auto& branch = stmt.as<Case>();
+			read(*branch.selector, defined);
+			auto res = defined;
+			for (const auto& arm : branch.arms) {
+				auto path = defined;
+				flow(*arm.body, path);
+				res = &arm == &branch.arms.front() ? path : both(res, path);
+			}
+			if (branch.else_branch) {
+				auto path = defined;
+				flow(*branch.else_branch, path);
+				res = branch.arms.empty() ? path : both(res, path);
+			} else {
+				res = both(res, defined);
+			}
+			defined = std::move(res);
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+// The bounds are constants and the body runs at least once
+bool Dependences::runs(const For& inner) const {
+	const auto constant = [&](const Expr& expr) -> std::optional<int32_t> {
+		if (expr.kind == Expr::Kind::Literal) return expr.as<Literal>().value.value.int_ptr;
+		if (expr.kind != Expr::Kind::Variable || !decl(expr.as<Variable>().name).is_const) return std::nullopt;
+		return decl(expr.as<Variable>().name).value.value.int_ptr;
+	};
+	const auto from = constant(*inner.from), to = constant(*inner.to);
+	return from && to && (inner.down ? *from >= *to : *from <= *to);
+}
+
+// Every access of a written aggregate has the loop variable for the same index, before any field
+void Dependences::indexed(const std::string& name) {
+	std::optional<std::set<size_t>> common;
+	for (const auto* selectors : accesses[name]) {
+		std::set<size_t> at;
+		size_t position = 0;
+		for (size_t i = 0; selectors && i < selectors->size() && (*selectors)[i].field.empty(); ++i)
+			for (const auto& index : (*selectors)[i].indices) {
+				if (is_variable(*index, loop.var)) at.insert(position);
+				++position;
+			}
+		if (common) {
+			std::erase_if(*common, [&](size_t p) { return !at.contains(p); });
+		} else {
+			common = std::move(at);
+		}
+	}
+	if (!common || common->empty()) fail(name + " is accessed at other indices than " + loop.var);
+}
+
+std::string Dependences::check(For& result) {
+	collect(*loop.body);
+	if (writes.contains(loop.var)) fail("the loop variable " + loop.var + " is assigned");
+	for (const auto& [name, count] : writes) {
+		if (decl(name).by_ref) fail("var parameter " + name + " is assigned");
+		// each thread writes a copy of the variable
+		for (const auto& other : references)
+			if (global(name)) fail(other + " may be another name of " + name);
+	}
+	if (!problem.empty()) return problem;
+
+	// all writes of a reduction have the same kind
+	std::map<std::string, std::pair<int, std::optional<For::Reduction::Kind>>> sites;
+	for (const auto& [stmt, found] : candidates) {
+		auto& [count, kind] = sites[found.reduction.var];
+		if (count++ && kind != found.reduction.kind) kind.reset();
+		else if (count == 1) kind = found.reduction.kind;
+	}
+	for (const auto& [name, site] : sites) {
+		const auto type = TypeChecker::canonical(decl(name).type);
+		if (site.first == writes[name] && site.second && (type == DataType::Integer || type == DataType::Double))
+			reductions.emplace(name, *site.second);
+	}
+	std::set<std::string> defined{loop.var};
+	flow(*loop.body, defined);
+	for (const auto& [name, count] : writes)
+		if (!reductions.contains(name) && !defined.contains(name)) fail(name + " is not assigned by every iteration");
+	for (const auto& name : stored)
+		indexed(name);
+	if (!problem.empty()) return problem;
+
+	for (const auto& [name, kind] : reductions)
+		result.reductions.push_back({name, kind});
+	// var parameters may name storage of another variable, the VM checks them before the loop runs
+	for (const auto& name : stored) {
+		for (const auto& [other, list] : accesses)
+			if (other != name && (decl(name).by_ref || decl(other).by_ref)) result.disjoint.emplace_back(name, other);
+		for (const auto& other : references)
+			result.disjoint.emplace_back(name, other);
+	}
+	return {};
+}
+
+}
+
+// The loop runs in parallel when the iterations are independent, see For
+void TypeChecker::parallel(For& loop) {
+	const auto decl = [this](const std::string& name) -> const Decl& {
+		return routine && routine->result != DataType::Null && name == routine->name ? result : variable(name);
+	};
+	const auto global = [this](const std::string& name) {
+		return routine && !locals.contains(name) && name != routine->name;
+	};
+	Dependences dependences(loop, program->types, decl, global);
+	if (const auto problem = dependences.check(loop); !problem.empty())
+		throw type_error(__FILE__, typeid(*this).name(), __LINE__, "Loop can't run in parallel: " + problem);
+}
@@ -0,0 +1,750 @@
+#include "compiler.h"
+#include "checker.h"
+#include "exceptions.h"
+#include <algorithm>
+#include <set>
+
+using namespace ast;
+
+namespace {
+
+// calls a routine of the program, which may assign any global
+bool calls(const Expr& expr) {
+	switch (expr.kind) {
+		case Expr::Kind::Unary: return calls(*expr.as<Unary>().operand);
+		case Expr::Kind::Binary: return calls(*expr.as<Binary>().lhs) || calls(*expr.as<Binary>().rhs);
+		case Expr::Kind::Element:
+			for (const auto& selector : expr.as<Element>().selectors)
+				for (const auto& index : selector.indices)
+					if (calls(*index)) return true;
+			return false;
+		case Expr::Kind::Call: {
+			const auto& call = expr.as<FunctionCall>();
+			return call.builtin == Builtin::None
+				|| std::any_of(call.args.begin(), call.args.end(), [](const ExprPtr& arg) { return calls(*arg); });
+		}
+		default: return false;
+	}
+}
+
+}
+
+size_t Compiler::emit(OpCode op, int32_t a, int32_t b) {
+	depth += stack_effect(op, a, b);
+	auto& peak = routine ? routine->max_stack : chunk.max_stack;
+	peak = std::max(peak, depth);
+	chunk.code.push_back({op, a, b});
+	chunk.lines.push_back(line);
+	return chunk.code.size() - 1;
+}
+
+int32_t Compiler::here() const {
+	return static_cast<int32_t>(chunk.code.size());
+}
+
+int32_t Compiler::constant(const Value& val) {
+	chunk.constants.push_back(val);
+	return static_cast<int32_t>(chunk.constants.size() - 1);
+}
+
+void Compiler::declare(const ast::Decl& decl) {
+	const auto slot = static_cast<int32_t>(chunk.globals.size());
+	if (!chunk.symbols.emplace(decl.name, Symbol{slot, decl.type, decl.is_const, decl.hidden, decl.aggregate}).second)
+		throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Duplicate identifier: " + decl.name);
+	chunk.globals.push_back(decl.value);
+}
+
+// Parameters, the result and the declarations of a routine in this order, see Routine
+void Compiler::local(const ast::Decl& decl, bool param) {
+	const auto slot = static_cast<int32_t>(routine->frame.size());
+	const Symbol symbol{slot, decl.type, decl.is_const, decl.hidden, decl.aggregate, true, decl.by_ref && decl.aggregate < 0};
+	if (!locals.emplace(decl.name, symbol).second)
+		throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Duplicate identifier: " + decl.name);
+	if (decl.aggregate < 0 && !decl.by_ref) {
+		routine->frame.push_back(decl.value);
+		return;
+	}
+	routine->frame.push_back(Value{DataType::Reference});
+	if (decl.aggregate < 0) return;
+	using Kind = interpreter::Routine::Aggregate::Kind;
+	routine->aggregates.push_back({decl.by_ref ? Kind::Var : param ? Kind::Value : Kind::Local, slot, decl.aggregate});
+}
+
+// Arrays and records of the program get a slot in the frame of a routine using them,
+// the instructions on aggregates only take slots of the current frame
+const Symbol& Compiler::variable(const std::string& identifier) {
+	if (routine)
+		if (const auto it = locals.find(identifier); it != locals.end()) return it->second;
+	const auto it = chunk.symbols.find(identifier);
+	if (it == chunk.symbols.end())
+		throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Undeclared identifier: " + identifier);
+	if (!routine || it->second.aggregate < 0) return it->second;
+	auto alias = it->second;
+	alias.slot = static_cast<int32_t>(routine->frame.size());
+	alias.local = true;
+	routine->frame.push_back(Value{DataType::Reference});
+	routine->aggregates.push_back({interpreter::Routine::Aggregate::Kind::Global, alias.slot, it->second.slot});
+	return locals.emplace(identifier, alias).first->second;
+}
+
+const Symbol& Compiler::assignable(const std::string& identifier) {
+	const auto& var = variable(identifier);
+	if (var.is_const)
+		throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Can't modify constant");
+	return var;
+}
+
+// A variable of the program used by a routine
+bool Compiler::global(const Symbol& var) const {
+	return routine && !var.local;
+}
+
+void Compiler::load(const Symbol& var) {
+	const auto type = TypeChecker::canonical(var.type);
+	if (var.reference) emit(element(OpCode::LoadRefI, type), var.slot, static_cast<int32_t>(type));
+	else emit(global(var) ? OpCode::LoadGlobal : OpCode::Load, var.slot);
+}
+
+void Compiler::store(const Symbol& var) {
+	const auto type = TypeChecker::canonical(var.type);
+	if (var.reference) emit(element(OpCode::StoreRefI, type), var.slot, static_cast<int32_t>(type));
+	else emit(global(var) ? OpCode::StoreGlobal : OpCode::Store, var.slot);
+}
+
+// s := s + a + b appends to the payload of s in place when nothing else holds it, see
+// StringData::append. The parts are appended one at a time when none of them can fail
+// or reads s, otherwise their concatenation is, so s is untouched when it fails.
+bool Compiler::append(const std::string& name, const Symbol& var, const Expr& value) {
+	if (var.reference || TypeChecker::canonical(var.type) != DataType::String || value.kind != Expr::Kind::Binary) return false;
+	const auto& concat = value.as<Binary>();
+	if (concat.op != Operator::Add || concat.lhs->kind != Expr::Kind::Variable || concat.lhs->as<Variable>().name != name
+		|| calls(*concat.rhs))
+		return false;
+	// a + b + c is a + (b + c)
+	std::vector<const Expr*> parts;
+	const Expr* rest = concat.rhs.get();
+	for (; rest->kind == Expr::Kind::Binary && rest->as<Binary>().op == Operator::Add; rest = rest->as<Binary>().rhs.get())
+		parts.push_back(rest->as<Binary>().lhs.get());
+	parts.push_back(rest);
+	const bool simple = std::all_of(parts.begin(), parts.end(), [&](const Expr* part) {
+		return part->kind == Expr::Kind::Literal || (part->kind == Expr::Kind::Variable && part->as<Variable>().name != name);
+	});
+	if (!simple) parts.assign(1, concat.rhs.get());
+	for (const auto* part : parts) {
+		expression(*part);
+		emit(global(var) ? OpCode::AppendGlobal : OpCode::Append, var.slot);
+	}
+	return true;
+}
+
+// Accesses with the same range share their entry
+int32_t Compiler::dimension(Dimension dim) {
+	const auto it = std::find_if(chunk.dimensions.begin(), chunk.dimensions.end(), [&](const Dimension& d) {
+		return d.low == dim.low && d.high == dim.high && d.stride == dim.stride && d.base == dim.base && d.type == dim.type;
+	});
+	if (it != chunk.dimensions.end()) return static_cast<int32_t>(it - chunk.dimensions.begin());
+	chunk.dimensions.push_back(dim);
+	return static_cast<int32_t>(chunk.dimensions.size() - 1);
+}
+
+// Resolves the selectors to one offset into the storage of the variable. Fields and the
+// layout of nested aggregates only add to the constant part, the indices are scaled by
+// their strides at run time. A single index is left on the stack for the access to rebase,
+// several are checked and scaled on their own by Index, their sum is always in range.
+// Offsets count scalars of the accessed type, or bytes for an aggregate or when asked for.
+Compiler::Access Compiler::access(const Symbol& var, const std::vector<Selector>& selectors, bool bytes) {
+	struct Term {
+		const Expr* index;
+		Bounds bounds;
+		size_t stride; // bytes
+	};
+	std::vector<Term> terms;
+	size_t base = 0;
+	TypeRef type{DataType::Reference, var.aggregate};
+	for (const auto& selector : selectors) {
+		if (!selector.field.empty()) {
+			const auto* field = chunk.types[type.aggregate].field(selector.field);
+			base += field->offset;
+			type = field->type;
+			continue;
+		}
+		for (size_t i = 0; i < selector.indices.size();) {
+			const auto& array = chunk.types[type.aggregate];
+			auto stride = static_cast<size_t>(array.size);
+			for (const auto& bounds : array.bounds) {
+				stride /= static_cast<size_t>(bounds.count());
+				terms.push_back({selector.indices[i++].get(), bounds, stride});
+			}
+			type = array.element;
+		}
+	}
+
+	const auto unit = bytes || type.type == DataType::Reference ? 1 : AggregateType::width(type.type);
+	const auto units = [&](size_t bytes) { return static_cast<int32_t>(bytes / unit); };
+	if (terms.empty()) return {type, dimension({0, 0, 0, units(base), type.type}), false};
+	if (terms.size() == 1) {
+		const auto& term = terms.front();
+		expression(*term.index);
+		return {type, dimension({term.bounds.low, term.bounds.high, units(term.stride), units(base), type.type}), true};
+	}
+	for (size_t i = 0; i < terms.size(); ++i) {
+		expression(*terms[i].index);
+		emit(OpCode::Index, dimension({terms[i].bounds.low, terms[i].bounds.high, units(terms[i].stride)}));
+		if (i) emit(OpCode::AddI);
+	}
+	const auto size = units(chunk.types[var.aggregate].size);
+	return {type, dimension({0, size - 1, 1, units(base), type.type}), true};
+}
+
+// Leaves the address of the aggregate or scalar the selectors pick on the stack, for Copy and Call
+TypeRef Compiler::address(const Symbol& var, const std::vector<Selector>& selectors) {
+	const auto place = access(var, selectors, true);
+	if (!place.indexed) emit(OpCode::Push, constant(Value{0}));
+	emit(OpCode::Address, var.slot, place.dimension);
+	return place.type;
+}
+
+// Pushes the argument of a scalar var parameter: the reference to the variable
+void Compiler::reference(const Expr& arg) {
+	if (arg.kind == Expr::Kind::Element) {
+		address(variable(arg.as<Element>().name), arg.as<Element>().selectors);
+		return;
+	}
+	const auto& var = variable(arg.as<Variable>().name);
+	if (var.reference) emit(OpCode::Load, var.slot);
+	else emit(global(var) ? OpCode::RefGlobal : OpCode::Ref, var.slot);
+}
+
+// The argument is passed by address and lies in the frame of the routine being compiled
+bool Compiler::frame_bound(const Expr& arg) const {
+	const auto& name = arg.kind == Expr::Kind::Element ? arg.as<Element>().name : arg.as<Variable>().name;
+	const auto owned = [&](const std::vector<Decl>& decls) {
+		return std::any_of(decls.begin(), decls.end(), [&](const Decl& d) { return d.name == name && !d.by_ref; });
+	};
+	return owned(source->params) || owned(source->decls);
+}
+
+// Value parameters are pushed by value, scalar var parameters by reference and arrays and
+// records by address. Call turns the arguments into the frame of the routine. A call of
+// the routine itself as the last thing it does reuses its frame, unless an argument
+// passed by address lies in that frame.
+void Compiler::call(const std::string& name, const std::vector<ExprPtr>& args, bool last) {
+	const auto index = routines.at(name);
+	const auto& params = program->routines[index].params;
+	bool reused = last && routine == &chunk.routines[index];
+	for (size_t i = 0; i < args.size(); ++i) {
+		const auto& arg = *args[i];
+		if (params[i].aggregate >= 0) {
+			if (arg.kind == Expr::Kind::Element) address(variable(arg.as<Element>().name), arg.as<Element>().selectors);
+			else address(variable(arg.as<Variable>().name), {});
+		} else if (params[i].by_ref) {
+			reference(arg);
+		} else {
+			expression(arg);
+			continue;
+		}
+		reused = reused && !frame_bound(arg);
+	}
+	emit(reused ? OpCode::TailCall : OpCode::Call, index);
+}
+
+void Compiler::compile(const ast::Routine& routine, int32_t index) {
+	this->routine = &chunk.routines[index];
+	source = &routine;
+	locals.clear();
+	depth = 0;
+	line = routine.source_line;
+	this->routine->entry = here();
+	for (const auto& param : routine.params)
+		local(param, true);
+	if (routine.result != DataType::Null) {
+		locals.emplace(routine.name, Symbol{this->routine->result, routine.result, false, false, -1, true});
+		this->routine->frame.emplace_back(routine.result);
+	}
+	for (const auto& decl : routine.decls)
+		local(decl, false);
+	tail = true;
+	statement(*routine.body);
+	tail = false;
+	emit(OpCode::Return, index);
+	this->routine->end = here();
+	this->routine = nullptr;
+	source = nullptr;
+}
+
+Chunk Compiler::compile(const ast::Program& program) {
+	chunk = {};
+	this->program = &program;
+	depth = 0;
+	line = 0;
+	routines.clear();
+	chunk.program_name = program.name;
+	chunk.types = program.types;
+	for (const auto& decl : program.decls)
+		declare(decl);
+	// calls may come before the code of their routine
+	chunk.routines.resize(program.routines.size());
+	for (size_t i = 0; i < program.routines.size(); ++i) {
+		const auto& source = program.routines[i];
+		auto& res = chunk.routines[i];
+		res.name = source.name;
+		res.params = static_cast<int32_t>(source.params.size());
+		if (source.result != DataType::Null) res.result = res.params;
+		routines.emplace(source.name, static_cast<int32_t>(i));
+	}
+	statement(*program.body);
+	emit(OpCode::Halt);
+	for (size_t i = 0; i < program.routines.size(); ++i)
+		compile(program.routines[i], static_cast<int32_t>(i));
+	this->program = nullptr;
+	return std::move(chunk);
+}
+
+int32_t Compiler::stack_effect(OpCode op, int32_t a, int32_t b) const {
+	switch (op) {
+		case OpCode::Push:
+		case OpCode::Load:
+		case OpCode::LoadGlobal:
+		case OpCode::Ref:
+		case OpCode::RefGlobal:
+		case OpCode::LoadRefI:
+		case OpCode::LoadRefR:
+		case OpCode::LoadRef:
+		case OpCode::LoadFieldI:
+		case OpCode::LoadFieldR:
+		case OpCode::LoadField:
+			return 1;
+		case OpCode::NegI:
+		case OpCode::NegR:
+		case OpCode::ToReal:
+		case OpCode::Not:
+		case OpCode::Jump:
+		case OpCode::ForTest:     //the final value is popped on exit, see For
+		case OpCode::ForTestDown:
+		case OpCode::ForNext:     //as by ForTest
+		case OpCode::ForPrev:
+		case OpCode::Read:
+		case OpCode::ReadLine:
+		case OpCode::Index:
+		case OpCode::LoadElemI:
+		case OpCode::LoadElemR:
+		case OpCode::LoadElem:
+		case OpCode::Address:
+		case OpCode::StrLength:
+		case OpCode::Kernel:      //the final value is popped when the kernel runs, see For
+		case OpCode::Parallel:    //as by Kernel
+		case OpCode::ParallelEnd:
+		case OpCode::Return:
+		case OpCode::Halt:
+			return 0;
+		case OpCode::StoreElemI:
+		case OpCode::StoreElemR:
+		case OpCode::StoreElem:
+		case OpCode::Copy:
+		case OpCode::StrCopy:
+			return -2;
+		case OpCode::Write:
+		case OpCode::Writeln:
+			return -a * (b ? 3 : 1);
+		case OpCode::Call:
+			return chunk.routines[a].result < 0 ? -chunk.routines[a].params : 1 - chunk.routines[a].params;
+		case OpCode::TailCall:
+			return -chunk.routines[a].params;
+		default: //stores, conditional jumps and binary operators
+			return -1;
+	}
+}
+
+OpCode Compiler::operation(Operator op, DataType operand) {
+	const bool real = operand == DataType::Double;
+	const bool integer = operand == DataType::Integer;
+	switch (op) {
+		case Operator::Add:
+			if (operand == DataType::String) return OpCode::Concat;
+			return real ? OpCode::AddR : OpCode::AddI;
+		case Operator::Sub: return real ? OpCode::SubR : OpCode::SubI;
+		case Operator::Mul: return real ? OpCode::MulR : OpCode::MulI;
+		case Operator::Div: return OpCode::DivR;
+		case Operator::IntDiv: return OpCode::IntDivI;
+		case Operator::Mod: return OpCode::ModI;
+		case Operator::Neg: return real ? OpCode::NegR : OpCode::NegI;
+		case Operator::ToReal: return OpCode::ToReal;
+		case Operator::Not: return OpCode::Not;
+		case Operator::And: return OpCode::And;
+		case Operator::Or: return OpCode::Or;
+		case Operator::Eq: return real ? OpCode::EqR : integer ? OpCode::EqI : OpCode::Eq;
+		case Operator::Ne: return real ? OpCode::NeR : integer ? OpCode::NeI : OpCode::Ne;
+		case Operator::Lt: return real ? OpCode::LtR : integer ? OpCode::LtI : OpCode::Lt;
+		case Operator::Le: return real ? OpCode::LeR : integer ? OpCode::LeI : OpCode::Le;
+		case Operator::Ge: return real ? OpCode::GeR : integer ? OpCode::GeI : OpCode::Ge;
+		case Operator::Gt: return real ? OpCode::GtR : integer ? OpCode::GtI : OpCode::Gt;
+	}
+	throw std::runtime_error("Unsupported operator");
+}
+
+// LoadElem, StoreElem, LoadField or StoreField for scalars of the type
+OpCode Compiler::element(OpCode op, DataType type) {
+	const auto shift = type == DataType::Integer ? 0 : type == DataType::Double ? 1 : 2;
+	return static_cast<OpCode>(static_cast<int>(op) + shift);
+}
+
+//-------------------------statements------------------------------------
+
+// Statements without a line of their own, like the optimizer's, belong to the enclosing one
+void Compiler::statement(const Stmt& stmt) {
+	const auto outer = line;
+	const auto last = tail;
+	if (stmt.source_line) line = stmt.source_line;
+	if (stmt.kind != Stmt::Kind::Compound) chunk.statements.push_back(here());
+	switch (stmt.kind) {
+		case Stmt::Kind::Compound: {
+			const auto& body = stmt.as<Compound>().body;
+			for (size_t i = 0; i < body.size(); ++i) {
+				tail = last && i + 1 == body.size();
+				statement(*body[i]);
+			}
+			break;
+		}
+		case Stmt::Kind::Assign: {
+			const auto& assign = stmt.as<Assign>();
+			const auto& var = assignable(assign.target.name);
+			if (var.aggregate < 0) {
+				// f := f(...) at the end of f leaves the result of the call in the result slot
+				const auto& value = *assign.value;
+				if (tail && routine && assign.target.name == routine->name && value.kind == Expr::Kind::Call
+					&& value.as<FunctionCall>().name == routine->name) {
+					call(routine->name, value.as<FunctionCall>().args, true);
+					if (chunk.code.back().op == OpCode::TailCall) break;
+					store(var);
+					break;
+				}
+				if (append(assign.target.name, var, value)) break;
+				expression(value);
+				store(var);
+				break;
+			}
+			if (assign.value->type == DataType::Reference) {
+				// whole arrays and records are block copies
+				const auto type = address(var, assign.target.selectors);
+				const auto& value = *assign.value;
+				if (value.kind == Expr::Kind::Variable) address(variable(value.as<Variable>().name), {});
+				else address(variable(value.as<Element>().name), value.as<Element>().selectors);
+				emit(OpCode::Copy, type.aggregate);
+				break;
+			}
+			const auto place = access(var, assign.target.selectors);
+			expression(*assign.value);
+			emit(element(place.indexed ? OpCode::StoreElemI : OpCode::StoreFieldI, place.type.type), var.slot, place.dimension);
+			break;
+		}
+		case Stmt::Kind::Call: {
+			const auto& call = stmt.as<Call>();
+			OpCode op;
+			if (call.name == "Write") op = OpCode::Write;
+			else if (call.name == "Writeln") op = OpCode::Writeln;
+			else if (routines.contains(call.name)) {
+				this->call(call.name, call.args, tail);
+				break;
+			} else throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Unknown function");
+			const bool formatted = std::any_of(call.formats.begin(), call.formats.end(),
+											   [](const Format& f) { return f.width || f.decimals; });
+			for (size_t i = 0; i < call.args.size(); ++i) {
+				expression(*call.args[i]);
+				if (!formatted) continue;
+				const auto& format = call.formats[i];
+				if (format.width) expression(*format.width);
+				else emit(OpCode::Push, constant(Value{0}));
+				if (format.decimals) expression(*format.decimals);
+				else emit(OpCode::Push, constant(Value{-1}));
+			}
+			emit(op, static_cast<int32_t>(call.args.size()), formatted);
+			break;
+		}
+		case Stmt::Kind::Read: {
+			const auto& read = stmt.as<Read>();
+			for (const auto& target : read.targets) {
+				const auto& var = assignable(target.name);
+				if (target.selectors.empty() && (var.reference || global(var))) {
+					emit(var.reference ? OpCode::Load : OpCode::RefGlobal, var.slot);
+					emit(OpCode::ReadRef, static_cast<int32_t>(TypeChecker::canonical(var.type)));
+					continue;
+				}
+				if (target.selectors.empty()) {
+					emit(OpCode::Read, var.slot);
+					continue;
+				}
+				const auto place = access(var, target.selectors);
+				if (!place.indexed) emit(OpCode::Push, constant(Value{0}));
+				emit(OpCode::ReadElem, var.slot, place.dimension);
+			}
+			if (read.line) emit(OpCode::ReadLine);
+			break;
+		}
+		case Stmt::Kind::If: {
+			const auto& branch = stmt.as<If>();
+			expression(*branch.cond);
+			const auto jump_else = emit(OpCode::JumpIfFalse);
+			statement(*branch.then_branch);
+			if (!branch.else_branch) {
+				chunk.code[jump_else].a = here();
+				break;
+			}
+			const auto jump_end = emit(OpCode::Jump);
+			chunk.code[jump_else].a = here();
+			statement(*branch.else_branch);
+			chunk.code[jump_end].a = here();
+			break;
+		}
+		case Stmt::Kind::While: {
+			const auto& loop = stmt.as<While>();
+			tail = false;
+			const auto head = here();
+			expression(*loop.cond);
+			const auto jump_end = emit(OpCode::JumpIfFalse);
+			statement(*loop.body);
+			emit(OpCode::Jump, head);
+			chunk.code[jump_end].a = here();
+			break;
+		}
+		case Stmt::Kind::For: {
+			const auto& loop = stmt.as<For>();
+			const auto& var = assignable(loop.var);
+			tail = false;
+
+			expression(*loop.from);
+			store(var);
+			expression(*loop.to);
+			const auto vectorized = loop.parallel ? -1 : kernel(loop, var);
+			const auto fast = vectorized < 0 ? 0 : emit(OpCode::Kernel, vectorized);
+			// the parts of a parallel loop run from the head to ParallelEnd
+			const auto split = loop.parallel ? parallel(loop, var) : -1;
+			const auto fork = split < 0 ? 0 : emit(OpCode::Parallel, split);
+
+			const auto head = here();
+			const auto test = emit(loop.down ? OpCode::ForTestDown : OpCode::ForTest, var.slot);
+			statement(*loop.body);
+			emit(loop.down ? OpCode::ForPrev : OpCode::ForNext, var.slot, head);
+			chunk.code[test].b = here();
+			if (vectorized >= 0) chunk.code[fast].b = here();
+			if (split >= 0) {
+				emit(OpCode::ParallelEnd, split);
+				chunk.code[fork].b = here();
+			}
+			--depth;
+			break;
+		}
+		case Stmt::Kind::Case: {
+			const auto& branch = stmt.as<Case>();
+			expression(*branch.selector);
+			const auto index = static_cast<int32_t>(chunk.tables.size());
+			chunk.tables.emplace_back();
+			const auto dispatch = emit(OpCode::JumpTable, index);
+
+			// the target of a label is the index of its arm until the code of the arms is known
+			std::vector<JumpTable::Range> labels;
+			std::vector<int32_t> entries;
+			std::vector<size_t> jumps_end;
+			for (size_t i = 0; i < branch.arms.size(); ++i) {
+				for (const auto& label : branch.arms[i].labels)
+					labels.push_back({Case::ordinal(label.low), Case::ordinal(label.high), static_cast<int32_t>(i)});
+				entries.push_back(here());
+				statement(*branch.arms[i].body);
+				if (i + 1 < branch.arms.size() || branch.else_branch) jumps_end.push_back(emit(OpCode::Jump));
+			}
+			JumpTable table{};
+			table.chars = branch.selector->type == DataType::Char;
+			table.otherwise = here();
+			if (branch.else_branch) statement(*branch.else_branch);
+			for (const auto at : jumps_end)
+				chunk.code[at].a = here();
+
+			std::sort(labels.begin(), labels.end(), [](const auto& l, const auto& r) { return l.low < r.low; });
+			int64_t covered = 0;
+			for (const auto& label : labels)
+				covered += static_cast<int64_t>(label.high) - label.low + 1;
+			const auto span = static_cast<int64_t>(labels.back().high) - labels.front().low + 1;
+			// a table at most three times the values the labels cover, sparser ones are searched
+			if (span <= std::min<int64_t>(max_table, 3 * covered)) {
+				table.low = labels.front().low;
+				table.targets.assign(static_cast<size_t>(span), table.otherwise);
+				for (const auto& label : labels)
+					std::fill(table.targets.begin() + (label.low - table.low), table.targets.begin() + (label.high - table.low + 1),
+							  entries[label.target]);
+			} else {
+				chunk.code[dispatch].op = OpCode::JumpSearch;
+				for (const auto& label : labels) {
+					auto& ranges = table.ranges;
+					if (!ranges.empty() && ranges.back().target == entries[label.target] && ranges.back().high + 1 == label.low)
+						ranges.back().high = label.high;
+					else ranges.push_back({label.low, label.high, entries[label.target]});
+				}
+			}
+			chunk.tables[index] = std::move(table);
+			break;
+		}
+	}
+	line = outer;
+	tail = last;
+}
+
+//-------------------------expressions------------------------------------
+
+void Compiler::expression(const Expr& expr) {
+	switch (expr.kind) {
+		case Expr::Kind::Literal:
+			emit(OpCode::Push, constant(expr.as<Literal>().value));
+			break;
+		case Expr::Kind::Variable:
+			load(variable(expr.as<Variable>().name));
+			break;
+		case Expr::Kind::Unary: {
+			const auto& unary = expr.as<Unary>();
+			expression(*unary.operand);
+			emit(operation(unary.op, unary.operand->type));
+			break;
+		}
+		case Expr::Kind::Binary: {
+			const auto& binary = expr.as<Binary>();
+			expression(*binary.lhs);
+			expression(*binary.rhs);
+			emit(operation(binary.op, binary.lhs->type));
+			break;
+		}
+		case Expr::Kind::Element: {
+			const auto& elem = expr.as<Element>();
+			const auto place = access(variable(elem.name), elem.selectors);
+			emit(element(place.indexed ? OpCode::LoadElemI : OpCode::LoadFieldI, expr.type), variable(elem.name).slot, place.dimension);
+			break;
+		}
+		case Expr::Kind::Call: {
+			const auto& call = expr.as<FunctionCall>();
+			if (call.builtin == Builtin::None) {
+				this->call(call.name, call.args, false);
+				break;
+			}
+			for (const auto& arg : call.args)
+				expression(*arg);
+			emit(call.builtin == Builtin::Length ? OpCode::StrLength : call.builtin == Builtin::Copy ? OpCode::StrCopy : OpCode::StrPos);
+			break;
+		}
+	}
+}
+
+//-------------------------kernels------------------------------------
+
+// A loop whose body is x[i] := a op b with i the loop variable, where x and the
+// operands are 1-D arrays of integers or reals indexed by i, other variables or
+// constants. No iteration reads what another one writes, so all of them run at
+// once when the bounds check of the whole range passes. Returns -1 for any other loop.
+int32_t Compiler::kernel(const For& loop, const Symbol& var) {
+	const Stmt* body = loop.body.get();
+	if (body->kind == Stmt::Kind::Compound && body->as<Compound>().body.size() == 1)
+		body = body->as<Compound>().body.front().get();
+	if (body->kind != Stmt::Kind::Assign) return -1;
+	const auto& assign = body->as<Assign>();
+
+	DataType type = DataType::Null;
+	// the symbol of a 1-D array of the type indexed by the loop variable alone
+	const auto array = [&](const std::string& name, const std::vector<Selector>& selectors) -> const Symbol* {
+		const auto& symbol = variable(name);
+		if (symbol.aggregate < 0 || selectors.size() != 1 || selectors.front().indices.size() != 1) return nullptr;
+		const auto& index = *selectors.front().indices.front();
+		if (index.kind != Expr::Kind::Variable || index.as<Variable>().name != loop.var) return nullptr;
+		const auto& aggregate = chunk.types[symbol.aggregate];
+		return aggregate.bounds.size() == 1 && aggregate.element.type == type ? &symbol : nullptr;
+	};
+	const auto operand = [&](const Expr& expr, Kernel::Operand& res) {
+		if (expr.type != type) return false;
+		switch (expr.kind) {
+			case Expr::Kind::Element: {
+				const auto* symbol = array(expr.as<Element>().name, expr.as<Element>().selectors);
+				res = {Kernel::Operand::Kind::Array, symbol ? symbol->slot : 0};
+				return symbol != nullptr;
+			}
+			case Expr::Kind::Variable: {
+				const auto& symbol = variable(expr.as<Variable>().name);
+				res = {Kernel::Operand::Kind::Variable, symbol.slot};
+				return symbol.aggregate < 0 && symbol.slot != var.slot && !symbol.reference && !global(symbol);
+			}
+			case Expr::Kind::Literal:
+				res = {Kernel::Operand::Kind::Constant, constant(expr.as<Literal>().value)};
+				return true;
+			default:
+				return false;
+		}
+	};
+
+	const auto& target = assignable(assign.target.name);
+	if (target.aggregate < 0) return -1;
+	type = chunk.types[target.aggregate].element.type;
+	if ((type != DataType::Integer && type != DataType::Double) || !array(assign.target.name, assign.target.selectors))
+		return -1;
+
+	Kernel res{OpCode::Store, target.slot, {}, {}, var.slot, loop.down};
+	const auto& value = *assign.value;
+	if (value.kind == Expr::Kind::Binary) {
+		const auto& binary = value.as<Binary>();
+		if (binary.op != Operator::Add && binary.op != Operator::Sub && binary.op != Operator::Mul) return -1;
+		if (!operand(*binary.lhs, res.a) || !operand(*binary.rhs, res.b)) return -1;
+		res.op = operation(binary.op, type);
+	} else if (!operand(value, res.a)) {
+		return -1;
+	}
+	chunk.kernels.push_back(res);
+	return static_cast<int32_t>(chunk.kernels.size() - 1);
+}
+
+// The scalars the body writes after the optimizer: its own temporaries are private to the parts as well
+int32_t Compiler::parallel(const For& loop, const Symbol& var) {
+	ParallelLoop res;
+	res.var = var.slot;
+	res.down = loop.down;
+	res.routine = routine ? static_cast<int32_t>(routine - chunk.routines.data()) : -1;
+	const auto place = [&](const std::string& name) {
+		const auto& symbol = variable(name);
+		return ParallelLoop::Place{symbol.slot, global(symbol)};
+	};
+	for (const auto& reduction : loop.reductions)
+		res.reductions.push_back({static_cast<ParallelLoop::Reduction::Kind>(reduction.kind), place(reduction.var),
+								  TypeChecker::canonical(variable(reduction.var).type) == DataType::Double});
+
+	std::set<std::string> written;
+	const auto scalars = [&](const auto& self, const Stmt& stmt) -> void {
+		switch (stmt.kind) {
+			case Stmt::Kind::Compound:
+				for (const auto& s : stmt.as<Compound>().body) self(self, *s);
+				break;
+			case Stmt::Kind::Assign:
+				if (variable(stmt.as<Assign>().target.name).aggregate < 0) written.insert(stmt.as<Assign>().target.name);
+				break;
+			case Stmt::Kind::If:
+				self(self, *stmt.as<If>().then_branch);
+				if (stmt.as<If>().else_branch) self(self, *stmt.as<If>().else_branch);
+				break;
+			case Stmt::Kind::While:
+				self(self, *stmt.as<While>().body);
+				break;
+			case Stmt::Kind::For:
+				written.insert(stmt.as<For>().var);
+				self(self, *stmt.as<For>().body);
+				break;
+			case Stmt::Kind::Case:
+				for (const auto& arm : stmt.as<Case>().arms) self(self, *arm.body);
+				if (stmt.as<Case>().else_branch) self(self, *stmt.as<Case>().else_branch);
+				break;
+			default:
+				break;
+		}
+	};
+	scalars(scalars, *loop.body);
+	for (const auto& name : written)
+		if (std::none_of(loop.reductions.begin(), loop.reductions.end(), [&](const For::Reduction& r) { return r.var == name; }))
+			res.privates.push_back(place(name));
+
+	for (const auto& [aggregate, other] : loop.disjoint) {
+		const auto& symbol = variable(other);
+		res.disjoint.push_back({variable(aggregate).slot, symbol.slot, symbol.aggregate < 0});
+	}
+	chunk.parallels.push_back(std::move(res));
+	return static_cast<int32_t>(chunk.parallels.size() - 1);
+}
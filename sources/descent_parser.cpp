@@ -0,0 +1,555 @@
+#include "descent_parser.h"
+#include <algorithm>
+#include <charconv>
+
+using namespace ast;
+
+bool DescentParser::accept(TokenKind kind) {
+	if (!at(kind)) return false;
+	advance();
+	return true;
+}
+
+Lexeme DescentParser::expect(TokenKind kind, const char* what) {
+	if (!at(kind)) fail(std::string("expected ") + what);
+	const auto res = current;
+	advance();
+	return res;
+}
+
+void DescentParser::fail(const std::string& msg) const {
+	throw parse_error(__FILE__, typeid(*this).name(), __LINE__,
+					  "line " + std::to_string(current.line) + ": " + msg + " at '" + std::string(current.text) + "'");
+}
+
+template<typename T> T DescentParser::number(const Lexeme& token) const {
+	T res{};
+	const auto [end, ec] = std::from_chars(token.text.data(), token.text.data() + token.text.size(), res);
+	if (ec != std::errc() || end != token.text.data() + token.text.size()) fail("number out of range");
+	return res;
+}
+
+//-------------------------program------------------------------------
+
+std::unique_ptr<Program> DescentParser::parse() {
+	advance();
+	auto res = std::make_unique<Program>();
+	program = res.get();
+	expect(TokenKind::Program, "program");
+	res->name = expect(TokenKind::Identifier, "program name").text;
+	if (accept(TokenKind::LParen)) {
+		do expect(TokenKind::Identifier, "identifier");
+		while (accept(TokenKind::Comma));
+		expect(TokenKind::RParen, "')'");
+	}
+	expect(TokenKind::Semi, "';'");
+	res->body = block(res->decls, true);
+	expect(TokenKind::Dot, "'.'");
+	expect(TokenKind::Eof, "end of file");
+	return res;
+}
+
+// Constants come before variables whatever order the parts are written in, as in the AstBuilder.
+// Only the outer block of the program declares procedures and functions.
+NodePtr<Compound> DescentParser::block(std::vector<Decl>& decls, bool outer) {
+	std::vector<Decl> vars;
+	while (!at(TokenKind::Begin)) {
+		if (accept(TokenKind::Const)) constants(decls);
+		else if (accept(TokenKind::Type)) typeDefinitions();
+		else if (accept(TokenKind::Var)) variables(vars);
+		else if (outer && (at(TokenKind::Procedure) || at(TokenKind::Function))) routine();
+		else fail("unsupported declaration");
+	}
+	for (auto& decl : vars)
+		decls.push_back(std::move(decl));
+	return compoundStatement();
+}
+
+void DescentParser::constants(std::vector<Decl>& decls) {
+	do {
+		std::string name{expect(TokenKind::Identifier, "constant name").text};
+		bool typed = false;
+		DataType type = DataType::Null;
+		if (accept(TokenKind::Colon)) {
+			type = this->type().type;
+			typed = true;
+		}
+		expect(TokenKind::Equal, "'='");
+
+		std::string val;
+		if (at(TokenKind::Plus) || at(TokenKind::Minus)) {
+			val = current.text;
+			advance();
+			if (!at(TokenKind::IntegerConst) && !at(TokenKind::RealConst)) fail("unsupported constant");
+		}
+		const auto kind = current.kind;
+		if (kind != TokenKind::IntegerConst && kind != TokenKind::RealConst && kind != TokenKind::StringConst)
+			fail("unsupported constant");
+		val += current.text;
+		advance();
+		expect(TokenKind::Semi, "';'");
+
+		if (!typed) {
+			if (kind == TokenKind::StringConst) type = DataType::String;
+			else if (kind == TokenKind::RealConst) type = DataType::Double;
+			else type = DataType::Integer;
+		}
+		auto res = Value{type};
+		if (in_group(type, TypeGroup::Numeric)) {
+			res.value.int_ptr = std::stoi(val);
+		}
+		else if (in_group(type, TypeGroup::Real)) {
+			res.value.double_ptr = std::stod(val);
+		}
+		else if (in_group(type, TypeGroup::String)) {
+			res = Value{kind == TokenKind::StringConst ? unquote(val) : val};
+		}
+		else {
+			fail("unknown type");
+		}
+		decls.push_back({std::move(name), type, true, std::move(res)});
+	} while (at(TokenKind::Identifier));
+}
+
+// A type name stands for its definition, all variables of the name share one aggregate
+void DescentParser::typeDefinitions() {
+	do {
+		std::string name{expect(TokenKind::Identifier, "type name").text};
+		expect(TokenKind::Equal, "'='");
+		const auto type = this->type();
+		expect(TokenKind::Semi, "';'");
+		if (!named.emplace(std::move(name), type).second) fail("duplicate type");
+	} while (at(TokenKind::Identifier));
+}
+
+void DescentParser::variables(std::vector<Decl>& decls) {
+	do {
+		std::vector<std::string_view> names;
+		do names.push_back(expect(TokenKind::Identifier, "variable name").text);
+		while (accept(TokenKind::Comma));
+		expect(TokenKind::Colon, "':'");
+		const auto type = this->type();
+		expect(TokenKind::Semi, "';'");
+		for (const auto& name : names)
+			decls.push_back({std::string(name), type.type, false, Value{type.type}, false, type.aggregate});
+	} while (at(TokenKind::Identifier));
+}
+
+// procedure p(a, b: T; var c: U); block; or function f(...): T; block;
+// Types defined by the routine are local to it.
+void DescentParser::routine() {
+	const bool function = at(TokenKind::Function);
+	Routine res;
+	res.source_line = current.line;
+	advance();
+	res.name = expect(TokenKind::Identifier, function ? "function name" : "procedure name").text;
+	if (accept(TokenKind::LParen)) {
+		do {
+			const bool by_ref = accept(TokenKind::Var);
+			std::vector<std::string_view> names;
+			do names.push_back(expect(TokenKind::Identifier, "parameter name").text);
+			while (accept(TokenKind::Comma));
+			expect(TokenKind::Colon, "':'");
+			const auto type = typeIdentifier();
+			for (const auto& name : names)
+				res.params.push_back({std::string(name), type.type, false, Value{type.type}, false, type.aggregate, by_ref});
+		} while (accept(TokenKind::Semi));
+		expect(TokenKind::RParen, "')'");
+	}
+	if (function) {
+		expect(TokenKind::Colon, "':'");
+		const auto type = typeIdentifier();
+		if (type.type == DataType::Reference) fail("unsupported result type");
+		res.result = type.type;
+	}
+	expect(TokenKind::Semi, "';'");
+
+	const auto outer = named;
+	locals = &res.decls;
+	res.body = block(res.decls, false);
+	locals = nullptr;
+	named = outer;
+	expect(TokenKind::Semi, "';'");
+	program->routines.push_back(std::move(res));
+}
+
+TypeRef DescentParser::type() {
+	if (at(TokenKind::Array)) return arrayType();
+	if (at(TokenKind::Record)) return recordType();
+	if (at(TokenKind::Identifier))
+		if (const auto it = named.find(std::string(current.text)); it != named.end()) {
+			advance();
+			return it->second;
+		}
+	switch (current.kind) {
+		case TokenKind::Identifier:
+		case TokenKind::Boolean:
+		case TokenKind::Char:
+		case TokenKind::Integer:
+		case TokenKind::Real:
+		case TokenKind::String:
+			break;
+		default:
+			fail("unsupported type");
+	}
+	const auto type = types.find(std::string(current.text));
+	if (type == types.end()) fail("unsupported type");
+	advance();
+	return {type->second};
+}
+
+// Types of parameters and results are named, as in PascalParser.g4
+TypeRef DescentParser::typeIdentifier() {
+	if (at(TokenKind::Array) || at(TokenKind::Record)) fail("expected type name");
+	return type();
+}
+
+// array[low..high, ...] of T, the bounds of nested array types are joined
+TypeRef DescentParser::arrayType() {
+	AggregateType res{};
+	do {
+		advance();
+		expect(TokenKind::LBrack, "'['");
+		do {
+			const auto low = bound();
+			expect(TokenKind::DotDot, "'..'");
+			res.bounds.push_back({low, bound()});
+		} while (accept(TokenKind::Comma));
+		expect(TokenKind::RBrack, "']'");
+		expect(TokenKind::Of, "of");
+	} while (at(TokenKind::Array));
+	res.element = type();
+	program->types.push_back(std::move(res));
+	return {DataType::Reference, static_cast<int32_t>(program->types.size() - 1)};
+}
+
+// record a, b: T; c: U end, the types of the fields come before the record in the table
+TypeRef DescentParser::recordType() {
+	advance();
+	AggregateType res{};
+	if (!at(TokenKind::End)) {
+		do {
+			std::vector<std::string_view> names;
+			do names.push_back(expect(TokenKind::Identifier, "field name").text);
+			while (accept(TokenKind::Comma));
+			expect(TokenKind::Colon, "':'");
+			const auto type = this->type();
+			for (const auto& name : names)
+				res.fields.push_back({std::string(name), type});
+		} while (accept(TokenKind::Semi));
+	}
+	expect(TokenKind::End, "end");
+	program->types.push_back(std::move(res));
+	return {DataType::Reference, static_cast<int32_t>(program->types.size() - 1)};
+}
+
+// The constant named by the current token, those of a routine hide the program's
+const Decl* DescentParser::constant() const {
+	if (!at(TokenKind::Identifier)) return nullptr;
+	const auto find = [&](const std::vector<Decl>& decls) -> const Decl* {
+		const auto it = std::find_if(decls.begin(), decls.end(), [&](const Decl& decl) {
+			return decl.is_const && decl.name == current.text;
+		});
+		return it == decls.end() ? nullptr : &*it;
+	};
+	const auto* res = locals ? find(*locals) : nullptr;
+	return res ? res : find(program->decls);
+}
+
+// A signed integer or integer constant
+int32_t DescentParser::bound() {
+	const bool negative = at(TokenKind::Minus);
+	if (negative || at(TokenKind::Plus)) advance();
+	int32_t res;
+	if (at(TokenKind::IntegerConst)) {
+		res = number<int32_t>(current);
+	} else {
+		const auto* decl = constant();
+		if (!decl || !in_group(decl->type, TypeGroup::Numeric)) fail("expected array bound");
+		res = decl->value.value.int_ptr;
+	}
+	advance();
+	return negative ? -res : res;
+}
+
+// A signed integer or integer constant, or a character or string constant of one character
+Value DescentParser::label() {
+	const bool negative = at(TokenKind::Minus);
+	const bool sign = negative || at(TokenKind::Plus);
+	if (sign) advance();
+	Value res;
+	if (at(TokenKind::IntegerConst)) {
+		res = Value{number<int32_t>(current)};
+	} else if (at(TokenKind::StringConst) && !sign) {
+		const auto text = unquote(std::string(current.text));
+		if (text.size() != 1) fail("expected case label");
+		res = Value{text[0]};
+	} else {
+		const auto* decl = constant();
+		if (!decl) fail("expected case label");
+		if (in_group(decl->type, TypeGroup::Numeric)) res = Value{decl->value.value.int_ptr};
+		else if (decl->type == DataType::String && !sign && decl->value.str().size() == 1) res = Value{decl->value.str()[0]};
+		else fail("expected case label");
+	}
+	advance();
+	if (negative) res.value.int_ptr = -res.value.int_ptr;
+	return res;
+}
+
+//-------------------------statements------------------------------------
+
+NodePtr<Compound> DescentParser::compoundStatement() {
+	expect(TokenKind::Begin, "begin");
+	auto res = program->make<Compound>();
+	do {
+		if (auto s = statement()) res->body.push_back(std::move(s));
+	} while (accept(TokenKind::Semi));
+	expect(TokenKind::End, "end");
+	return res;
+}
+
+// An empty statement is a nullptr, what follows it is checked by the enclosing rule
+StmtPtr DescentParser::statement() {
+	const auto line = current.line;
+	auto res = unlabelledStatement();
+	if (res) res->source_line = line;
+	return res;
+}
+
+StmtPtr DescentParser::unlabelledStatement() {
+	switch (current.kind) {
+		case TokenKind::Identifier: {
+			std::string name{current.text};
+			advance();
+			if (at(TokenKind::LBrack) || at(TokenKind::Dot)) {
+				Target target{std::move(name), selectors()};
+				expect(TokenKind::Assign, "':='");
+				return program->make<Assign>(std::move(target), expression());
+			}
+			if (accept(TokenKind::Assign))
+				return program->make<Assign>(std::move(name), expression());
+			return procedureStatement(std::move(name));
+		}
+		case TokenKind::Begin:
+			return compoundStatement();
+		case TokenKind::If:
+			return ifStatement();
+		case TokenKind::While:
+			return whileStatement();
+		case TokenKind::Parallel:
+		case TokenKind::For:
+			return forStatement();
+		case TokenKind::Case:
+			return caseStatement();
+		case TokenKind::IntegerConst:
+		case TokenKind::Reserved:
+		case TokenKind::Other:
+			fail("unsupported statement");
+		default:
+			return nullptr;
+	}
+}
+
+StmtPtr DescentParser::procedureStatement(std::string name) {
+	if (name == "Read" || name == "Readln") {
+		auto res = program->make<Read>();
+		res->line = name == "Readln";
+		if (accept(TokenKind::LParen)) {
+			do {
+				std::string target{expect(TokenKind::Identifier, "variable").text};
+				res->targets.emplace_back(std::move(target), selectors());
+			} while (accept(TokenKind::Comma));
+			expect(TokenKind::RParen, "')'");
+		}
+		return res;
+	}
+
+	auto res = program->make<Call>(std::move(name));
+	if (accept(TokenKind::LParen)) {
+		do {
+			res->args.push_back(expression());
+			auto& format = res->formats.emplace_back();
+			if (accept(TokenKind::Colon)) format.width = expression();
+			if (accept(TokenKind::Colon)) format.decimals = expression();
+			if (at(TokenKind::Colon)) fail("too many format specifiers");
+		} while (accept(TokenKind::Comma));
+		expect(TokenKind::RParen, "')'");
+	}
+	return res;
+}
+
+StmtPtr DescentParser::ifStatement() {
+	advance();
+	auto cond = expression();
+	expect(TokenKind::Then, "then");
+	auto then_branch = statement();
+	auto else_branch = accept(TokenKind::Else) ? statement() : nullptr;
+	return program->make<If>(std::move(cond), std::move(then_branch), std::move(else_branch));
+}
+
+StmtPtr DescentParser::whileStatement() {
+	advance();
+	auto cond = expression();
+	expect(TokenKind::Do, "do");
+	return program->make<While>(std::move(cond), statement());
+}
+
+StmtPtr DescentParser::forStatement() {
+	const bool parallel = accept(TokenKind::Parallel);
+	expect(TokenKind::For, "for");
+	std::string var{expect(TokenKind::Identifier, "loop variable").text};
+	expect(TokenKind::Assign, "':='");
+	auto from = expression();
+	bool down;
+	if (accept(TokenKind::To)) down = false;
+	else if (accept(TokenKind::Downto)) down = true;
+	else fail("expected to or downto");
+	auto to = expression();
+	expect(TokenKind::Do, "do");
+	auto res = program->make<For>(std::move(var), std::move(from), std::move(to), down, statement());
+	res->parallel = parallel;
+	return res;
+}
+
+// case e of 1, 3..5: s; 'a': t; else u; v end, a ';' may come before the else part and the end.
+// An empty arm does nothing.
+StmtPtr DescentParser::caseStatement() {
+	advance();
+	auto res = program->make<Case>(expression());
+	expect(TokenKind::Of, "of");
+	do {
+		auto& arm = res->arms.emplace_back();
+		do {
+			auto low = label();
+			auto high = accept(TokenKind::DotDot) ? label() : low;
+			arm.labels.push_back({std::move(low), std::move(high)});
+		} while (accept(TokenKind::Comma));
+		expect(TokenKind::Colon, "':'");
+		arm.body = statement();
+		if (!arm.body) arm.body = program->make<Compound>();
+	} while (accept(TokenKind::Semi) && !at(TokenKind::Else) && !at(TokenKind::End));
+	if (accept(TokenKind::Else)) {
+		auto other = program->make<Compound>();
+		do {
+			if (auto s = statement()) other->body.push_back(std::move(s));
+		} while (accept(TokenKind::Semi));
+		res->else_branch = std::move(other);
+	}
+	expect(TokenKind::End, "end");
+	return res;
+}
+
+//-------------------------expressions------------------------------------
+
+// The grammar makes every binary level right recursive, so a - b - c is a - (b - c)
+// here exactly as in the AstBuilder
+
+ExprPtr DescentParser::expression() {
+	auto lhs = simpleExpression();
+	Operator op;
+	switch (current.kind) {
+		case TokenKind::Equal: op = Operator::Eq; break;
+		case TokenKind::NotEqual: op = Operator::Ne; break;
+		case TokenKind::Lt: op = Operator::Lt; break;
+		case TokenKind::Le: op = Operator::Le; break;
+		case TokenKind::Ge: op = Operator::Ge; break;
+		case TokenKind::Gt: op = Operator::Gt; break;
+		default: return lhs;
+	}
+	advance();
+	return program->make<Binary>(op, std::move(lhs), expression());
+}
+
+ExprPtr DescentParser::simpleExpression() {
+	auto lhs = term();
+	Operator op;
+	switch (current.kind) {
+		case TokenKind::Plus: op = Operator::Add; break;
+		case TokenKind::Minus: op = Operator::Sub; break;
+		case TokenKind::Or: op = Operator::Or; break;
+		default: return lhs;
+	}
+	advance();
+	return program->make<Binary>(op, std::move(lhs), simpleExpression());
+}
+
+//----------------------------terms------------------------------------
+
+ExprPtr DescentParser::term() {
+	auto lhs = signedFactor();
+	Operator op;
+	switch (current.kind) {
+		case TokenKind::Star: op = Operator::Mul; break;
+		case TokenKind::Slash: op = Operator::Div; break;
+		case TokenKind::Div: op = Operator::IntDiv; break;
+		case TokenKind::Mod: op = Operator::Mod; break;
+		case TokenKind::And: op = Operator::And; break;
+		default: return lhs;
+	}
+	advance();
+	return program->make<Binary>(op, std::move(lhs), term());
+}
+
+ExprPtr DescentParser::signedFactor() {
+	if (accept(TokenKind::Minus)) return program->make<Unary>(Operator::Neg, factor());
+	accept(TokenKind::Plus);
+	return factor();
+}
+
+ExprPtr DescentParser::factor() {
+	const auto token = current;
+	switch (token.kind) {
+		case TokenKind::LParen: {
+			advance();
+			auto res = expression();
+			expect(TokenKind::RParen, "')'");
+			return res;
+		}
+		case TokenKind::Not:
+			advance();
+			return program->make<Unary>(Operator::Not, factor());
+		case TokenKind::Identifier:
+			advance();
+			if (accept(TokenKind::LParen)) {
+				std::vector<ExprPtr> args;
+				do args.push_back(expression());
+				while (accept(TokenKind::Comma));
+				expect(TokenKind::RParen, "')'");
+				return program->make<FunctionCall>(std::string(token.text), std::move(args));
+			}
+			if (at(TokenKind::LBrack) || at(TokenKind::Dot)) return program->make<Element>(std::string(token.text), selectors());
+			return program->make<Variable>(std::string(token.text));
+		case TokenKind::IntegerConst:
+			advance();
+			return program->make<Literal>(Value{number<int>(token)});
+		case TokenKind::RealConst:
+			advance();
+			return program->make<Literal>(Value{number<double>(token)});
+		case TokenKind::StringConst:
+			advance();
+			return program->make<Literal>(Value{unquote(token.text)});
+		case TokenKind::True:
+		case TokenKind::False:
+			advance();
+			return program->make<Literal>(Value{token.kind == TokenKind::True});
+		default:
+			fail("unsupported expression");
+	}
+}
+
+// a[i, j] and a[i][j] are the same element, consecutive index lists join
+std::vector<Selector> DescentParser::selectors() {
+	std::vector<Selector> res;
+	while (at(TokenKind::LBrack) || at(TokenKind::Dot)) {
+		if (accept(TokenKind::Dot)) {
+			res.push_back({{}, std::string(expect(TokenKind::Identifier, "field name").text)});
+			continue;
+		}
+		advance();
+		if (res.empty() || !res.back().field.empty()) res.emplace_back();
+		do res.back().indices.push_back(expression());
+		while (accept(TokenKind::Comma));
+		expect(TokenKind::RBrack, "']'");
+	}
+	return res;
+}
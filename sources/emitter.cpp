@@ -0,0 +1,686 @@
+#include "emitter.h"
+#include "checker.h"
+#include "exceptions.h"
+#include <cmath>
+#include <cstdio>
+
+using namespace ast;
+
+namespace {
+
+// Runtime support of the generated code, mirrors Value and the VM builtins
+const char* prelude = R"(#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* reference counted string, NULL is the empty string. A shared one is immutable,
+   pas_append grows one its variable holds the only reference to in place */
+typedef struct pas_string {
+	unsigned refs;
+	unsigned size;
+	unsigned capacity;
+	char data[];
+} pas_string;
+
+static const char* pas_error;
+
+#define PAS_CHECK if (pas_error) goto pas_end
+#define PAS_ADD(a, b) ((int)((unsigned)(a) + (unsigned)(b)))
+#define PAS_SUB(a, b) ((int)((unsigned)(a) - (unsigned)(b)))
+#define PAS_MUL(a, b) ((int)((unsigned)(a) * (unsigned)(b)))
+#define PAS_NEG(a) ((int)(0u - (unsigned)(a)))
+
+static pas_string* pas_str_make(const char* lhs, size_t lsize, const char* rhs, size_t rsize, size_t capacity) {
+	pas_string* str;
+	if (capacity < lsize + rsize) capacity = lsize + rsize;
+	if (capacity == 0) return NULL;
+	str = (pas_string*)malloc(sizeof(pas_string) + capacity);
+	if (!str) abort();
+	str->refs = 1;
+	str->size = (unsigned)(lsize + rsize);
+	str->capacity = (unsigned)capacity;
+	if (lsize) memcpy(str->data, lhs, lsize);
+	if (rsize) memcpy(str->data + lsize, rhs, rsize);
+	return str;
+}
+
+static pas_string* pas_str_new(const char* lhs, size_t lsize, const char* rhs, size_t rsize) {
+	return pas_str_make(lhs, lsize, rhs, rsize, 0);
+}
+
+static pas_string* pas_str_ref(pas_string* str) {
+	if (str) ++str->refs;
+	return str;
+}
+
+static void pas_str_release(pas_string* str) {
+	if (str && --str->refs == 0) free(str);
+}
+
+static void pas_str_set(pas_string** var, pas_string* val) {
+	pas_str_release(*var);
+	*var = val;
+}
+
+/* string operations consume their arguments */
+static pas_string* pas_concat(pas_string* lhs, pas_string* rhs) {
+	pas_string* res = pas_str_new(lhs ? lhs->data : "", lhs ? lhs->size : 0, rhs ? rhs->data : "", rhs ? rhs->size : 0);
+	pas_str_release(lhs);
+	pas_str_release(rhs);
+	return res;
+}
+
+/* var := var + tail, a payload that grows in place at least doubles */
+static void pas_append(pas_string** var, pas_string* tail) {
+	pas_string* str = *var;
+	const unsigned size = str ? str->size : 0, tsize = tail ? tail->size : 0;
+	if (tsize && str && str->refs == 1 && tsize <= str->capacity - size) {
+		memcpy(str->data + size, tail->data, tsize);
+		str->size += tsize;
+	} else if (tsize) {
+		*var = pas_str_make(str ? str->data : "", size, tail->data, tsize, str && str->refs == 1 ? 2 * ((size_t)size + tsize) : 0);
+		pas_str_release(str);
+	}
+	pas_str_release(tail);
+}
+
+static int pas_length(pas_string* str) {
+	const int res = str ? (int)str->size : 0;
+	pas_str_release(str);
+	return res;
+}
+
+/* Copy(str, index, count) clamped to the string */
+static pas_string* pas_copy(pas_string* str, int index, int count) {
+	const size_t size = str ? str->size : 0, from = index < 1 ? 0 : (size_t)index - 1;
+	pas_string* res = NULL;
+	if (count > 0 && from < size)
+		res = pas_str_new(str->data + from, (size_t)count < size - from ? (size_t)count : size - from, "", 0);
+	pas_str_release(str);
+	return res;
+}
+
+/* Pos(part, str), 0 when part is empty or not found */
+static int pas_pos(pas_string* part, pas_string* str) {
+	int res = 0;
+	if (part && str && part->size <= str->size) {
+		unsigned i;
+		for (i = 0; i + part->size <= str->size; ++i)
+			if (memcmp(str->data + i, part->data, part->size) == 0) {
+				res = (int)i + 1;
+				break;
+			}
+	}
+	pas_str_release(part);
+	pas_str_release(str);
+	return res;
+}
+
+static int pas_compare(pas_string* lhs, pas_string* rhs) {
+	unsigned lsize = lhs ? lhs->size : 0, rsize = rhs ? rhs->size : 0;
+	int res = memcmp(lhs ? lhs->data : "", rhs ? rhs->data : "", lsize < rsize ? lsize : rsize);
+	if (res == 0) res = lsize < rsize ? -1 : (lsize > rsize ? 1 : 0);
+	pas_str_release(lhs);
+	pas_str_release(rhs);
+	return res;
+}
+
+static int pas_idiv(int lhs, int rhs) {
+	if (rhs == 0) { pas_error = "Division by zero"; return 0; }
+	if (rhs == -1) return PAS_NEG(lhs);
+	return lhs / rhs;
+}
+
+static int pas_mod(int lhs, int rhs) {
+	if (rhs == 0) { pas_error = "Division by zero"; return 0; }
+	if (rhs == -1) return 0;
+	return lhs % rhs;
+}
+
+static double pas_div(double lhs, double rhs) {
+	if (rhs == 0) { pas_error = "Division by zero"; return 0; }
+	return lhs / rhs;
+}
+
+static void pas_print(pas_string* str) {
+	if (str && str->size) fwrite(str->data, 1, str->size, stdout);
+}
+
+static void pas_pad(int count) {
+	for (; count > 0; --count) putchar(' ');
+}
+
+/* the formats are checked before anything is printed, the bound is Output::max_field */
+static void pas_field(int width, int decimals) {
+	if (!pas_error && (width < -65536 || width > 65536 || decimals > 65536)) pas_error = "Field width out of range";
+}
+
+/* value:width:decimals, a negative width left aligns and decimals < 0 means not given */
+static void pas_write_int(int val, int width) { printf("%*d ", width, val); }
+static void pas_write_real(double val, int width, int decimals) {
+	if (decimals < 0) printf("%*g ", width, val);
+	else printf("%*.*f ", width, decimals, val);
+}
+static void pas_write_bool(int val, int width) { printf("%*s ", width, val ? "TRUE" : "FALSE"); }
+static void pas_write_char(char val, int width) { printf("%*c ", width, val); }
+static void pas_write_str(pas_string* val, int width) {
+	const int size = val ? (int)val->size : 0;
+	pas_pad(width - size);
+	pas_print(val);
+	pas_pad(-width - size);
+	putchar(' ');
+	pas_str_release(val);
+}
+
+/* Pascal style input, the same as the VM: numbers are separated by any
+   whitespace, a string takes the rest of the line and Readln skips past it */
+static char* pas_input;
+static size_t pas_input_capacity;
+
+static int pas_is_space(int c) {
+	return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static void pas_input_push(size_t size, char c) {
+	if (size >= pas_input_capacity) {
+		pas_input_capacity = pas_input_capacity ? pas_input_capacity * 2 : 64;
+		pas_input = (char*)realloc(pas_input, pas_input_capacity);
+		if (!pas_input) abort();
+	}
+	pas_input[size] = c;
+}
+
+static char* pas_read_token(int line, size_t* size) {
+	int c = getchar();
+	*size = 0;
+	if (!line)
+		while (c != EOF && pas_is_space(c)) c = getchar();
+	while (c != EOF && (line ? c != '\n' : !pas_is_space(c))) {
+		pas_input_push((*size)++, (char)c);
+		c = getchar();
+	}
+	if (c != EOF) ungetc(c, stdin);
+	pas_input_push(*size, '\0');
+	return pas_input;
+}
+
+static void pas_read_skip_line(void) {
+	int c;
+	while ((c = getchar()) != EOF && c != '\n') {}
+}
+
+static void pas_invalid_input(const char* what, const char* token) {
+	static char* message;
+	free(message);
+	message = (char*)malloc(strlen(what) + strlen(token) + sizeof("Invalid  input: "));
+	if (!message) abort();
+	sprintf(message, "Invalid %s input: %s", what, token);
+	pas_error = message;
+}
+
+static int pas_read_int(int* var) {
+	size_t size;
+	char* token;
+	char* end;
+	long val;
+	fflush(stdout);
+	token = pas_read_token(0, &size);
+	if (!size) { pas_error = "Unexpected end of input"; return 0; }
+	errno = 0;
+	val = strtol(token, &end, 10);
+	if (end != token + size || errno == ERANGE || val < INT_MIN || val > INT_MAX) {
+		pas_invalid_input("integer", token);
+		return 0;
+	}
+	*var = (int)val;
+	return 1;
+}
+
+static int pas_read_real(double* var) {
+	size_t size;
+	char* token;
+	char* end;
+	double val;
+	fflush(stdout);
+	token = pas_read_token(0, &size);
+	if (!size) { pas_error = "Unexpected end of input"; return 0; }
+	errno = 0;
+	val = strtod(token, &end);
+	if (end != token + size || errno == ERANGE || strpbrk(token, "xX")) {
+		pas_invalid_input("real", token);
+		return 0;
+	}
+	*var = val;
+	return 1;
+}
+
+static int pas_read_str(pas_string** var) {
+	size_t size;
+	char* token;
+	fflush(stdout);
+	token = pas_read_token(1, &size);
+	pas_str_set(var, pas_str_new(token, size, "", 0));
+	return 1;
+}
+
+)";
+
+}
+
+std::ostream& CEmitter::line() {
+	for (int i = 0; i < depth; ++i) body << '\t';
+	return body;
+}
+
+std::string CEmitter::temporary() {
+	return "e" + std::to_string(temporaries++);
+}
+
+const Decl& CEmitter::variable(const std::string& identifier) {
+	const auto it = symbols.find(identifier);
+	if (it == symbols.end())
+		throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Undeclared identifier: " + identifier);
+	return *it->second;
+}
+
+std::string CEmitter::identifier(const Decl& decl) {
+	if (decl.hidden) return "t_" + decl.name.substr(1); // "$N"
+	return "v_" + decl.name;
+}
+
+std::string CEmitter::c_type(DataType type) {
+	switch (TypeChecker::canonical(type)) {
+		case DataType::Integer: return "int";
+		case DataType::Double: return "double";
+		case DataType::Boolean: return "int";
+		case DataType::Char: return "char";
+		case DataType::String: return "pas_string*";
+		default: throw std::runtime_error("Unsupported type");
+	}
+}
+
+std::string CEmitter::quote(std::string_view str) {
+	std::string res = "\"";
+	for (const unsigned char c : str) {
+		if (c == '"' || c == '\\') {
+			res += '\\';
+			res += static_cast<char>(c);
+		} else if (c < 0x20 || c >= 0x7F || c == '?') {
+			char buf[8];
+			std::snprintf(buf, sizeof(buf), "\\%03o", c);
+			res += buf;
+		} else res += static_cast<char>(c);
+	}
+	return res + "\"";
+}
+
+std::string CEmitter::literal(const Value& val) {
+	switch (TypeChecker::canonical(val.type())) {
+		case DataType::Integer:
+			if (val.value.int_ptr == INT32_MIN) return "(-2147483647 - 1)";
+			return std::to_string(val.value.int_ptr);
+		case DataType::Double: {
+			const auto v = val.value.double_ptr;
+			if (std::isnan(v)) return "NAN";
+			if (std::isinf(v)) return v < 0 ? "(-HUGE_VAL)" : "HUGE_VAL";
+			char buf[32];
+			std::snprintf(buf, sizeof(buf), "%.17g", v);
+			std::string res = buf;
+			if (res.find_first_of(".e") == std::string::npos) res += ".0";
+			return res;
+		}
+		case DataType::Boolean:
+			return val.value.bool_ptr ? "1" : "0";
+		case DataType::Char:
+			return "((char)" + std::to_string(static_cast<unsigned char>(val.value.char_ptr)) + ")";
+		case DataType::String:
+			literals.emplace_back(val.str());
+			return "pas_str_ref(lit" + std::to_string(literals.size() - 1) + ")";
+		default:
+			throw std::runtime_error("Unsupported type");
+	}
+}
+
+std::string CEmitter::emit(const ast::Program& program, bool dump) {
+	body.str({});
+	symbols.clear();
+	literals.clear();
+	temporaries = 0;
+	depth = 1;
+
+	if (!program.types.empty())
+		throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Not supported by the C backend: arrays and records");
+	if (!program.routines.empty())
+		throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Not supported by the C backend: procedures and functions");
+	for (const auto& decl : program.decls)
+		if (!symbols.emplace(decl.name, &decl).second)
+			throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Duplicate identifier: " + decl.name);
+	statement(*program.body);
+
+	std::ostringstream out;
+	out << "/* " << program.name << " */\n" << prelude;
+	out << "int main(void) {\n";
+	for (size_t i = 0; i < literals.size(); ++i)
+		out << "\tpas_string* lit" << i << " = pas_str_new(" << quote(literals[i]) << ", " << literals[i].size() << ", \"\", 0);\n";
+	for (const auto& decl : program.decls) {
+		out << '\t' << c_type(decl.type) << ' ' << identifier(decl) << " = ";
+		if (decl.type == DataType::String)
+			out << (decl.value.str().empty() ? "NULL" : "pas_str_new(" + quote(decl.value.str()) + ", "
+				+ std::to_string(decl.value.str().size()) + ", \"\", 0)");
+		else out << literal(decl.value);
+		out << ";\n";
+	}
+	out << "\tstatic char buffer[1 << 16];\n";
+	out << "\tsetvbuf(stdout, buffer, _IOFBF, sizeof(buffer));\n\n";
+	out << body.str();
+	out << "pas_end:\n";
+	out << "\tfflush(stdout);\n";
+	out << "\tif (pas_error) fprintf(stderr, \"%s\\n\", pas_error);\n";
+	if (dump) {
+		out << "\tputs(\"================Dumping variables================\");\n";
+		for (const auto& [name, decl] : symbols) {
+			if (decl->hidden) continue;
+			const auto prefix = quote((decl->is_const ? "const " : "") + name + " = ");
+			const auto var = identifier(*decl);
+			switch (TypeChecker::canonical(decl->type)) {
+				case DataType::Integer: out << "\tprintf(" << prefix.substr(0, prefix.size() - 1) << "%d\\n\", " << var << ");\n"; break;
+				case DataType::Double: out << "\tprintf(" << prefix.substr(0, prefix.size() - 1) << "%g\\n\", " << var << ");\n"; break;
+				case DataType::Boolean: out << "\tprintf(" << prefix.substr(0, prefix.size() - 1) << "%s\\n\", " << var << " ? \"TRUE\" : \"FALSE\");\n"; break;
+				case DataType::Char: out << "\tprintf(" << prefix.substr(0, prefix.size() - 1) << "%c\\n\", " << var << ");\n"; break;
+				default: out << "\tfputs(" << prefix << ", stdout);\n\tpas_print(" << var << ");\n\tputchar('\\n');\n"; break;
+			}
+		}
+	}
+	for (size_t i = 0; i < literals.size(); ++i)
+		out << "\tpas_str_release(lit" << i << ");\n";
+	for (const auto& decl : program.decls)
+		if (decl.type == DataType::String)
+			out << "\tpas_str_release(" << identifier(decl) << ");\n";
+	out << "\tfflush(stdout);\n";
+	out << "\treturn pas_error ? 1 : 0;\n}\n";
+	return out.str();
+}
+
+//-------------------------statements------------------------------------
+
+// Runtime errors leave the statement before any of its effects, as the VM does
+std::string CEmitter::evaluate(const Expr& expr) {
+	if (!fallible(expr)) return expression(expr);
+	const auto tmp = temporary();
+	line() << c_type(expr.type) << ' ' << tmp << " = " << expression(expr) << ";\n";
+	line() << "PAS_CHECK;\n";
+	return tmp;
+}
+
+void CEmitter::nested(const Stmt& stmt) {
+	++depth;
+	statement(stmt);
+	--depth;
+}
+
+void CEmitter::statement(const Stmt& stmt) {
+	switch (stmt.kind) {
+		case Stmt::Kind::Compound:
+			for (const auto& s : stmt.as<Compound>().body)
+				statement(*s);
+			break;
+		case Stmt::Kind::Assign: {
+			const auto& assign = stmt.as<Assign>();
+			const auto& var = variable(assign.target.name);
+			const bool block = fallible(*assign.value);
+			if (block) {
+				line() << "{\n";
+				++depth;
+			}
+			const auto& value = *assign.value;
+			// s := s + x appends to s where it is
+			const bool append = var.type == DataType::String && value.kind == Expr::Kind::Binary && value.as<Binary>().op == Operator::Add
+				&& value.as<Binary>().lhs->kind == Expr::Kind::Variable && value.as<Binary>().lhs->as<Variable>().name == var.name;
+			const auto val = evaluate(append ? *value.as<Binary>().rhs : value);
+			if (append)
+				line() << "pas_append(&" << identifier(var) << ", " << val << ");\n";
+			else if (var.type == DataType::String)
+				line() << "pas_str_set(&" << identifier(var) << ", " << val << ");\n";
+			else line() << identifier(var) << " = " << val << ";\n";
+			if (block) {
+				--depth;
+				line() << "}\n";
+			}
+			break;
+		}
+		case Stmt::Kind::Call: {
+			const auto& call = stmt.as<Call>();
+			if (call.name != "Writeln" && call.name != "Write")
+				throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Not supported by the C backend: " + call.name);
+			line() << "{\n";
+			++depth;
+			// every argument and format is evaluated before anything is printed
+			std::vector<std::string> args, widths, decimals;
+			bool check = false;
+			const auto value = [&](const Expr* expr, const char* absent) {
+				if (!expr) return std::string(absent);
+				const auto tmp = temporary();
+				line() << c_type(expr->type) << ' ' << tmp << " = " << expression(*expr) << ";\n";
+				check = check || fallible(*expr);
+				return tmp;
+			};
+			for (size_t i = 0; i < call.args.size(); ++i) {
+				const auto* format = i < call.formats.size() ? &call.formats[i] : nullptr;
+				args.push_back(value(call.args[i].get(), ""));
+				widths.push_back(value(format ? format->width.get() : nullptr, "0"));
+				decimals.push_back(value(format ? format->decimals.get() : nullptr, "-1"));
+				if (format) {
+					line() << "pas_field(" << widths.back() << ", " << decimals.back() << ");\n";
+					check = true;
+				}
+			}
+			if (check) line() << "PAS_CHECK;\n";
+			for (size_t i = 0; i < args.size(); ++i) {
+				switch (call.args[i]->type) {
+					case DataType::Integer: line() << "pas_write_int(" << args[i] << ", " << widths[i] << ");\n"; break;
+					case DataType::Double: line() << "pas_write_real(" << args[i] << ", " << widths[i] << ", " << decimals[i] << ");\n"; break;
+					case DataType::Boolean: line() << "pas_write_bool(" << args[i] << ", " << widths[i] << ");\n"; break;
+					case DataType::Char: line() << "pas_write_char(" << args[i] << ", " << widths[i] << ");\n"; break;
+					default: line() << "pas_write_str(" << args[i] << ", " << widths[i] << ");\n"; break;
+				}
+			}
+			if (call.name == "Writeln") line() << "putchar('\\n');\n";
+			--depth;
+			line() << "}\n";
+			break;
+		}
+		case Stmt::Kind::Read:
+			for (const auto& target : stmt.as<Read>().targets) {
+				const auto& var = variable(target.name);
+				const auto type = TypeChecker::canonical(var.type);
+				const char* fn = type == DataType::Integer ? "pas_read_int" : type == DataType::Double ? "pas_read_real" : "pas_read_str";
+				line() << "if (!" << fn << "(&" << identifier(var) << ")) goto pas_end;\n";
+			}
+			if (stmt.as<Read>().line) line() << "pas_read_skip_line();\n";
+			break;
+		case Stmt::Kind::If: {
+			const auto& branch = stmt.as<If>();
+			const bool block = fallible(*branch.cond);
+			if (block) {
+				line() << "{\n";
+				++depth;
+			}
+			const auto cond = evaluate(*branch.cond);
+			line() << "if (" << cond << ") {\n";
+			nested(*branch.then_branch);
+			if (branch.else_branch) {
+				line() << "} else {\n";
+				nested(*branch.else_branch);
+			}
+			line() << "}\n";
+			if (block) {
+				--depth;
+				line() << "}\n";
+			}
+			break;
+		}
+		case Stmt::Kind::While: {
+			const auto& loop = stmt.as<While>();
+			if (!fallible(*loop.cond)) {
+				line() << "while (" << expression(*loop.cond) << ") {\n";
+				nested(*loop.body);
+				line() << "}\n";
+				break;
+			}
+			line() << "for (;;) {\n";
+			++depth;
+			const auto cond = evaluate(*loop.cond);
+			line() << "if (!" << cond << ") break;\n";
+			statement(*loop.body);
+			--depth;
+			line() << "}\n";
+			break;
+		}
+		case Stmt::Kind::For: {
+			const auto& loop = stmt.as<For>();
+			const auto var = identifier(variable(loop.var));
+			line() << "{\n";
+			++depth;
+			const auto from = evaluate(*loop.from);
+			line() << var << " = " << from << ";\n";
+			const auto to = evaluate(*loop.to);
+			const auto limit = temporary();
+			line() << "const int " << limit << " = " << to << ";\n";
+			// the limit is tested before the step, which wraps after the last iteration as in the VM
+			line() << "while (" << var << (loop.down ? " >= " : " <= ") << limit << ") {\n";
+			nested(*loop.body);
+			++depth;
+			const auto last = temporary();
+			line() << "const int " << last << " = " << var << (loop.down ? " <= " : " >= ") << limit << ";\n";
+			line() << var << " = " << (loop.down ? "PAS_SUB(" : "PAS_ADD(") << var << ", 1);\n";
+			line() << "if (" << last << ") break;\n";
+			--depth;
+			line() << "}\n";
+			--depth;
+			line() << "}\n";
+			break;
+		}
+		// the C compiler picks the dispatch of the chain of compares
+		case Stmt::Kind::Case: {
+			const auto& branch = stmt.as<Case>();
+			line() << "{\n";
+			++depth;
+			const auto selector = evaluate(*branch.selector);
+			const auto value = temporary();
+			if (branch.selector->type == DataType::Char) line() << "const int " << value << " = (unsigned char)" << selector << ";\n";
+			else line() << "const int " << value << " = " << selector << ";\n";
+			for (size_t i = 0; i < branch.arms.size(); ++i) {
+				std::string cond;
+				for (const auto& label : branch.arms[i].labels) {
+					const auto low = Case::ordinal(label.low), high = Case::ordinal(label.high);
+					if (!cond.empty()) cond += " || ";
+					if (low == high) cond += value + " == " + std::to_string(low);
+					else cond += "(" + value + " >= " + std::to_string(low) + " && " + value + " <= " + std::to_string(high) + ")";
+				}
+				line() << (i ? "} else if (" : "if (") << cond << ") {\n";
+				nested(*branch.arms[i].body);
+			}
+			if (branch.else_branch) {
+				line() << "} else {\n";
+				nested(*branch.else_branch);
+			}
+			line() << "}\n";
+			--depth;
+			line() << "}\n";
+			break;
+		}
+	}
+}
+
+//-------------------------expressions------------------------------------
+
+bool CEmitter::fallible(const Expr& expr) {
+	switch (expr.kind) {
+		case Expr::Kind::Unary:
+			return fallible(*expr.as<Unary>().operand);
+		case Expr::Kind::Binary: {
+			const auto& binary = expr.as<Binary>();
+			if (binary.op == Operator::Div || binary.op == Operator::IntDiv || binary.op == Operator::Mod) return true;
+			return fallible(*binary.lhs) || fallible(*binary.rhs);
+		}
+		default:
+			return false;
+	}
+}
+
+std::string CEmitter::expression(const Expr& expr) {
+	switch (expr.kind) {
+		case Expr::Kind::Literal:
+			return literal(expr.as<Literal>().value);
+		case Expr::Kind::Variable: {
+			const auto var = identifier(variable(expr.as<Variable>().name));
+			return expr.type == DataType::String ? "pas_str_ref(" + var + ")" : var;
+		}
+		case Expr::Kind::Unary: {
+			const auto& unary = expr.as<Unary>();
+			const auto operand = expression(*unary.operand);
+			switch (unary.op) {
+				case Operator::Neg:
+					return unary.type == DataType::Double ? "(-(" + operand + "))" : "PAS_NEG(" + operand + ")";
+				case Operator::Not: return "(!" + operand + ")";
+				case Operator::ToReal: return "((double)" + operand + ")";
+				default: break;
+			}
+			break;
+		}
+		case Expr::Kind::Binary: {
+			const auto& binary = expr.as<Binary>();
+			const auto type = binary.lhs->type;
+			const auto lhs = expression(*binary.lhs);
+			const auto rhs = expression(*binary.rhs);
+			const auto infix = [&](const char* op) { return "(" + lhs + " " + op + " " + rhs + ")"; };
+			const auto call = [&](const char* fn) { return std::string(fn) + "(" + lhs + ", " + rhs + ")"; };
+			const auto compare = [&](const char* op) {
+				if (type == DataType::String) return "(pas_compare(" + lhs + ", " + rhs + ") " + op + " 0)";
+				if (type == DataType::Char) return "((unsigned char)" + lhs + " " + op + " (unsigned char)" + rhs + ")";
+				return infix(op);
+			};
+			const bool integer = type == DataType::Integer;
+			switch (binary.op) {
+				case Operator::Add:
+					if (type == DataType::String) return call("pas_concat");
+					return integer ? call("PAS_ADD") : infix("+");
+				case Operator::Sub: return integer ? call("PAS_SUB") : infix("-");
+				case Operator::Mul: return integer ? call("PAS_MUL") : infix("*");
+				case Operator::Div: return call("pas_div");
+				case Operator::IntDiv: return call("pas_idiv");
+				case Operator::Mod: return call("pas_mod");
+				// both sides are evaluated, like the VM does
+				case Operator::And: return infix("&");
+				case Operator::Or: return infix("|");
+				case Operator::Eq: return compare("==");
+				case Operator::Ne: return compare("!=");
+				case Operator::Lt: return compare("<");
+				case Operator::Le: return compare("<=");
+				case Operator::Ge: return compare(">=");
+				case Operator::Gt: return compare(">");
+				default: break;
+			}
+			break;
+		}
+		case Expr::Kind::Call: { // routines are rejected by emit
+			const auto& call = expr.as<FunctionCall>();
+			std::string args;
+			for (const auto& arg : call.args)
+				args += (args.empty() ? "" : ", ") + expression(*arg);
+			switch (call.builtin) {
+				case Builtin::Length: return "pas_length(" + args + ")";
+				case Builtin::Copy: return "pas_copy(" + args + ")";
+				case Builtin::Pos: return "pas_pos(" + args + ")";
+				default: break;
+			}
+			break;
+		}
+		case Expr::Kind::Element: // arrays are rejected by emit
+			break;
+	}
+	throw std::runtime_error("Unsupported expression");
+}
@@ -6,7 +6,7 @@ base_exception::base_exception(const string &fileName, const string &className,
 			   + "Line: " + to_string(numLine) + "\n"
 			   + "Error: " + erInfo + "\n") {}
 
-char const *base_exception::what() const { return info.c_str(); }
+char const *base_exception::what() const noexcept { return info.c_str(); }
 
 
 invalid_size::invalid_size(const string &fileName, const string &className, int numLine, const string &erInfo)
@@ -23,3 +23,6 @@ key_error::key_error(const string &fileName, const string &className, int numLin
 
 parse_error::parse_error(const string &fileName, const string &className, int numLine, const string &erInfo)
 		: base_exception(fileName, className, numLine, erInfo) {}
+
+type_error::type_error(const string &fileName, const string &className, int numLine, const string &erInfo)
+		: base_exception(fileName, className, numLine, erInfo) {}
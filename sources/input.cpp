@@ -0,0 +1,124 @@
+#include "input.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+bool is_space(char c) {
+	return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+template<typename T> T parse(std::string_view text, const char* what) {
+	T res{};
+	auto digits = text;
+	if (digits.size() > 1 && digits[0] == '+') digits.remove_prefix(1);
+	const auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), res);
+	if (ec != std::errc() || end != digits.data() + digits.size())
+		throw std::runtime_error(std::string("Invalid ") + what + " input: " + std::string(text));
+	return res;
+}
+
+}
+
+Input::Input(std::istream& is, size_t capacity) : is(is), capacity(std::max<size_t>(capacity, 64)) {}
+
+// Moves the unread bytes to the front and appends what the stream has, false at the end of input
+bool Input::fill() {
+	if (fed) return false;
+	if (pos) {
+		std::memmove(buffer.data(), buffer.data() + pos, end - pos);
+		end -= pos;
+		pos = 0;
+	}
+	if (buffer.empty()) buffer.resize(capacity);
+	else if (end == buffer.size()) buffer.resize(buffer.size() * 2);
+	using traits = std::istream::traits_type;
+	auto* source = is.rdbuf();
+	// blocks until input arrives, afterwards a buffered stream reports what it holds
+	if (!source || traits::eq_int_type(source->sgetc(), traits::eof())) return false;
+	const auto start = end;
+	if (const auto buffered = source->in_avail(); buffered > 0) {
+		const auto room = static_cast<std::streamsize>(buffer.size() - end);
+		end += static_cast<size_t>(source->sgetn(buffer.data() + end, std::min(buffered, room)));
+	} else {
+		// unbuffered, e.g. std::cin synced with stdio: a line at a time so a terminal never waits for more
+		for (auto c = source->sbumpc(); !traits::eq_int_type(c, traits::eof()); c = source->sbumpc()) {
+			buffer[end++] = traits::to_char_type(c);
+			if (c == '\n' || end == buffer.size()) break;
+		}
+	}
+	return end > start;
+}
+
+// A token ends at whitespace, a line at its line break
+bool Input::delimited(bool line) const noexcept {
+	const auto* at = buffer.data() + pos;
+	const auto* last = buffer.data() + end;
+	if (line) return std::find(at, last, '\n') != last;
+	at = std::find_if_not(at, last, is_space);
+	return std::find_if(at, last, is_space) != last;
+}
+
+void Input::feed(std::string_view text) {
+	fed = true;
+	if (text.empty()) return;
+	if (pos) {
+		std::memmove(buffer.data(), buffer.data() + pos, end - pos);
+		end -= pos;
+		pos = 0;
+	}
+	if (end + text.size() > buffer.size()) buffer.resize(std::max({end + text.size(), buffer.size() * 2, capacity}));
+	std::memcpy(buffer.data() + end, text.data(), text.size());
+	end += text.size();
+}
+
+bool Input::skip_spaces() {
+	for (;;) {
+		while (pos < end && is_space(buffer[pos])) ++pos;
+		if (pos < end) return true;
+		if (!fill()) return false;
+	}
+}
+
+// The next whitespace delimited token or the rest of the line, valid until the next read
+std::string_view Input::token(bool line) {
+	if (!line && !skip_spaces()) return {};
+	size_t length = 0;
+	for (;;) {
+		while (pos + length < end && (line ? buffer[pos + length] != '\n' : !is_space(buffer[pos + length]))) ++length;
+		if (pos + length < end || !fill()) break;
+	}
+	const std::string_view res{buffer.data() + pos, length};
+	pos += length;
+	return res;
+}
+
+void Input::read(Value& var) {
+	if (in_group(var.type(), TypeGroup::String)) {
+		var = Value{token(true)};
+		return;
+	}
+	const auto text = token(false);
+	if (text.empty()) throw std::runtime_error("Unexpected end of input");
+	if (in_group(var.type(), TypeGroup::Numeric))
+		var.value.int_ptr = parse<int>(text, "integer");
+	else if (in_group(var.type(), TypeGroup::Real))
+		var.value.double_ptr = parse<double>(text, "real");
+	else
+		throw std::runtime_error("Can't read a value of this type");
+}
+
+void Input::skip_line() {
+	for (;;) {
+		const auto* eol = pos < end ? static_cast<const char*>(std::memchr(buffer.data() + pos, '\n', end - pos)) : nullptr;
+		if (eol) {
+			pos = static_cast<size_t>(eol - buffer.data()) + 1;
+			return;
+		}
+		pos = end;
+		if (!fill()) return;
+	}
+}
@@ -0,0 +1,656 @@
+#include "jit.h"
+#include <cstddef>
+#include <cstring>
+#include <map>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define PASCAL_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef PASCAL_JIT
+
+namespace {
+
+// Value layout the generated code relies on: the tag byte first, the payload at 8
+constexpr int32_t payload = 8;
+
+enum Reg : uint8_t { rax = 0, rcx = 1, rdx = 2, rbx = 3, rsi = 6, rdi = 7, r12 = 12, r13 = 13, r14 = 14, r15 = 15 };
+
+// x86 condition codes, the low nibble of jcc and setcc
+enum Cond : uint8_t { B = 0x2, AE = 0x3, E = 0x4, NE = 0x5, A = 0x7, P = 0xA, NP = 0xB, L = 0xC, GE = 0xD, LE = 0xE, G = 0xF };
+
+// Emits the handful of instructions the templates need, memory operands are always [base + disp32]
+class Assembler {
+public:
+	std::vector<uint8_t> code;
+
+	[[nodiscard]] size_t here() const { return code.size(); }
+
+	void bytes(std::initializer_list<uint8_t> list) { code.insert(code.end(), list); }
+
+	void imm32(int32_t v) {
+		uint8_t b[4];
+		std::memcpy(b, &v, 4);
+		code.insert(code.end(), b, b + 4);
+	}
+
+	void imm64(uint64_t v) {
+		uint8_t b[8];
+		std::memcpy(b, &v, 8);
+		code.insert(code.end(), b, b + 8);
+	}
+
+	// [prefix] [REX] opcode modrm [sib] disp32
+	void mem(std::initializer_list<uint8_t> prefix, bool wide, std::initializer_list<uint8_t> opcode,
+			 uint8_t reg, uint8_t base, int32_t disp) {
+		bytes(prefix);
+		const uint8_t rex = 0x40 | (wide ? 0x08 : 0) | ((reg & 8) ? 0x04 : 0) | ((base & 8) ? 0x01 : 0);
+		if (rex != 0x40) code.push_back(rex);
+		bytes(opcode);
+		code.push_back(0x80 | ((reg & 7) << 3) | (base & 7));
+		if ((base & 7) == 4) code.push_back(0x24);
+		imm32(disp);
+	}
+
+	void push(Reg reg) {
+		if (reg & 8) code.push_back(0x41);
+		code.push_back(0x50 | (reg & 7));
+	}
+
+	void pop(Reg reg) {
+		if (reg & 8) code.push_back(0x41);
+		code.push_back(0x58 | (reg & 7));
+	}
+
+	// add/sub r12, imm32 - moves the stack pointer
+	void add_sp(int32_t v) { bytes({0x49, 0x81, 0xC4}); imm32(v); }
+	void sub_sp(int32_t v) { bytes({0x49, 0x81, 0xEC}); imm32(v); }
+
+	void setcc(Cond cc, Reg reg) { bytes({0x0F, static_cast<uint8_t>(0x90 | cc), static_cast<uint8_t>(0xC0 | reg)}); }
+
+	// returns the position of the rel32 to patch
+	size_t jcc(Cond cc) {
+		bytes({0x0F, static_cast<uint8_t>(0x80 | cc)});
+		imm32(0);
+		return here() - 4;
+	}
+
+	size_t jmp() {
+		code.push_back(0xE9);
+		imm32(0);
+		return here() - 4;
+	}
+
+	void patch(size_t at, size_t target) {
+		const auto rel = static_cast<int32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(at + 4));
+		std::memcpy(code.data() + at, &rel, 4);
+	}
+};
+
+constexpr int32_t slot(int32_t index) { return index * static_cast<int32_t>(sizeof(Value)); }
+
+// stack operands relative to r12, which points past the top
+constexpr int32_t top = -slot(1);
+constexpr int32_t next = -slot(2);
+
+struct Operand {
+	uint8_t base;
+	int32_t disp;
+};
+
+int32_t width(DataType type) {
+	if (in_group(type, TypeGroup::Real)) return 8;
+	if (type == DataType::Boolean) return 1;
+	return 4;
+}
+
+// binary operators that can take their right operand straight from a frame slot
+bool fusable(OpCode op) {
+	switch (op) {
+		case OpCode::AddI: case OpCode::SubI: case OpCode::MulI:
+		case OpCode::AddR: case OpCode::SubR: case OpCode::MulR:
+		case OpCode::EqI: case OpCode::NeI: case OpCode::LtI: case OpCode::LeI: case OpCode::GeI: case OpCode::GtI:
+		case OpCode::EqR: case OpCode::NeR: case OpCode::LtR: case OpCode::LeR: case OpCode::GeR: case OpCode::GtR:
+			return true;
+		default:
+			return false;
+	}
+}
+
+}
+
+Jit::Jit() {
+	Value probe{1};
+	const auto* base = reinterpret_cast<const unsigned char*>(&probe);
+	enabled = base[0] == static_cast<unsigned char>(DataType::Integer)
+		&& reinterpret_cast<const unsigned char*>(&probe.value) - base == payload;
+}
+
+Jit::~Jit() {
+	clear();
+}
+
+bool Jit::available() const noexcept {
+	return enabled;
+}
+
+void Jit::clear() noexcept {
+	for (auto& [ptr, size] : blocks)
+		munmap(ptr, size);
+	blocks.clear();
+}
+
+// Translates code[head..end] where end is the back edge of the loop. Registers:
+// rbx - frame, r12 - stack pointer, r13 - state. The stack stays in memory so
+// the interpreter can take over at any instruction boundary.
+JitFunction Jit::compile(const Chunk& chunk, int32_t head, int32_t end, JitSlowPath slow) {
+	if (!enabled) return nullptr;
+
+	Assembler a;
+	const auto state_sp = static_cast<int32_t>(offsetof(JitState, sp));
+	const auto state_frame = static_cast<int32_t>(offsetof(JitState, frame));
+
+	std::vector<size_t> labels(end - head + 1);
+	std::vector<std::pair<size_t, int32_t>> jumps;  // in-loop targets
+	std::map<int32_t, std::vector<size_t>> exits;   // resume the interpreter at pc
+	std::vector<size_t> errors;
+
+	const auto jump_to = [&](size_t at, int32_t target) {
+		if (target >= head && target <= end) jumps.emplace_back(at, target);
+		else exits[target].push_back(at);
+	};
+	// hands the instruction at pc over to the interpreter
+	const auto bail = [&](size_t at, int32_t pc) {
+		exits[pc].push_back(at);
+	};
+	// declared types of the frame slots, those of a routine when the loop is in one
+	const auto* frame = &chunk.globals;
+	for (const auto& routine : chunk.routines)
+		if (head >= routine.entry && head < routine.end) frame = &routine.frame;
+	// strings are counted and references are pointers, the interpreter moves them
+	const auto is_boxed = [&](int32_t index) {
+		const auto type = (*frame)[index].type();
+		return type == DataType::String || type == DataType::Reference;
+	};
+
+	for (const auto reg : {rbx, r12, r13, r14, r15})
+		a.push(reg);
+	a.bytes({0x49, 0x89, 0xFD}); // mov r13, rdi
+	a.mem({}, true, {0x8B}, rbx, r13, state_frame);
+	a.mem({}, true, {0x8B}, r12, r13, state_sp);
+
+	for (int32_t pc = head; pc <= end; ++pc) {
+		labels[pc - head] = a.here();
+		const auto* ins = &chunk.code[pc];
+
+		// binary operands, "Load slot; op" reads the slot in place of the top of the stack
+		int32_t lhs = next;
+		Operand rhs{r12, top + payload};
+		if (ins->op == OpCode::Load && pc < end && !is_boxed(ins->a) && fusable(chunk.code[pc + 1].op)) {
+			lhs = top;
+			rhs = {rbx, slot(ins->a) + payload};
+			ins = &chunk.code[++pc];
+			labels[pc - head] = a.here();
+		}
+		// payloads are moved at the width their operators write, so stores forward to loads
+		const auto move = [&](bool load, DataType type, uint8_t base, int32_t disp) {
+			switch (width(type)) {
+				case 8: a.mem({}, true, {static_cast<uint8_t>(load ? 0x8B : 0x89)}, rax, base, disp); break;
+				case 4: a.mem({}, false, {static_cast<uint8_t>(load ? 0x8B : 0x89)}, rax, base, disp); break;
+				default: a.mem({}, false, {static_cast<uint8_t>(load ? 0x8A : 0x88)}, rax, base, disp); break;
+			}
+		};
+		const auto pop = [&] {
+			if (lhs == next) a.sub_sp(slot(1));
+		};
+
+		const auto int_op = [&](std::initializer_list<uint8_t> opcode) {
+			a.mem({}, false, {0x8B}, rax, r12, lhs + payload);
+			a.mem({}, false, opcode, rax, rhs.base, rhs.disp);
+			a.mem({}, false, {0x89}, rax, r12, lhs + payload);
+			pop();
+		};
+		const auto real_op = [&](uint8_t opcode) {
+			a.mem({0xF2}, false, {0x0F, 0x10}, 0, r12, lhs + payload);
+			a.mem({0xF2}, false, {0x0F, opcode}, 0, rhs.base, rhs.disp);
+			a.mem({0xF2}, false, {0x0F, 0x11}, 0, r12, lhs + payload);
+			pop();
+		};
+		const auto bool_result = [&] {
+			a.bytes({0x0F, 0xB6, 0xC0}); // movzx eax, al
+			a.mem({}, true, {0x89}, rax, r12, lhs + payload);
+			a.mem({}, false, {0xC6}, 0, r12, lhs);
+			a.code.push_back(static_cast<uint8_t>(DataType::Boolean));
+			pop();
+		};
+		const auto int_compare = [&](Cond cc) {
+			a.mem({}, false, {0x8B}, rax, r12, lhs + payload);
+			a.mem({}, false, {0x3B}, rax, rhs.base, rhs.disp);
+			a.setcc(cc, rax);
+			bool_result();
+		};
+		// ucomisd leaves ZF, PF and CF set for NaN, so only "above" conditions are used
+		const auto real_compare = [&](bool swap, Cond cc) {
+			const Operand left{r12, lhs + payload};
+			const auto& x = swap ? rhs : left;
+			const auto& y = swap ? left : rhs;
+			a.mem({0xF2}, false, {0x0F, 0x10}, 0, x.base, x.disp);
+			a.mem({0x66}, false, {0x0F, 0x2E}, 0, y.base, y.disp);
+			a.setcc(cc, rax);
+			if (cc == E) {
+				a.setcc(NP, rcx);
+				a.bytes({0x20, 0xC8}); // and al, cl
+			} else if (cc == NE) {
+				a.setcc(P, rcx);
+				a.bytes({0x08, 0xC8}); // or al, cl
+			}
+			bool_result();
+		};
+		const auto integer_division = [&](Reg result) {
+			// zero and -1 divisors are left to the interpreter
+			for (const int8_t divisor : {0, -1}) {
+				a.mem({}, false, {0x83}, 7, r12, top + payload);
+				a.code.push_back(static_cast<uint8_t>(divisor));
+				bail(a.jcc(E), pc);
+			}
+			a.mem({}, false, {0x8B}, rax, r12, next + payload);
+			a.code.push_back(0x99); // cdq
+			a.mem({}, false, {0xF7}, 7, r12, top + payload);
+			a.mem({}, false, {0x89}, result, r12, next + payload);
+			a.sub_sp(slot(1));
+		};
+		// eax = index - low of the dimension, out of range indices are left to the interpreter
+		const auto rebase = [&](int32_t index, int32_t dim) {
+			const auto& d = chunk.dimensions[dim];
+			a.mem({}, false, {0x8B}, rax, r12, index + payload);
+			a.code.push_back(0x2D); // sub eax, low
+			a.imm32(d.low);
+			a.code.push_back(0x3D); // cmp eax, high - low
+			a.imm32(d.high - d.low);
+			bail(a.jcc(A), pc);
+		};
+		// eax = (index - low) * stride + base, the offset of the scalar
+		const auto offset = [&](int32_t index, int32_t dim) {
+			const auto& d = chunk.dimensions[dim];
+			rebase(index, dim);
+			if (d.stride != 1) {
+				a.bytes({0x69, 0xC0}); // imul eax, eax, stride
+				a.imm32(d.stride);
+			}
+			if (d.base) {
+				a.code.push_back(0x05); // add eax, base
+				a.imm32(d.base);
+			}
+		};
+		// rcx = storage of the aggregate in the slot
+		const auto elements = [&](int32_t aggregate) {
+			a.mem({}, true, {0x8B}, rcx, rbx, slot(aggregate) + payload);
+			a.bytes({0x48, 0x8B, 0x09}); // mov rcx, [rcx]
+		};
+		const auto interpret = [&] {
+			a.mem({}, true, {0x89}, r12, r13, state_sp);
+			a.bytes({0x4C, 0x89, 0xEF}); // mov rdi, r13
+			a.code.push_back(0xBE);      // mov esi, pc
+			a.imm32(pc);
+			a.bytes({0x48, 0xB8});       // mov rax, slow
+			a.imm64(reinterpret_cast<uint64_t>(slow));
+			a.bytes({0xFF, 0xD0});       // call rax
+			a.bytes({0x85, 0xC0});       // test eax, eax
+			errors.push_back(a.jcc(NE));
+			a.mem({}, true, {0x8B}, r12, r13, state_sp);
+		};
+
+		switch (ins->op) {
+			case OpCode::Push: {
+				const auto& val = chunk.constants[ins->a];
+				if (val.type() == DataType::String) {
+					interpret();
+					break;
+				}
+				a.mem({}, true, {0xC7}, 0, r12, 0);
+				a.imm32(static_cast<int32_t>(val.type()));
+				if (width(val.type()) == 8) {
+					uint64_t bits;
+					std::memcpy(&bits, &val.value, sizeof(bits));
+					a.bytes({0x48, 0xB8});
+					a.imm64(bits);
+					move(false, val.type(), r12, payload);
+				} else {
+					a.mem({}, false, {0xC7}, 0, r12, payload);
+					a.imm32(val.type() == DataType::Boolean ? val.value.bool_ptr : val.value.int_ptr);
+				}
+				a.add_sp(slot(1));
+				break;
+			}
+			// frame slots keep their declared tag, only payloads move
+			case OpCode::Load: {
+				const auto type = (*frame)[ins->a].type();
+				if (is_boxed(ins->a)) {
+					interpret();
+					break;
+				}
+				a.mem({}, true, {0xC7}, 0, r12, 0);
+				a.imm32(static_cast<int32_t>(type));
+				move(true, type, rbx, slot(ins->a) + payload);
+				move(false, type, r12, payload);
+				a.add_sp(slot(1));
+				break;
+			}
+			case OpCode::Store: {
+				const auto type = (*frame)[ins->a].type();
+				if (is_boxed(ins->a)) {
+					interpret();
+					break;
+				}
+				move(true, type, r12, top + payload);
+				move(false, type, rbx, slot(ins->a) + payload);
+				a.sub_sp(slot(1));
+				break;
+			}
+			case OpCode::AddI: int_op({0x03}); break;
+			case OpCode::SubI: int_op({0x2B}); break;
+			case OpCode::MulI: int_op({0x0F, 0xAF}); break;
+			case OpCode::IntDivI: integer_division(rax); break;
+			case OpCode::ModI: integer_division(rdx); break;
+			case OpCode::NegI:
+				a.mem({}, false, {0xF7}, 3, r12, top + payload);
+				break;
+			case OpCode::AddR: real_op(0x58); break;
+			case OpCode::SubR: real_op(0x5C); break;
+			case OpCode::MulR: real_op(0x59); break;
+			case OpCode::DivR:
+				a.bytes({0x66, 0x0F, 0x57, 0xC9}); // xorpd xmm1, xmm1
+				a.mem({0x66}, false, {0x0F, 0x2E}, 1, r12, top + payload);
+				bail(a.jcc(E), pc); // zero or NaN divisor
+				real_op(0x5E);
+				break;
+			case OpCode::NegR:
+				a.mem({}, true, {0x0F, 0xBA}, 7, r12, top + payload); // btc qword, 63
+				a.code.push_back(63);
+				break;
+			case OpCode::ToReal:
+				a.mem({0xF2}, false, {0x0F, 0x2A}, 0, r12, top + payload);
+				a.mem({0xF2}, false, {0x0F, 0x11}, 0, r12, top + payload);
+				a.mem({}, false, {0xC6}, 0, r12, top);
+				a.code.push_back(static_cast<uint8_t>(DataType::Double));
+				break;
+			case OpCode::Not:
+				a.mem({}, false, {0x80}, 6, r12, top + payload);
+				a.code.push_back(1);
+				break;
+			case OpCode::And:
+			case OpCode::Or:
+				a.mem({}, false, {0x8A}, rax, r12, top + payload);
+				a.mem({}, false, {static_cast<uint8_t>(ins->op == OpCode::And ? 0x20 : 0x08)}, rax, r12, next + payload);
+				a.sub_sp(slot(1));
+				break;
+			case OpCode::EqI: int_compare(E); break;
+			case OpCode::NeI: int_compare(NE); break;
+			case OpCode::LtI: int_compare(L); break;
+			case OpCode::LeI: int_compare(LE); break;
+			case OpCode::GeI: int_compare(GE); break;
+			case OpCode::GtI: int_compare(G); break;
+			case OpCode::EqR: real_compare(false, E); break;
+			case OpCode::NeR: real_compare(false, NE); break;
+			case OpCode::LtR: real_compare(true, A); break;
+			case OpCode::LeR: real_compare(true, AE); break;
+			case OpCode::GeR: real_compare(false, AE); break;
+			case OpCode::GtR: real_compare(false, A); break;
+			case OpCode::Jump:
+				jump_to(a.jmp(), ins->a);
+				break;
+			case OpCode::JumpIfFalse:
+				a.sub_sp(slot(1));
+				a.mem({}, false, {0x80}, 7, r12, payload);
+				a.code.push_back(0);
+				jump_to(a.jcc(E), ins->a);
+				break;
+			// eax = the popped selector, a table of jmp rel32 or a tree of compares picks the arm
+			case OpCode::JumpTable:
+			case OpCode::JumpSearch: {
+				const auto& table = chunk.tables[ins->a];
+				a.sub_sp(slot(1));
+				if (table.chars) a.mem({}, false, {0x0F, 0xB6}, rax, r12, payload); // movzx eax, byte
+				else a.mem({}, false, {0x8B}, rax, r12, payload);
+				if (ins->op == OpCode::JumpTable) {
+					a.code.push_back(0x2D); // sub eax, low
+					a.imm32(table.low);
+					a.code.push_back(0x3D); // cmp eax, size - 1
+					a.imm32(static_cast<int32_t>(table.targets.size() - 1));
+					jump_to(a.jcc(A), table.otherwise);
+					a.bytes({0x48, 0x8D, 0x0D}); // lea rcx, [rip + 9], the first entry
+					a.imm32(9);
+					a.bytes({0x48, 0x8D, 0x04, 0x80}); // lea rax, [rax + rax * 4]
+					a.bytes({0x48, 0x01, 0xC8});       // add rax, rcx
+					a.bytes({0xFF, 0xE0});             // jmp rax
+					for (const auto target : table.targets)
+						jump_to(a.jmp(), target);
+					break;
+				}
+				const auto tree = [&](auto& self, size_t low, size_t high) -> void {
+					if (low == high) {
+						jump_to(a.jmp(), table.otherwise);
+						return;
+					}
+					const auto mid = low + (high - low) / 2;
+					const auto& range = table.ranges[mid];
+					a.code.push_back(0x3D); // cmp eax, range.low
+					a.imm32(range.low);
+					const auto below = a.jcc(L);
+					a.code.push_back(0x3D); // cmp eax, range.high
+					a.imm32(range.high);
+					const auto above = a.jcc(G);
+					jump_to(a.jmp(), range.target);
+					a.patch(below, a.here());
+					self(self, low, mid);
+					a.patch(above, a.here());
+					self(self, mid + 1, high);
+				};
+				tree(tree, 0, table.ranges.size());
+				break;
+			}
+			case OpCode::ForTest:
+			case OpCode::ForTestDown: {
+				a.mem({}, false, {0x8B}, rax, rbx, slot(ins->a) + payload);
+				a.mem({}, false, {0x3B}, rax, r12, top + payload);
+				const auto body = a.jcc(ins->op == OpCode::ForTest ? LE : GE);
+				a.sub_sp(slot(1));
+				jump_to(a.jmp(), ins->b);
+				a.patch(body, a.here());
+				break;
+			}
+			case OpCode::ForNext:
+			case OpCode::ForPrev:
+				// the variable before the step against the limit, the last iteration pops it
+				a.mem({}, false, {0x8B}, rax, rbx, slot(ins->a) + payload);
+				a.mem({}, false, {0x83}, ins->op == OpCode::ForNext ? 0 : 5, rbx, slot(ins->a) + payload);
+				a.code.push_back(1);
+				a.mem({}, false, {0x3B}, rax, r12, top + payload);
+				jump_to(a.jcc(ins->op == OpCode::ForNext ? L : G), ins->b);
+				a.sub_sp(slot(1));
+				break;
+			case OpCode::Index:
+				offset(top, ins->a);
+				a.mem({}, false, {0x89}, rax, r12, top + payload);
+				break;
+			case OpCode::LoadElemI:
+				offset(top, ins->b);
+				elements(ins->a);
+				a.bytes({0x8B, 0x04, 0x81}); // mov eax, [rcx + rax * 4]
+				a.mem({}, false, {0x89}, rax, r12, top + payload);
+				break;
+			case OpCode::LoadElemR:
+				offset(top, ins->b);
+				elements(ins->a);
+				a.bytes({0xF2, 0x0F, 0x10, 0x04, 0xC1}); // movsd xmm0, [rcx + rax * 8]
+				a.mem({0xF2}, false, {0x0F, 0x11}, 0, r12, top + payload);
+				a.mem({}, false, {0xC6}, 0, r12, top);
+				a.code.push_back(static_cast<uint8_t>(DataType::Double));
+				break;
+			case OpCode::StoreElemI:
+				offset(next, ins->b);
+				elements(ins->a);
+				a.mem({}, false, {0x8B}, rdx, r12, top + payload);
+				a.bytes({0x89, 0x14, 0x81}); // mov [rcx + rax * 4], edx
+				a.sub_sp(slot(2));
+				break;
+			case OpCode::StoreElemR:
+				offset(next, ins->b);
+				elements(ins->a);
+				a.mem({0xF2}, false, {0x0F, 0x10}, 0, r12, top + payload);
+				a.bytes({0xF2, 0x0F, 0x11, 0x04, 0xC1}); // movsd [rcx + rax * 8], xmm0
+				a.sub_sp(slot(2));
+				break;
+			// the offsets of fields are displacements
+			case OpCode::LoadFieldI:
+				elements(ins->a);
+				a.mem({}, true, {0xC7}, 0, r12, 0);
+				a.imm32(static_cast<int32_t>(DataType::Integer));
+				a.mem({}, false, {0x8B}, rax, rcx, chunk.dimensions[ins->b].base * 4);
+				a.mem({}, false, {0x89}, rax, r12, payload);
+				a.add_sp(slot(1));
+				break;
+			case OpCode::LoadFieldR:
+				elements(ins->a);
+				a.mem({}, true, {0xC7}, 0, r12, 0);
+				a.imm32(static_cast<int32_t>(DataType::Double));
+				a.mem({0xF2}, false, {0x0F, 0x10}, 0, rcx, chunk.dimensions[ins->b].base * 8);
+				a.mem({0xF2}, false, {0x0F, 0x11}, 0, r12, payload);
+				a.add_sp(slot(1));
+				break;
+			case OpCode::StoreFieldI:
+				elements(ins->a);
+				a.mem({}, false, {0x8B}, rdx, r12, top + payload);
+				a.mem({}, false, {0x89}, rdx, rcx, chunk.dimensions[ins->b].base * 4);
+				a.sub_sp(slot(1));
+				break;
+			case OpCode::StoreFieldR:
+				elements(ins->a);
+				a.mem({0xF2}, false, {0x0F, 0x10}, 0, r12, top + payload);
+				a.mem({0xF2}, false, {0x0F, 0x11}, 0, rcx, chunk.dimensions[ins->b].base * 8);
+				a.sub_sp(slot(1));
+				break;
+			// var parameters hold the address of the payload
+			case OpCode::LoadRefI:
+				a.mem({}, true, {0x8B}, rcx, rbx, slot(ins->a) + payload);
+				a.mem({}, true, {0xC7}, 0, r12, 0);
+				a.imm32(static_cast<int32_t>(DataType::Integer));
+				a.mem({}, false, {0x8B}, rax, rcx, 0);
+				a.mem({}, false, {0x89}, rax, r12, payload);
+				a.add_sp(slot(1));
+				break;
+			case OpCode::LoadRefR:
+				a.mem({}, true, {0x8B}, rcx, rbx, slot(ins->a) + payload);
+				a.mem({}, true, {0xC7}, 0, r12, 0);
+				a.imm32(static_cast<int32_t>(DataType::Double));
+				a.mem({0xF2}, false, {0x0F, 0x10}, 0, rcx, 0);
+				a.mem({0xF2}, false, {0x0F, 0x11}, 0, r12, payload);
+				a.add_sp(slot(1));
+				break;
+			case OpCode::StoreRefI:
+				a.mem({}, true, {0x8B}, rcx, rbx, slot(ins->a) + payload);
+				a.mem({}, false, {0x8B}, rax, r12, top + payload);
+				a.mem({}, false, {0x89}, rax, rcx, 0);
+				a.sub_sp(slot(1));
+				break;
+			case OpCode::StoreRefR:
+				a.mem({}, true, {0x8B}, rcx, rbx, slot(ins->a) + payload);
+				a.mem({0xF2}, false, {0x0F, 0x10}, 0, r12, top + payload);
+				a.mem({0xF2}, false, {0x0F, 0x11}, 0, rcx, 0);
+				a.sub_sp(slot(1));
+				break;
+			case OpCode::LoadGlobal:
+			case OpCode::StoreGlobal:
+			case OpCode::Ref:
+			case OpCode::RefGlobal:
+			case OpCode::LoadRef:
+			case OpCode::StoreRef:
+			case OpCode::ReadRef:
+			case OpCode::LoadElem:
+			case OpCode::StoreElem:
+			case OpCode::LoadField:
+			case OpCode::StoreField:
+			case OpCode::ReadElem:
+			case OpCode::Address:
+			case OpCode::Copy:
+			case OpCode::Concat:
+			case OpCode::Append:
+			case OpCode::AppendGlobal:
+			case OpCode::StrLength:
+			case OpCode::StrCopy:
+			case OpCode::StrPos:
+			case OpCode::Eq:
+			case OpCode::Ne:
+			case OpCode::Lt:
+			case OpCode::Le:
+			case OpCode::Ge:
+			case OpCode::Gt:
+			case OpCode::Write:
+			case OpCode::Writeln:
+			case OpCode::Read:
+			case OpCode::ReadLine:
+				interpret();
+				break;
+			default:
+				bail(a.jmp(), pc);
+				break;
+		}
+	}
+	jump_to(a.jmp(), end + 1);
+
+	for (const auto& [at, target] : jumps)
+		a.patch(at, labels[target - head]);
+
+	std::vector<size_t> to_epilogue;
+	for (const auto& [pc, sites] : exits) {
+		for (const auto at : sites)
+			a.patch(at, a.here());
+		a.mem({}, true, {0x89}, r12, r13, state_sp);
+		a.code.push_back(0xB8); // mov eax, pc
+		a.imm32(pc);
+		to_epilogue.push_back(a.jmp());
+	}
+	for (const auto at : errors)
+		a.patch(at, a.here());
+	if (!errors.empty()) {
+		a.code.push_back(0xB8);
+		a.imm32(-1);
+	}
+	for (const auto at : to_epilogue)
+		a.patch(at, a.here());
+	for (const auto reg : {r15, r14, r13, r12, rbx})
+		a.pop(reg);
+	a.code.push_back(0xC3);
+
+	const auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	const auto size = (a.code.size() + page - 1) / page * page;
+	void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED) return nullptr;
+	std::memcpy(mem, a.code.data(), a.code.size());
+	if (mprotect(mem, size, PROT_READ | PROT_EXEC) != 0) {
+		munmap(mem, size);
+		return nullptr;
+	}
+	blocks.emplace_back(mem, size);
+	return reinterpret_cast<JitFunction>(mem);
+}
+
+#else
+
+Jit::Jit() : enabled(false) {}
+
+Jit::~Jit() = default;
+
+bool Jit::available() const noexcept {
+	return false;
+}
+
+void Jit::clear() noexcept {}
+
+JitFunction Jit::compile(const Chunk&, int32_t, int32_t, JitSlowPath) {
+	return nullptr;
+}
+
+#endif
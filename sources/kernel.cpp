@@ -0,0 +1,105 @@
+#include "kernel.h"
+#include <cstring>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PASCAL_VECTORS
+#endif
+
+namespace {
+
+// array elements from the first iteration on or the same value for all of them
+template<typename T> struct Source {
+	const T* data;
+	T scalar;
+};
+
+#ifdef PASCAL_VECTORS
+// 16 bytes, one SSE or NEON register
+template<typename T> struct VectorOf;
+template<> struct VectorOf<uint32_t> { typedef uint32_t type __attribute__((vector_size(16))); };
+template<> struct VectorOf<double> { typedef double type __attribute__((vector_size(16))); };
+template<typename T> using Vector = typename VectorOf<T>::type;
+
+template<typename T> Vector<T> load(const Source<T>& src, size_t at) {
+	Vector<T> res;
+	if (src.data) std::memcpy(&res, src.data + at, sizeof(res));
+	else res = Vector<T>{} + src.scalar;
+	return res;
+}
+#endif
+
+// the target may be one of the sources, every element is read before it is written
+template<typename T, typename Op> void apply(T* out, Source<T> a, Source<T> b, size_t count, Op op) {
+	size_t at = 0;
+#ifdef PASCAL_VECTORS
+	constexpr size_t lanes = sizeof(Vector<T>) / sizeof(T);
+	for (; at + lanes <= count; at += lanes) {
+		const Vector<T> res = op(load(a, at), load(b, at));
+		std::memcpy(out + at, &res, sizeof(res));
+	}
+#endif
+	for (; at < count; ++at)
+		out[at] = op(a.data ? a.data[at] : a.scalar, b.data ? b.data[at] : b.scalar);
+}
+
+template<typename T> void run(OpCode op, T* out, Source<T> a, Source<T> b, size_t count) {
+	switch (op) {
+		case OpCode::AddI: case OpCode::AddR: apply(out, a, b, count, [](auto x, auto y) { return x + y; }); break;
+		case OpCode::SubI: case OpCode::SubR: apply(out, a, b, count, [](auto x, auto y) { return x - y; }); break;
+		case OpCode::MulI: case OpCode::MulR: apply(out, a, b, count, [](auto x, auto y) { return x * y; }); break;
+		default: apply(out, a, b, count, [](auto x, auto) { return x; }); break;
+	}
+}
+
+const Bounds& bounds(const Value* frame, int32_t slot) {
+	return frame[slot].value.aggregate_ptr->type->bounds.front();
+}
+
+// integers wrap around like in the interpreter, as unsigned values they do so without undefined behaviour
+template<typename T, typename Storage> Source<T> source(const Chunk& chunk, const Kernel::Operand& operand, const Value* frame, int32_t first) {
+	switch (operand.kind) {
+		case Kernel::Operand::Kind::Array: {
+			const auto* array = frame[operand.index].value.aggregate_ptr;
+			return {reinterpret_cast<const T*>(array->elements<Storage>() + (first - bounds(frame, operand.index).low)), {}};
+		}
+		case Kernel::Operand::Kind::Variable: {
+			Storage val;
+			std::memcpy(&val, &frame[operand.index].value, sizeof(val));
+			return {nullptr, static_cast<T>(val)};
+		}
+		default: {
+			Storage val;
+			std::memcpy(&val, &chunk.constants[operand.index].value, sizeof(val));
+			return {nullptr, static_cast<T>(val)};
+		}
+	}
+}
+
+template<typename T, typename Storage> void run(const Chunk& chunk, const Kernel& kernel, Value* frame, int32_t first, size_t count) {
+	auto* out = reinterpret_cast<T*>(frame[kernel.target].value.aggregate_ptr->elements<Storage>() + (first - bounds(frame, kernel.target).low));
+	const auto a = source<T, Storage>(chunk, kernel.a, frame, first);
+	const auto b = kernel.op == OpCode::Store ? Source<T>{nullptr, {}} : source<T, Storage>(chunk, kernel.b, frame, first);
+	run(kernel.op, out, a, b, count);
+}
+
+}
+
+bool run_kernel(const Chunk& chunk, const Kernel& kernel, Value* frame, int32_t to) {
+	auto& var = frame[kernel.var].value.int_ptr;
+	if (kernel.down ? var < to : var > to) return false;
+	const auto first = kernel.down ? to : var;
+	const auto last = kernel.down ? var : to;
+	const auto covers = [&](int32_t slot) {
+		const auto& dim = bounds(frame, slot);
+		return dim.low <= first && last <= dim.high;
+	};
+	if (!covers(kernel.target)) return false;
+	if (kernel.a.kind == Kernel::Operand::Kind::Array && !covers(kernel.a.index)) return false;
+	if (kernel.op != OpCode::Store && kernel.b.kind == Kernel::Operand::Kind::Array && !covers(kernel.b.index)) return false;
+
+	const auto count = static_cast<size_t>(static_cast<int64_t>(last) - first + 1);
+	if (frame[kernel.target].value.aggregate_ptr->type->element.type == DataType::Double) run<double, double>(chunk, kernel, frame, first, count);
+	else run<uint32_t, int32_t>(chunk, kernel, frame, first, count);
+	var = static_cast<int32_t>(static_cast<uint32_t>(to) + (kernel.down ? -1u : 1u));
+	return true;
+}
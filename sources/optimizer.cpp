@@ -0,0 +1,502 @@
+#include "optimizer.h"
+#include "checker.h"
+#include "arith.h"
+#include <algorithm>
+#include <optional>
+
+using namespace ast;
+
+namespace {
+
+Value canonical(const Value& val) {
+	switch (TypeChecker::canonical(val.type())) {
+		case DataType::Integer: return Value{val.value.int_ptr};
+		case DataType::Double: return Value{val.value.double_ptr};
+		default: return val;
+	}
+}
+
+ExprPtr literal(Program& program, Value val) {
+	auto res = program.make<Literal>(canonical(val));
+	res->type = TypeChecker::canonical(val.type());
+	return res;
+}
+
+bool is_literal(const ExprPtr& expr) {
+	return expr->kind == Expr::Kind::Literal;
+}
+
+template<typename T>
+Value compare(Operator op, const T& lhs, const T& rhs) {
+	switch (op) {
+		case Operator::Eq: return Value{lhs == rhs};
+		case Operator::Ne: return Value{lhs != rhs};
+		case Operator::Lt: return Value{lhs < rhs};
+		case Operator::Le: return Value{lhs <= rhs};
+		case Operator::Ge: return Value{lhs >= rhs};
+		default: return Value{lhs > rhs};
+	}
+}
+
+// Mirrors the semantics of the typed VM instructions, integers go through the
+// same wrapping helpers. Returns nothing for operations that have to fail at run time
+std::optional<Value> evaluate(Operator op, DataType type, const Value& lhs, const Value* rhs) {
+	const bool real = type == DataType::Double;
+	switch (op) {
+		case Operator::Neg:
+			return real ? Value{-lhs.value.double_ptr} : Value{arith::neg(lhs.value.int_ptr)};
+		case Operator::Not:
+			return Value{!lhs.value.bool_ptr};
+		case Operator::ToReal:
+			return Value{static_cast<double>(lhs.value.int_ptr)};
+		case Operator::Add:
+			if (type == DataType::String) return lhs + *rhs;
+			return real ? Value{lhs.value.double_ptr + rhs->value.double_ptr} : Value{arith::add(lhs.value.int_ptr, rhs->value.int_ptr)};
+		case Operator::Sub:
+			return real ? Value{lhs.value.double_ptr - rhs->value.double_ptr} : Value{arith::sub(lhs.value.int_ptr, rhs->value.int_ptr)};
+		case Operator::Mul:
+			return real ? Value{lhs.value.double_ptr * rhs->value.double_ptr} : Value{arith::mul(lhs.value.int_ptr, rhs->value.int_ptr)};
+		case Operator::Div:
+			if (rhs->value.double_ptr == 0) return std::nullopt;
+			return Value{lhs.value.double_ptr / rhs->value.double_ptr};
+		case Operator::IntDiv:
+			if (rhs->value.int_ptr == 0) return std::nullopt;
+			return Value{arith::div(lhs.value.int_ptr, rhs->value.int_ptr)};
+		case Operator::Mod:
+			if (rhs->value.int_ptr == 0) return std::nullopt;
+			return Value{arith::mod(lhs.value.int_ptr, rhs->value.int_ptr)};
+		case Operator::And:
+			return Value{lhs.value.bool_ptr && rhs->value.bool_ptr};
+		case Operator::Or:
+			return Value{lhs.value.bool_ptr || rhs->value.bool_ptr};
+		default:
+			if (type == DataType::Integer) return compare(op, lhs.value.int_ptr, rhs->value.int_ptr);
+			if (real) return compare(op, lhs.value.double_ptr, rhs->value.double_ptr);
+			return compare(op, lhs, *rhs);
+	}
+}
+
+// only a zero divisor fails, arith::div and arith::mod define every other one
+bool may_trap(const Binary& expr) {
+	if (expr.op != Operator::Div && expr.op != Operator::IntDiv && expr.op != Operator::Mod) return false;
+	if (!is_literal(expr.rhs)) return true;
+	const auto& divisor = expr.rhs->as<Literal>().value;
+	return expr.op == Operator::Div ? divisor.value.double_ptr == 0 : divisor.value.int_ptr == 0;
+}
+
+bool invariant(const Expr& expr, const std::set<std::string>& assigned) {
+	switch (expr.kind) {
+		case Expr::Kind::Literal: return true;
+		case Expr::Kind::Variable: return !assigned.contains(expr.as<Variable>().name);
+		case Expr::Kind::Unary: return invariant(*expr.as<Unary>().operand, assigned);
+		case Expr::Kind::Binary: {
+			const auto& binary = expr.as<Binary>();
+			return !may_trap(binary) && invariant(*binary.lhs, assigned) && invariant(*binary.rhs, assigned);
+		}
+		case Expr::Kind::Element: return false; // the index may be out of range
+		case Expr::Kind::Call: {
+			const auto& call = expr.as<FunctionCall>();
+			return call.builtin != Builtin::None && std::all_of(call.args.begin(), call.args.end(), [&](const ExprPtr& arg) {
+				return invariant(*arg, assigned);
+			});
+		}
+	}
+	return false;
+}
+
+bool calls(const Expr& expr) {
+	switch (expr.kind) {
+		case Expr::Kind::Unary: return calls(*expr.as<Unary>().operand);
+		case Expr::Kind::Binary: return calls(*expr.as<Binary>().lhs) || calls(*expr.as<Binary>().rhs);
+		case Expr::Kind::Element:
+			for (const auto& selector : expr.as<Element>().selectors)
+				for (const auto& index : selector.indices)
+					if (calls(*index)) return true;
+			return false;
+		case Expr::Kind::Call: {
+			const auto& call = expr.as<FunctionCall>();
+			return call.builtin == Builtin::None
+				|| std::any_of(call.args.begin(), call.args.end(), [](const ExprPtr& arg) { return calls(*arg); });
+		}
+		default: return false;
+	}
+}
+
+// The statement calls a routine, which may assign any global or var argument
+bool calls(const Stmt& stmt) {
+	const auto any = [](const std::vector<ExprPtr>& exprs) {
+		return std::any_of(exprs.begin(), exprs.end(), [](const ExprPtr& e) { return calls(*e); });
+	};
+	const auto indexed = [&](const std::vector<Selector>& selectors) {
+		return std::any_of(selectors.begin(), selectors.end(), [&](const Selector& s) { return any(s.indices); });
+	};
+	switch (stmt.kind) {
+		case Stmt::Kind::Compound:
+			return std::any_of(stmt.as<Compound>().body.begin(), stmt.as<Compound>().body.end(),
+							   [](const StmtPtr& s) { return calls(*s); });
+		case Stmt::Kind::Assign:
+			return indexed(stmt.as<Assign>().target.selectors) || calls(*stmt.as<Assign>().value);
+		case Stmt::Kind::Call: {
+			const auto& call = stmt.as<Call>();
+			if (call.name != "Write" && call.name != "Writeln") return true;
+			return any(call.args) || std::any_of(call.formats.begin(), call.formats.end(), [](const Format& f) {
+				return (f.width && calls(*f.width)) || (f.decimals && calls(*f.decimals));
+			});
+		}
+		case Stmt::Kind::Read:
+			return std::any_of(stmt.as<Read>().targets.begin(), stmt.as<Read>().targets.end(),
+							   [&](const Target& t) { return indexed(t.selectors); });
+		case Stmt::Kind::If: {
+			const auto& branch = stmt.as<If>();
+			return calls(*branch.cond) || calls(*branch.then_branch) || (branch.else_branch && calls(*branch.else_branch));
+		}
+		case Stmt::Kind::While:
+			return calls(*stmt.as<While>().cond) || calls(*stmt.as<While>().body);
+		case Stmt::Kind::For: {
+			const auto& loop = stmt.as<For>();
+			return calls(*loop.from) || calls(*loop.to) || calls(*loop.body);
+		}
+		case Stmt::Kind::Case: {
+			const auto& branch = stmt.as<Case>();
+			return calls(*branch.selector) || (branch.else_branch && calls(*branch.else_branch))
+				|| std::any_of(branch.arms.begin(), branch.arms.end(), [](const Case::Arm& arm) { return calls(*arm.body); });
+		}
+	}
+	return false;
+}
+
+void assignments(const Stmt& stmt, std::set<std::string>& assigned) {
+	switch (stmt.kind) {
+		case Stmt::Kind::Compound:
+			for (const auto& s : stmt.as<Compound>().body) assignments(*s, assigned);
+			break;
+		case Stmt::Kind::Assign:
+			assigned.insert(stmt.as<Assign>().target.name);
+			break;
+		case Stmt::Kind::Read:
+			for (const auto& target : stmt.as<Read>().targets) assigned.insert(target.name);
+			break;
+		case Stmt::Kind::If: {
+			const auto& branch = stmt.as<If>();
+			assignments(*branch.then_branch, assigned);
+			if (branch.else_branch) assignments(*branch.else_branch, assigned);
+			break;
+		}
+		case Stmt::Kind::While:
+			assignments(*stmt.as<While>().body, assigned);
+			break;
+		case Stmt::Kind::For:
+			assigned.insert(stmt.as<For>().var);
+			assignments(*stmt.as<For>().body, assigned);
+			break;
+		case Stmt::Kind::Case:
+			for (const auto& arm : stmt.as<Case>().arms) assignments(*arm.body, assigned);
+			if (stmt.as<Case>().else_branch) assignments(*stmt.as<Case>().else_branch, assigned);
+			break;
+		case Stmt::Kind::Call:
+			break;
+	}
+}
+
+}
+
+// The declarations of a routine hide the program's constants
+void Optimizer::optimize(ast::Program& program) {
+	this->program = &program;
+	temporaries = 0;
+	std::map<std::string, Value> globals;
+	for (const auto& decl : program.decls)
+		if (decl.is_const) globals.emplace(decl.name, decl.value);
+	for (auto& routine : program.routines) {
+		constants = globals;
+		for (const auto* scope : {&routine.params, &routine.decls})
+			for (const auto& decl : *scope) {
+				constants.erase(decl.name);
+				if (decl.is_const) constants.emplace(decl.name, decl.value);
+			}
+		decls = &routine.decls;
+		this->routine = &routine;
+		compound(*routine.body);
+	}
+	constants = std::move(globals);
+	decls = &program.decls;
+	routine = nullptr;
+	compound(*program.body);
+}
+
+//-------------------------expressions------------------------------------
+
+void Optimizer::fold(ExprPtr& expr) {
+	switch (expr->kind) {
+		case Expr::Kind::Literal:
+			break;
+		case Expr::Kind::Variable: {
+			const auto it = constants.find(expr->as<Variable>().name);
+			if (it != constants.end()) expr = literal(*program, it->second);
+			break;
+		}
+		case Expr::Kind::Unary: {
+			auto& unary = expr->as<Unary>();
+			fold(unary.operand);
+			if (!is_literal(unary.operand)) break;
+			if (auto res = evaluate(unary.op, unary.operand->type, unary.operand->as<Literal>().value, nullptr))
+				expr = literal(*program, std::move(*res));
+			break;
+		}
+		case Expr::Kind::Binary: {
+			auto& binary = expr->as<Binary>();
+			fold(binary.lhs);
+			fold(binary.rhs);
+			if (!is_literal(binary.lhs) || !is_literal(binary.rhs)) break;
+			if (auto res = evaluate(binary.op, binary.lhs->type, binary.lhs->as<Literal>().value,
+									&binary.rhs->as<Literal>().value))
+				expr = literal(*program, std::move(*res));
+			break;
+		}
+		case Expr::Kind::Element:
+			for (auto& selector : expr->as<Element>().selectors)
+				for (auto& index : selector.indices) fold(index);
+			break;
+		case Expr::Kind::Call: {
+			auto& call = expr->as<FunctionCall>();
+			for (auto& arg : call.args) fold(arg);
+			if (call.builtin == Builtin::None || !std::all_of(call.args.begin(), call.args.end(), is_literal)) break;
+			const auto& args = call.args;
+			const auto str = args[0]->as<Literal>().value.str();
+			switch (call.builtin) {
+				case Builtin::Length:
+					expr = literal(*program, Value{static_cast<int32_t>(str.size())});
+					break;
+				case Builtin::Copy:
+					expr = literal(*program, Value{substring(str, args[1]->as<Literal>().value.value.int_ptr, args[2]->as<Literal>().value.value.int_ptr)});
+					break;
+				default:
+					expr = literal(*program, Value{position(str, args[1]->as<Literal>().value.str())});
+					break;
+			}
+			break;
+		}
+	}
+}
+
+//-------------------------statements------------------------------------
+
+void Optimizer::compound(Compound& stmt) {
+	std::vector<StmtPtr> body;
+	for (auto& s : stmt.body) {
+		statement(s);
+		if (s) body.push_back(std::move(s));
+	}
+	stmt.body = std::move(body);
+}
+
+void Optimizer::statement(StmtPtr& stmt) {
+	switch (stmt->kind) {
+		case Stmt::Kind::Compound:
+			compound(stmt->as<Compound>());
+			break;
+		case Stmt::Kind::Assign:
+			for (auto& selector : stmt->as<Assign>().target.selectors)
+				for (auto& index : selector.indices) fold(index);
+			fold(stmt->as<Assign>().value);
+			break;
+		case Stmt::Kind::Call:
+			for (auto& arg : stmt->as<Call>().args) fold(arg);
+			for (auto& format : stmt->as<Call>().formats) {
+				if (format.width) fold(format.width);
+				if (format.decimals) fold(format.decimals);
+			}
+			break;
+		case Stmt::Kind::Read:
+			for (auto& target : stmt->as<Read>().targets)
+				for (auto& selector : target.selectors)
+					for (auto& index : selector.indices) fold(index);
+			break;
+		case Stmt::Kind::If: {
+			auto& branch = stmt->as<If>();
+			fold(branch.cond);
+			nested(branch.then_branch);
+			if (branch.else_branch) statement(branch.else_branch);
+			if (is_literal(branch.cond))
+				stmt = std::move(branch.cond->as<Literal>().value.value.bool_ptr ? branch.then_branch : branch.else_branch);
+			break;
+		}
+		case Stmt::Kind::While: {
+			auto& loop = stmt->as<While>();
+			fold(loop.cond);
+			if (is_literal(loop.cond) && !loop.cond->as<Literal>().value.value.bool_ptr) {
+				stmt = nullptr;
+				break;
+			}
+			nested(loop.body);
+			hoist(stmt);
+			break;
+		}
+		case Stmt::Kind::For: {
+			auto& loop = stmt->as<For>();
+			fold(loop.from);
+			fold(loop.to);
+			if (is_literal(loop.from) && is_literal(loop.to)) {
+				const auto from = loop.from->as<Literal>().value.value.int_ptr;
+				const auto to = loop.to->as<Literal>().value.value.int_ptr;
+				if (loop.down ? from < to : from > to) {
+					const auto line = stmt->source_line;
+					stmt = program->make<Assign>(loop.var, std::move(loop.from));
+					stmt->source_line = line;
+					break;
+				}
+			}
+			nested(loop.body);
+			hoist(stmt);
+			break;
+		}
+		case Stmt::Kind::Case: {
+			auto& branch = stmt->as<Case>();
+			fold(branch.selector);
+			for (auto& arm : branch.arms) nested(arm.body);
+			if (branch.else_branch) statement(branch.else_branch);
+			if (!is_literal(branch.selector)) break;
+			// a constant selector leaves the one statement it picks
+			const auto value = Case::ordinal(branch.selector->as<Literal>().value);
+			const auto arm = std::find_if(branch.arms.begin(), branch.arms.end(), [&](const Case::Arm& a) {
+				return std::any_of(a.labels.begin(), a.labels.end(), [&](const Case::Label& l) {
+					return Case::ordinal(l.low) <= value && value <= Case::ordinal(l.high);
+				});
+			});
+			stmt = std::move(arm != branch.arms.end() ? arm->body : branch.else_branch);
+			break;
+		}
+	}
+	if (stmt && stmt->kind == Stmt::Kind::Compound && stmt->as<Compound>().body.empty())
+		stmt = nullptr;
+}
+
+void Optimizer::nested(StmtPtr& stmt) {
+	statement(stmt);
+	if (!stmt) stmt = program->make<Compound>();
+}
+
+//-------------------------loop invariant code motion------------------------------------
+
+void Optimizer::hoist(StmtPtr& loop) {
+	if (calls(*loop)) return;
+	std::set<std::string> assigned;
+	assignments(*loop, assigned);
+	aliases(assigned);
+
+	std::vector<StmtPtr> hoisted;
+	if (loop->kind == Stmt::Kind::While) {
+		auto& body = loop->as<While>();
+		hoist(body.cond, assigned, hoisted);
+		hoist(*body.body, assigned, hoisted);
+	} else {
+		hoist(*loop->as<For>().body, assigned, hoisted);
+	}
+	if (hoisted.empty()) return;
+
+	// the hoisted code runs as part of the loop statement
+	for (auto& s : hoisted) s->source_line = loop->source_line;
+	auto res = program->make<Compound>();
+	res->body = std::move(hoisted);
+	res->body.push_back(std::move(loop));
+	loop = std::move(res);
+}
+
+// A var parameter may refer to a global or to another var parameter, writing any of them
+// assigns them all
+void Optimizer::aliases(std::set<std::string>& assigned) const {
+	if (!routine) return;
+	const auto declared = [](const std::vector<Decl>& scope, const std::string& name) {
+		return std::any_of(scope.begin(), scope.end(), [&](const Decl& decl) { return decl.name == name; });
+	};
+	const auto local = [&](const std::string& name) { return declared(routine->params, name) || declared(routine->decls, name); };
+	const auto aliased = [&](const std::string& name) {
+		const auto param = std::find_if(routine->params.begin(), routine->params.end(), [&](const Decl& decl) { return decl.name == name; });
+		if (param != routine->params.end()) return param->by_ref;
+		return !declared(routine->decls, name) && declared(program->decls, name);
+	};
+	const auto by_ref = std::any_of(routine->params.begin(), routine->params.end(), [](const Decl& decl) { return decl.by_ref; });
+	if (!by_ref || std::none_of(assigned.begin(), assigned.end(), aliased)) return;
+	for (const auto& param : routine->params)
+		if (param.by_ref) assigned.insert(param.name);
+	for (const auto& decl : program->decls)
+		if (!decl.is_const && !local(decl.name)) assigned.insert(decl.name);
+}
+
+void Optimizer::hoist(Stmt& stmt, const std::set<std::string>& assigned, std::vector<StmtPtr>& hoisted) {
+	switch (stmt.kind) {
+		case Stmt::Kind::Compound:
+			for (auto& s : stmt.as<Compound>().body) hoist(*s, assigned, hoisted);
+			break;
+		case Stmt::Kind::Assign:
+			for (auto& selector : stmt.as<Assign>().target.selectors)
+				for (auto& index : selector.indices) hoist(index, assigned, hoisted);
+			hoist(stmt.as<Assign>().value, assigned, hoisted);
+			break;
+		case Stmt::Kind::Call:
+			for (auto& arg : stmt.as<Call>().args) hoist(arg, assigned, hoisted);
+			for (auto& format : stmt.as<Call>().formats) {
+				if (format.width) hoist(format.width, assigned, hoisted);
+				if (format.decimals) hoist(format.decimals, assigned, hoisted);
+			}
+			break;
+		case Stmt::Kind::Read:
+			for (auto& target : stmt.as<Read>().targets)
+				for (auto& selector : target.selectors)
+					for (auto& index : selector.indices) hoist(index, assigned, hoisted);
+			break;
+		case Stmt::Kind::If: {
+			auto& branch = stmt.as<If>();
+			hoist(branch.cond, assigned, hoisted);
+			hoist(*branch.then_branch, assigned, hoisted);
+			if (branch.else_branch) hoist(*branch.else_branch, assigned, hoisted);
+			break;
+		}
+		case Stmt::Kind::While: {
+			auto& loop = stmt.as<While>();
+			hoist(loop.cond, assigned, hoisted);
+			hoist(*loop.body, assigned, hoisted);
+			break;
+		}
+		case Stmt::Kind::For: {
+			auto& loop = stmt.as<For>();
+			hoist(loop.from, assigned, hoisted);
+			hoist(loop.to, assigned, hoisted);
+			hoist(*loop.body, assigned, hoisted);
+			break;
+		}
+		case Stmt::Kind::Case: {
+			auto& branch = stmt.as<Case>();
+			hoist(branch.selector, assigned, hoisted);
+			for (auto& arm : branch.arms) hoist(*arm.body, assigned, hoisted);
+			if (branch.else_branch) hoist(*branch.else_branch, assigned, hoisted);
+			break;
+		}
+	}
+}
+
+void Optimizer::hoist(ExprPtr& expr, const std::set<std::string>& assigned, std::vector<StmtPtr>& hoisted) {
+	if (expr->kind == Expr::Kind::Literal || expr->kind == Expr::Kind::Variable) return;
+
+	if (!invariant(*expr, assigned)) {
+		if (expr->kind == Expr::Kind::Unary) {
+			hoist(expr->as<Unary>().operand, assigned, hoisted);
+		} else if (expr->kind == Expr::Kind::Element) {
+			for (auto& selector : expr->as<Element>().selectors)
+				for (auto& index : selector.indices) hoist(index, assigned, hoisted);
+		} else if (expr->kind == Expr::Kind::Call) {
+			for (auto& arg : expr->as<FunctionCall>().args) hoist(arg, assigned, hoisted);
+		} else {
+			hoist(expr->as<Binary>().lhs, assigned, hoisted);
+			hoist(expr->as<Binary>().rhs, assigned, hoisted);
+		}
+		return;
+	}
+
+	const auto type = expr->type;
+	auto name = "$" + std::to_string(temporaries++);
+	decls->push_back({name, type, false, Value{type}, true});
+	hoisted.push_back(program->make<Assign>(name, std::move(expr)));
+	expr = program->make<Variable>(std::move(name));
+	expr->type = type;
+}
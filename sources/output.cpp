@@ -0,0 +1,97 @@
+#include "output.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+Output::Output(std::ostream& os, size_t capacity) : os(os), buffer(std::max<size_t>(capacity, 64)) {}
+
+Output::~Output() {
+	try {
+		flush();
+	} catch (...) {
+	}
+}
+
+void Output::drain() {
+	os.write(buffer.data(), static_cast<std::streamsize>(used));
+	used = 0;
+}
+
+void Output::flush() {
+	drain();
+	os.flush();
+}
+
+void Output::pad(int count, char c) {
+	while (count > 0) {
+		if (used == buffer.size()) drain();
+		const auto size = std::min(static_cast<size_t>(count), buffer.size() - used);
+		std::memset(buffer.data() + used, c, size);
+		used += size;
+		count -= static_cast<int>(size);
+	}
+}
+
+void Output::write(std::string_view str) {
+	if (str.empty()) return;
+	if (str.size() > buffer.size() - used) {
+		drain();
+		if (str.size() >= buffer.size()) {
+			os.write(str.data(), static_cast<std::streamsize>(str.size()));
+			return;
+		}
+	}
+	std::memcpy(buffer.data() + used, str.data(), str.size());
+	used += str.size();
+}
+
+void Output::write(const Value& val, int width, int decimals) {
+	char digits[64];
+	std::string_view text;
+	switch (val.type()) {
+		case DataType::Integer:
+		case DataType::Word:
+		case DataType::Byte:
+			text = {digits, static_cast<size_t>(std::to_chars(digits, std::end(digits), val.value.int_ptr).ptr - digits)};
+			break;
+		case DataType::Double:
+		case DataType::Real:
+		case DataType::Extended: {
+			// without decimals this is the %g form operator<< produces
+			const auto res = decimals < 0
+				? std::to_chars(digits, std::end(digits), val.value.double_ptr, std::chars_format::general, 6)
+				: std::to_chars(digits, std::end(digits), val.value.double_ptr, std::chars_format::fixed, decimals);
+			if (res.ec == std::errc()) text = {digits, static_cast<size_t>(res.ptr - digits)};
+			else {
+				// only long fixed forms overflow the local buffer, the decimals past the last binary
+				// digit of a double are zeros and are padded instead of formatted
+				constexpr int exact_decimals = 1074;
+				char wide[exact_decimals + 330];
+				const auto exact = std::min(decimals, exact_decimals);
+				const auto end = std::to_chars(wide, std::end(wide), val.value.double_ptr, std::chars_format::fixed, exact).ptr;
+				const auto size = static_cast<int>(end - wide) + decimals - exact;
+				pad(width - size);
+				write({wide, static_cast<size_t>(end - wide)});
+				pad(decimals - exact, '0');
+				pad(-width - size);
+				return;
+			}
+			break;
+		}
+		case DataType::Boolean:
+			text = val.value.bool_ptr ? "TRUE" : "FALSE";
+			break;
+		case DataType::Char:
+			digits[0] = val.value.char_ptr;
+			text = {digits, 1};
+			break;
+		case DataType::String:
+			text = val.str();
+			break;
+		default:
+			break;
+	}
+	pad(width - static_cast<int>(text.size()));
+	write(text);
+	pad(-width - static_cast<int>(text.size()));
+}
@@ -0,0 +1,450 @@
+#include "ast_builder.h"
+#include <algorithm>
+
+using namespace ast;
+
+
+//-------------------------program------------------------------------
+
+std::unique_ptr<Program> AstBuilder::build(PascalParser::ProgramContext *ctx) {
+	auto res = std::make_unique<Program>();
+	program = res.get();
+	res->name = ctx->programHeading()->identifier()->getText();
+	res->body = block(ctx->block(), res->decls, true);
+	return res;
+}
+
+// Constants come before variables whatever order the parts are written in, the parts are
+// visited in source order so the type table comes out as from the DescentParser. Only the
+// outer block of the program declares procedures and functions.
+NodePtr<Compound> AstBuilder::block(PascalParser::BlockContext *ctx, std::vector<Decl>& decls, bool outer) {
+	std::vector<Decl> vars;
+	for (auto* child : ctx->children) {
+		if (auto* part = dynamic_cast<PascalParser::ConstantDefinitionPartContext*>(child)) {
+			constants(part, decls);
+		} else if (auto* part = dynamic_cast<PascalParser::ProcedureAndFunctionDeclarationPartContext*>(child)) {
+			if (!outer) throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Unsupported nested routine: " + part->getText());
+			routine(part->procedureOrFunctionDeclaration());
+		} else if (auto* part = dynamic_cast<PascalParser::TypeDefinitionPartContext*>(child)) {
+			for (const auto& def : part->typeDefinition()) {
+				if (!def->type_()) throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Unsupported type: " + def->getText());
+				if (!named.emplace(def->identifier()->getText(), type(def->type_())).second)
+					throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Duplicate type: " + def->identifier()->getText());
+			}
+		} else if (auto* part = dynamic_cast<PascalParser::VariableDeclarationPartContext*>(child)) {
+			for (const auto& decl : part->variableDeclaration()) {
+				const auto type = this->type(decl->type_());
+				for (const auto& identifier : decl->identifierList()->identifier())
+					vars.push_back({identifier->getText(), type.type, false, Value{type.type}, false, type.aggregate});
+			}
+		}
+	}
+	for (auto& decl : vars)
+		decls.push_back(std::move(decl));
+	return compoundStatement(ctx->compoundStatement());
+}
+
+// Types defined by the routine are local to it
+void AstBuilder::routine(PascalParser::ProcedureOrFunctionDeclarationContext *ctx) {
+	auto* procedure = ctx->procedureDeclaration();
+	auto* function = ctx->functionDeclaration();
+	auto* params = procedure ? procedure->formalParameterList() : function->formalParameterList();
+	Routine res;
+	res.name = procedure ? procedure->identifier()->getText() : function->identifier()->getText();
+	res.source_line = static_cast<uint32_t>(ctx->getStart()->getLine());
+	if (params)
+		for (const auto& section : params->formalParameterSection()) {
+			if (section->FUNCTION() || section->PROCEDURE())
+				throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Unsupported parameter: " + section->getText());
+			auto* group = section->parameterGroup();
+			const auto type = typeIdentifier(group->typeIdentifier());
+			for (const auto& identifier : group->identifierList()->identifier())
+				res.params.push_back({identifier->getText(), type.type, false, Value{type.type}, false, type.aggregate, section->VAR() != nullptr});
+		}
+	if (function) {
+		const auto type = typeIdentifier(function->resultType()->typeIdentifier());
+		if (type.type == DataType::Reference)
+			throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Unsupported result type: " + function->resultType()->getText());
+		res.result = type.type;
+	}
+
+	const auto outer = named;
+	locals = &res.decls;
+	res.body = block(procedure ? procedure->block() : function->block(), res.decls, false);
+	locals = nullptr;
+	named = outer;
+	program->routines.push_back(std::move(res));
+}
+
+void AstBuilder::constants(PascalParser::ConstantDefinitionPartContext *ctx, std::vector<Decl>& decls) {
+	for (const auto& def : ctx->constantDefinition()) {
+		const auto& name = def->identifier()->getText();
+		auto val = def->constant()->getText();
+		DataType type;
+		if (def->type_())
+			type = this->type(def->type_()).type;
+		else if (def->constant()->string())
+			type = DataType::String;
+		else if (def->constant()->unsignedNumber() && def->constant()->unsignedNumber()->unsignedReal())
+			type = DataType::Double;
+		else
+			type = DataType::Integer;
+		auto res = Value{type};
+		if (in_group(type, TypeGroup::Numeric)) {
+			res.value.int_ptr = std::stoi(val);
+		}
+		else if (in_group(type, TypeGroup::Real)) {
+			res.value.double_ptr = std::stod(val);
+		}
+		else if (in_group(type, TypeGroup::String)) {
+			res = Value{def->constant()->string() ? unquote(val) : val};
+		}
+		else {
+			throw std::runtime_error("Unknown type");
+		}
+		decls.push_back({name, type, true, std::move(res)});
+	}
+}
+
+TypeRef AstBuilder::typeIdentifier(PascalParser::TypeIdentifierContext *ctx) {
+	const auto text = ctx->getText();
+	if (const auto it = named.find(text); it != named.end()) return it->second;
+	auto type = types.find(text);
+	if (type == types.end()) throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Unsupported type: " + text);
+	return {type->second};
+}
+
+TypeRef AstBuilder::type(PascalParser::Type_Context *ctx) {
+	if (auto* structured = ctx->structuredType()) {
+		auto* unpacked = structured->unpackedStructuredType();
+		if (auto* array = unpacked->arrayType()) return arrayType(array);
+		if (auto* record = unpacked->recordType()) return recordType(record);
+	}
+	const auto text = ctx->simpleType() ? ctx->simpleType()->getText() : ctx->getText();
+	if (const auto it = named.find(text); it != named.end()) return it->second;
+	auto type = types.find(text);
+	if (type == types.end()) throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Unsupported type");
+	return {type->second};
+}
+
+// The bounds of nested array types are joined
+TypeRef AstBuilder::arrayType(PascalParser::ArrayTypeContext *array) {
+	AggregateType res{};
+	PascalParser::Type_Context* element = nullptr;
+	while (array) {
+		for (auto* index : array->typeList()->indexType()) {
+			auto* range = index->simpleType()->subrangeType();
+			if (!range) throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Unsupported index type: " + index->getText());
+			res.bounds.push_back({bound(range->constant(0)), bound(range->constant(1))});
+		}
+		element = array->componentType()->type_();
+		auto* structured = element->structuredType();
+		array = structured ? structured->unpackedStructuredType()->arrayType() : nullptr;
+	}
+	res.element = type(element);
+	program->types.push_back(std::move(res));
+	return {DataType::Reference, static_cast<int32_t>(program->types.size() - 1)};
+}
+
+// The types of the fields come before the record in the table
+TypeRef AstBuilder::recordType(PascalParser::RecordTypeContext *ctx) {
+	AggregateType res{};
+	if (auto* fields = ctx->fieldList()) {
+		if (fields->variantPart()) throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Unsupported variant record");
+		for (const auto& section : fields->fixedPart()->recordSection()) {
+			const auto type = this->type(section->type_());
+			for (const auto& identifier : section->identifierList()->identifier())
+				res.fields.push_back({identifier->getText(), type});
+		}
+	}
+	program->types.push_back(std::move(res));
+	return {DataType::Reference, static_cast<int32_t>(program->types.size() - 1)};
+}
+
+// The constant of the name, those of a routine hide the program's
+const Decl* AstBuilder::constant(const std::string& name) const {
+	const auto find = [&](const std::vector<Decl>& decls) -> const Decl* {
+		const auto it = std::find_if(decls.begin(), decls.end(), [&](const Decl& decl) {
+			return decl.is_const && decl.name == name;
+		});
+		return it == decls.end() ? nullptr : &*it;
+	};
+	const auto* res = locals ? find(*locals) : nullptr;
+	return res ? res : find(program->decls);
+}
+
+// A signed integer or integer constant
+int32_t AstBuilder::bound(PascalParser::ConstantContext *ctx) {
+	int32_t res;
+	if (auto* number = ctx->unsignedNumber(); number && number->unsignedInteger()) {
+		res = std::stoi(number->getText());
+	} else {
+		const auto* decl = ctx->identifier() ? constant(ctx->identifier()->getText()) : nullptr;
+		if (!decl || !in_group(decl->type, TypeGroup::Numeric))
+			throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Unsupported array bound: " + ctx->getText());
+		res = decl->value.value.int_ptr;
+	}
+	return ctx->sign() && ctx->sign()->MINUS() ? -res : res;
+}
+
+// A signed integer or integer constant, a character, string constant of one character or chr(n)
+Value AstBuilder::label(PascalParser::ConstantContext *ctx) {
+	const auto fail = [&]() -> Value {
+		throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Unsupported case label: " + ctx->getText());
+	};
+	Value res;
+	if (auto* number = ctx->unsignedNumber(); number && number->unsignedInteger()) {
+		res = Value{std::stoi(number->getText())};
+	} else if (auto* chr = ctx->constantChr()) {
+		const auto code = std::stoi(chr->unsignedInteger()->getText());
+		if (code > 255) return fail();
+		res = Value{static_cast<char>(code)};
+	} else if (auto* str = ctx->string()) {
+		const auto text = unquote(str->getText());
+		if (text.size() != 1) return fail();
+		res = Value{text[0]};
+	} else {
+		const auto* decl = ctx->identifier() ? constant(ctx->identifier()->getText()) : nullptr;
+		if (decl && in_group(decl->type, TypeGroup::Numeric)) res = Value{decl->value.value.int_ptr};
+		else if (decl && decl->type == DataType::String && !ctx->sign() && decl->value.str().size() == 1) res = Value{decl->value.str()[0]};
+		else return fail();
+	}
+	if (ctx->sign() && res.type() != DataType::Integer) return fail();
+	if (ctx->sign() && ctx->sign()->MINUS()) res.value.int_ptr = -res.value.int_ptr;
+	return res;
+}
+
+// a[i][j] is a[i, j], consecutive index lists join
+Target AstBuilder::variable(PascalParser::VariableContext *ctx) {
+	if (ctx->AT() || !ctx->POINTER().empty())
+		throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Unsupported variable: " + ctx->getText());
+	Target res{ctx->identifier(0)->getText()};
+	for (size_t i = 1; i < ctx->children.size(); ++i) {
+		if (auto* field = dynamic_cast<PascalParser::IdentifierContext*>(ctx->children[i])) {
+			res.selectors.push_back({{}, field->getText()});
+		} else if (auto* index = dynamic_cast<PascalParser::ExpressionContext*>(ctx->children[i])) {
+			if (res.selectors.empty() || !res.selectors.back().field.empty()) res.selectors.emplace_back();
+			res.selectors.back().indices.push_back(expression(index));
+		}
+	}
+	return res;
+}
+
+//-------------------------statements------------------------------------
+
+NodePtr<Compound> AstBuilder::compoundStatement(PascalParser::CompoundStatementContext *ctx) {
+	auto res = program->make<Compound>();
+	for (const auto& stat : ctx->statements()->statement())
+		if (auto s = statement(stat)) res->body.push_back(std::move(s));
+	return res;
+}
+
+StmtPtr AstBuilder::statement(PascalParser::StatementContext *ctx) {
+	auto* stat = ctx->unlabelledStatement();
+	auto res = stat->simpleStatement() ? simpleStatement(stat->simpleStatement())
+									   : structuredStatement(stat->structuredStatement());
+	if (res) res->source_line = static_cast<uint32_t>(ctx->getStart()->getLine());
+	return res;
+}
+
+StmtPtr AstBuilder::simpleStatement(PascalParser::SimpleStatementContext *ctx) {
+	if (auto* assign = ctx->assignmentStatement())
+		return assignmentStatement(assign);
+	if (auto* proc = ctx->procedureStatement())
+		return procedureStatement(proc);
+	if (ctx->emptyStatement_())
+		return nullptr;
+	throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Unsupported statement: " + ctx->getText());
+}
+
+StmtPtr AstBuilder::structuredStatement(PascalParser::StructuredStatementContext *ctx) {
+	if (auto* compound = ctx->compoundStatement())
+		return compoundStatement(compound);
+	if (auto* cond = ctx->conditionalStatement(); cond && cond->ifStatement())
+		return ifStatement(cond->ifStatement());
+	if (auto* cond = ctx->conditionalStatement(); cond && cond->caseStatement())
+		return caseStatement(cond->caseStatement());
+	if (auto* loop = ctx->repetetiveStatement()) {
+		if (loop->whileStatement()) return whileStatement(loop->whileStatement());
+		if (loop->forStatement()) return forStatement(loop->forStatement());
+	}
+	throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Unsupported statement: " + ctx->getText());
+}
+
+StmtPtr AstBuilder::assignmentStatement(PascalParser::AssignmentStatementContext *ctx) {
+	auto target = variable(ctx->variable());
+	return program->make<Assign>(std::move(target), expression(ctx->expression()));
+}
+
+StmtPtr AstBuilder::procedureStatement(PascalParser::ProcedureStatementContext *ctx) {
+	const auto& name = ctx->identifier()->getText();
+	auto* params = ctx->parameterList();
+
+	if (name == "Read" || name == "Readln") {
+		auto res = program->make<Read>();
+		res->line = name == "Readln";
+		if (!params) return res;
+		// the arguments are parsed as expressions, only variables and elements are targets
+		for (const auto& param : params->actualParameter()) {
+			auto arg = expression(param->expression());
+			if (arg->kind == Expr::Kind::Variable) res->targets.emplace_back(arg->as<Variable>().name);
+			else if (arg->kind == Expr::Kind::Element) res->targets.emplace_back(arg->as<Element>().name, std::move(arg->as<Element>().selectors));
+			else throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Not a variable: " + param->getText());
+		}
+		return res;
+	}
+
+	auto res = program->make<Call>(name);
+	if (params)
+		for (const auto& param : params->actualParameter()) {
+			res->args.push_back(expression(param->expression()));
+			auto& format = res->formats.emplace_back();
+			const auto widths = param->parameterwidth();
+			if (widths.size() > 2) throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Too many format specifiers");
+			if (widths.size() > 0) format.width = expression(widths[0]->expression());
+			if (widths.size() > 1) format.decimals = expression(widths[1]->expression());
+		}
+	return res;
+}
+
+StmtPtr AstBuilder::ifStatement(PascalParser::IfStatementContext *ctx) {
+	auto* other = ctx->statement(1);
+	return program->make<If>(expression(ctx->expression()), statement(ctx->statement(0)),
+								other ? statement(other) : nullptr);
+}
+
+StmtPtr AstBuilder::whileStatement(PascalParser::WhileStatementContext *ctx) {
+	return program->make<While>(expression(ctx->expression()), statement(ctx->statement()));
+}
+
+StmtPtr AstBuilder::forStatement(PascalParser::ForStatementContext *ctx) {
+	auto* list = ctx->forList();
+	auto res = program->make<For>(ctx->identifier()->getText(),
+								  expression(list->initialValue()->expression()),
+								  expression(list->finalValue()->expression()),
+								  list->DOWNTO() != nullptr,
+								  statement(ctx->statement()));
+	res->parallel = ctx->PARALLEL() != nullptr;
+	return res;
+}
+
+// An empty arm does nothing, as from the DescentParser
+StmtPtr AstBuilder::caseStatement(PascalParser::CaseStatementContext *ctx) {
+	auto res = program->make<Case>(expression(ctx->expression()));
+	for (auto* element : ctx->caseListElement()) {
+		auto& arm = res->arms.emplace_back();
+		for (auto* label : element->caseLabel()) {
+			auto low = this->label(label->constant(0));
+			auto high = label->constant(1) ? this->label(label->constant(1)) : low;
+			arm.labels.push_back({std::move(low), std::move(high)});
+		}
+		arm.body = statement(element->statement());
+		if (!arm.body) arm.body = program->make<Compound>();
+	}
+	if (auto* other = ctx->statements()) {
+		auto body = program->make<Compound>();
+		for (auto* stat : other->statement())
+			if (auto s = statement(stat)) body->body.push_back(std::move(s));
+		res->else_branch = std::move(body);
+	}
+	return res;
+}
+
+//-------------------------expressions------------------------------------
+
+ExprPtr AstBuilder::expression(PascalParser::ExpressionContext *ctx) {
+	auto lhs = simpleExpression(ctx->simpleExpression());
+	if (!ctx->relationaloperator()) return lhs;
+
+	auto rhs = expression(ctx->expression());
+
+	auto* op = ctx->relationaloperator();
+	Operator res;
+	if (op->EQUAL()) res = Operator::Eq;
+	else if (op->NOT_EQUAL()) res = Operator::Ne;
+	else if (op->LT()) res = Operator::Lt;
+	else if (op->LE()) res = Operator::Le;
+	else if (op->GE()) res = Operator::Ge;
+	else if (op->GT()) res = Operator::Gt;
+	else throw runtime_error("Unknown relational operator");
+	return program->make<Binary>(res, std::move(lhs), std::move(rhs));
+}
+
+ExprPtr AstBuilder::simpleExpression(PascalParser::SimpleExpressionContext *ctx) {
+	auto lhs = term(ctx->term());
+	if (!ctx->additiveoperator()) return lhs;
+
+	auto rhs = simpleExpression(ctx->simpleExpression());
+
+	auto* op = ctx->additiveoperator();
+	Operator res;
+	if (op->PLUS()) res = Operator::Add;
+	else if (op->MINUS()) res = Operator::Sub;
+	else if (op->OR()) res = Operator::Or;
+	else throw std::runtime_error("Unsupported binary operator");
+	return program->make<Binary>(res, std::move(lhs), std::move(rhs));
+}
+
+//----------------------------terms------------------------------------
+
+ExprPtr AstBuilder::term(PascalParser::TermContext *ctx) {
+	auto lhs = signedFactor(ctx->signedFactor());
+	if (!ctx->multiplicativeoperator()) return lhs;
+
+	auto rhs = term(ctx->term());
+
+	auto* op = ctx->multiplicativeoperator();
+	Operator res;
+	if (op->STAR()) res = Operator::Mul;
+	else if (op->SLASH()) res = Operator::Div;
+	else if (op->DIV()) res = Operator::IntDiv;
+	else if (op->MOD()) res = Operator::Mod;
+	else res = Operator::And;
+	return program->make<Binary>(res, std::move(lhs), std::move(rhs));
+}
+
+ExprPtr AstBuilder::signedFactor(PascalParser::SignedFactorContext *ctx) {
+	auto res = factor(ctx->factor());
+	if (ctx->MINUS()) return program->make<Unary>(Operator::Neg, std::move(res));
+	return res;
+}
+
+ExprPtr AstBuilder::factor(PascalParser::FactorContext *ctx) {
+	if (auto* expr = ctx->expression())
+		return expression(expr);
+	if (ctx->NOT())
+		return program->make<Unary>(Operator::Not, factor(ctx->factor()));
+	if (auto* var = ctx->variable()) {
+		auto target = variable(var);
+		if (target.selectors.empty()) return program->make<Variable>(std::move(target.name));
+		return program->make<Element>(std::move(target.name), std::move(target.selectors));
+	}
+	if (auto* constant = ctx->unsignedConstant())
+		return unsignedConstant(constant);
+	if (auto* b = ctx->bool_())
+		return program->make<Literal>(Value{b->TRUE() != nullptr});
+	if (auto* func = ctx->functionDesignator()) {
+		std::vector<ExprPtr> args;
+		for (const auto& param : func->parameterList()->actualParameter()) {
+			if (!param->parameterwidth().empty())
+				throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Unexpected format specifier: " + param->getText());
+			args.push_back(expression(param->expression()));
+		}
+		return program->make<FunctionCall>(func->identifier()->getText(), std::move(args));
+	}
+	throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Unsupported expression: " + ctx->getText());
+}
+
+ExprPtr AstBuilder::unsignedConstant(PascalParser::UnsignedConstantContext *ctx) {
+	if (auto* number = ctx->unsignedNumber())
+		return unsignedNumber(number);
+	if (auto* str = ctx->string())
+		return program->make<Literal>(Value{unquote(str->getText())});
+	throw parse_error(__FILE__, typeid(*this).name(), __LINE__, "Unsupported constant: " + ctx->getText());
+}
+
+ExprPtr AstBuilder::unsignedNumber(PascalParser::UnsignedNumberContext *ctx) {
+	if (auto* real = ctx->unsignedReal())
+		return program->make<Literal>(Value{std::stod(real->getText())});
+	return program->make<Literal>(Value{std::stoi(ctx->unsignedInteger()->getText())});
+}
@@ -0,0 +1,56 @@
+#ifndef __AST_BUILDER_H__
+#define __AST_BUILDER_H__
+
+#include "ast.h"
+#include "exceptions.h"
+#include "tokenizer.h"
+#include <PascalParser.h>
+#include <map>
+#include <string>
+
+
+using namespace ANTLRPascalParser;
+
+// Lowers the ANTLR parse tree into the interpreter AST
+class AstBuilder {
+	ast::Program* program = nullptr; //owns the nodes being built
+	std::map<std::string, TypeRef> named; //of the type definitions
+	const std::vector<ast::Decl>* locals = nullptr; //of the routine being built
+public:
+	std::unique_ptr<ast::Program> build(PascalParser::ProgramContext *ctx);
+
+private:
+	ast::NodePtr<ast::Compound> block(PascalParser::BlockContext *ctx, std::vector<ast::Decl>& decls, bool outer);
+	void constants(PascalParser::ConstantDefinitionPartContext *ctx, std::vector<ast::Decl>& decls);
+	void routine(PascalParser::ProcedureOrFunctionDeclarationContext *ctx);
+	TypeRef type(PascalParser::Type_Context *ctx);
+	TypeRef typeIdentifier(PascalParser::TypeIdentifierContext *ctx);
+	TypeRef arrayType(PascalParser::ArrayTypeContext *ctx);
+	TypeRef recordType(PascalParser::RecordTypeContext *ctx);
+	[[nodiscard]] const ast::Decl* constant(const std::string& name) const;
+	int32_t bound(PascalParser::ConstantContext *ctx);
+	Value label(PascalParser::ConstantContext *ctx);
+	ast::Target variable(PascalParser::VariableContext *ctx);
+
+	ast::NodePtr<ast::Compound> compoundStatement(PascalParser::CompoundStatementContext *ctx);
+	ast::StmtPtr statement(PascalParser::StatementContext *ctx);
+	ast::StmtPtr simpleStatement(PascalParser::SimpleStatementContext *ctx);
+	ast::StmtPtr structuredStatement(PascalParser::StructuredStatementContext *ctx);
+	ast::StmtPtr assignmentStatement(PascalParser::AssignmentStatementContext *ctx);
+	ast::StmtPtr procedureStatement(PascalParser::ProcedureStatementContext *ctx);
+	ast::StmtPtr ifStatement(PascalParser::IfStatementContext *ctx);
+	ast::StmtPtr whileStatement(PascalParser::WhileStatementContext *ctx);
+	ast::StmtPtr forStatement(PascalParser::ForStatementContext *ctx);
+	ast::StmtPtr caseStatement(PascalParser::CaseStatementContext *ctx);
+
+	ast::ExprPtr expression(PascalParser::ExpressionContext *ctx);
+	ast::ExprPtr simpleExpression(PascalParser::SimpleExpressionContext *ctx);
+	ast::ExprPtr term(PascalParser::TermContext *ctx);
+	ast::ExprPtr signedFactor(PascalParser::SignedFactorContext *ctx);
+	ast::ExprPtr factor(PascalParser::FactorContext *ctx);
+	ast::ExprPtr unsignedConstant(PascalParser::UnsignedConstantContext *ctx);
+	ast::ExprPtr unsignedNumber(PascalParser::UnsignedNumberContext *ctx);
+};
+
+
+#endif
@@ -300,6 +300,11 @@ WS
     : [ \t\r\n] -> skip
     ;
 
+// before COMMENT_2, which matches the same text
+PARALLEL
+    : '{$PARALLEL}'
+    ;
+
 COMMENT_1
     : '(*' .*? '*)' -> skip
     ;
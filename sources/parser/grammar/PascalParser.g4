@@ -422,11 +422,15 @@ ifStatement
     ;
 
 caseStatement
-    : CASE expression OF caseListElement (SEMI caseListElement)* (SEMI ELSE statements)? END
+    : CASE expression OF caseListElement (SEMI caseListElement)* (SEMI? ELSE statements)? SEMI? END
     ;
 
 caseListElement
-    : constList COLON statement
+    : caseLabel (COMMA caseLabel)* COLON statement
+    ;
+
+caseLabel
+    : constant (DOTDOT constant)?
     ;
 
 repetetiveStatement
@@ -444,7 +448,7 @@ repeatStatement
     ;
 
 forStatement
-    : FOR identifier ASSIGN forList DO statement
+    : PARALLEL? FOR identifier ASSIGN forList DO statement
     ;
 
 forList
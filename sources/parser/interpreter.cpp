@@ -0,0 +1,199 @@
+#include "interpreter.h"
+#include <optional>
+#include <utility>
+
+#include "cache.h"
+#include "compiler.h"
+#include "pascal_parser.h"
+
+namespace {
+
+// Gives every string its own payload and pins it, copies made by the runs never count
+void pin(std::vector<Value>& values) {
+	for (auto& val : values) {
+		if (val.type() != DataType::String || !val.value.string_ptr) continue;
+		val = Value{val.str()};
+		val.value.string_ptr->refs = StringData::pinned;
+	}
+}
+
+void unpin(std::vector<Value>& values) noexcept {
+	for (auto& val : values)
+		if (val.type() == DataType::String && val.value.string_ptr)
+			val.value.string_ptr->refs = 1;
+}
+
+}
+
+//-------------------------CompiledProgram------------------------------------
+
+CompiledProgram::CompiledProgram(Chunk chunk) : code(std::move(chunk)) {
+	pin(code.constants);
+	pin(code.globals);
+	for (auto& routine : code.routines)
+		pin(routine.frame);
+}
+
+CompiledProgram::~CompiledProgram() {
+	unpin(code.constants);
+	unpin(code.globals);
+	for (auto& routine : code.routines)
+		unpin(routine.frame);
+}
+
+//-------------------------ExecutionContext------------------------------------
+
+ExecutionContext::ExecutionContext(std::istream& in, std::ostream& out, const Options& options) : vm(options, in, out) {}
+
+Status ExecutionContext::run(std::shared_ptr<const CompiledProgram> program) {
+	// the frame still holds values of the last program until the run replaces it
+	const auto last = std::exchange(loaded, std::move(program));
+	try {
+		vm.run(loaded->chunk());
+	} catch (std::exception& e) {
+		return {e.what()};
+	}
+	return {};
+}
+
+const Value* ExecutionContext::variable(const CompiledProgram& program, std::string_view name) const {
+	const auto& symbols = program.chunk().symbols;
+	const auto it = symbols.find(std::string(name));
+	if (it == symbols.end() || it->second.hidden || loaded.get() != &program) return nullptr;
+	const auto slot = static_cast<size_t>(it->second.slot);
+	return slot < vm.program.frame.size() ? &vm.program.frame[slot] : nullptr;
+}
+
+Status ExecutionContext::start(std::shared_ptr<const CompiledProgram> program) {
+	const auto last = std::exchange(loaded, std::move(program));
+	try {
+		vm.start(loaded->chunk());
+	} catch (std::exception& e) {
+		return {e.what()};
+	}
+	return {};
+}
+
+SliceResult ExecutionContext::resume(uint64_t steps) {
+	SliceResult res;
+	try {
+		res.progress = vm.resume(steps);
+	} catch (std::exception& e) {
+		res.error = e.what();
+	}
+	return res;
+}
+
+void ExecutionContext::dump(const CompiledProgram& program, std::ostream& os) const {
+	for (const auto& [name, symbol] : program.chunk().symbols) {
+		const auto* val = variable(program, name);
+		if (!val) continue;
+		if (symbol.is_const) os << "const ";
+		os << name << " = " << *val << std::endl;
+	}
+}
+
+//-------------------------Scheduler------------------------------------
+
+Scheduler::Entry::Entry(std::shared_ptr<const CompiledProgram> program, std::istream& in, const Options& options)
+	: program(std::move(program)), context(in, out, options) {}
+
+Scheduler::Scheduler(const Options& options, uint64_t slice) : options(options), slice(std::max<uint64_t>(slice, 1)) {}
+
+Scheduler::Task Scheduler::spawn(std::shared_ptr<const CompiledProgram> program) {
+	const auto task = next++;
+	auto& entry = *tasks.emplace(task, std::make_unique<Entry>(std::move(program), none, options)).first->second;
+	entry.status = entry.context.start(entry.program);
+	if (!entry.status) {
+		entry.done = true;
+		return task;
+	}
+	entry.context.feed({});
+	ready.push_back(task);
+	return task;
+}
+
+void Scheduler::wake(Task task, Entry& entry) {
+	if (!entry.waiting) return;
+	entry.waiting = false;
+	ready.push_back(task);
+}
+
+void Scheduler::feed(Task task, std::string_view text) {
+	auto& entry = *tasks.at(task);
+	if (entry.done) return;
+	entry.context.feed(text);
+	wake(task, entry);
+}
+
+void Scheduler::close_input(Task task) {
+	auto& entry = *tasks.at(task);
+	if (entry.done) return;
+	entry.context.close_input();
+	wake(task, entry);
+}
+
+bool Scheduler::step() {
+	while (!ready.empty()) {
+		const auto task = ready.front();
+		ready.pop_front();
+		const auto it = tasks.find(task);
+		if (it == tasks.end()) continue;
+		auto& entry = *it->second;
+		const auto res = entry.context.resume(slice);
+		if (res.progress == Progress::Yielded) ready.push_back(task);
+		else if (res.progress == Progress::Waiting) entry.waiting = true;
+		else {
+			entry.status = res;
+			entry.done = true;
+		}
+		return true;
+	}
+	return false;
+}
+
+void Scheduler::run() {
+	while (step()) {}
+}
+
+std::string Scheduler::output(Task task) {
+	auto& out = tasks.at(task)->out;
+	auto res = out.str();
+	out.str({});
+	return res;
+}
+
+void Scheduler::dump(Task task, std::ostream& os) const {
+	const auto& entry = *tasks.at(task);
+	entry.context.dump(*entry.program, os);
+}
+
+//-------------------------Interpreter------------------------------------
+
+CompileResult Interpreter::compile(const std::string& source) const {
+	CompileResult res;
+	try {
+		std::optional<ChunkCache> cache;
+		if (!options.cache_dir.empty()) cache.emplace(options.cache_dir);
+		auto chunk = cache ? cache->load(source) : std::nullopt;
+		if (!chunk) {
+			Compiler compiler;
+			chunk = compiler.compile(*Runtime::analyze(source, options));
+			if (cache) cache->store(source, *chunk);
+		}
+		res.program = std::make_shared<const CompiledProgram>(std::move(*chunk));
+	} catch (std::exception& e) {
+		res.error = e.what();
+	}
+	return res;
+}
+
+ExecutionContext Interpreter::context(std::istream& in, std::ostream& out) const {
+	return ExecutionContext(in, out, options);
+}
+
+Status Interpreter::run(const std::string& source, std::istream& in, std::ostream& out) const {
+	auto compiled = compile(source);
+	if (!compiled) return compiled;
+	return context(in, out).run(std::move(compiled.program));
+}
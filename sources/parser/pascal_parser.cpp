@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include "pascal_parser.h"
 #include <antlr4-runtime.h>
@@ -5,33 +8,236 @@
 
 #include <PascalLexer.h>
 #include <PascalParser.h>
-#include "visitor.h"
+#include "ast_builder.h"
+#include "checker.h"
+#include "descent_parser.h"
+#include "emitter.h"
+#include "interpreter.h"
+#include "optimizer.h"
 
 using namespace antlr4;
 using namespace ANTLRPascalParser;
 
-void ::Runtime::run(const std::string& infix) {
+namespace {
+
+// Collects the syntax errors instead of printing them to the console
+class SyntaxErrors : public BaseErrorListener {
+public:
+	std::string messages;
+
+	void syntaxError(Recognizer*, Token*, size_t line, size_t column, const std::string& msg, std::exception_ptr) override {
+		if (!messages.empty()) messages += '\n';
+		messages += "line " + std::to_string(line) + ":" + std::to_string(column) + " " + msg;
+	}
+};
+
+std::unique_ptr<ast::Program> antlr_parse(const std::string& infix) {
 	ANTLRInputStream input(infix);
 	PascalLexer lexer(&input);
 	CommonTokenStream tokens(&lexer);
 	PascalParser parser(&tokens);
+	SyntaxErrors errors;
+	lexer.removeErrorListeners();
+	lexer.addErrorListener(&errors);
+	parser.removeErrorListeners();
+	parser.addErrorListener(&errors);
 
 	PascalParser::ProgramContext* tree;
 	try{
 		tree = parser.program();
 	} catch(ParseCancellationException& e){
-		std::cerr << e.what();
-		exit(1);
+		throw std::runtime_error(e.what());
 	}
-	Visitor visitor;
-	try {
-		visitor.visit(tree);
-	} catch(std::exception& e){
-		std::cerr << e.what() << std::endl;
+	if (!errors.messages.empty()) throw std::runtime_error(errors.messages);
+	AstBuilder builder;
+	return builder.build(tree);
+}
+
+//-------------------------validation------------------------------------
+
+bool same(const Value& lhs, const Value& rhs) {
+	if (lhs.type() != rhs.type()) return false;
+	if (lhs.type() == DataType::String) return lhs.str() == rhs.str();
+	return std::memcmp(&lhs.value, &rhs.value, sizeof(lhs.value)) == 0;
+}
+
+bool same(const ast::Expr* lhs, const ast::Expr* rhs);
+
+bool same(const std::vector<ast::ExprPtr>& lhs, const std::vector<ast::ExprPtr>& rhs) {
+	return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+					  [](const ast::ExprPtr& a, const ast::ExprPtr& b) { return same(a.get(), b.get()); });
+}
+
+bool same(const std::vector<ast::Selector>& lhs, const std::vector<ast::Selector>& rhs) {
+	return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const ast::Selector& a, const ast::Selector& b) {
+		return a.field == b.field && same(a.indices, b.indices);
+	});
+}
+
+bool same(const ast::Target& lhs, const ast::Target& rhs) {
+	return lhs.name == rhs.name && same(lhs.selectors, rhs.selectors);
+}
+
+bool same(const ast::Expr* lhs, const ast::Expr* rhs) {
+	using namespace ast;
+	if (!lhs || !rhs) return lhs == rhs;
+	if (lhs->kind != rhs->kind) return false;
+	switch (lhs->kind) {
+		case Expr::Kind::Literal:
+			return same(lhs->as<Literal>().value, rhs->as<Literal>().value);
+		case Expr::Kind::Variable:
+			return lhs->as<Variable>().name == rhs->as<Variable>().name;
+		case Expr::Kind::Unary:
+			return lhs->as<Unary>().op == rhs->as<Unary>().op
+				&& same(lhs->as<Unary>().operand.get(), rhs->as<Unary>().operand.get());
+		case Expr::Kind::Binary: {
+			const auto& l = lhs->as<Binary>();
+			const auto& r = rhs->as<Binary>();
+			return l.op == r.op && same(l.lhs.get(), r.lhs.get()) && same(l.rhs.get(), r.rhs.get());
+		}
+		case Expr::Kind::Element:
+			return lhs->as<Element>().name == rhs->as<Element>().name
+				&& same(lhs->as<Element>().selectors, rhs->as<Element>().selectors);
+		case Expr::Kind::Call:
+			return lhs->as<FunctionCall>().name == rhs->as<FunctionCall>().name
+				&& same(lhs->as<FunctionCall>().args, rhs->as<FunctionCall>().args);
 	}
-	std::cout << "================Dumping variables================" << std::endl;
-	for(auto& a : visitor.program.vars) {
-		if(a.second.is_const()) std::cout << "const ";
-		cout << a.first << " = " << a.second << endl;
+	return false;
+}
+
+bool same(const ast::Stmt* lhs, const ast::Stmt* rhs) {
+	using namespace ast;
+	if (!lhs || !rhs) return lhs == rhs;
+	if (lhs->kind != rhs->kind || lhs->source_line != rhs->source_line) return false;
+	switch (lhs->kind) {
+		case Stmt::Kind::Compound: {
+			const auto& l = lhs->as<Compound>().body;
+			const auto& r = rhs->as<Compound>().body;
+			return std::equal(l.begin(), l.end(), r.begin(), r.end(),
+							  [](const StmtPtr& a, const StmtPtr& b) { return same(a.get(), b.get()); });
+		}
+		case Stmt::Kind::Assign:
+			return same(lhs->as<Assign>().target, rhs->as<Assign>().target)
+				&& same(lhs->as<Assign>().value.get(), rhs->as<Assign>().value.get());
+		case Stmt::Kind::Call: {
+			const auto& l = lhs->as<Call>();
+			const auto& r = rhs->as<Call>();
+			return l.name == r.name && same(l.args, r.args)
+				&& std::equal(l.formats.begin(), l.formats.end(), r.formats.begin(), r.formats.end(),
+							  [](const Format& a, const Format& b) {
+								  return same(a.width.get(), b.width.get()) && same(a.decimals.get(), b.decimals.get());
+							  });
+		}
+		case Stmt::Kind::Read: {
+			const auto& l = lhs->as<Read>();
+			const auto& r = rhs->as<Read>();
+			return l.line == r.line && std::equal(l.targets.begin(), l.targets.end(), r.targets.begin(), r.targets.end(),
+												  [](const Target& a, const Target& b) { return same(a, b); });
+		}
+		case Stmt::Kind::If: {
+			const auto& l = lhs->as<If>();
+			const auto& r = rhs->as<If>();
+			return same(l.cond.get(), r.cond.get()) && same(l.then_branch.get(), r.then_branch.get())
+				&& same(l.else_branch.get(), r.else_branch.get());
+		}
+		case Stmt::Kind::While:
+			return same(lhs->as<While>().cond.get(), rhs->as<While>().cond.get())
+				&& same(lhs->as<While>().body.get(), rhs->as<While>().body.get());
+		case Stmt::Kind::For: {
+			const auto& l = lhs->as<For>();
+			const auto& r = rhs->as<For>();
+			return l.var == r.var && l.down == r.down && l.parallel == r.parallel && same(l.from.get(), r.from.get())
+				&& same(l.to.get(), r.to.get()) && same(l.body.get(), r.body.get());
+		}
+		case Stmt::Kind::Case: {
+			const auto& l = lhs->as<Case>();
+			const auto& r = rhs->as<Case>();
+			return same(l.selector.get(), r.selector.get()) && same(l.else_branch.get(), r.else_branch.get())
+				&& std::equal(l.arms.begin(), l.arms.end(), r.arms.begin(), r.arms.end(), [](const Case::Arm& a, const Case::Arm& b) {
+					   return same(a.body.get(), b.body.get())
+						   && std::equal(a.labels.begin(), a.labels.end(), b.labels.begin(), b.labels.end(),
+										 [](const Case::Label& x, const Case::Label& y) { return same(x.low, y.low) && same(x.high, y.high); });
+				   });
+		}
 	}
+	return false;
+}
+
+bool same(const std::vector<ast::Decl>& lhs, const std::vector<ast::Decl>& rhs) {
+	return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const ast::Decl& a, const ast::Decl& b) {
+		return a.name == b.name && a.type == b.type && a.is_const == b.is_const && same(a.value, b.value)
+			&& a.aggregate == b.aggregate && a.by_ref == b.by_ref;
+	});
+}
+
+bool same(const ast::Program& lhs, const ast::Program& rhs) {
+	return lhs.name == rhs.name && same(lhs.body.get(), rhs.body.get()) && lhs.types == rhs.types && same(lhs.decls, rhs.decls)
+		&& std::equal(lhs.routines.begin(), lhs.routines.end(), rhs.routines.begin(), rhs.routines.end(),
+					  [](const ast::Routine& a, const ast::Routine& b) {
+						  return a.name == b.name && a.result == b.result && a.source_line == b.source_line
+							  && same(a.params, b.params) && same(a.decls, b.decls) && same(a.body.get(), b.body.get());
+					  });
+}
+
+}
+
+std::unique_ptr<ast::Program> Runtime::parse(const std::string& infix, const Options& options) {
+	switch (options.frontend) {
+		case Frontend::Antlr:
+			return antlr_parse(infix);
+		case Frontend::Validate: {
+			auto expected = antlr_parse(infix);
+			std::unique_ptr<ast::Program> res;
+			try {
+				res = DescentParser(infix).parse();
+			} catch (std::exception& e) {
+				throw std::runtime_error(std::string("Front ends disagree: ") + e.what());
+			}
+			if (!same(*expected, *res)) throw std::runtime_error("Front ends disagree on the syntax tree");
+			return res;
+		}
+		default:
+			// the ANTLR parser reports the errors, the fast path only handles programs it fully understands
+			try {
+				return DescentParser(infix).parse();
+			} catch (std::exception&) {
+				return antlr_parse(infix);
+			}
+	}
+}
+
+std::unique_ptr<ast::Program> Runtime::analyze(const std::string& infix, const Options& options) {
+	TypeChecker checker;
+	Optimizer optimizer;
+	auto program = parse(infix, options);
+	checker.check(*program);
+	optimizer.optimize(*program);
+	return program;
+}
+
+bool ::Runtime::run(const std::string& infix, const Options& options) {
+	Interpreter interpreter(options);
+	auto context = interpreter.context(std::cin, std::cout);
+	const auto compiled = interpreter.compile(infix);
+	const auto status = compiled ? context.run(compiled.program) : Status{compiled.error};
+	if (!status) std::cerr << status.error << std::endl;
+	if (compiled && options.profile) {
+		context.profile().report(std::cerr, infix);
+		if (!options.flamegraph.empty()) {
+			std::ofstream fout(options.flamegraph);
+			if (!fout.is_open()) std::cerr << "Can't write " << options.flamegraph << std::endl;
+			context.profile().folded(fout);
+		}
+	}
+	// a program that ran is dumped also when it failed
+	if (compiled && options.dump) {
+		std::cout << "================Dumping variables================" << std::endl;
+		context.dump(*compiled.program, std::cout);
+	}
+	return status.ok();
+}
+
+std::string Runtime::emit_c(const std::string& infix, const Options& options) {
+	CEmitter emitter;
+	return emitter.emit(*analyze(infix, options), options.dump);
 }
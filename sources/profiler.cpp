@@ -0,0 +1,140 @@
+#include "profiler.h"
+#include <algorithm>
+#include <iomanip>
+#include <unordered_map>
+
+namespace {
+
+// Loop head of a back edge instruction, -1 for every other instruction
+int32_t loop_head(const Instruction& ins, int32_t pc) {
+	switch (ins.op) {
+		case OpCode::Jump: return ins.a < pc ? ins.a : -1;
+		case OpCode::ForNext:
+		case OpCode::ForPrev: return ins.b;
+		default: return -1;
+	}
+}
+
+const char* builtin(OpCode op) {
+	switch (op) {
+		case OpCode::Write: return "Write";
+		case OpCode::Writeln: return "Writeln";
+		case OpCode::Read: return "Read";
+		case OpCode::ReadLine: return "Readln";
+		default: return nullptr;
+	}
+}
+
+std::string frame(const char* what, uint32_t line) {
+	return line ? std::string(what) + " " + std::to_string(line) : std::string("program");
+}
+
+}
+
+Profiler::Profiler(const Chunk& chunk, Profile& profile)
+	: chunk(chunk), profile(profile), segments(chunk.code.size()), counted(chunk.code.size()), hits(chunk.code.size()) {
+	const auto size = static_cast<int32_t>(chunk.code.size());
+	const auto line = [&](int32_t pc) { return static_cast<size_t>(pc) < chunk.lines.size() ? chunk.lines[pc] : 0u; };
+
+	// structured code only produces nested loops, a stack of the open ones gives the enclosing loops
+	std::vector<std::pair<int32_t, int32_t>> loops; // head, back edge
+	for (int32_t pc = 0; pc < size; ++pc)
+		if (const auto head = loop_head(chunk.code[pc], pc); head >= 0) loops.emplace_back(head, pc);
+	std::sort(loops.begin(), loops.end(), [](const auto& l, const auto& r) {
+		return l.first != r.first ? l.first < r.first : l.second > r.second;
+	});
+
+	std::vector<std::pair<int32_t, std::string>> open{{size, chunk.program_name}}; // back edge, stack up to the loop
+	std::unordered_map<std::string, uint32_t> ids;
+	size_t next = 0;
+	for (int32_t pc = 0; pc < size; ++pc) {
+		// the code of a routine is its own, whoever calls it
+		for (const auto& routine : chunk.routines)
+			if (routine.entry == pc) open = {{size, chunk.program_name + ";" + routine.name}};
+		while (open.back().first < pc) open.pop_back();
+		for (; next < loops.size() && loops[next].first == pc; ++next)
+			open.emplace_back(loops[next].second, open.back().second + ";" + frame("loop at line", line(pc)));
+		auto stack = open.back().second;
+		if (line(pc)) stack += ";" + frame("line", line(pc));
+		const auto [it, added] = ids.emplace(stack, static_cast<uint32_t>(stacks.size()));
+		if (added) {
+			stacks.push_back(std::move(stack));
+			lines.push_back(line(pc));
+		}
+		segments[pc] = it->second;
+		counted[pc] = loop_head(chunk.code[pc], pc) >= 0 || builtin(chunk.code[pc].op);
+	}
+	for (const auto pc : chunk.statements) counted[pc] = 1;
+	spent.assign(stacks.size(), 0);
+	start = mark = clock::now();
+}
+
+void Profiler::enter(uint32_t segment) {
+	const auto now = clock::now();
+	if (current != none) spent[current] += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - mark).count());
+	mark = now;
+	current = segment;
+}
+
+void Profiler::finish() {
+	enter(none);
+	profile.program_name = chunk.program_name;
+	profile.nanoseconds += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(mark - start).count());
+	const auto size = static_cast<int32_t>(chunk.code.size());
+	for (const auto pc : chunk.statements)
+		profile.lines[pc < static_cast<int32_t>(chunk.lines.size()) ? chunk.lines[pc] : 0].executions += hits[pc];
+	for (int32_t pc = 0; pc < size; ++pc) {
+		if (!hits[pc]) continue;
+		const auto& ins = chunk.code[pc];
+		if (const auto head = loop_head(ins, pc); head >= 0)
+			profile.lines[lines[segments[head]]].iterations += hits[pc];
+		if (const auto* name = builtin(ins.op)) profile.builtins[name] += hits[pc];
+	}
+	for (size_t segment = 0; segment < spent.size(); ++segment) {
+		if (!spent[segment]) continue;
+		profile.lines[lines[segment]].nanoseconds += spent[segment];
+		profile.stacks[stacks[segment]] += spent[segment];
+	}
+}
+
+void Profile::report(std::ostream& os, std::string_view source, size_t limit) const {
+	std::vector<std::string_view> text;
+	for (size_t pos = 0; pos <= source.size() && !source.empty();) {
+		const auto end = std::min(source.find('\n', pos), source.size());
+		text.push_back(source.substr(pos, end - pos));
+		pos = end + 1;
+	}
+	std::vector<std::pair<uint32_t, const LineStats*>> hot;
+	for (const auto& [line, stats] : lines) hot.emplace_back(line, &stats);
+	std::stable_sort(hot.begin(), hot.end(), [](const auto& l, const auto& r) { return l.second->nanoseconds > r.second->nanoseconds; });
+	if (hot.size() > limit) hot.resize(limit);
+
+	const auto flags = os.flags();
+	const auto total = static_cast<double>(std::max<uint64_t>(nanoseconds, 1));
+	os << "================Profile of " << program_name << ": " << std::fixed << std::setprecision(3)
+	   << nanoseconds / 1e6 << " ms================" << std::endl
+	   << "    line  executions  iterations          ms       %  source" << std::endl;
+	for (const auto& [line, stats] : hot) {
+		os << std::setw(8) << line << std::setw(12) << stats->executions << std::setw(12) << stats->iterations
+		   << std::setw(12) << stats->nanoseconds / 1e6 << std::setw(7) << std::setprecision(1)
+		   << 100 * stats->nanoseconds / total << "%  " << std::setprecision(3);
+		if (line == 0) os << "(outside statements)";
+		else if (line <= text.size()) {
+			auto code = text[line - 1];
+			code.remove_prefix(std::min(code.find_first_not_of(" \t"), code.size()));
+			os << code.substr(0, 60);
+		}
+		os << std::endl;
+	}
+	if (!builtins.empty()) {
+		os << "builtins:";
+		for (const auto& [name, count] : builtins) os << " " << name << " " << count;
+		os << std::endl;
+	}
+	os.flags(flags);
+}
+
+void Profile::folded(std::ostream& os) const {
+	for (const auto& [stack, ns] : stacks)
+		os << stack << ' ' << ns << '\n';
+}
@@ -0,0 +1,93 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+// index of the pool's worker running on this thread
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+
+}
+
+ThreadPool::ThreadPool(unsigned threads) {
+	threads = std::max(threads, 1u);
+	for (unsigned i = 0; i < threads; ++i)
+		queues.push_back(std::make_unique<Queue>());
+	for (unsigned i = 0; i < threads; ++i)
+		workers.emplace_back(&ThreadPool::work, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& worker : workers) worker.join();
+}
+
+void ThreadPool::submit(Task task) {
+	const auto target = current_pool == this ? current_worker : next++ % queues.size();
+	unfinished.fetch_add(1);
+	{
+		std::lock_guard guard(queues[target]->lock);
+		queues[target]->tasks.push_back(std::move(task));
+	}
+	{
+		std::lock_guard guard(lock);
+		++queued;
+	}
+	wake.notify_one();
+}
+
+// Own deque from the back, then the others from the front
+bool ThreadPool::take(size_t self, Task& task) {
+	for (size_t i = 0; i < queues.size(); ++i) {
+		auto& queue = *queues[(self + i) % queues.size()];
+		std::lock_guard guard(queue.lock);
+		if (queue.tasks.empty()) continue;
+		if (i == 0) {
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+		} else {
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+		}
+		return true;
+	}
+	return false;
+}
+
+void ThreadPool::work(size_t self) {
+	current_pool = this;
+	current_worker = self;
+	for (;;) {
+		{
+			std::unique_lock guard(lock);
+			wake.wait(guard, [this] { return stopping || queued > 0; });
+			if (queued == 0) return;
+			--queued;
+		}
+		// a task is reserved for this worker, it may still have to steal it
+		Task task;
+		while (!take(self, task))
+			std::this_thread::yield();
+		try {
+			task();
+		} catch (...) {
+			std::lock_guard guard(lock);
+			if (!error) error = std::current_exception();
+		}
+		if (unfinished.fetch_sub(1) == 1) {
+			std::lock_guard guard(lock);
+			idle.notify_all();
+		}
+	}
+}
+
+void ThreadPool::wait() {
+	std::unique_lock guard(lock);
+	idle.wait(guard, [this] { return unfinished.load() == 0; });
+	if (auto res = std::exchange(error, nullptr)) std::rethrow_exception(res);
+}
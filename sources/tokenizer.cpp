@@ -0,0 +1,218 @@
+#include "tokenizer.h"
+#include <array>
+#include <vector>
+
+namespace {
+
+struct Keyword {
+	std::string_view name;
+	TokenKind kind;
+};
+
+constexpr Keyword keywords[] = {
+		{"AND",             TokenKind::And},
+		{"ARRAY",           TokenKind::Array},
+		{"BEGIN",           TokenKind::Begin},
+		{"BOOLEAN",         TokenKind::Boolean},
+		{"CASE",            TokenKind::Case},
+		{"CHAR",            TokenKind::Char},
+		{"CONST",           TokenKind::Const},
+		{"DIV",             TokenKind::Div},
+		{"DO",              TokenKind::Do},
+		{"DOWNTO",          TokenKind::Downto},
+		{"ELSE",            TokenKind::Else},
+		{"END",             TokenKind::End},
+		{"FALSE",           TokenKind::False},
+		{"FOR",             TokenKind::For},
+		{"FUNCTION",        TokenKind::Function},
+		{"IF",              TokenKind::If},
+		{"INTEGER",         TokenKind::Integer},
+		{"MOD",             TokenKind::Mod},
+		{"NOT",             TokenKind::Not},
+		{"OF",              TokenKind::Of},
+		{"OR",              TokenKind::Or},
+		{"PROCEDURE",       TokenKind::Procedure},
+		{"PROGRAM",         TokenKind::Program},
+		{"REAL",            TokenKind::Real},
+		{"RECORD",          TokenKind::Record},
+		{"STRING",          TokenKind::String},
+		{"THEN",            TokenKind::Then},
+		{"TO",              TokenKind::To},
+		{"TRUE",            TokenKind::True},
+		{"TYPE",            TokenKind::Type},
+		{"VAR",             TokenKind::Var},
+		{"WHILE",           TokenKind::While},
+		{"CHR",             TokenKind::Reserved},
+		{"FILE",            TokenKind::Reserved},
+		{"GOTO",            TokenKind::Reserved},
+		{"IN",              TokenKind::Reserved},
+		{"LABEL",           TokenKind::Reserved},
+		{"NIL",             TokenKind::Reserved},
+		{"PACKED",          TokenKind::Reserved},
+		{"REPEAT",          TokenKind::Reserved},
+		{"SET",             TokenKind::Reserved},
+		{"UNTIL",           TokenKind::Reserved},
+		{"WITH",            TokenKind::Reserved},
+		{"UNIT",            TokenKind::Reserved},
+		{"INTERFACE",       TokenKind::Reserved},
+		{"USES",            TokenKind::Reserved},
+		{"IMPLEMENTATION",  TokenKind::Reserved},
+};
+
+constexpr size_t longest_keyword = 14;
+constexpr std::string_view parallel = "{$PARALLEL}";
+
+// keywords grouped by their first letter, most identifiers are rejected after a length compare or two
+const auto buckets = [] {
+	std::array<std::vector<Keyword>, 26> res;
+	for (const auto& keyword : keywords)
+		res[keyword.name[0] - 'A'].push_back(keyword);
+	return res;
+}();
+
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+bool is_alpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+
+TokenKind word(std::string_view text) {
+	if (text.size() > longest_keyword) return TokenKind::Identifier;
+	char upper[longest_keyword];
+	for (size_t i = 0; i < text.size(); ++i)
+		upper[i] = text[i] >= 'a' && text[i] <= 'z' ? static_cast<char>(text[i] - 'a' + 'A') : text[i];
+	const std::string_view name{upper, text.size()};
+	for (const auto& keyword : buckets[upper[0] - 'A'])
+		if (keyword.name == name) return keyword.kind;
+	return TokenKind::Identifier;
+}
+
+// the text starts with the {$PARALLEL} directive, in any case like the keywords
+bool is_parallel(std::string_view text) {
+	if (text.size() < parallel.size()) return false;
+	for (size_t i = 0; i < parallel.size(); ++i)
+		if ((text[i] >= 'a' && text[i] <= 'z' ? static_cast<char>(text[i] - 'a' + 'A') : text[i]) != parallel[i]) return false;
+	return true;
+}
+
+}
+
+std::string unquote(std::string_view literal) {
+	std::string res;
+	if (literal.size() < 2) return res;
+	res.reserve(literal.size() - 2);
+	for (size_t i = 1; i + 1 < literal.size(); ++i) {
+		res += literal[i];
+		if (literal[i] == '\'') ++i;
+	}
+	return res;
+}
+
+// Skips whitespace and comments, false on an unterminated comment
+bool Tokenizer::skip() {
+	while (pos < source.size()) {
+		const char c = source[pos];
+		if (c == '\n') {
+			++line;
+			++pos;
+		} else if (c == ' ' || c == '\t' || c == '\r') {
+			++pos;
+		} else if ((c == '{' && !is_parallel(source.substr(pos))) || (c == '(' && pos + 1 < source.size() && source[pos + 1] == '*')) {
+			const auto close = c == '{' ? source.find('}', pos + 1) : source.find("*)", pos + 2);
+			if (close == std::string_view::npos) return false;
+			const auto end = close + (c == '{' ? 1 : 2);
+			for (; pos < end; ++pos)
+				if (source[pos] == '\n') ++line;
+		} else {
+			break;
+		}
+	}
+	return true;
+}
+
+Lexeme Tokenizer::next() {
+	if (!skip()) {
+		const auto start = pos;
+		pos = source.size();
+		return {TokenKind::Other, source.substr(start), line};
+	}
+	const auto start = pos;
+	const auto at = line;
+	const auto token = [&](TokenKind kind) { return Lexeme{kind, source.substr(start, pos - start), at}; };
+	const auto peek = [&](size_t offset) { return pos + offset < source.size() ? source[pos + offset] : '\0'; };
+
+	if (pos == source.size()) return token(TokenKind::Eof);
+	const char c = source[pos];
+
+	if (is_alpha(c)) {
+		while (pos < source.size() && (is_alpha(source[pos]) || is_digit(source[pos]) || source[pos] == '_')) ++pos;
+		return token(word(source.substr(start, pos - start)));
+	}
+
+	if (is_digit(c)) {
+		while (is_digit(peek(0))) ++pos;
+		auto kind = TokenKind::IntegerConst;
+		if (peek(0) == '.' && is_digit(peek(1))) {
+			++pos;
+			while (is_digit(peek(0))) ++pos;
+			kind = TokenKind::RealConst;
+		}
+		if (peek(0) == 'e' || peek(0) == 'E') {
+			const size_t sign = peek(1) == '+' || peek(1) == '-';
+			if (is_digit(peek(1 + sign))) {
+				pos += 1 + sign;
+				while (is_digit(peek(0))) ++pos;
+				kind = TokenKind::RealConst;
+			}
+		}
+		return token(kind);
+	}
+
+	if (c == '\'') {
+		for (++pos; pos < source.size(); ++pos) {
+			if (source[pos] == '\n') ++line;
+			if (source[pos] != '\'') continue;
+			if (peek(1) != '\'') {
+				++pos;
+				return token(TokenKind::StringConst);
+			}
+			++pos;
+		}
+		return token(TokenKind::Other);
+	}
+
+	if (c == '{' && is_parallel(source.substr(pos))) {
+		pos += parallel.size();
+		return token(TokenKind::Parallel);
+	}
+
+	++pos;
+	switch (c) {
+		case '+': return token(TokenKind::Plus);
+		case '-': return token(TokenKind::Minus);
+		case '*': return token(TokenKind::Star);
+		case '/': return token(TokenKind::Slash);
+		case ',': return token(TokenKind::Comma);
+		case ';': return token(TokenKind::Semi);
+		case '=': return token(TokenKind::Equal);
+		case ')': return token(TokenKind::RParen);
+		case '[': return token(TokenKind::LBrack);
+		case ']': return token(TokenKind::RBrack);
+		case ':':
+			if (peek(0) == '=') return ++pos, token(TokenKind::Assign);
+			return token(TokenKind::Colon);
+		case '<':
+			if (peek(0) == '=') return ++pos, token(TokenKind::Le);
+			if (peek(0) == '>') return ++pos, token(TokenKind::NotEqual);
+			return token(TokenKind::Lt);
+		case '>':
+			if (peek(0) == '=') return ++pos, token(TokenKind::Ge);
+			return token(TokenKind::Gt);
+		case '(':
+			if (peek(0) == '.') return ++pos, token(TokenKind::LBrack);
+			return token(TokenKind::LParen);
+		case '.':
+			if (peek(0) == '.') return ++pos, token(TokenKind::DotDot);
+			if (peek(0) == ')') return ++pos, token(TokenKind::RBrack);
+			return token(TokenKind::Dot);
+		default:
+			return token(TokenKind::Other);
+	}
+}
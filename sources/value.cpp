@@ -1,61 +1,167 @@
 #include "value.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
 #include <stdexcept>
+#include <utility>
+
+namespace {
+
+// Released payloads of up to 256 bytes by size class, each thread reuses its
+// own before asking the heap. Blocks of every class are plain heap blocks, a
+// payload made by one thread may be released into the pool of another.
+struct StringPool {
+	static constexpr size_t granule = 16;
+	static constexpr size_t classes = 16;
+	static constexpr size_t depth = 1024; // blocks kept per class
+
+	struct Free {
+		Free* next;
+	};
+
+	Free* lists[classes];
+	size_t counts[classes];
+	bool closed; // the thread is exiting, blocks go straight back to the heap
+	StringStats stats;
+	MemoryMeter* meter;
+};
+
+thread_local StringPool pool{};
+
+// Returns the pooled blocks to the heap when the thread exits
+thread_local struct StringPoolGuard {
+	~StringPoolGuard() {
+		pool.closed = true;
+		for (auto* list : pool.lists)
+			while (list) ::operator delete(std::exchange(list, list->next));
+	}
+} pool_guard;
 
-Value::Value() : Value(DataType::Null, nullptr, false) {}
+size_t size_class(size_t bytes) noexcept {
+	return (bytes - 1) / StringPool::granule;
+}
 
-Value::Value(DataType type, const void* p, bool is_const) : _type(type), _const(is_const)  {
-	if (type == DataType::String)
-		value.string_ptr = new std::string();
-	else if (type == DataType::Null || type == DataType::Reference || !p)  return;
-	init_type(p);
 }
 
-Value::Value(const std::string& name, DataType type, const void* p, bool is_const) :_name(name), _type(type), _const(is_const)  {
-	if (type == DataType::String)
-		value.string_ptr = new std::string();
-	else if (type == DataType::Null || type == DataType::Reference || !p)  return;
-	init_type(p);
+void MemoryMeter::charge(size_t bytes) {
+	if (limit && bytes > limit - std::min(used, limit)) throw std::runtime_error("Memory limit exceeded");
+	used += bytes;
 }
 
+StringStats StringData::stats() noexcept {
+	return pool.stats;
+}
 
-Value::Value(const Value &v) : _name(v._name),_type(v._type), value(v.value), _const(v._const) {
-	if(_type == DataType::String)
-		value.string_ptr = new std::string(*v.value.string_ptr);
+MemoryMeter* StringData::install(MemoryMeter* meter) noexcept {
+	return std::exchange(pool.meter, meter);
 }
 
-Value::Value(Value &&moved) noexcept{
-	std::swap(_type, moved._type);
-	std::swap(value, moved.value);
-	std::swap(_name, moved._name);
+StringData* StringData::make(std::string_view lhs, std::string_view rhs, size_t capacity) {
+	constexpr size_t limit = UINT32_MAX - 64; // the size of the block fits the counters
+	const auto size = lhs.size() + rhs.size();
+	if (size > limit) throw std::runtime_error("String is too long");
+	capacity = std::min(std::max(capacity, size), limit);
+	if (capacity == 0) return nullptr;
+	auto bytes = sizeof(StringData) + capacity;
+	const auto index = size_class(bytes);
+	// the rest of a pooled block is room to grow
+	if (index < StringPool::classes) bytes = (index + 1) * StringPool::granule;
+	if (pool.meter) pool.meter->charge(bytes);
+	++pool.stats.made;
+	StringData* str;
+	if (index < StringPool::classes && pool.lists[index]) {
+		str = reinterpret_cast<StringData*>(std::exchange(pool.lists[index], pool.lists[index]->next));
+		--pool.counts[index];
+	} else {
+		++pool.stats.allocated;
+		str = static_cast<StringData*>(::operator new(bytes));
+	}
+	str->refs = 1;
+	str->size = static_cast<uint32_t>(size);
+	str->capacity = static_cast<uint32_t>(bytes - sizeof(StringData));
+	if (!lhs.empty()) std::memcpy(str->data(), lhs.data(), lhs.size());
+	if (!rhs.empty()) std::memcpy(str->data() + lhs.size(), rhs.data(), rhs.size());
+	return str;
+}
+
+StringData* StringData::append(StringData* str, std::string_view tail) {
+	if (tail.empty()) return str;
+	if (str && str->refs == 1 && tail.size() <= str->capacity - str->size) {
+		// the tail may be the payload itself, its characters are before the end
+		std::memcpy(str->data() + str->size, tail.data(), tail.size());
+		str->size += static_cast<uint32_t>(tail.size());
+		return str;
+	}
+	const std::string_view head = str ? std::string_view{str->data(), str->size} : std::string_view{};
+	// a payload only its caller holds is appended to again, a shared one is copied once
+	const auto capacity = str && str->refs == 1 ? 2 * (head.size() + tail.size()) : 0;
+	auto* res = make(head, tail, capacity);
+	release(str);
+	return res;
+}
+
+void StringData::release(StringData* str) noexcept {
+	if (!str || str->refs == pinned || --str->refs != 0) return;
+	const auto bytes = sizeof(StringData) + str->capacity;
+	if (pool.meter) pool.meter->credit(bytes);
+	const auto index = size_class(bytes);
+	if (index >= StringPool::classes || pool.closed || pool.counts[index] == StringPool::depth) {
+		::operator delete(str);
+		return;
+	}
+	// the first block a class keeps makes sure the thread frees them all on exit
+	if (!pool.lists[index]) (void)pool_guard;
+	auto* block = reinterpret_cast<StringPool::Free*>(str);
+	block->next = pool.lists[index];
+	pool.lists[index] = block;
+	++pool.counts[index];
+}
+
+std::string_view interpreter::substring(std::string_view str, int32_t index, int32_t count) noexcept {
+	const auto from = static_cast<size_t>(std::max(index, 1) - 1);
+	if (count <= 0 || from >= str.size()) return {};
+	return str.substr(from, static_cast<size_t>(count));
+}
+
+int32_t interpreter::position(std::string_view part, std::string_view str) noexcept {
+	const auto at = part.empty() ? std::string_view::npos : str.find(part);
+	return at == std::string_view::npos ? 0 : static_cast<int32_t>(at + 1);
+}
+
+Value::Value(DataType type) noexcept : _type(type) {}
+
+Value::Value(int v) noexcept : _type(DataType::Integer) { value.int_ptr = v; }
+
+Value::Value(double v) noexcept : _type(DataType::Double) { value.double_ptr = v; }
+
+Value::Value(bool v) noexcept : _type(DataType::Boolean) { value.bool_ptr = v; }
+
+Value::Value(char v) noexcept : _type(DataType::Char) { value.char_ptr = v; }
+
+Value::Value(std::string_view v) : _type(DataType::String) { value.string_ptr = StringData::make(v); }
+
+Value::Value(const Value &v) noexcept : _type(v._type), value(v.value) {
+	if (_type == DataType::String && value.string_ptr && value.string_ptr->refs != StringData::pinned)
+		++value.string_ptr->refs;
+}
+
+Value::Value(Value &&moved) noexcept : _type(moved._type), value(moved.value) {
+	moved._type = DataType::Null;
+	moved.value = {};
 }
 
 Value::~Value() {
 	if (_type == DataType::String)
-		delete value.string_ptr;
+		StringData::release(value.string_ptr);
 }
 
 DataType Value::type() const noexcept { return _type; }
 
 Value::operator bool() const noexcept { return _type == DataType::Null; }
 
-void Value::init_type(const void *val) {
-	switch(_type) {
-		case DataType::Integer:
-			 value.int_ptr =  *static_cast<const int *>(val) ;
-			break;
-		case DataType::Boolean:
-			value.bool_ptr =  *static_cast<const bool *>(val);
-			break;
-		case DataType::Double:
-		case DataType::Real:
-			value.double_ptr =*static_cast<const double *>(val) ;
-			break;
-		case DataType::String:
-			*value.string_ptr = val ? *static_cast<const std::string *>(val) : " ";
-			break;
-		case DataType::Null:
-			throw std::runtime_error("can't identificate type");
-	}
+std::string_view Value::str() const noexcept {
+	if (_type != DataType::String || !value.string_ptr) return {};
+	return {value.string_ptr->data(), value.string_ptr->size};
 }
 
 [[nodiscard]] bool interpreter::in_group(DataType type, TypeGroup group) {
@@ -77,37 +183,64 @@ void Value::init_type(const void *val) {
 }
 
 Value& Value::operator=(Value&& other) noexcept {
-	std::swap(_type, other._type);
-	std::swap(value, other.value);
+	if (this != &other) {
+		if (_type == DataType::String)
+			StringData::release(value.string_ptr);
+		_type = other._type;
+		value = other.value;
+		other._type = DataType::Null;
+		other.value = {};
+	}
 	return *this;
 }
 
-Value& Value::operator=(const Value& other)  {
+Value& Value::operator=(const Value& other) noexcept {
+	if (other._type == DataType::String && other.value.string_ptr && other.value.string_ptr->refs != StringData::pinned)
+		++other.value.string_ptr->refs;
+	if (_type == DataType::String)
+		StringData::release(value.string_ptr);
 	_type = other._type;
-	if(_type == DataType::String){
-		*value.string_ptr = *other.value.string_ptr;
-	}
 	value = other.value;
 	return *this;
 }
 
-bool Value::is_const() const noexcept { return _const;}
+namespace {
 
+bool is_number(DataType type) noexcept {
+	return in_group(type, TypeGroup::Numeric) || in_group(type, TypeGroup::Real);
+}
+
+double as_real(const Value& v) noexcept {
+	return in_group(v.type(), TypeGroup::Real) ? v.value.double_ptr : v.value.int_ptr;
+}
+
+template<typename T>
+int three_way(const T& lhs, const T& rhs) noexcept {
+	return lhs < rhs ? -1 : (rhs < lhs ? 1 : 0);
+}
+
+bool comparable(const Value& lhs, const Value& rhs) noexcept {
+	if (is_number(lhs.type()) && is_number(rhs.type())) return true;
+	return lhs.type() == rhs.type();
+}
+
+}
 
 int Value::cmp(const Value& other) const noexcept {
-	return std::memcmp(&value, &other.value, sizeof(value));
+	if (in_group(_type, TypeGroup::Numeric) && in_group(other._type, TypeGroup::Numeric))
+		return three_way(value.int_ptr, other.value.int_ptr);
+	if (is_number(_type) && is_number(other._type))
+		return three_way(as_real(*this), as_real(other));
+	if (_type == DataType::String)
+		return three_way(str(), other.str());
+	return three_way(value.bool_ptr, other.value.bool_ptr);
 }
 
 template<typename C>
 [[nodiscard]] bool xcmp(const Value& lhs, const Value& rhs, C cfn) noexcept {
-	if (lhs.type() != rhs.type()) {
+	if (!comparable(lhs, rhs)) {
 		return false;
 	}
-
-	if (lhs.type() == DataType::String) {
-		return cfn(*lhs.value.string_ptr, *rhs.value.string_ptr);
-	}
-
 	return cfn(lhs.cmp(rhs), 0);
 }
 
@@ -132,43 +265,22 @@ bool Value::operator>(const Value& other) const noexcept {
 
 
 template<typename BinaryOp>
-[[nodiscard]] Value binop(const Value& lhs, const Value& rhs, BinaryOp op, bool to_real = false) {
-
+[[nodiscard]] Value binop(const Value& lhs, const Value& rhs, BinaryOp op) {
 	if (in_group(lhs.type(), TypeGroup::Numeric) && in_group(rhs.type(), TypeGroup::Numeric)) {
-		if (to_real) {
-			Value res(DataType::Double);
-			res.value.double_ptr = op(lhs.value.int_ptr, rhs.value.int_ptr);
-			return res;
-		}
-		Value res(DataType::Integer);
-		res.value.int_ptr = op(lhs.value.int_ptr, rhs.value.int_ptr);
-		return res;
-	}
-
-	Value res(DataType::Double);
-	if (in_group(lhs.type(), TypeGroup::Real) && in_group(rhs.type(), TypeGroup::Real)) {
-		res.value.double_ptr = op(lhs.value.double_ptr, rhs.value.double_ptr);
-	}
-	else if (in_group(lhs.type(), TypeGroup::Numeric) && in_group(rhs.type(), TypeGroup::Real)) {
-		res.value.double_ptr = op(lhs.value.int_ptr, rhs.value.double_ptr);
+		return Value{op(lhs.value.int_ptr, rhs.value.int_ptr)};
 	}
-	else if (in_group(lhs.type(), TypeGroup::Real) && in_group(rhs.type(), TypeGroup::Numeric)) {
-		res.value.double_ptr = op(lhs.value.double_ptr, rhs.value.int_ptr);
-	}
-	else {
-		throw std::runtime_error("TODO");
+	if (!is_number(lhs.type()) || !is_number(rhs.type())) {
+		throw std::runtime_error("This operation is applicable to numeric values only");
 	}
-	return res;
-}
-
-double divide_real(int lhs, int rhs) {
-	return static_cast<double>(lhs) / rhs;
+	return Value{op(as_real(lhs), as_real(rhs))};
 }
 
 Value Value::operator+(const Value& other) const {
 	if (_type == DataType::String) {
+		if (other._type != DataType::String)
+			throw std::runtime_error("Only strings can be concatenated with strings");
 		Value res(_type);
-		res.value.string_ptr = new std::string(*value.string_ptr + *other.value.string_ptr);
+		res.value.string_ptr = StringData::make(str(), other.str());
 		return res;
 	}
 	return binop(*this, other, std::plus<>{});
@@ -179,40 +291,31 @@ Value Value::operator-(const Value& other) const {
 }
 
 Value Value::operator*(const Value& other) const {
-	if (_type == DataType::String) {
-		throw std::runtime_error("This operation is applicable to numeric values only");
-	}
 	return binop(*this, other, std::multiplies<>{});
 }
 
 Value Value::operator/(const Value& other) const {
-	if (_type == DataType::String) {
+	if (!is_number(_type) || !is_number(other._type)) {
 		throw std::runtime_error("This operation is applicable to numeric values only");
 	}
-	if (other.value.double_ptr == 0) {
+	if (as_real(other) == 0) {
 		throw std::runtime_error("Division by zero");
 	}
-	if(in_group(_type, TypeGroup::Real)) return binop(*this, other, divide_real, true);
-	else return binop(*this, other, divide_real, false);
+	return Value{as_real(*this) / as_real(other)};
 }
 
 Value Value::operator%(const Value& other) const {
-	if (_type != DataType::Integer) {
+	if (!in_group(_type, TypeGroup::Numeric) || !in_group(other._type, TypeGroup::Numeric)) {
 		throw std::runtime_error("This operation is applicable to integers only");
 	}
-	Value res(_type);
-	res.value.int_ptr = value.int_ptr % other.value.int_ptr;
-	return res;
+	if (other.value.int_ptr == 0) {
+		throw std::runtime_error("Division by zero");
+	}
+	return Value{value.int_ptr % other.value.int_ptr};
 }
 
 Value Value::operator-() const {
-	if (_type == DataType::String) {
-		throw std::runtime_error("This operation is applicable only to numeric values");
-	}
-
-	return binop(Value(_type, nullptr), *this, std::minus<>{});
+	if (in_group(_type, TypeGroup::Numeric)) return Value{-value.int_ptr};
+	if (in_group(_type, TypeGroup::Real)) return Value{-value.double_ptr};
+	throw std::runtime_error("This operation is applicable only to numeric values");
 }
-
-std::string Value::name() const  { return _name;}
-
-
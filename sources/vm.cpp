@@ -0,0 +1,918 @@
+#include "vm.h"
+#include "arith.h"
+#include "exceptions.h"
+#include "kernel.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PASCAL_COMPUTED_GOTO
+#endif
+
+namespace {
+
+// Prints the arguments of Write, each is followed by its width and decimals when formatted.
+// The formats come from the program, all of them are checked before anything is printed.
+void write(Output& output, std::span<Value> args, bool formatted) {
+	if (!formatted) {
+		for (const auto& a : args) {
+			output.write(a);
+			output.put(' ');
+		}
+		return;
+	}
+	for (size_t i = 0; i < args.size(); i += 3) {
+		const auto width = args[i + 1].value.int_ptr, decimals = args[i + 2].value.int_ptr;
+		if (width < -Output::max_field || width > Output::max_field || decimals > Output::max_field)
+			throw std::runtime_error("Field width out of range");
+	}
+	for (size_t i = 0; i < args.size(); i += 3) {
+		output.write(args[i], args[i + 1].value.int_ptr, args[i + 2].value.int_ptr);
+		output.put(' ');
+	}
+}
+
+[[noreturn]] void out_of_range(const Dimension& dim, int32_t index) {
+	throw std::runtime_error("Index " + std::to_string(index) + " out of range " + std::to_string(dim.low) + ".."
+							 + std::to_string(dim.high));
+}
+
+// Position of the scalar in the storage, one unsigned compare covers both bounds
+int32_t offset(const Dimension& dim, int32_t index) {
+	const auto at = static_cast<uint32_t>(index) - static_cast<uint32_t>(dim.low);
+	if (at > static_cast<uint32_t>(dim.high - dim.low)) out_of_range(dim, index);
+	return static_cast<int32_t>(at) * dim.stride + dim.base;
+}
+
+int32_t ordinal(const JumpTable& table, const Value& selector) {
+	return table.chars ? static_cast<unsigned char>(selector.value.char_ptr) : selector.value.int_ptr;
+}
+
+// Target of a dense case dispatch, the unsigned compare covers both ends of the table
+int32_t lookup(const JumpTable& table, int32_t selector) {
+	const auto at = static_cast<uint32_t>(selector) - static_cast<uint32_t>(table.low);
+	return at < table.targets.size() ? table.targets[at] : table.otherwise;
+}
+
+// Target of a sparse case dispatch, the last range starting at or below the selector may hold it
+int32_t search(const JumpTable& table, int32_t selector) {
+	auto it = std::upper_bound(table.ranges.begin(), table.ranges.end(), selector,
+							   [](int32_t v, const JumpTable::Range& r) { return v < r.low; });
+	if (it == table.ranges.begin() || (--it)->high < selector) return table.otherwise;
+	return it->target;
+}
+
+}
+
+VM::VM(const Options& options, std::istream& is, std::ostream& os) : options(options), input(is), output(os) {}
+
+// Instructions that touch strings or the outside world, shared by the dispatch loop and native code
+Value* VM::execute(const Chunk& chunk, const Instruction& ins, Value* frame, Value* globals, Value* sp, Input& input, Output& output) {
+#define GENERIC_COMPARE(op) { \
+		Value rhs = std::move(*--sp); \
+		sp[-1] = Value{sp[-1] op rhs}; \
+		break; }
+
+	switch (ins.op) {
+		case OpCode::Push:
+			*sp++ = chunk.constants[ins.a];
+			break;
+		case OpCode::Load:
+			*sp++ = frame[ins.a];
+			break;
+		case OpCode::Store:
+			frame[ins.a] = std::move(*--sp);
+			break;
+		// a temporary on the left nothing else holds grows in place
+		case OpCode::Concat: {
+			Value rhs = std::move(*--sp);
+			sp[-1].value.string_ptr = StringData::append(sp[-1].value.string_ptr, rhs.str());
+			break;
+		}
+		case OpCode::Append:
+		case OpCode::AppendGlobal: {
+			Value tail = std::move(*--sp);
+			auto& str = (ins.op == OpCode::Append ? frame : globals)[ins.a].value.string_ptr;
+			str = StringData::append(str, tail.str());
+			break;
+		}
+		case OpCode::StrLength:
+			sp[-1] = Value{static_cast<int32_t>(sp[-1].str().size())};
+			break;
+		case OpCode::StrCopy: {
+			const auto count = (--sp)->value.int_ptr;
+			const auto index = (--sp)->value.int_ptr;
+			sp[-1] = Value{substring(sp[-1].str(), index, count)};
+			break;
+		}
+		case OpCode::StrPos: {
+			Value str = std::move(*--sp);
+			sp[-1] = Value{position(sp[-1].str(), str.str())};
+			break;
+		}
+		case OpCode::Eq: GENERIC_COMPARE(==)
+		case OpCode::Ne: GENERIC_COMPARE(!=)
+		case OpCode::Lt: GENERIC_COMPARE(<)
+		case OpCode::Le: GENERIC_COMPARE(<=)
+		case OpCode::Ge: GENERIC_COMPARE(>=)
+		case OpCode::Gt: GENERIC_COMPARE(>)
+		case OpCode::Write:
+		case OpCode::Writeln: {
+			auto count = static_cast<size_t>(ins.a) * (ins.b ? 3 : 1);
+			write(output, {sp - count, count}, ins.b);
+			if (ins.op == OpCode::Writeln) output.put('\n');
+			for (; count; --count)
+				*--sp = Value{};
+			break;
+		}
+		case OpCode::Read:
+			output.flush();
+			input.read(frame[ins.a]);
+			break;
+		case OpCode::ReadLine:
+			input.skip_line();
+			break;
+		case OpCode::LoadElem: {
+			const auto& dim = chunk.dimensions[ins.b];
+			sp[-1] = frame[ins.a].value.aggregate_ptr->get(offset(dim, sp[-1].value.int_ptr), dim.type);
+			break;
+		}
+		case OpCode::StoreElem: {
+			const auto& dim = chunk.dimensions[ins.b];
+			Value val = std::move(*--sp);
+			const auto at = offset(dim, (--sp)->value.int_ptr);
+			frame[ins.a].value.aggregate_ptr->set(at, dim.type, std::move(val));
+			break;
+		}
+		case OpCode::LoadField: {
+			const auto& dim = chunk.dimensions[ins.b];
+			*sp++ = frame[ins.a].value.aggregate_ptr->get(dim.base, dim.type);
+			break;
+		}
+		case OpCode::StoreField: {
+			const auto& dim = chunk.dimensions[ins.b];
+			frame[ins.a].value.aggregate_ptr->set(dim.base, dim.type, std::move(*--sp));
+			break;
+		}
+		case OpCode::ReadElem: {
+			const auto& dim = chunk.dimensions[ins.b];
+			auto& aggregate = *frame[ins.a].value.aggregate_ptr;
+			const auto at = offset(dim, (--sp)->value.int_ptr);
+			Value val = aggregate.get(at, dim.type);
+			output.flush();
+			input.read(val);
+			aggregate.set(at, dim.type, std::move(val));
+			break;
+		}
+		// the offset on the stack becomes the address of the inner aggregate
+		case OpCode::Address: {
+			const auto at = offset(chunk.dimensions[ins.b], sp[-1].value.int_ptr);
+			sp[-1] = Value{DataType::Reference};
+			sp[-1].value.address_ptr = frame[ins.a].value.aggregate_ptr->elements<char>() + at;
+			break;
+		}
+		case OpCode::Copy: {
+			const auto* from = (--sp)->value.address_ptr;
+			AggregateData::copy(chunk.types, ins.a, (--sp)->value.address_ptr, from);
+			break;
+		}
+		case OpCode::LoadGlobal:
+			*sp++ = globals[ins.a];
+			break;
+		case OpCode::StoreGlobal:
+			globals[ins.a] = std::move(*--sp);
+			break;
+		// references point to the payload of a boxed scalar, laid out as an unboxed one
+		case OpCode::Ref:
+		case OpCode::RefGlobal:
+			*sp = Value{DataType::Reference};
+			sp->value.address_ptr = reinterpret_cast<char*>(&(ins.op == OpCode::Ref ? frame : globals)[ins.a].value);
+			++sp;
+			break;
+		case OpCode::LoadRefI:
+		case OpCode::LoadRefR:
+		case OpCode::LoadRef:
+			*sp++ = AggregateData::load(frame[ins.a].value.address_ptr, static_cast<DataType>(ins.b));
+			break;
+		case OpCode::StoreRefI:
+		case OpCode::StoreRefR:
+		case OpCode::StoreRef:
+			AggregateData::store(frame[ins.a].value.address_ptr, static_cast<DataType>(ins.b), std::move(*--sp));
+			break;
+		case OpCode::ReadRef: {
+			const auto type = static_cast<DataType>(ins.a);
+			auto* at = (--sp)->value.address_ptr;
+			Value val = AggregateData::load(at, type);
+			output.flush();
+			input.read(val);
+			AggregateData::store(at, type, std::move(val));
+			break;
+		}
+		default:
+			throw std::runtime_error("Unsupported instruction");
+	}
+	return sp;
+#undef GENERIC_COMPARE
+}
+
+int32_t VM::slow_path(JitState* state, int32_t pc) noexcept {
+	try {
+		state->sp = execute(*state->chunk, state->chunk->code[pc], state->frame, state->globals, state->sp, *state->input, *state->output);
+		return 0;
+	} catch (...) {
+		state->error = std::current_exception();
+		return 1;
+	}
+}
+
+JitFunction VM::hot_loop(const Chunk& chunk, int32_t head, int32_t end) {
+	if (compiled[head]) return compiled[head];
+	if (++counters[head] != std::max(options.jit_threshold, 1u)) return nullptr;
+	compiled[head] = jit.compile(chunk, head, end, slow_path);
+	return compiled[head];
+}
+
+// The stack never moves, references into frames stay valid
+void VM::grow(size_t size) {
+	auto& stack = program.stack;
+	if (size > stack.capacity()) throw std::runtime_error("Stack overflow");
+	const auto before = stack.size();
+	stack.resize(std::min(stack.capacity(), std::max(size, stack.size() * 2)));
+	charge((stack.size() - before) * sizeof(Value));
+}
+
+void VM::charge(size_t bytes) {
+	current.memory.charge(bytes);
+}
+
+// Arrays and records of a new frame, see Routine::Aggregate. Storage is reused from returned calls.
+void VM::enter(const Chunk& chunk, const Routine& routine, Value* frame, Value* globals) {
+	using Kind = Routine::Aggregate::Kind;
+	for (const auto& aggregate : routine.aggregates) {
+		auto& slot = frame[aggregate.slot];
+		if (aggregate.kind == Kind::Global) {
+			slot = globals[aggregate.index];
+			continue;
+		}
+		auto& pool = aggregate.kind == Kind::Var ? views : spare[aggregate.index];
+		AggregateData* storage;
+		if (!pool.empty()) {
+			storage = pool.back();
+			pool.pop_back();
+		} else if (aggregate.kind == Kind::Var) {
+			charge(sizeof(AggregateData));
+			program.aggregates.push_back(std::make_unique<AggregateData>(chunk.types, aggregate.index, nullptr));
+			storage = program.aggregates.back().get();
+		} else {
+			charge(sizeof(AggregateData) + chunk.types[aggregate.index].size);
+			program.aggregates.push_back(std::make_unique<AggregateData>(chunk.types, aggregate.index));
+			storage = program.aggregates.back().get();
+		}
+		// the argument is the address of the caller's aggregate
+		if (aggregate.kind == Kind::Var) {
+			storage->data = slot.value.address_ptr;
+			storage->type = &chunk.types[aggregate.index];
+		} else if (aggregate.kind == Kind::Value) {
+			AggregateData::copy(chunk.types, aggregate.index, storage->data, slot.value.address_ptr);
+		}
+		slot = Value{DataType::Reference};
+		slot.value.aggregate_ptr = storage;
+	}
+}
+
+void VM::leave(const Routine& routine, Value* frame) noexcept {
+	using Kind = Routine::Aggregate::Kind;
+	for (const auto& aggregate : routine.aggregates) {
+		auto* storage = frame[aggregate.slot].value.aggregate_ptr;
+		if (aggregate.kind == Kind::Var) {
+			views.push_back(storage);
+		} else if (aggregate.kind != Kind::Global) {
+			storage->clear();
+			spare[aggregate.index].push_back(storage);
+		}
+	}
+}
+
+// Splits the iterations of the loop into parts the pool runs on copies of the frame, see
+// ParallelLoop. The parts only depend on the range, so the reductions come out the same on
+// any number of threads. Returns false to run the loop on this thread: inside a part, for
+// a single iteration or when a var parameter shares storage with an array the loop writes.
+bool VM::parallel(const Chunk& chunk, int32_t index, int32_t head, Value* frame, Value* globals, int32_t last) {
+	static constexpr int64_t max_parts = 64;
+	const auto& loop = chunk.parallels[index];
+	const auto first = frame[loop.var].value.int_ptr;
+	const auto count = loop.down ? int64_t{first} - last + 1 : int64_t{last} - first + 1;
+	if (running >= 0 || count < 2) return false;
+	const auto storage = [&](int32_t slot, bool scalar) {
+		const auto& val = frame[slot].value;
+		const auto begin = reinterpret_cast<uintptr_t>(scalar ? val.address_ptr : val.aggregate_ptr->elements<char>());
+		return std::pair{begin, begin + (scalar ? 1 : val.aggregate_ptr->type->size)};
+	};
+	for (const auto& disjoint : loop.disjoint) {
+		const auto [begin, end] = storage(disjoint.aggregate, false);
+		const auto [other, other_end] = storage(disjoint.other, disjoint.scalar);
+		if (begin < other_end && other < end) return false;
+	}
+	if (!pool) pool = std::make_unique<ThreadPool>(options.threads ? options.threads : std::thread::hardware_concurrency());
+
+	// strings are counted without atomics, the parts can't use them
+	const auto copy = [](const Value* from, size_t size) {
+		std::vector<Value> res(size);
+		for (size_t i = 0; i < size; ++i)
+			if (from[i].type() != DataType::String) res[i] = from[i];
+		return res;
+	};
+	struct Part {
+		std::vector<Value> frame, globals;
+		std::exception_ptr error;
+		Value& at(ParallelLoop::Place place) { return (place.global ? globals : frame)[place.slot]; }
+	};
+	const auto at = [&](ParallelLoop::Place place) -> Value& { return (place.global ? globals : frame)[place.slot]; };
+	const auto frame_size = loop.routine < 0 ? program.frame.size() : chunk.routines[loop.routine].frame.size();
+	const auto depth = std::accumulate(chunk.routines.begin(), chunk.routines.end(), chunk.max_stack,
+									   [](int32_t res, const Routine& r) { return std::max(res, r.max_stack); });
+	const auto parts = std::min(count, max_parts);
+	std::vector<Part> results(static_cast<size_t>(parts));
+	for (int64_t p = 0; p < parts; ++p)
+		pool->submit([&, p] {
+			auto& part = results[p];
+			VM* worker = nullptr;
+			try {
+				part.frame = copy(frame, frame_size);
+				if (frame != globals) part.globals = copy(globals, program.frame.size());
+				for (const auto& reduction : loop.reductions)
+					if (reduction.kind == ParallelLoop::Reduction::Kind::Sum) part.at(reduction.var) = Value{at(reduction.var).type()};
+				const auto begin = count * p / parts, end = count * (p + 1) / parts;
+				part.frame[loop.var] = Value{static_cast<int32_t>(loop.down ? first - begin : first + begin)};
+				{
+					std::lock_guard guard(lock);
+					if (idle.empty()) {
+						workers.push_back(std::make_unique<VM>(options));
+						idle.push_back(workers.back().get());
+						idle.back()->prepare(chunk);
+						idle.back()->program.stack.assign(static_cast<size_t>(depth) + 1, Value{});
+					}
+					worker = idle.back();
+					idle.pop_back();
+				}
+				worker->running = index;
+				auto* sp = worker->program.stack.data();
+				*sp++ = Value{static_cast<int32_t>(loop.down ? first - (end - 1) : first + (end - 1))};
+				auto* part_globals = frame == globals ? part.frame.data() : part.globals.data();
+				JitState state{part.frame.data(), sp, &chunk, {}, &worker->input, &worker->output, part_globals};
+				auto budget = UINT64_MAX;
+				worker->interpret<false>(chunk, state, nullptr, head, budget);
+			} catch (...) {
+				part.error = std::current_exception();
+			}
+			if (!worker) return;
+			std::lock_guard guard(lock);
+			idle.push_back(worker);
+		});
+	pool->wait();
+
+	// the error of the earliest part is the one the loop would have stopped at
+	for (const auto& part : results)
+		if (part.error) std::rethrow_exception(part.error);
+	using Kind = ParallelLoop::Reduction::Kind;
+	for (const auto& reduction : loop.reductions) {
+		auto& total = at(reduction.var).value;
+		for (auto& part : results) {
+			const auto& val = part.at(reduction.var).value;
+			if (reduction.real) {
+				if (reduction.kind == Kind::Sum) total.double_ptr += val.double_ptr;
+				else if (reduction.kind == Kind::Min ? val.double_ptr < total.double_ptr : val.double_ptr > total.double_ptr)
+					total.double_ptr = val.double_ptr;
+			} else {
+				if (reduction.kind == Kind::Sum)
+					total.int_ptr = static_cast<int32_t>(static_cast<uint32_t>(total.int_ptr) + static_cast<uint32_t>(val.int_ptr));
+				else if (reduction.kind == Kind::Min ? val.int_ptr < total.int_ptr : val.int_ptr > total.int_ptr)
+					total.int_ptr = val.int_ptr;
+			}
+		}
+	}
+	// the variables are left as the last iteration left them
+	auto& tail = results.back();
+	for (const auto& place : loop.privates)
+		at(place) = std::move(tail.at(place));
+	frame[loop.var] = std::move(tail.frame[loop.var]);
+	return true;
+}
+
+// Tables of the jit for the code of the chunk
+void VM::prepare(const Chunk& chunk) {
+	if (options.profile || !options.jit || !jit.available()) return;
+	jit.clear();
+	counters.assign(chunk.code.size(), 0);
+	compiled.assign(chunk.code.size(), nullptr);
+}
+
+void VM::run(const Chunk& chunk) {
+	start(chunk);
+	resume();
+}
+
+void VM::start(const Chunk& chunk) {
+	finish();
+	current = Run{};
+	current.memory.limit = options.memory_limit;
+	program.program_name = chunk.program_name;
+	program.frame = chunk.globals;
+	if (chunk.routines.empty()) {
+		program.stack.assign(chunk.max_stack, Value{});
+	} else {
+		// frames are pushed on the operand stack, which must not move when it grows
+		auto bytes = options.stack_size;
+		if (options.memory_limit) bytes = std::min(bytes, options.memory_limit);
+		program.stack.clear();
+		program.stack.reserve(std::max(bytes / sizeof(Value), static_cast<size_t>(chunk.max_stack)));
+		program.stack.resize(chunk.max_stack);
+	}
+	calls.clear();
+	spare.assign(chunk.types.size(), {});
+	views.clear();
+	program.aggregates.clear();
+	charge((program.frame.size() + program.stack.size()) * sizeof(Value));
+	for (const auto& [name, symbol] : chunk.symbols) {
+		if (symbol.aggregate < 0) continue;
+		charge(sizeof(AggregateData) + chunk.types[symbol.aggregate].size);
+		program.aggregates.push_back(std::make_unique<AggregateData>(chunk.types, symbol.aggregate));
+		program.frame[symbol.slot].value.aggregate_ptr = program.aggregates.back().get();
+	}
+	input.reset();
+	prepare(chunk);
+	workers.clear();
+	idle.clear();
+
+	Value* const frame = program.frame.data();
+	current.chunk = &chunk;
+	current.state = JitState{frame, program.stack.data(), &chunk, {}, &input, &output, frame};
+	current.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.time_limit);
+	if (options.profile) {
+		profile = Profile{};
+		profiler = std::make_unique<Profiler>(chunk, profile);
+	}
+}
+
+// The run is over, the profile covers the part that ran also when the program failed
+void VM::finish() noexcept {
+	if (profiler) profiler->finish();
+	profiler.reset();
+	current.chunk = nullptr;
+}
+
+// Hands the interpreter budgets of steps until the slice is used up, between them the clock is
+// read and the step limit checked. A limit is exceeded when the run needs one step more.
+Progress VM::resume(uint64_t steps) {
+	static constexpr uint64_t clock_interval = 1 << 12; // steps between looks at the clock
+	if (!current.chunk) throw std::runtime_error("No program is running");
+	// the output is complete whenever resume returns, also when the program fails
+	struct Flush {
+		Output& output;
+		~Flush() { output.flush(); }
+	} flush{output};
+	// the strings the program makes count against its memory
+	struct Meter {
+		MemoryMeter* outer;
+		~Meter() { StringData::install(outer); }
+	} meter{StringData::install(options.memory_limit ? &current.memory : nullptr)};
+
+	const auto& chunk = *current.chunk;
+	bounded = steps || options.max_steps || options.time_limit || options.memory_limit;
+	auto left = steps ? steps : UINT64_MAX;
+	uint64_t budget = 0, rest = 0; // of the slice the interpreter runs, it leaves the rest also when it throws
+	try {
+		for (;;) {
+			budget = left;
+			if (options.max_steps) budget = std::min(budget, options.max_steps - current.steps);
+			if (options.time_limit) budget = std::min(budget, clock_interval);
+			rest = budget;
+			const auto stop = profiler ? interpret<true>(chunk, current.state, profiler.get(), current.pc, rest)
+									   : interpret<false>(chunk, current.state, nullptr, current.pc, rest);
+			current.steps += budget - rest;
+			left -= budget - rest;
+			rest = budget = 0;
+			if (stop == Stop::Halt) {
+				finish();
+				return Progress::Finished;
+			}
+			if (stop == Stop::Input) return Progress::Waiting;
+			if (options.max_steps && current.steps == options.max_steps) throw std::runtime_error("Step limit exceeded");
+			if (options.time_limit && std::chrono::steady_clock::now() >= current.deadline)
+				throw std::runtime_error("Time limit exceeded");
+			if (!left) return Progress::Yielded;
+		}
+	} catch (...) {
+		current.steps += budget - rest;
+		finish();
+		throw;
+	}
+}
+
+// The profiling instantiation reports every dispatch to the profiler, the other one carries no trace of it.
+// Runs until Halt or until the budget of steps or the fed input does not last, see Run.
+template<bool Profiling> VM::Stop VM::interpret(const Chunk& chunk, JitState& state, Profiler* profiler, int32_t pc, uint64_t& budget) {
+	// the jit'ed loops would run past the profiler and the step count
+	const bool jit_on = !Profiling && !bounded && options.jit && jit.available();
+	auto left = budget;
+	// what is left goes back also when the program fails
+	struct Spent {
+		uint64_t& budget;
+		const uint64_t& left;
+		~Spent() { budget = left; }
+	} spent{budget, left};
+
+	Value* frame = state.frame;
+	Value* const globals = state.globals;
+	Value* sp = state.sp;
+	Value* const stack = program.stack.data();
+	const Instruction* code = chunk.code.data();
+	const Instruction* ip = code + pc;
+
+#define PROFILE() if constexpr (Profiling) profiler->step(static_cast<int32_t>(ip - code))
+
+#ifdef PASCAL_COMPUTED_GOTO
+	static const void* labels[] = {
+#define PASCAL_OPCODE_LABEL(name) &&op_##name,
+		PASCAL_OPCODES(PASCAL_OPCODE_LABEL)
+#undef PASCAL_OPCODE_LABEL
+	};
+#define DISPATCH() { PROFILE(); goto *labels[static_cast<size_t>(ip->op)]; }
+#define CASE(name) op_##name:
+	DISPATCH();
+#else
+#define DISPATCH() goto dispatch
+#define CASE(name) case OpCode::name:
+	dispatch:
+	PROFILE();
+	switch (ip->op) {
+#endif
+
+#define ARITH(field, op) { \
+		Value& rhs = sp[-1]; Value& lhs = sp[-2]; \
+		lhs.value.field = lhs.value.field op rhs.value.field; \
+		--sp; ++ip; DISPATCH(); }
+#define INT_ARITH(fn) { \
+		sp[-2].value.int_ptr = arith::fn(sp[-2].value.int_ptr, sp[-1].value.int_ptr); \
+		--sp; ++ip; DISPATCH(); }
+#define COMPARE(field, op) { \
+		const bool r = sp[-2].value.field op sp[-1].value.field; \
+		--sp; sp[-1] = Value{r}; ++ip; DISPATCH(); }
+#define SLOW() { \
+		sp = execute(chunk, *ip, frame, globals, sp, input, output); \
+		++ip; DISPATCH(); }
+// the instruction runs again when the run resumes, the profiler saw it already
+#define SUSPEND(reason) { \
+		if constexpr (Profiling) profiler->unstep(static_cast<int32_t>(ip - code)); \
+		state.frame = frame; \
+		state.sp = sp; \
+		current.pc = static_cast<int32_t>(ip - code); \
+		return reason; }
+// taken by back edges and calls before they change anything
+#define STEP() \
+	if (!left) SUSPEND(Stop::Budget) \
+	--left;
+// a fed run waits for the whole value to arrive
+#define AWAIT(line) \
+	if (!input.ready(line)) SUSPEND(Stop::Input)
+// ip was just moved back to the head of a loop ending at from
+#define BACKEDGE(from) \
+	if (jit_on) { \
+		if (auto fn = hot_loop(chunk, static_cast<int32_t>(ip - code), static_cast<int32_t>((from) - code))) { \
+			state.frame = frame; \
+			state.sp = sp; \
+			const auto next = fn(&state); \
+			sp = state.sp; \
+			if (next < 0) std::rethrow_exception(state.error); \
+			ip = code + next; \
+		} \
+	}
+
+	CASE(Push) {
+		*sp++ = chunk.constants[ip->a];
+		++ip; DISPATCH();
+	}
+	CASE(Load) {
+		*sp++ = frame[ip->a];
+		++ip; DISPATCH();
+	}
+	CASE(Store) {
+		frame[ip->a] = std::move(*--sp);
+		++ip; DISPATCH();
+	}
+	CASE(AddI) INT_ARITH(add)
+	CASE(SubI) INT_ARITH(sub)
+	CASE(MulI) INT_ARITH(mul)
+	CASE(IntDivI) {
+		if (sp[-1].value.int_ptr == 0)
+			throw std::runtime_error("Division by zero");
+		INT_ARITH(div)
+	}
+	CASE(ModI) {
+		if (sp[-1].value.int_ptr == 0)
+			throw std::runtime_error("Division by zero");
+		INT_ARITH(mod)
+	}
+	CASE(NegI) {
+		sp[-1].value.int_ptr = arith::neg(sp[-1].value.int_ptr);
+		++ip; DISPATCH();
+	}
+	CASE(AddR) ARITH(double_ptr, +)
+	CASE(SubR) ARITH(double_ptr, -)
+	CASE(MulR) ARITH(double_ptr, *)
+	CASE(DivR) {
+		if (sp[-1].value.double_ptr == 0)
+			throw std::runtime_error("Division by zero");
+		ARITH(double_ptr, /)
+	}
+	CASE(NegR) {
+		sp[-1].value.double_ptr = -sp[-1].value.double_ptr;
+		++ip; DISPATCH();
+	}
+	CASE(ToReal) {
+		sp[-1] = Value{static_cast<double>(sp[-1].value.int_ptr)};
+		++ip; DISPATCH();
+	}
+	CASE(Concat) SLOW()
+	CASE(Append) SLOW()
+	CASE(AppendGlobal) SLOW()
+	CASE(StrLength) SLOW()
+	CASE(StrCopy) SLOW()
+	CASE(StrPos) SLOW()
+	CASE(Not) {
+		sp[-1].value.bool_ptr = !sp[-1].value.bool_ptr;
+		++ip; DISPATCH();
+	}
+	CASE(And) ARITH(bool_ptr, &&)
+	CASE(Or) ARITH(bool_ptr, ||)
+	CASE(EqI) COMPARE(int_ptr, ==)
+	CASE(NeI) COMPARE(int_ptr, !=)
+	CASE(LtI) COMPARE(int_ptr, <)
+	CASE(LeI) COMPARE(int_ptr, <=)
+	CASE(GeI) COMPARE(int_ptr, >=)
+	CASE(GtI) COMPARE(int_ptr, >)
+	CASE(EqR) COMPARE(double_ptr, ==)
+	CASE(NeR) COMPARE(double_ptr, !=)
+	CASE(LtR) COMPARE(double_ptr, <)
+	CASE(LeR) COMPARE(double_ptr, <=)
+	CASE(GeR) COMPARE(double_ptr, >=)
+	CASE(GtR) COMPARE(double_ptr, >)
+	CASE(Eq) SLOW()
+	CASE(Ne) SLOW()
+	CASE(Lt) SLOW()
+	CASE(Le) SLOW()
+	CASE(Ge) SLOW()
+	CASE(Gt) SLOW()
+	CASE(Jump) {
+		const auto* from = ip;
+		if (ip->a < from - code) STEP()
+		ip = code + ip->a;
+		if (ip < from) BACKEDGE(from)
+		DISPATCH();
+	}
+	CASE(JumpIfFalse) {
+		const bool cond = (--sp)->value.bool_ptr;
+		ip = cond ? ip + 1 : code + ip->a;
+		DISPATCH();
+	}
+	CASE(JumpTable) {
+		const auto& table = chunk.tables[ip->a];
+		ip = code + lookup(table, ordinal(table, *--sp));
+		DISPATCH();
+	}
+	CASE(JumpSearch) {
+		const auto& table = chunk.tables[ip->a];
+		ip = code + search(table, ordinal(table, *--sp));
+		DISPATCH();
+	}
+	CASE(ForTest) {
+		if (frame[ip->a].value.int_ptr > sp[-1].value.int_ptr) {
+			--sp;
+			ip = code + ip->b;
+		} else ++ip;
+		DISPATCH();
+	}
+	CASE(ForTestDown) {
+		if (frame[ip->a].value.int_ptr < sp[-1].value.int_ptr) {
+			--sp;
+			ip = code + ip->b;
+		} else ++ip;
+		DISPATCH();
+	}
+	// the limit is tested before the step, so a loop up to the highest integer ends, and the
+	// variable is left one past the limit
+	CASE(ForNext) {
+		STEP()
+		auto& var = frame[ip->a].value.int_ptr;
+		const bool last = var >= sp[-1].value.int_ptr;
+		var = arith::add(var, 1);
+		if (last) {
+			--sp;
+			++ip; DISPATCH();
+		}
+		const auto* from = ip;
+		ip = code + ip->b;
+		BACKEDGE(from)
+		DISPATCH();
+	}
+	CASE(ForPrev) {
+		STEP()
+		auto& var = frame[ip->a].value.int_ptr;
+		const bool last = var <= sp[-1].value.int_ptr;
+		var = arith::sub(var, 1);
+		if (last) {
+			--sp;
+			++ip; DISPATCH();
+		}
+		const auto* from = ip;
+		ip = code + ip->b;
+		BACKEDGE(from)
+		DISPATCH();
+	}
+	CASE(Write) SLOW()
+	CASE(Writeln) SLOW()
+	CASE(Read) {
+		AWAIT(in_group(frame[ip->a].type(), TypeGroup::String))
+		SLOW()
+	}
+	CASE(ReadLine) {
+		AWAIT(true)
+		SLOW()
+	}
+	CASE(Index) {
+		sp[-1].value.int_ptr = offset(chunk.dimensions[ip->a], sp[-1].value.int_ptr);
+		++ip; DISPATCH();
+	}
+	CASE(LoadElemI) {
+		const auto at = offset(chunk.dimensions[ip->b], sp[-1].value.int_ptr);
+		sp[-1].value.int_ptr = frame[ip->a].value.aggregate_ptr->elements<int32_t>()[at];
+		++ip; DISPATCH();
+	}
+	CASE(LoadElemR) {
+		const auto at = offset(chunk.dimensions[ip->b], sp[-1].value.int_ptr);
+		sp[-1] = Value{frame[ip->a].value.aggregate_ptr->elements<double>()[at]};
+		++ip; DISPATCH();
+	}
+	CASE(LoadElem) SLOW()
+	CASE(StoreElemI) {
+		const auto at = offset(chunk.dimensions[ip->b], sp[-2].value.int_ptr);
+		frame[ip->a].value.aggregate_ptr->elements<int32_t>()[at] = sp[-1].value.int_ptr;
+		sp -= 2; ++ip; DISPATCH();
+	}
+	CASE(StoreElemR) {
+		const auto at = offset(chunk.dimensions[ip->b], sp[-2].value.int_ptr);
+		frame[ip->a].value.aggregate_ptr->elements<double>()[at] = sp[-1].value.double_ptr;
+		sp -= 2; ++ip; DISPATCH();
+	}
+	CASE(StoreElem) SLOW()
+	// fields are at offsets fixed by the compiler
+	CASE(LoadFieldI) {
+		*sp++ = Value{frame[ip->a].value.aggregate_ptr->elements<int32_t>()[chunk.dimensions[ip->b].base]};
+		++ip; DISPATCH();
+	}
+	CASE(LoadFieldR) {
+		*sp++ = Value{frame[ip->a].value.aggregate_ptr->elements<double>()[chunk.dimensions[ip->b].base]};
+		++ip; DISPATCH();
+	}
+	CASE(LoadField) SLOW()
+	CASE(StoreFieldI) {
+		frame[ip->a].value.aggregate_ptr->elements<int32_t>()[chunk.dimensions[ip->b].base] = sp[-1].value.int_ptr;
+		--sp; ++ip; DISPATCH();
+	}
+	CASE(StoreFieldR) {
+		frame[ip->a].value.aggregate_ptr->elements<double>()[chunk.dimensions[ip->b].base] = sp[-1].value.double_ptr;
+		--sp; ++ip; DISPATCH();
+	}
+	CASE(StoreField) SLOW()
+	CASE(ReadElem) {
+		AWAIT(in_group(chunk.dimensions[ip->b].type, TypeGroup::String))
+		SLOW()
+	}
+	CASE(Address) SLOW()
+	CASE(Copy) SLOW()
+	// the profile and the step count take the iterations of the checked loop
+	CASE(Kernel) {
+		if (!Profiling && !bounded && run_kernel(chunk, chunk.kernels[ip->a], frame, sp[-1].value.int_ptr)) {
+			--sp;
+			ip = code + ip->b;
+		} else ++ip;
+		DISPATCH();
+	}
+	// the parts run from the loop head, profiled and bounded runs take the loop on this thread
+	CASE(Parallel) {
+		if (!Profiling && !bounded && parallel(chunk, ip->a, static_cast<int32_t>(ip + 1 - code), frame, globals, sp[-1].value.int_ptr)) {
+			--sp;
+			ip = code + ip->b;
+		} else ++ip;
+		DISPATCH();
+	}
+	CASE(ParallelEnd) {
+		if (ip->a == running) return Stop::Halt;
+		++ip; DISPATCH();
+	}
+	CASE(LoadGlobal) {
+		*sp++ = globals[ip->a];
+		++ip; DISPATCH();
+	}
+	CASE(StoreGlobal) {
+		globals[ip->a] = std::move(*--sp);
+		++ip; DISPATCH();
+	}
+	CASE(Ref) SLOW()
+	CASE(RefGlobal) SLOW()
+	CASE(LoadRefI) {
+		int32_t v;
+		std::memcpy(&v, frame[ip->a].value.address_ptr, sizeof(v));
+		*sp++ = Value{v};
+		++ip; DISPATCH();
+	}
+	CASE(LoadRefR) {
+		double v;
+		std::memcpy(&v, frame[ip->a].value.address_ptr, sizeof(v));
+		*sp++ = Value{v};
+		++ip; DISPATCH();
+	}
+	CASE(LoadRef) SLOW()
+	CASE(StoreRefI) {
+		std::memcpy(frame[ip->a].value.address_ptr, &(--sp)->value.int_ptr, sizeof(int32_t));
+		++ip; DISPATCH();
+	}
+	CASE(StoreRefR) {
+		std::memcpy(frame[ip->a].value.address_ptr, &(--sp)->value.double_ptr, sizeof(double));
+		++ip; DISPATCH();
+	}
+	CASE(StoreRef) SLOW()
+	CASE(ReadRef) {
+		AWAIT(in_group(static_cast<DataType>(ip->a), TypeGroup::String))
+		SLOW()
+	}
+	// the arguments on the stack become the first slots of the new frame
+	CASE(Call) {
+		STEP()
+		const auto& routine = chunk.routines[ip->a];
+		Value* const base = sp - routine.params;
+		const auto size = routine.frame.size();
+		const auto needed = static_cast<size_t>(base - stack) + size + static_cast<size_t>(routine.max_stack);
+		if (needed > program.stack.size()) grow(needed);
+		calls.push_back({ip + 1, frame});
+		for (auto i = static_cast<size_t>(routine.params); i < size; ++i)
+			base[i] = routine.frame[i];
+		frame = base;
+		sp = base + size;
+		if (!routine.aggregates.empty()) enter(chunk, routine, frame, globals);
+		ip = code + routine.entry;
+		DISPATCH();
+	}
+	// a call of the running routine as the last thing it does, the frame starts over
+	CASE(TailCall) {
+		STEP()
+		const auto& routine = chunk.routines[ip->a];
+		if (!routine.aggregates.empty()) leave(routine, frame);
+		sp -= routine.params;
+		for (int32_t i = 0; i < routine.params; ++i)
+			frame[i] = std::move(sp[i]);
+		for (auto i = static_cast<size_t>(routine.params); i < routine.frame.size(); ++i)
+			frame[i] = routine.frame[i];
+		sp = frame + routine.frame.size();
+		if (!routine.aggregates.empty()) enter(chunk, routine, frame, globals);
+		ip = code + routine.entry;
+		DISPATCH();
+	}
+	// the frame is cleared, a function leaves its result in place of the arguments
+	CASE(Return) {
+		const auto& routine = chunk.routines[ip->a];
+		if (!routine.aggregates.empty()) leave(routine, frame);
+		Value result = routine.result < 0 ? Value{} : std::move(frame[routine.result]);
+		for (auto* slot = frame; slot != sp; ++slot)
+			*slot = Value{};
+		sp = frame;
+		if (routine.result >= 0) *sp++ = std::move(result);
+		frame = calls.back().frame;
+		ip = calls.back().ret;
+		calls.pop_back();
+		DISPATCH();
+	}
+	CASE(Halt) {
+		return Stop::Halt;
+	}
+
+#ifndef PASCAL_COMPUTED_GOTO
+	}
+#endif
+#undef ARITH
+#undef INT_ARITH
+#undef COMPARE
+#undef SLOW
+#undef BACKEDGE
+#undef SUSPEND
+#undef STEP
+#undef AWAIT
+#undef CASE
+#undef DISPATCH
+#undef PROFILE
+}
@@ -0,0 +1,38 @@
+#!/bin/sh
+# Usage: batch_out_dir.sh pascal_batch
+# Runs programs given by paths with .. parts and checks every output lands under --out-dir
+# at its path from the parent of the given path.
+set -u
+batch=$1
+work=$(mktemp -d "${TMPDIR:-/tmp}/pascal_batch.XXXXXX") || exit 1
+trap 'rm -rf "$work"' EXIT
+
+mkdir -p "$work/suite/nested" "$work/run"
+cat > "$work/suite/outer.pas" <<'PAS'
+program outer;
+begin
+    Writeln('outer')
+end.
+PAS
+cat > "$work/suite/nested/inner.pas" <<'PAS'
+program inner;
+begin
+    Writeln('inner')
+end.
+PAS
+
+cd "$work/run" || exit 1
+"$batch" -j 2 --quiet --out-dir out ../suite ../suite/nested/inner.pas > report.txt || {
+	cat report.txt
+	exit 1
+}
+expected="out/inner.out
+out/suite/nested/inner.out
+out/suite/outer.out"
+actual=$(find "$work" -name '*.out' | sed "s|^$work/run/||" | sort)
+if [ "$actual" != "$expected" ]; then
+	echo "outputs written to:"
+	echo "$actual"
+	exit 1
+fi
+[ "$(cat out/suite/nested/inner.out)" = "inner " ] || exit 1
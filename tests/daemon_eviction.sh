@@ -0,0 +1,78 @@
+#!/bin/sh
+# Usage: daemon_eviction.sh pascal_daemon [jit]
+# Requests alternate between two programs on a server that keeps one, each compile evicts the
+# program the only worker ran last while its context still holds it. Fails when a reply is wrong
+# or the server does not shut down cleanly.
+set -u
+daemon=$1
+work=$(mktemp -d "${TMPDIR:-/tmp}/pascal_daemon.XXXXXX") || exit 1
+socket=$work/socket
+server=
+
+finish() {
+	[ -n "$server" ] && kill "$server" 2>/dev/null
+	rm -rf "$work"
+}
+trap finish EXIT
+
+cat > "$work/first.pas" <<'PAS'
+program first;
+const
+    greeting: string = 'Hello';
+var
+    name: string;
+begin
+    name := greeting + ', first';
+    Writeln(name)
+end.
+PAS
+cat > "$work/second.pas" <<'PAS'
+program second;
+var
+    i, sum: integer;
+    text: string;
+begin
+    sum := 0;
+    for i := 1 to 5000 do sum := sum + i;
+    text := 'sum';
+    Writeln(text, sum)
+end.
+PAS
+
+"$daemon" serve --socket "$socket" -j 1 --programs 1 ${2:+--jit} 2> "$work/server.log" &
+server=$!
+tries=0
+until "$daemon" run --socket "$socket" --no-dump "$work/second.pas" < /dev/null > /dev/null 2>&1; do
+	tries=$((tries + 1))
+	if [ $tries -gt 100 ] || ! kill -0 "$server" 2>/dev/null; then
+		echo "The server did not start:" >&2
+		cat "$work/server.log" >&2
+		exit 1
+	fi
+	sleep 0.1
+done
+
+for round in 1 2 3 4 5; do
+	for name in first second; do
+		if [ $name = first ]; then expected='Hello, first '; else expected='sum 12502500 '; fi
+		if ! output=$("$daemon" run --socket "$socket" "$work/$name.pas" < /dev/null); then
+			echo "Request $round of $name failed" >&2
+			cat "$work/server.log" >&2
+			exit 1
+		fi
+		if [ "$(printf '%s\n' "$output" | head -n 1)" != "$expected" ]; then
+			printf 'Request %s of %s replied:\n%s\n' $round $name "$output" >&2
+			exit 1
+		fi
+	done
+done
+
+kill -TERM "$server"
+wait "$server"
+status=$?
+server=
+if [ $status -ne 0 ]; then
+	echo "The server exited with $status:" >&2
+	cat "$work/server.log" >&2
+	exit 1
+fi
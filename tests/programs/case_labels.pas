@@ -0,0 +1,97 @@
+program case_labels;
+const
+    Big = 2147483647;
+    Least = -2147483648;
+var
+    i, small, tens, teens, other, sparse, found, missed: integer;
+    lower, upper, digits, blanks, rest: integer;
+
+function kind(c: char): integer;
+begin
+    case c of
+        'a'..'z': kind := 1;
+        'A'..'Z': kind := 2;
+        '0'..'9': kind := 3;
+        ' ', '_': kind := 4;
+    else
+        kind := 5
+    end
+end;
+
+function lookup(n: integer): integer;
+begin
+    lookup := 0;
+    case n of
+        Least: lookup := 1;
+        -70000: lookup := 2;
+        1, 3: lookup := 3;
+        100: lookup := 4;
+        1000..1010: lookup := 5;
+        1011: lookup := 6;
+        50000: lookup := 7;
+        Big: lookup := 8;
+    end
+end;
+
+procedure count(c: char);
+begin
+    case kind(c) of
+        1: lower := lower + 1;
+        2: upper := upper + 1;
+        3: digits := digits + 1;
+        4: blanks := blanks + 1;
+    else
+        rest := rest + 1
+    end
+end;
+
+begin
+    small := 0;
+    tens := 0;
+    teens := 0;
+    other := 0;
+    for i := -5 to 25 do
+        case i of
+            0..9: small := small + 1;
+            10, 20: tens := tens + 1;
+            11..19: teens := teens + 1;
+        else
+            other := other + 1
+        end;
+    Writeln(small, ' ', tens, ' ', teens, ' ', other);
+
+    sparse := 0;
+    found := 0;
+    missed := 0;
+    for i := 0 to 1100 do
+    begin
+        sparse := sparse + lookup(i);
+        if lookup(i) = 0 then
+            missed := missed + 1
+        else
+            found := found + 1
+    end;
+    Writeln(sparse, ' ', found, ' ', missed);
+    Writeln(lookup(Least), ' ', lookup(-70000), ' ', lookup(-69999), ' ', lookup(50000), ' ', lookup(Big), ' ', lookup(Big - 1));
+
+    lower := 0;
+    upper := 0;
+    digits := 0;
+    blanks := 0;
+    rest := 0;
+    count('a');
+    count('z');
+    count('m');
+    count('A');
+    count('Z');
+    count('0');
+    count('9');
+    count(' ');
+    count('_');
+    count('@');
+    count('[');
+    count('`');
+    count('{');
+    count('~');
+    Writeln(lower, ' ', upper, ' ', digits, ' ', blanks, ' ', rest);
+end.
@@ -0,0 +1,25 @@
+program copy_pos;
+var
+    s, empty, part: string;
+    i, n: integer;
+begin
+    s := 'hello world';
+    empty := '';
+    i := 0;
+    n := -1;
+    Writeln('[', Copy(s, 1, 5), '] [', Copy(s, 7, 100), '] [', Copy(s, 11, 1), ']');
+    Writeln('[', Copy(s, i, 3), '] [', Copy(s, n, 3), '] [', Copy(s, -2147483647 - 1, 2), ']');
+    Writeln('[', Copy(s, 1, i), '] [', Copy(s, 1, n), '] [', Copy(s, 12, 1), '] [', Copy(s, 2147483647, 2147483647), ']');
+    Writeln('[', Copy(s, 3, 2147483647), '] [', Copy(empty, 1, 1), '] [', Copy('abc', 0, 2), '] [', Copy('abc', 4, 1), ']');
+    Writeln(Pos('o', s), ' ', Pos('world', s), ' ', Pos('xyz', s), ' ', Pos(empty, s), ' ', Pos(empty, empty));
+    Writeln(Pos('hello world!', s), ' ', Pos(s, s), ' ', Pos('d', s), ' ', Pos('h', s), ' ', Pos('o', empty));
+    part := '';
+    for i := 1 to 3 do
+        part := part + 'ab';
+    part := part + 'c';
+    Writeln(Pos('abc', part), ' ', Pos('ababc', part), ' ', Pos('abd', part), ' ', Pos('', 'abc'));
+    n := 0;
+    for i := -2 to 14 do
+        n := n + Length(Copy(s, i, 3));
+    Writeln(n, ' ', Length(Copy(s, 5, 0)), ' ', Length(empty));
+end.
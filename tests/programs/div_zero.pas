@@ -0,0 +1,13 @@
+program div_zero;
+var
+    n, i, q, sum: integer;
+begin
+    Read(n);
+    sum := 0;
+    for i := 1 to 3000 do
+    begin
+        q := 100000 div (n - i);
+        sum := sum + q mod ((n - i) + 1)
+    end;
+    Writeln(sum)
+end.
@@ -0,0 +1,14 @@
+program field_width;
+var
+    w, d: integer;
+    x: real;
+begin
+    x := 1.5;
+    Writeln(x:8:3, 42:-6, 'ab':5, x:1:70);
+    Writeln(x:1:1100);
+    Writeln(0.1:0:1080);
+    w := 300;
+    Writeln('pad':-w, '|');
+    d := 300000000;
+    Writeln('never', x:1:d)
+end.
@@ -0,0 +1,29 @@
+program for_bounds;
+var
+    i, j, n, sum: integer;
+begin
+    n := 0;
+    for i := 2147483645 to 2147483647 do n := n + 1;
+    Writeln(n, i);
+    n := 0;
+    for i := (-2147483647 - 1) + 2 downto -2147483647 - 1 do n := n + 1;
+    Writeln(n, i);
+    sum := 0;
+    for i := 1 to 3000 do
+        sum := sum + i mod 7;
+    Writeln(sum, i);
+    for i := 8 downto 1 do sum := sum - i * i;
+    Writeln(sum, i);
+    n := 0;
+    for i := 5 to 4 do n := n + 1;
+    Writeln(n, i);
+    n := 0;
+    for i := 2147483647 - 5000 to 2147483647 do n := n + 1;
+    Writeln(n, i);
+    for i := (-2147483647 - 1) + 5000 downto -2147483647 - 1 do n := n + 1;
+    Writeln(n, i);
+    n := 0;
+    for j := 1 to 3 do
+        for i := 2147483647 - 2000 to 2147483647 do n := n + j;
+    Writeln(n, i, j)
+end.
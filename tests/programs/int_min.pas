@@ -0,0 +1,19 @@
+program int_min;
+var
+    a, b, i, q, r, s, t: integer;
+begin
+    Read(a, b);
+    q := 0;
+    r := 0;
+    s := 0;
+    t := 0;
+    for i := 1 to 3000 do
+    begin
+        q := a div b;
+        r := a mod b;
+        s := s + a * 3 - b;
+        t := -a + i div b
+    end;
+    Writeln(q, r, s, t);
+    Writeln((-2147483647 - 1) div -1, (-2147483647 - 1) mod -1, 2147483647 + 1, 65536 * 65536)
+end.
@@ -0,0 +1,57 @@
+program record_strings;
+type
+    person = record
+        name: string;
+        age: integer
+    end;
+    pair = record
+        first, second: person;
+        title: string
+    end;
+    crowd = array[1..50] of person;
+var
+    i, total: integer;
+    p: pair;
+    people: crowd;
+
+function describe(who: person): string;
+begin
+    describe := who.name + '/' + who.name
+end;
+
+procedure rename(var who: person; name: string);
+begin
+    who.name := name;
+    who.age := who.age + 1
+end;
+
+procedure shuffle(var all: crowd);
+var
+    k: integer;
+    saved: person;
+begin
+    for k := 1 to 25 do
+    begin
+        saved := all[k];
+        all[k] := all[51 - k];
+        all[51 - k] := saved
+    end
+end;
+
+begin
+    p.first.name := 'ann';
+    p.first.age := 30;
+    p.second := p.first;
+    rename(p.second, 'bob');
+    p.title := describe(p.first) + ' ' + describe(p.second);
+    total := 0;
+    for i := 1 to 3000 do
+    begin
+        people[1 + i mod 50].name := p.first.name + 'x';
+        people[1 + i mod 50].age := i;
+        total := total + people[1 + i mod 50].age mod 7
+    end;
+    for i := 1 to 3 do shuffle(people);
+    Writeln(p.title, p.second.age, total);
+    Writeln(people[1].name, people[1].age, people[50].age)
+end.
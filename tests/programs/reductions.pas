@@ -0,0 +1,51 @@
+program reductions;
+const
+    n = 60000;
+var
+    i, sum, down, low, high, odd, empty: integer;
+    total, least, most: real;
+begin
+    sum := 0;
+    odd := 0;
+    {$PARALLEL}
+    for i := 1 to n do
+    begin
+        sum := sum + i;
+        odd := odd + i mod 2;
+    end;
+    Writeln(sum, ' ', odd);
+
+    down := 0;
+    {$PARALLEL}
+    for i := n downto 1 do
+        down := down - i mod 7;
+    Writeln(down);
+
+    low := 2147483647;
+    high := -2147483647 - 1;
+    {$PARALLEL}
+    for i := 1 to n do
+    begin
+        if (i * 7919) mod 60013 < low then low := (i * 7919) mod 60013;
+        if high < (i * 7919) mod 60013 then high := (i * 7919) mod 60013;
+    end;
+    Writeln(low, ' ', high);
+
+    total := 0;
+    least := 1000000;
+    most := -1000000;
+    {$PARALLEL}
+    for i := 1 to n do
+    begin
+        total := total + (i mod 8) * 0.25;
+        if (i mod 1000) * 0.5 - 100 <= least then least := (i mod 1000) * 0.5 - 100;
+        if (i mod 1000) * 0.5 - 100 >= most then most := (i mod 1000) * 0.5 - 100;
+    end;
+    Writeln(total:0:2, ' ', least:0:2, ' ', most:0:2);
+
+    empty := 5;
+    {$PARALLEL}
+    for i := 1 to 0 do
+        empty := empty + i;
+    Writeln(empty);
+end.
@@ -0,0 +1,44 @@
+program var_alias;
+var
+    g, y, h: integer;
+
+procedure bump(var a: integer);
+begin
+    while a < 5 do
+    begin
+        a := a + 1;
+        y := g * 10;
+        Writeln(y)
+    end
+end;
+
+procedure swap(var a, b: integer);
+var
+    i: integer;
+begin
+    for i := 1 to 3 do
+    begin
+        a := a + 1;
+        Writeln(b * 2)
+    end
+end;
+
+procedure reads(var a: integer);
+var
+    i: integer;
+begin
+    for i := 1 to 3 do
+    begin
+        g := g + 100;
+        Writeln(a + 1)
+    end
+end;
+
+begin
+    g := 0;
+    bump(g);
+    h := 1;
+    swap(h, h);
+    reads(g);
+    Writeln(g, y, h)
+end.
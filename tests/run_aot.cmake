@@ -0,0 +1,62 @@
+# Translates PROGRAM to C, builds it with CC and fails when the native program and the
+# interpreter disagree on the output, the errors or the exit status. Programs the C backend
+# does not support and programs that do not compile are skipped.
+# Usage: cmake -DPASCAL=pascal -DCC=cc -DPROGRAM=file.pas -DWORK=dir [-DINPUT=file.in] -P run_aot.cmake
+
+if (NOT INPUT)
+	set(INPUT /dev/null)
+endif ()
+get_filename_component(name ${PROGRAM} NAME_WE)
+file(MAKE_DIRECTORY ${WORK})
+set(native ${WORK}/${name})
+
+execute_process(COMMAND ${PASCAL} --emit-c -o ${native}.c ${PROGRAM}
+		ERROR_VARIABLE errors
+		RESULT_VARIABLE status)
+if (NOT status STREQUAL "0")
+	if (errors MATCHES "Not supported by the C backend")
+		message("SKIPPED: ${errors}")
+		return()
+	endif ()
+	execute_process(COMMAND ${PASCAL} ${PROGRAM}
+			INPUT_FILE ${INPUT}
+			OUTPUT_QUIET
+			ERROR_VARIABLE compile_errors)
+	string(FIND "${compile_errors}" "${errors}" at)
+	if (at EQUAL 0)
+		message("SKIPPED: ${PROGRAM} does not compile")
+		return()
+	endif ()
+	message(FATAL_ERROR "${PROGRAM} runs but is not translated to C (${status}):\n${errors}")
+endif ()
+execute_process(COMMAND ${CC} -O2 -o ${native} ${native}.c -lm
+		OUTPUT_VARIABLE output
+		ERROR_VARIABLE errors
+		RESULT_VARIABLE status)
+if (NOT status STREQUAL "0")
+	message(FATAL_ERROR "the C translation of ${PROGRAM} does not build:\n${output}${errors}")
+endif ()
+
+foreach (mode vm native)
+	if (mode STREQUAL vm)
+		set(command ${PASCAL} ${PROGRAM})
+	else ()
+		set(command ${native})
+	endif ()
+	execute_process(COMMAND ${command}
+			INPUT_FILE ${INPUT}
+			OUTPUT_VARIABLE ${mode}_output
+			ERROR_VARIABLE ${mode}_errors
+			RESULT_VARIABLE ${mode}_status
+			TIMEOUT 600)
+endforeach ()
+
+if (NOT vm_status STREQUAL native_status)
+	message(FATAL_ERROR "${PROGRAM} exits with ${vm_status} interpreted and ${native_status} native:\n${vm_errors}${native_errors}")
+endif ()
+if (NOT vm_output STREQUAL native_output)
+	message(FATAL_ERROR "the native output of ${PROGRAM} differs\n--- interpreter\n${vm_output}\n--- native\n${native_output}")
+endif ()
+if (NOT vm_errors STREQUAL native_errors)
+	message(FATAL_ERROR "the native errors of ${PROGRAM} differ\n--- interpreter\n${vm_errors}\n--- native\n${native_errors}")
+endif ()
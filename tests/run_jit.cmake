@@ -0,0 +1,61 @@
+# Runs PROGRAM with and without --jit and fails when the output, the errors or
+# the exit status differ, when the output is not EXPECTED or does not hash to the SHA-256 in
+# EXPECTED_SHA256, or when the errors do not contain ERRORS. A program with ERRORS must fail,
+# any other must succeed.
+# Usage: cmake -DPASCAL=pascal -DPROGRAM=file.pas [-DINPUT=file.in] [-DEXPECTED=file.out]
+#        [-DEXPECTED_SHA256=file.sha256] [-DERRORS=file.err] -P run_jit.cmake
+
+function(run_pascal prefix)
+	execute_process(COMMAND ${PASCAL} ${ARGN} ${PROGRAM}
+			INPUT_FILE ${INPUT}
+			OUTPUT_VARIABLE output
+			ERROR_VARIABLE errors
+			RESULT_VARIABLE status
+			TIMEOUT 600)
+	set(${prefix}_output "${output}" PARENT_SCOPE)
+	set(${prefix}_errors "${errors}" PARENT_SCOPE)
+	set(${prefix}_status "${status}" PARENT_SCOPE)
+endfunction()
+
+if (NOT INPUT)
+	set(INPUT /dev/null)
+endif ()
+
+run_pascal(vm)
+run_pascal(jit --jit)
+
+if (NOT vm_status STREQUAL jit_status)
+	message(FATAL_ERROR "${PROGRAM} exits with ${vm_status} interpreted and ${jit_status} with --jit:\n${vm_errors}${jit_errors}")
+endif ()
+if (ERRORS AND vm_status STREQUAL "0")
+	message(FATAL_ERROR "${PROGRAM} succeeds but is expected to fail")
+elseif (NOT ERRORS AND NOT vm_status STREQUAL "0")
+	message(FATAL_ERROR "${PROGRAM} failed with ${vm_status}:\n${vm_errors}")
+endif ()
+if (NOT vm_output STREQUAL jit_output)
+	message(FATAL_ERROR "--jit changes the output of ${PROGRAM}\n--- interpreter\n${vm_output}\n--- jit\n${jit_output}")
+endif ()
+if (NOT vm_errors STREQUAL jit_errors)
+	message(FATAL_ERROR "--jit changes the errors of ${PROGRAM}\n--- interpreter\n${vm_errors}\n--- jit\n${jit_errors}")
+endif ()
+if (EXPECTED)
+	file(READ ${EXPECTED} expected)
+	if (NOT vm_output STREQUAL expected)
+		message(FATAL_ERROR "unexpected output of ${PROGRAM}\n--- expected\n${expected}\n--- actual\n${vm_output}")
+	endif ()
+endif ()
+if (EXPECTED_SHA256)
+	file(READ ${EXPECTED_SHA256} expected)
+	string(STRIP "${expected}" expected)
+	string(SHA256 actual "${vm_output}")
+	if (NOT actual STREQUAL expected)
+		message(FATAL_ERROR "unexpected output of ${PROGRAM}, its SHA-256 is ${actual} and not ${expected}")
+	endif ()
+endif ()
+if (ERRORS)
+	file(READ ${ERRORS} expected)
+	string(FIND "${vm_errors}" "${expected}" at)
+	if (at EQUAL -1)
+		message(FATAL_ERROR "unexpected errors of ${PROGRAM}\n--- expected\n${expected}\n--- actual\n${vm_errors}")
+	endif ()
+endif ()
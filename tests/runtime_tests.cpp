@@ -0,0 +1,456 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "aggregate.h"
+#include "interpreter.h"
+
+// Runs the test named by the argument or all of them, fails when a check fails.
+// Meant to be built with PASCAL_SANITIZE, most of what they check is memory safety.
+
+#ifndef PASCAL_SOURCE_DIR
+#define PASCAL_SOURCE_DIR "."
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+int failures = 0;
+std::string subject; // printed with the failed checks, the program a test is at
+
+#define CHECK(cond) \
+	if (!(cond)) { \
+		std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #cond; \
+		if (!subject.empty()) std::cerr << " (" << subject << ")"; \
+		std::cerr << std::endl; \
+		++failures; \
+	}
+
+const char* greeting = R"(program greeting;
+const
+    hello: string = 'Hello';
+var
+    name, text: string;
+begin
+    name := 'world';
+    text := hello + ', ' + name;
+    Writeln(text)
+end.
+)";
+
+const char* counter = R"(program counter;
+var
+    i, sum: integer;
+    text: string;
+begin
+    sum := 0;
+    for i := 1 to 10 do sum := sum + i;
+    text := 'done';
+    Writeln(text, sum)
+end.
+)";
+
+// strings in arrays and records of the globals and of routine frames reused between calls
+const char* labels = R"(program labels;
+type
+    entry = record
+        name: string;
+        count: integer
+    end;
+    table = array[1..3] of entry;
+var
+    i: integer;
+    names: array[1..4] of string;
+    rows: table;
+
+procedure fill(var t: table; prefix: string);
+var
+    k: integer;
+    made: table;
+begin
+    for k := 1 to 3 do
+    begin
+        made[k].name := prefix + names[k];
+        made[k].count := k
+    end;
+    t := made
+end;
+
+begin
+    names[1] := 'a';
+    names[2] := 'b';
+    names[3] := 'c';
+    for i := 1 to 5 do fill(rows, names[1 + i mod 3]);
+    Writeln(rows[1].name, rows[3].name, rows[3].count)
+end.
+)";
+
+const char* spin = R"(program spin;
+var
+    i: integer;
+begin
+    i := 0;
+    while true do i := i + 1
+end.
+)";
+
+const char* hoard = R"(program hoard;
+var
+    s: string;
+begin
+    s := 'x';
+    while true do s := s + s
+end.
+)";
+
+// no string is near the limit, together they are far over it
+const char* hoards = R"(program hoards;
+var
+    parts: array[1..200] of string;
+    s: string;
+    i: integer;
+begin
+    s := 'x';
+    for i := 1 to 14 do s := s + s;
+    for i := 1 to 200 do parts[i] := Copy(s, 1, 16000 + i)
+end.
+)";
+
+const char* greet = R"(program greet;
+var
+    name: string;
+    n, i, sum: integer;
+begin
+    Readln(name);
+    Read(n);
+    sum := 0;
+    for i := 1 to n do sum := sum + i;
+    Writeln('Hello, ' + name, sum)
+end.
+)";
+
+std::shared_ptr<const CompiledProgram> compile(const Interpreter& interpreter, const std::string& source) {
+	auto compiled = interpreter.compile(source);
+	if (!compiled) std::cerr << compiled.error << std::endl;
+	return compiled.program;
+}
+
+std::string slurp(const fs::path& path) {
+	std::ifstream fin(path, std::ios::binary);
+	std::stringstream ss;
+	ss << fin.rdbuf();
+	return ss.str();
+}
+
+// the examples, benchmarks and test programs, sorted
+std::vector<fs::path> programs() {
+	std::vector<fs::path> res;
+	for (const char* dir : {"examples", "benchmarks", "tests/programs"})
+		for (const auto& entry : fs::directory_iterator(fs::path(PASCAL_SOURCE_DIR) / dir))
+			if (entry.path().extension() == ".pas") res.push_back(entry.path());
+	std::sort(res.begin(), res.end());
+	return res;
+}
+
+// examples that are not valid programs on purpose
+bool invalid(const fs::path& program) {
+	return program.stem() == "error" || program.stem() == "if_conditional";
+}
+
+// the input next to the program or under tests/input, like the jit tests use
+std::string input_of(const fs::path& program) {
+	auto path = program;
+	if (path.replace_extension(".in"); fs::exists(path)) return slurp(path);
+	path = fs::path(PASCAL_SOURCE_DIR) / "tests" / "input" / program.filename();
+	if (path.replace_extension(".in"); fs::exists(path)) return slurp(path);
+	return {};
+}
+
+struct Outcome {
+	Status status;
+	std::string output, dump;
+};
+
+Outcome run(const Interpreter& interpreter, const std::shared_ptr<const CompiledProgram>& program, const std::string& input) {
+	std::istringstream in(input);
+	std::ostringstream out, dump;
+	auto context = interpreter.context(in, out);
+	const auto status = context.run(program);
+	context.dump(*program, dump);
+	return {status, out.str(), dump.str()};
+}
+
+// in slices of steps, fed the input a few bytes at a time whenever the program waits for it
+Outcome resumed(const Interpreter& interpreter, const std::shared_ptr<const CompiledProgram>& program, const std::string& input, uint64_t steps) {
+	std::istringstream none;
+	std::ostringstream out, dump;
+	auto context = interpreter.context(none, out);
+	Outcome res;
+	res.status = context.start(program);
+	context.feed({});
+	for (size_t fed = 0; res.status;) {
+		const auto slice = context.resume(steps);
+		if (slice.progress == Progress::Finished) {
+			res.status = slice;
+			break;
+		}
+		if (slice.progress != Progress::Waiting) continue;
+		if (fed < input.size()) context.feed(std::string_view(input).substr(fed, 3));
+		else context.close_input();
+		fed += 3;
+	}
+	context.dump(*program, dump);
+	res.output = out.str();
+	res.dump = dump.str();
+	return res;
+}
+
+//-------------------------lifetime------------------------------------
+
+// the frame keeps the strings of the program after the caller dropped it
+void context_outlives_program() {
+	const Interpreter interpreter;
+	std::istringstream in;
+	std::ostringstream out;
+	auto context = interpreter.context(in, out);
+	{
+		const auto program = compile(interpreter, greeting);
+		CHECK(program && context.run(program));
+	}
+	CHECK(out.str() == "Hello, world \n");
+}
+
+// the next run lets go of the previous program only once its frame is replaced
+void program_replaced_between_runs() {
+	const Interpreter interpreter;
+	std::istringstream in;
+	std::ostringstream out;
+	auto context = interpreter.context(in, out);
+	for (int i = 0; i < 3; ++i) {
+		CHECK(context.run(compile(interpreter, i % 2 ? counter : greeting)));
+		CHECK(context.run(compile(interpreter, i % 2 ? greeting : counter)));
+	}
+	const auto program = compile(interpreter, counter);
+	CHECK(context.run(program));
+	const auto* sum = context.variable(*program, "sum");
+	CHECK(sum && sum->value.int_ptr == 55);
+	CHECK(!context.variable(*compile(interpreter, counter), "sum"));
+}
+
+//-------------------------aggregates------------------------------------
+
+// storage without strings does not look at its types again, they may be gone
+void aggregate_outlives_types() {
+	auto types = std::make_unique<interpreter::AggregateTable>(1);
+	(*types)[0].element = {DataType::Integer};
+	(*types)[0].bounds = {{1, 1000}};
+	interpreter::layout(*types);
+	auto data = std::make_unique<interpreter::AggregateData>(*types, 0);
+	CHECK(data->count == 1000 && !data->strings);
+	types.reset();
+	data.reset();
+}
+
+void string_aggregates_between_runs() {
+	const Interpreter interpreter;
+	std::istringstream in;
+	std::ostringstream out;
+	auto context = interpreter.context(in, out);
+	for (int i = 0; i < 3; ++i) {
+		CHECK(context.run(compile(interpreter, labels)));
+		CHECK(context.run(compile(interpreter, greeting)));
+	}
+	CHECK(out.str().starts_with("ca cc 3 \nHello, world \n"));
+}
+
+//-------------------------programs------------------------------------
+
+// every example compiles and runs to completion without errors
+void examples_complete() {
+	const Interpreter interpreter;
+	for (const auto& path : programs()) {
+		if (path.parent_path().filename() != "examples") continue;
+		subject = path.string();
+		if (invalid(path)) {
+			CHECK(!interpreter.compile(slurp(path)));
+			continue;
+		}
+		const auto program = compile(interpreter, slurp(path));
+		CHECK(program);
+		if (!program) continue;
+		const auto outcome = run(interpreter, program, input_of(path));
+		CHECK(outcome.status);
+		CHECK(!outcome.output.empty() || !outcome.dump.empty());
+	}
+	subject.clear();
+}
+
+// a run split into slices, with the input fed in pieces, ends exactly like one that is not;
+// the benchmarks run long, they are only split in larger slices
+void resumed_matches_uninterrupted() {
+	const Interpreter interpreter;
+	for (const auto& path : programs()) {
+		if (invalid(path)) continue;
+		subject = path.string();
+		const auto program = compile(interpreter, slurp(path));
+		CHECK(program);
+		if (!program) continue;
+		const auto input = input_of(path);
+		const auto expected = run(interpreter, program, input);
+		const bool benchmark = path.parent_path().filename() == "benchmarks";
+		for (const uint64_t steps : benchmark ? std::vector<uint64_t>{997} : std::vector<uint64_t>{1, 7, 0}) {
+			const auto actual = resumed(interpreter, program, input, steps);
+			CHECK(actual.status.error == expected.status.error);
+			CHECK(actual.output == expected.output);
+			CHECK(actual.dump == expected.dump);
+		}
+	}
+	subject.clear();
+}
+
+//-------------------------limits------------------------------------
+
+Status limited(const Options& options, const char* source, uint64_t steps = 0) {
+	const Interpreter interpreter(options);
+	std::istringstream in;
+	std::ostringstream out;
+	auto context = interpreter.context(in, out);
+	if (auto status = context.start(compile(interpreter, source)); !status) return status;
+	for (;;)
+		if (const auto slice = context.resume(steps); slice.progress == Progress::Finished) return slice;
+}
+
+void step_limit() {
+	Options options;
+	options.max_steps = 5000;
+	for (const uint64_t steps : {uint64_t{0}, uint64_t{7}, uint64_t{5000}}) {
+		const Interpreter interpreter(options);
+		std::istringstream in;
+		std::ostringstream out;
+		auto context = interpreter.context(in, out);
+		const auto program = compile(interpreter, spin);
+		Status status = context.start(program);
+		while (status)
+			if (const auto slice = context.resume(steps); slice.progress == Progress::Finished) status = slice;
+		CHECK(status.error == "Step limit exceeded");
+		CHECK(context.steps() == 5000);
+		const auto* i = context.variable(*program, "i");
+		CHECK(i && i->value.int_ptr == 5001); // the body runs once before the first back edge
+	}
+	// a program within the limit is not stopped
+	options.max_steps = 1000;
+	CHECK(limited(options, counter));
+}
+
+void time_limit() {
+	Options options;
+	options.time_limit = 50;
+	CHECK(limited(options, spin).error == "Time limit exceeded");
+	CHECK(limited(options, spin, 100).error == "Time limit exceeded");
+}
+
+void memory_limit() {
+	Options options;
+	options.memory_limit = 1 << 20;
+	CHECK(limited(options, hoard).error == "Memory limit exceeded");
+	CHECK(limited(options, hoard, 3).error == "Memory limit exceeded");
+	CHECK(limited(options, hoards).error == "Memory limit exceeded");
+	CHECK(limited(options, hoards, 3).error == "Memory limit exceeded");
+	CHECK(limited(options, labels));
+	// released strings are given back
+	options.memory_limit = 8 << 20;
+	CHECK(limited(options, hoards));
+	CHECK(limited(options, R"(program churn;
+var
+    s, t: string;
+    i: integer;
+begin
+    s := 'x';
+    for i := 1 to 16 do s := s + s;
+    for i := 1 to 1000 do t := Copy(s, 1, 60000 + i)
+end.
+)"));
+}
+
+// a context goes on with the next program after one was stopped
+void context_reused_after_limit() {
+	Options options;
+	options.max_steps = 100;
+	const Interpreter interpreter(options);
+	std::istringstream in;
+	std::ostringstream out;
+	auto context = interpreter.context(in, out);
+	CHECK(context.run(compile(interpreter, spin)).error == "Step limit exceeded");
+	CHECK(context.run(compile(interpreter, greeting)));
+	CHECK(out.str() == "Hello, world \n");
+}
+
+// programs that never end are stopped by the limits while the others finish on the same thread
+void scheduler_limits() {
+	Options options;
+	options.max_steps = 100000;
+	options.memory_limit = 4u << 20;
+	const Interpreter interpreter(options);
+	Scheduler scheduler(options, 100);
+	const auto spinner = scheduler.spawn(compile(interpreter, spin));
+	const auto hoarder = scheduler.spawn(compile(interpreter, hoard));
+	std::vector<Scheduler::Task> tasks;
+	for (int i = 0; i < 20; ++i)
+		tasks.push_back(scheduler.spawn(compile(interpreter, greet)));
+	for (int i = 0; i < 20; ++i) {
+		scheduler.step();
+		scheduler.feed(tasks[i], "task " + std::to_string(i) + "\n" + std::to_string(i));
+	}
+	for (int i = 0; i < 20; ++i)
+		scheduler.close_input(tasks[i]);
+	scheduler.run();
+	CHECK(scheduler.status(spinner).error == "Step limit exceeded");
+	CHECK(scheduler.status(hoarder).error == "Memory limit exceeded");
+	for (int i = 0; i < 20; ++i) {
+		CHECK(scheduler.finished(tasks[i]) && scheduler.status(tasks[i]));
+		CHECK(scheduler.output(tasks[i]) == "Hello, task " + std::to_string(i) + " " + std::to_string(i * (i + 1) / 2) + " \n");
+	}
+}
+
+struct Test {
+	const char* name;
+	void (*run)();
+};
+
+const Test tests[] = {
+	{"context_outlives_program", context_outlives_program},
+	{"program_replaced_between_runs", program_replaced_between_runs},
+	{"aggregate_outlives_types", aggregate_outlives_types},
+	{"string_aggregates_between_runs", string_aggregates_between_runs},
+	{"examples_complete", examples_complete},
+	{"resumed_matches_uninterrupted", resumed_matches_uninterrupted},
+	{"step_limit", step_limit},
+	{"time_limit", time_limit},
+	{"memory_limit", memory_limit},
+	{"context_reused_after_limit", context_reused_after_limit},
+	{"scheduler_limits", scheduler_limits},
+};
+
+}
+
+// Usage: runtime_tests [test]
+int main(int argc, char** argv) {
+	bool found = false;
+	for (const auto& test : tests) {
+		if (argc > 1 && std::strcmp(argv[1], test.name) != 0) continue;
+		found = true;
+		test.run();
+	}
+	if (!found) {
+		std::cerr << "No such test: " << argv[1] << std::endl;
+		return 2;
+	}
+	return failures ? 1 : 0;
+}